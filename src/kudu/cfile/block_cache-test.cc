@@ -15,11 +15,21 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <cstring>
+#include <string>
+
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
 #include "kudu/cfile/block_cache.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int64(block_cache_secondary_capacity_mb);
+DECLARE_string(block_cache_secondary_dir);
+DECLARE_bool(cache_force_single_shard);
 
 namespace kudu {
 namespace cfile {
@@ -44,7 +54,7 @@ TEST(TestBlockCache, TestBasics) {
 
   // Insert and re-lookup
   BlockCacheHandle inserted_handle;
-  cache.Insert(&data, &inserted_handle);
+  cache.Insert(&data, Cache::NORMAL_PRIORITY, &inserted_handle);
   ASSERT_FALSE(data.valid());
   ASSERT_TRUE(inserted_handle.valid());
 
@@ -60,6 +70,46 @@ TEST(TestBlockCache, TestBasics) {
   ASSERT_FALSE(cache.Lookup(key1, Cache::EXPECT_IN_CACHE, &retrieved_handle));
 }
 
+class BlockCacheSecondaryTest : public KuduTest {};
+
+// Blocks evicted from the block cache are written to the secondary cache in
+// the background, and served from it once they've been written.
+TEST_F(BlockCacheSecondaryTest, TestEvictedBlocksAreServedFromSecondaryCache) {
+  FLAGS_block_cache_secondary_dir = GetTestPath("secondary");
+  FLAGS_block_cache_secondary_capacity_mb = 16;
+  // With a single shard, the first block is sure to be evicted.
+  FLAGS_cache_force_single_shard = true;
+  const int kBlockSize = 64 * 1024;
+  const int kNumBlocks = 64;
+  BlockCache cache(1024 * 1024);
+  cache.StartSecondaryCache("fs");
+  BlockCache::FileId id(1234);
+
+  for (int i = 0; i < kNumBlocks; i++) {
+    BlockCache::PendingEntry data = cache.Allocate(BlockCache::CacheKey(id, i), kBlockSize);
+    ASSERT_TRUE(data.valid());
+    memset(data.val_ptr(), i, kBlockSize);
+    BlockCacheHandle handle;
+    cache.Insert(&data, Cache::NORMAL_PRIORITY, &handle);
+  }
+
+  // The first block has long been evicted from memory, but is found once the
+  // writer thread has written it to the secondary cache.
+  BlockCache::CacheKey key(id, 0);
+  BlockCacheHandle handle;
+  MonoTime deadline = MonoTime::Now() + MonoDelta::FromSeconds(30);
+  while (!cache.Lookup(key, Cache::EXPECT_IN_CACHE, &handle)) {
+    ASSERT_LT(MonoTime::Now(), deadline) << "block never reached the secondary cache";
+    SleepFor(MonoDelta::FromMilliseconds(10));
+  }
+  ASSERT_EQ(kBlockSize, handle.data().size());
+  ASSERT_EQ(std::string(kBlockSize, '\0'), handle.data().ToString());
+
+  // Blocks the secondary cache never saw are still misses.
+  BlockCacheHandle missing;
+  ASSERT_FALSE(cache.Lookup(BlockCache::CacheKey(id, kNumBlocks), Cache::EXPECT_IN_CACHE,
+                            &missing));
+}
 
 } // namespace cfile
 } // namespace kudu
@@ -18,10 +18,13 @@
 #include <gflags/gflags.h>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/cfile/secondary_block_cache.h"
 #include "kudu/gutil/port.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/string_case.h"
 
@@ -30,11 +33,33 @@ TAG_FLAG(block_cache_capacity_mb, stable);
 
 DEFINE_string(block_cache_type, "DRAM",
               "Which type of block cache to use for caching data. "
-              "Valid choices are 'DRAM' or 'NVM'. DRAM, the default, "
-              "caches data in regular memory. 'NVM' caches data "
-              "in a memory-mapped file using the NVML library.");
+              "Valid choices are 'DRAM', 'SLRU' or 'NVM'. DRAM, the default, "
+              "caches data in regular memory. 'SLRU' also caches data in "
+              "regular memory, but with a segmented LRU eviction policy which "
+              "keeps blocks that are read repeatedly from being evicted by "
+              "large scans. 'NVM' caches data in a memory-mapped file using "
+              "the NVML library.");
 TAG_FLAG(block_cache_type, experimental);
 
+DEFINE_string(block_cache_secondary_dir, "",
+              "Directory in which to keep a secondary block cache, which holds "
+              "blocks evicted from the block cache in a file. Intended for a local "
+              "SSD on servers whose data is on slower disks. If empty, there is no "
+              "secondary block cache.");
+TAG_FLAG(block_cache_secondary_dir, experimental);
+
+DEFINE_int64(block_cache_secondary_capacity_mb, 10 * 1024,
+             "Capacity of the secondary block cache in MB, if "
+             "--block_cache_secondary_dir is set.");
+TAG_FLAG(block_cache_secondary_capacity_mb, experimental);
+
+DEFINE_bool(block_cache_secondary_persistent, false,
+            "Whether the contents of the secondary block cache survive restarts. "
+            "If false, the secondary block cache starts out empty.");
+TAG_FLAG(block_cache_secondary_persistent, experimental);
+
+using std::string;
+
 namespace kudu {
 
 class MetricEntity;
@@ -50,9 +75,11 @@ Cache* CreateCache(int64_t capacity) {
     t = NVM_CACHE;
   } else if (FLAGS_block_cache_type == "DRAM") {
     t = DRAM_CACHE;
+  } else if (FLAGS_block_cache_type == "SLRU") {
+    return NewSLRUCache(capacity, "block_cache");
   } else {
     LOG(FATAL) << "Unknown block cache type: '" << FLAGS_block_cache_type
-               << "' (expected 'DRAM' or 'NVM')";
+               << "' (expected 'DRAM', 'SLRU' or 'NVM')";
   }
   return NewLRUCache(t, capacity, "block_cache");
 }
@@ -64,7 +91,11 @@ BlockCache::BlockCache()
 }
 
 BlockCache::BlockCache(size_t capacity)
-  : cache_(CreateCache(capacity)) {
+  : secondary_cache_started_(false),
+    cache_(CreateCache(capacity)) {
+}
+
+BlockCache::~BlockCache() {
 }
 
 BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t val_size) {
@@ -75,22 +106,61 @@ BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t val_si
 
 bool BlockCache::Lookup(const CacheKey& key, Cache::CacheBehavior behavior,
                         BlockCacheHandle *handle) {
-  Cache::Handle *h = cache_->Lookup(Slice(reinterpret_cast<const uint8_t*>(&key),
-                                          sizeof(key)), behavior);
+  Slice key_slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
+  Cache::Handle *h = cache_->Lookup(key_slice, behavior);
+  if (h == nullptr && secondary_cache_) {
+    Cache::PendingHandle* ph = secondary_cache_->Lookup(key_slice, cache_.get());
+    if (ph != nullptr) {
+      // The block's original priority isn't known here.
+      h = cache_->Insert(ph, secondary_cache_.get(), Cache::NORMAL_PRIORITY);
+    }
+  }
   if (h != nullptr) {
     handle->SetHandle(cache_.get(), h);
   }
   return h != nullptr;
 }
 
-void BlockCache::Insert(BlockCache::PendingEntry* entry, BlockCacheHandle* inserted) {
-  Cache::Handle *h = cache_->Insert(entry->handle_, /* eviction_callback= */ nullptr);
+void BlockCache::Insert(BlockCache::PendingEntry* entry, Cache::Priority priority,
+                        BlockCacheHandle* inserted) {
+  // Blocks evicted from the cache are written to the secondary cache, if any.
+  Cache::Handle *h = cache_->Insert(entry->handle_, secondary_cache_.get(), priority);
   entry->handle_ = nullptr;
   inserted->SetHandle(cache_.get(), h);
 }
 
 void BlockCache::StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity) {
   cache_->SetMetrics(metric_entity);
+  MutexLock l(secondary_cache_lock_);
+  metric_entity_ = metric_entity;
+  if (secondary_cache_) {
+    secondary_cache_->SetMetrics(metric_entity);
+  }
+}
+
+void BlockCache::StartSecondaryCache(const string& fs_uuid) {
+  MutexLock l(secondary_cache_lock_);
+  if (secondary_cache_started_) {
+    return;
+  }
+  secondary_cache_started_ = true;
+  if (FLAGS_block_cache_secondary_dir.empty()) {
+    return;
+  }
+  gscoped_ptr<SecondaryBlockCache> secondary;
+  Status s = SecondaryBlockCache::Open(Env::Default(), FLAGS_block_cache_secondary_dir,
+                                       FLAGS_block_cache_secondary_capacity_mb * 1024 * 1024,
+                                       FLAGS_block_cache_secondary_persistent, fs_uuid,
+                                       &secondary);
+  if (!s.ok()) {
+    // The secondary cache only speeds up reads, so the server can do without.
+    LOG(WARNING) << s.ToString() << "; running without a secondary block cache";
+    return;
+  }
+  if (metric_entity_) {
+    secondary->SetMetrics(metric_entity_);
+  }
+  secondary_cache_ = secondary.Pass();
 }
 
 } // namespace cfile
@@ -18,6 +18,8 @@
 #define KUDU_CFILE_BLOCK_CACHE_H
 
 #include <algorithm>
+#include <string>
+
 #include <glog/logging.h>
 
 #include "kudu/fs/block_id.h"
@@ -25,16 +27,19 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/singleton.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/mutex.h"
 
 DECLARE_string(block_cache_type);
 
 namespace kudu {
 
+class MetricEntity;
 class MetricRegistry;
 
 namespace cfile {
 
 class BlockCacheHandle;
+class SecondaryBlockCache;
 
 // Wrapper around kudu::Cache specifically for caching blocks of CFiles.
 // Provides a singleton and LRU cache for CFile blocks.
@@ -111,7 +116,10 @@ class BlockCache {
 
   explicit BlockCache(size_t capacity);
 
-  // Lookup the given block in the cache.
+  ~BlockCache();
+
+  // Lookup the given block in the cache. Blocks found in the secondary
+  // cache (see --block_cache_secondary_dir) are inserted back into the cache.
   //
   // If the entry is found, then sets *handle to refer to the entry.
   // This object's destructor will release the cache entry so it may be freed again.
@@ -127,6 +135,15 @@ class BlockCache {
   // Calling StartInstrumentation multiple times will reset the metrics each time.
   void StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity);
 
+  // Opens the secondary cache (see --block_cache_secondary_dir), if one is
+  // configured, for the blocks of the filesystem whose UUID is 'fs_uuid'.
+  // The secondary cache can only be opened once the filesystem is, since a
+  // persistent secondary cache may only be reused by the same filesystem.
+  //
+  // This should be called before the block cache starts serving blocks.
+  // Only the first call has any effect.
+  void StartSecondaryCache(const std::string& fs_uuid);
+
   // Insertion path
   // --------------------
   // Block cache entries are written in two phases. First, a pending entry must be
@@ -143,14 +160,18 @@ class BlockCache {
   //   RETURN_NOT_OK(ReadDataFromDiskIntoBuffer(entry.val_ptr()));
   //   // "Commit" the entry to the cache
   //   BlockCacheHandle bch;
-  //   cache->Insert(&entry, &bch);
+  //   cache->Insert(&entry, Cache::NORMAL_PRIORITY, &bch);
 
   // Allocate a new entry to be inserted into the cache.
   PendingEntry Allocate(const CacheKey& key, size_t block_size);
 
   // Insert the given block into the cache. 'inserted' is set to refer to the
   // entry in the cache.
-  void Insert(PendingEntry* entry, BlockCacheHandle* inserted);
+  //
+  // Blocks which are needed to read any other block of a CFile (i.e. index,
+  // bloom filter and dictionary blocks) should be inserted with high
+  // priority, so that they're evicted after data blocks.
+  void Insert(PendingEntry* entry, Cache::Priority priority, BlockCacheHandle* inserted);
 
  private:
   friend class Singleton<BlockCache>;
@@ -158,6 +179,15 @@ class BlockCache {
 
   DISALLOW_COPY_AND_ASSIGN(BlockCache);
 
+  // Protects the members below when the secondary cache is started.
+  Mutex secondary_cache_lock_;
+  bool secondary_cache_started_;
+  scoped_refptr<MetricEntity> metric_entity_;
+
+  // Receives the blocks evicted from 'cache_'. Declared before 'cache_' so
+  // that it outlives 'cache_', whose destruction evicts all of its blocks.
+  gscoped_ptr<SecondaryBlockCache> secondary_cache_;
+
   gscoped_ptr<Cache> cache_;
 };
 
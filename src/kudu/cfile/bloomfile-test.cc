@@ -18,7 +18,10 @@
 #include "kudu/cfile/bloomfile-test-base.h"
 #include "kudu/fs/fs-test-util.h"
 
+DECLARE_bool(cfile_blocked_bloom_filters);
+
 using std::shared_ptr;
+using std::vector;
 
 namespace kudu {
 namespace cfile {
@@ -57,6 +60,38 @@ class BloomFileTest : public BloomFileTestBase {
     ASSERT_LT(fp_rate, FLAGS_fp_rate + FLAGS_fp_rate * 0.20f)
       << "Should be no more than 1.2x the expected FP rate";
   }
+
+  // Checks a sorted batch of keys, some of which were inserted and some of
+  // which weren't, with CheckKeysPresent(), and verifies that each result
+  // matches CheckKeyPresent() for the same key.
+  void VerifyCheckKeysPresent() {
+    vector<uint64_t> keys;
+    for (uint64_t i = 0; i < FLAGS_n_keys + 10; i += 3) {
+      // Inserted keys have their low bits clear.
+      keys.push_back(BigEndian::FromHost64((i << kKeyShift) | (i % 2)));
+    }
+    vector<BloomKeyProbe> probes;
+    for (const uint64_t& key : keys) {
+      probes.emplace_back(Slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key)));
+    }
+    vector<const BloomKeyProbe*> probe_ptrs;
+    for (const auto& probe : probes) {
+      probe_ptrs.push_back(&probe);
+    }
+    gscoped_ptr<bool[]> present(new bool[probes.size()]);
+    ASSERT_OK(bfr_->CheckKeysPresent(probe_ptrs, present.get()));
+
+    for (int i = 0; i < probes.size(); i++) {
+      SCOPED_TRACE(i);
+      bool expected = false;
+      ASSERT_OK(bfr_->CheckKeyPresent(probes[i], &expected));
+      ASSERT_EQ(expected, present[i]);
+      uint64_t key = BigEndian::ToHost64(keys[i]);
+      if ((key & 1) == 0 && (key >> kKeyShift) < FLAGS_n_keys) {
+        ASSERT_TRUE(present[i]);
+      }
+    }
+  }
 };
 
 
@@ -64,6 +99,34 @@ TEST_F(BloomFileTest, TestWriteAndRead) {
   ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
   ASSERT_OK(OpenBloomFile());
   VerifyBloomFile();
+  VerifyCheckKeysPresent();
+}
+
+TEST_F(BloomFileTest, TestBlockedWriteAndRead) {
+  FLAGS_cfile_blocked_bloom_filters = true;
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
+  ASSERT_OK(OpenBloomFile());
+  VerifyBloomFile();
+  VerifyCheckKeysPresent();
+
+  // Check a sorted batch of keys, spanning several bloom blocks, at once.
+  vector<uint64_t> keys;
+  for (uint64_t i = 0; i < FLAGS_n_keys; i += 7) {
+    keys.push_back(BigEndian::FromHost64(i << kKeyShift));
+  }
+  vector<BloomKeyProbe> probes;
+  for (const uint64_t& key : keys) {
+    probes.emplace_back(Slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key)));
+  }
+  vector<const BloomKeyProbe*> probe_ptrs;
+  for (const auto& probe : probes) {
+    probe_ptrs.push_back(&probe);
+  }
+  gscoped_ptr<bool[]> present(new bool[probes.size()]);
+  ASSERT_OK(bfr_->CheckKeysPresent(probe_ptrs, present.get()));
+  for (int i = 0; i < probes.size(); i++) {
+    ASSERT_TRUE(present[i]) << i;
+  }
 }
 
 #ifdef NDEBUG
@@ -19,35 +19,65 @@
 #include <sched.h>
 #include <string>
 #include <unistd.h>
+#include <vector>
 
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/sysinfo.h"
 #include "kudu/util/coding.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/pb_util.h"
 
 DECLARE_bool(cfile_lazy_open);
 
+DEFINE_bool(cfile_blocked_bloom_filters, false,
+            "Whether to write the bloom filters of new bloom files in the blocked "
+            "format, in which probing a key touches a single cache line. Such files "
+            "can't be read by versions which don't support the format.");
+TAG_FLAG(cfile_blocked_bloom_filters, experimental);
+TAG_FLAG(cfile_blocked_bloom_filters, runtime);
+
 namespace kudu {
 namespace cfile {
 
+using std::vector;
+
 using fs::ReadableBlock;
 using fs::ScopedWritableBlockCloser;
 using fs::WritableBlock;
 
+namespace {
+
+// Returns whether the filter of a bloom block with header 'hdr' may contain
+// the key of 'probe'.
+bool BloomBlockMayContainKey(const BloomBlockHeaderPB& hdr, const Slice& bloom_data,
+                             const BloomKeyProbe& probe) {
+  if (hdr.format() == BLOCKED_BLOOM_FILTER) {
+    return BlockedBloomFilter(bloom_data).MayContainKey(probe);
+  }
+  return BloomFilter(bloom_data, hdr.num_hash_functions()).MayContainKey(probe);
+}
+
+} // anonymous namespace
+
 ////////////////////////////////////////////////////////////
 // Writer
 ////////////////////////////////////////////////////////////
 
 BloomFileWriter::BloomFileWriter(gscoped_ptr<WritableBlock> block,
-                                 const BloomFilterSizing &sizing)
-  : bloom_builder_(sizing) {
+                                 const BloomFilterSizing &sizing) {
   cfile::WriterOptions opts;
   opts.write_posidx = false;
   opts.write_validx = true;
+  if (FLAGS_cfile_blocked_bloom_filters) {
+    blocked_bloom_builder_.reset(new BlockedBloomFilterBuilder(sizing));
+    opts.incompatible_features |= BLOCKED_BLOOM_FILTERS;
+  } else {
+    bloom_builder_.reset(new BloomFilterBuilder(sizing));
+  }
   // Never use compression, regardless of the default settings, since
   // bloom filters are high-entropy data structures by their nature.
   opts.storage_attributes.encoding  = PLAIN_ENCODING;
@@ -66,7 +96,7 @@ Status BloomFileWriter::Finish() {
 }
 
 Status BloomFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer) {
-  if (bloom_builder_.count() > 0) {
+  if (bloom_count() > 0) {
     RETURN_NOT_OK(FinishCurrentBloomBlock());
   }
   return writer_->FinishAndReleaseBlock(closer);
@@ -76,20 +106,32 @@ size_t BloomFileWriter::written_size() const {
   return writer_->written_size();
 }
 
+size_t BloomFileWriter::bloom_count() const {
+  return blocked_bloom_builder_ ? blocked_bloom_builder_->count() : bloom_builder_->count();
+}
+
 Status BloomFileWriter::AppendKeys(
   const Slice *keys, size_t n_keys) {
+  if (blocked_bloom_builder_) {
+    return AppendKeysToBuilder(blocked_bloom_builder_.get(), keys, n_keys);
+  }
+  return AppendKeysToBuilder(bloom_builder_.get(), keys, n_keys);
+}
 
+template<class Builder>
+Status BloomFileWriter::AppendKeysToBuilder(Builder* builder,
+                                            const Slice *keys, size_t n_keys) {
   // If this is the call on a new bloom, copy the first key.
-  if (bloom_builder_.count() == 0 && n_keys > 0) {
+  if (builder->count() == 0 && n_keys > 0) {
     first_key_.assign_copy(keys[0].data(), keys[0].size());
   }
 
   for (size_t i = 0; i < n_keys; i++) {
 
-    bloom_builder_.AddKey(BloomKeyProbe(keys[i]));
+    builder->AddKey(BloomKeyProbe(keys[i]));
 
     // Bloom has reached optimal occupancy: flush it to the file
-    if (PREDICT_FALSE(bloom_builder_.count() >= bloom_builder_.expected_count())) {
+    if (PREDICT_FALSE(builder->count() >= builder->expected_count())) {
       RETURN_NOT_OK(FinishCurrentBloomBlock());
 
       // Update the last key and set the next key as the first key of the next block.
@@ -111,7 +153,15 @@ Status BloomFileWriter::FinishCurrentBloomBlock() {
 
   // Encode the header.
   BloomBlockHeaderPB hdr;
-  hdr.set_num_hash_functions(bloom_builder_.n_hashes());
+  Slice bloom_data;
+  if (blocked_bloom_builder_) {
+    hdr.set_num_hash_functions(BlockedBloomFilter::kNumHashes);
+    hdr.set_format(BLOCKED_BLOOM_FILTER);
+    bloom_data = blocked_bloom_builder_->slice();
+  } else {
+    hdr.set_num_hash_functions(bloom_builder_->n_hashes());
+    bloom_data = bloom_builder_->slice();
+  }
   faststring hdr_str;
   PutFixed32(&hdr_str, hdr.ByteSize());
   pb_util::AppendToString(hdr, &hdr_str);
@@ -119,14 +169,18 @@ Status BloomFileWriter::FinishCurrentBloomBlock() {
   // The data is the concatenation of the header and the bloom itself.
   vector<Slice> slices;
   slices.push_back(Slice(hdr_str));
-  slices.push_back(bloom_builder_.slice());
+  slices.push_back(bloom_data);
 
   // Append to the file.
   Slice start_key(first_key_);
   Slice last_key(last_key_);
   RETURN_NOT_OK(writer_->AppendRawBlock(slices, 0, &start_key, last_key, "bloom block"));
 
-  bloom_builder_.Clear();
+  if (blocked_bloom_builder_) {
+    blocked_bloom_builder_->Clear();
+  } else {
+    bloom_builder_->Clear();
+  }
 
   #ifndef NDEBUG
   first_key_.assign_copy("POST_RESET");
@@ -236,33 +290,41 @@ Status BloomFileReader::ParseBlockHeader(const Slice &block,
   }
 
   data.remove_prefix(header_len);
+  if (hdr->format() == BLOCKED_BLOOM_FILTER &&
+      (data.empty() || data.size() % BlockedBloomFilter::kBucketBytes != 0)) {
+    return Status::Corruption(
+      StringPrintf("Invalid blocked bloom filter size %ld", data.size()));
+  }
   *bloom_data = data;
   return Status::OK();
 }
 
-Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
-                                        bool *maybe_present) {
-  DCHECK(init_once_.initted());
-
+cfile::IndexTreeIterator* BloomFileReader::LockIndexIterator(
+    std::unique_lock<simple_spinlock>* lock) {
 #if defined(__linux__)
   int cpu = sched_getcpu();
 #else
   // Use just one lock if on OS X.
   int cpu = 0;
 #endif
+  while (true) {
+    std::unique_lock<simple_spinlock> l(iter_locks_[cpu], std::try_to_lock);
+    if (l.owns_lock()) {
+      lock->swap(l);
+      return index_iters_[cpu].get();
+    }
+    cpu = (cpu + 1) % index_iters_.size();
+  }
+}
+
+Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
+                                        bool *maybe_present) {
+  DCHECK(init_once_.initted());
+
   BlockPointer bblk_ptr;
   {
     std::unique_lock<simple_spinlock> lock;
-    while (true) {
-      std::unique_lock<simple_spinlock> l(iter_locks_[cpu], std::try_to_lock);
-      if (l.owns_lock()) {
-        lock.swap(l);
-        break;
-      }
-      cpu = (cpu + 1) % index_iters_.size();
-    }
-
-    cfile::IndexTreeIterator *index_iter = index_iters_[cpu].get();
+    cfile::IndexTreeIterator *index_iter = LockIndexIterator(&lock);
 
     Status s = index_iter->SeekAtOrBefore(probe.key());
     if (PREDICT_FALSE(s.IsNotFound())) {
@@ -277,7 +339,8 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   }
 
   BlockHandle dblk_data;
-  RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, &dblk_data));
+  RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, Cache::HIGH_PRIORITY,
+                                   &dblk_data));
 
   // Parse the header in the block.
   BloomBlockHeaderPB hdr;
@@ -285,8 +348,52 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
 
   // Actually check the bloom filter.
-  BloomFilter bf(bloom_data, hdr.num_hash_functions());
-  *maybe_present = bf.MayContainKey(probe);
+  *maybe_present = BloomBlockMayContainKey(hdr, bloom_data, probe);
+  return Status::OK();
+}
+
+Status BloomFileReader::CheckKeysPresent(const vector<const BloomKeyProbe*>& probes,
+                                         bool* maybe_present) {
+  DCHECK(init_once_.initted());
+
+  // Find the bloom block of each key. Keys which sort before the first
+  // entry in the file can't be present; their block pointers are left
+  // empty.
+  vector<BlockPointer> bblk_ptrs(probes.size(), BlockPointer(0, 0));
+  {
+    std::unique_lock<simple_spinlock> lock;
+    cfile::IndexTreeIterator *index_iter = LockIndexIterator(&lock);
+    for (int i = 0; i < probes.size(); i++) {
+      Status s = index_iter->SeekAtOrBefore(probes[i]->key());
+      if (PREDICT_FALSE(s.IsNotFound())) {
+        continue;
+      }
+      RETURN_NOT_OK(s);
+      bblk_ptrs[i] = index_iter->GetCurrentBlockPointer();
+    }
+  }
+
+  // Since the keys are sorted, the keys sharing a block are adjacent.
+  BlockHandle dblk_data;
+  BlockPointer cur_ptr(0, 0);
+  BloomBlockHeaderPB hdr;
+  Slice bloom_data;
+  for (int i = 0; i < probes.size(); i++) {
+    const BlockPointer& ptr = bblk_ptrs[i];
+    if (ptr.size() == 0) {
+      maybe_present[i] = false;
+      continue;
+    }
+    if (ptr.offset() != cur_ptr.offset() || cur_ptr.size() == 0) {
+      BlockHandle new_data;
+      RETURN_NOT_OK(reader_->ReadBlock(ptr, CFileReader::CACHE_BLOCK, Cache::HIGH_PRIORITY,
+                                       &new_data));
+      dblk_data = std::move(new_data);
+      RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
+      cur_ptr = ptr;
+    }
+    maybe_present[i] = BloomBlockMayContainKey(hdr, bloom_data, *probes[i]);
+  }
   return Status::OK();
 }
 
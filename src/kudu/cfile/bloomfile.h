@@ -18,6 +18,7 @@
 #define KUDU_CFILE_BLOOMFILE_H
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -53,11 +54,20 @@ class BloomFileWriter {
  private:
   DISALLOW_COPY_AND_ASSIGN(BloomFileWriter);
 
+  template<class Builder>
+  Status AppendKeysToBuilder(Builder* builder, const Slice *keys, size_t n_keys);
+
   Status FinishCurrentBloomBlock();
 
+  // Returns the number of keys in the current bloom filter.
+  size_t bloom_count() const;
+
   gscoped_ptr<cfile::CFileWriter> writer_;
 
-  BloomFilterBuilder bloom_builder_;
+  // Exactly one of these is set, depending on the format of the filters
+  // being written.
+  gscoped_ptr<BloomFilterBuilder> bloom_builder_;
+  gscoped_ptr<BlockedBloomFilterBuilder> blocked_bloom_builder_;
 
   // first key inserted in the current block.
   faststring first_key_;
@@ -103,6 +113,15 @@ class BloomFileReader {
   Status CheckKeyPresent(const BloomKeyProbe &probe,
                          bool *maybe_present);
 
+  // Like CheckKeyPresent(), for each of 'probes', which must be sorted by
+  // key. Sets maybe_present[i] for the i-th probe.
+  //
+  // Consecutive keys which fall in the same bloom filter block share a
+  // single read of the block, so this is much cheaper than checking each of
+  // the keys with CheckKeyPresent().
+  Status CheckKeysPresent(const std::vector<const BloomKeyProbe*>& probes,
+                          bool* maybe_present);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BloomFileReader);
 
@@ -117,6 +136,10 @@ class BloomFileReader {
                           BloomBlockHeaderPB *hdr,
                           Slice *bloom_data) const;
 
+  // Locks one of 'index_iters_' with 'lock', preferring the one for the
+  // current CPU, and returns it.
+  cfile::IndexTreeIterator* LockIndexIterator(std::unique_lock<simple_spinlock>* lock);
+
   // Callback used in 'init_once_' to initialize this bloom file.
   Status InitOnce();
 
@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 #include <glog/logging.h>
 #include <stdlib.h>
+#include <cmath>
 #include <list>
 
 #include "kudu/cfile/cfile-test-base.h"
@@ -26,15 +27,19 @@
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/cfile/zone_map.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/fs/fs-test-util.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/stopwatch.h"
 
 DECLARE_string(block_cache_type);
+DECLARE_int32(cfile_readahead_max_blocks);
 DECLARE_string(cfile_do_on_finish);
 
 #if defined(__linux__)
@@ -47,6 +52,7 @@ METRIC_DECLARE_counter(block_cache_hits_caching);
 METRIC_DECLARE_entity(server);
 
 using std::shared_ptr;
+using strings::Substitute;
 
 namespace kudu {
 namespace cfile {
@@ -55,6 +61,36 @@ using fs::CountingReadableBlock;
 using fs::ReadableBlock;
 using fs::WritableBlock;
 
+// Decodes a bound of a ZoneMapPB into a cell.
+template<typename T>
+T DecodeZoneMapBound(const string& bound) {
+  T val;
+  CHECK_EQ(sizeof(val), bound.size());
+  memcpy(&val, bound.data(), sizeof(val));
+  return val;
+}
+
+template<>
+Slice DecodeZoneMapBound<Slice>(const string& bound) {
+  return Slice(bound);
+}
+
+// Generates nullable UINT32 values with the usual NULL pattern, except that
+// every row from 'first_null' onwards is NULL.
+class TrailingNullsUInt32DataGenerator : public UInt32DataGenerator<true> {
+ public:
+  explicit TrailingNullsUInt32DataGenerator(size_t first_null)
+      : first_null_(first_null) {
+  }
+
+  bool TestValueShouldBeNull(size_t n) OVERRIDE {
+    return n >= first_null_ || UInt32DataGenerator<true>::TestValueShouldBeNull(n);
+  }
+
+ private:
+  const size_t first_null_;
+};
+
 class TestCFile : public CFileTestBase {
  protected:
   template <class DataGeneratorType>
@@ -207,6 +243,177 @@ class TestCFile : public CFileTestBase {
   }
 
 
+  // Scans the file in batches, skipping runs of unselected rows, and checks
+  // that the selected rows are materialized correctly.
+  template <class DataGeneratorType>
+  void TestScanSelectedRows(DataGeneratorType* generator, EncodingType encoding) {
+    const size_t kNumEntries = 10000;
+    BlockId block_id;
+    WriteTestFile(generator, encoding, NO_COMPRESSION, kNumEntries, SMALL_BLOCKSIZE, &block_id);
+
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToFirst());
+
+    ScopedColumnBlock<DataGeneratorType::kDataType> cb(1000);
+    SelectionVector sel(cb.nrows());
+    size_t fetched = 0;
+    while (iter->HasNext()) {
+      // Select runs of random lengths, some of which span whole data blocks.
+      sel.SetAllFalse();
+      for (size_t i = 0; i < cb.nrows(); ) {
+        size_t run = std::min<size_t>(random() % 300 + 1, cb.nrows() - i);
+        if (random() % 2) {
+          BitmapChangeBits(sel.mutable_bitmap(), i, run, true);
+        }
+        i += run;
+      }
+      ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&cb, &sel);
+      ctx.SetSkipUnselectedRows();
+      size_t n = cb.nrows();
+      ASSERT_OK(iter->CopyNextValues(&n, &ctx));
+
+      for (size_t i = 0; i < n; i++) {
+        if (!sel.IsRowSelected(i)) continue;
+        size_t row = fetched + i;
+        SCOPED_TRACE(row);
+        bool expect_null = generator->TestValueShouldBeNull(row);
+        ASSERT_EQ(expect_null, cb.is_null(i));
+        if (!expect_null) {
+          ASSERT_EQ(generator->BuildTestValue(0, row), cb[i]);
+        }
+      }
+      fetched += n;
+      cb.arena()->Reset();
+    }
+    ASSERT_EQ(kNumEntries, fetched);
+  }
+
+  // Writes a file of RLE-encoded ints whose rows from 'first_null' onwards
+  // are NULL, and scans its last rows skipping an unselected run which ends
+  // among those NULLs.
+  void TestScanSelectedRowsBeforeTrailingNulls(size_t first_null) {
+    const size_t kNumEntries = 10000;
+    TrailingNullsUInt32DataGenerator generator(first_null);
+    BlockId block_id;
+    WriteTestFile(&generator, RLE, NO_COMPRESSION, kNumEntries, SMALL_BLOCKSIZE, &block_id);
+
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+
+    // Select the first and last few rows of the batch. The unselected run
+    // between them ends among the trailing NULLs.
+    const size_t first_row = first_null > 100 ? first_null - 100 : 0;
+    const size_t kBatchRows = kNumEntries - first_row;
+    ASSERT_OK(iter->SeekToOrdinal(first_row));
+    ScopedColumnBlock<UINT32> cb(kBatchRows);
+    SelectionVector sel(cb.nrows());
+    sel.SetAllFalse();
+    BitmapChangeBits(sel.mutable_bitmap(), 0, 10, true);
+    BitmapChangeBits(sel.mutable_bitmap(), kBatchRows - 10, 10, true);
+    ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&cb, &sel);
+    ctx.SetSkipUnselectedRows();
+    size_t n = cb.nrows();
+    ASSERT_OK(iter->CopyNextValues(&n, &ctx));
+    ASSERT_EQ(kBatchRows, n);
+    for (size_t i = 0; i < n; i++) {
+      if (!sel.IsRowSelected(i)) continue;
+      size_t row = first_row + i;
+      SCOPED_TRACE(row);
+      bool expect_null = generator.TestValueShouldBeNull(row);
+      ASSERT_EQ(expect_null, cb.is_null(i));
+      if (!expect_null) {
+        ASSERT_EQ(generator.BuildTestValue(0, row), cb[i]);
+      }
+    }
+    ASSERT_FALSE(iter->HasNext());
+  }
+
+  // Writes a file with zone maps and checks that the zone map of each data
+  // block matches the values in it, and that predicates are checked against
+  // them correctly.
+  template <class DataGeneratorType>
+  void TestZoneMaps(DataGeneratorType* generator, EncodingType encoding) {
+    typedef typename DataGeneratorType::cpp_type cpp_type;
+    const TypeInfo* type_info = GetTypeInfo(DataGeneratorType::kDataType);
+    const size_t kNumEntries = 10000;
+    BlockId block_id;
+    WriteTestFile(generator, encoding, NO_COMPRESSION, kNumEntries,
+                  SMALL_BLOCKSIZE | WRITE_ZONE_MAPS, &block_id);
+
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    ASSERT_TRUE(reader->has_zone_maps());
+    BlockZoneMapsPB zone_maps;
+    ASSERT_OK(reader->ReadBlockZoneMaps(CFileReader::CACHE_BLOCK, &zone_maps));
+    ASSERT_GT(zone_maps.zone_maps_size(), 1);
+
+    ColumnSchema col("c", DataGeneratorType::kDataType, generator->has_nulls());
+    size_t first_row = 0;
+    int64_t total_nulls = 0;
+    for (const ZoneMapPB& zone_map : zone_maps.zone_maps()) {
+      size_t end_row = first_row + zone_map.num_rows();
+      SCOPED_TRACE(Substitute("rows $0-$1", first_row, end_row));
+      ASSERT_LE(end_row, kNumEntries);
+
+      int64_t nulls = 0;
+      for (size_t row = first_row; row < end_row; row++) {
+        if (generator->TestValueShouldBeNull(row)) {
+          nulls++;
+        }
+      }
+      ASSERT_EQ(nulls, zone_map.null_count());
+      total_nulls += nulls;
+      ASSERT_EQ(nulls < zone_map.num_rows(), zone_map.has_min_value());
+
+      ASSERT_EQ(nulls > 0, ZoneMapMayMatch(type_info, zone_map, ColumnPredicate::IsNull(col)));
+      ASSERT_EQ(nulls < zone_map.num_rows(),
+                ZoneMapMayMatch(type_info, zone_map, ColumnPredicate::IsNotNull(col)));
+      if (!zone_map.has_min_value()) {
+        first_row = end_row;
+        continue;
+      }
+
+      // Every value must be within the bounds, and the bounds must be values.
+      cpp_type min = DecodeZoneMapBound<cpp_type>(zone_map.min_value());
+      cpp_type max = DecodeZoneMapBound<cpp_type>(zone_map.max_value());
+      bool saw_min = false;
+      bool saw_max = false;
+      for (size_t row = first_row; row < end_row; row++) {
+        if (generator->TestValueShouldBeNull(row)) continue;
+        cpp_type val = generator->BuildTestValue(0, row);
+        ASSERT_GE(type_info->Compare(&val, &min), 0);
+        ASSERT_LE(type_info->Compare(&val, &max), 0);
+        saw_min |= type_info->Compare(&val, &min) == 0;
+        saw_max |= type_info->Compare(&val, &max) == 0;
+      }
+      ASSERT_TRUE(saw_min);
+      ASSERT_TRUE(saw_max);
+
+      ASSERT_TRUE(ZoneMapMayMatch(type_info, zone_map, ColumnPredicate::Equality(col, &min)));
+      ASSERT_TRUE(ZoneMapMayMatch(type_info, zone_map, ColumnPredicate::Equality(col, &max)));
+      ASSERT_TRUE(ZoneMapMayMatch(type_info, zone_map,
+                                  ColumnPredicate::Range(col, &max, nullptr)));
+      ASSERT_FALSE(ZoneMapMayMatch(type_info, zone_map,
+                                   ColumnPredicate::Range(col, nullptr, &min)));
+      first_row = end_row;
+    }
+    ASSERT_EQ(kNumEntries, first_row);
+
+    ASSERT_EQ(kNumEntries, reader->zone_map().num_rows());
+    ASSERT_EQ(total_nulls, reader->zone_map().null_count());
+  }
+
   void TestReadWriteRawBlocks(CompressionType compression, int num_entries) {
     // Test Write
     gscoped_ptr<WritableBlock> sink;
@@ -247,7 +454,8 @@ class TestCFile : public CFileTestBase {
     do {
       BlockHandle dblk_data;
       BlockPointer blk_ptr = iter->GetCurrentBlockPointer();
-      ASSERT_OK(reader->ReadBlock(blk_ptr, CFileReader::CACHE_BLOCK, &dblk_data));
+      ASSERT_OK(reader->ReadBlock(blk_ptr, CFileReader::CACHE_BLOCK, Cache::NORMAL_PRIORITY,
+                                  &dblk_data));
 
       memcpy(data + 12, &count, 4);
       ASSERT_EQ(expected_data, dblk_data.data());
@@ -782,6 +990,71 @@ TEST_P(TestCFileBothCacheTypes, TestNullDictStrings) {
   TestNullTypes(&generator, DICT_ENCODING, LZ4);
 }
 
+// Tests reading files while the blocks following each batch are read in the
+// background, including files whose blocks have to be decompressed.
+TEST_P(TestCFileBothCacheTypes, TestAsyncReadahead) {
+  FLAGS_cfile_readahead_max_blocks = 4;
+  TestReadWriteFixedSizeTypes<UInt32DataGenerator<false>>(PLAIN_ENCODING);
+  UInt32DataGenerator<true> generator;
+  TestNullTypes(&generator, PLAIN_ENCODING, LZ4);
+  StringDataGenerator<true> strings("hello %zu");
+  TestNullTypes(&strings, DICT_ENCODING, NO_COMPRESSION);
+}
+
+TEST_P(TestCFileBothCacheTypes, TestScanSelectedRows) {
+  UInt32DataGenerator<false> ints;
+  TestScanSelectedRows(&ints, BIT_SHUFFLE);
+  TestScanSelectedRows(&ints, RLE);
+  UInt32DataGenerator<true> nullable_ints;
+  TestScanSelectedRows(&nullable_ints, BIT_SHUFFLE);
+  TestScanSelectedRows(&nullable_ints, RLE);
+  TrailingNullsUInt32DataGenerator trailing_null_ints(9000);
+  TestScanSelectedRows(&trailing_null_ints, RLE);
+  TrailingNullsUInt32DataGenerator null_ints(0);
+  TestScanSelectedRows(&null_ints, RLE);
+  TestScanSelectedRowsBeforeTrailingNulls(9800);
+  TestScanSelectedRowsBeforeTrailingNulls(0);
+  StringDataGenerator<true> strings("hello %zu");
+  TestScanSelectedRows(&strings, DICT_ENCODING);
+  TestScanSelectedRows(&strings, PLAIN_ENCODING);
+}
+
+TEST_P(TestCFileBothCacheTypes, TestZoneMaps) {
+  Int32DataGenerator<false> ints;
+  TestZoneMaps(&ints, BIT_SHUFFLE);
+  Int32DataGenerator<true> nullable_ints;
+  TestZoneMaps(&nullable_ints, RLE);
+  FPDataGenerator<DOUBLE, true> doubles;
+  TestZoneMaps(&doubles, PLAIN_ENCODING);
+  StringDataGenerator<true> strings("hello %zu");
+  TestZoneMaps(&strings, DICT_ENCODING);
+  TestZoneMaps(&strings, PREFIX_ENCODING);
+}
+
+// Zone maps of cells which can't be ordered, or which are all NULL, must not
+// rule out any non-NULL values, or must rule out all of them, respectively.
+TEST_F(TestCFile, TestZoneMapBoundsUnknown) {
+  ColumnSchema col("c", DOUBLE, true);
+  const TypeInfo* type_info = col.type_info();
+  double val = 1;
+  ZoneMapPB pb;
+
+  ZoneMapBuilder builder(type_info);
+  vector<double> cells = { 1, std::nan(""), 3 };
+  builder.AddValues(cells.data(), cells.size());
+  builder.ToPB(&pb);
+  ASSERT_FALSE(pb.has_min_value());
+  ASSERT_TRUE(ZoneMapMayMatch(type_info, pb, ColumnPredicate::Equality(col, &val)));
+
+  builder.Reset();
+  builder.AddNulls(10);
+  builder.ToPB(&pb);
+  ASSERT_EQ(10, pb.null_count());
+  ASSERT_FALSE(pb.has_min_value());
+  ASSERT_FALSE(ZoneMapMayMatch(type_info, pb, ColumnPredicate::Equality(col, &val)));
+  ASSERT_TRUE(ZoneMapMayMatch(type_info, pb, ColumnPredicate::IsNull(col)));
+}
+
 TEST_P(TestCFileBothCacheTypes, TestReleaseBlock) {
   gscoped_ptr<WritableBlock> sink;
   ASSERT_OK(fs_manager_->CreateNewBlock(&sink));
@@ -888,6 +1161,7 @@ TEST_P(TestCFileBothCacheTypes, TestCacheKeysAreStable) {
     BlockHandle bh;
     ASSERT_OK(reader->ReadBlock(iter->GetCurrentBlockPointer(),
                                 CFileReader::CACHE_BLOCK,
+                                Cache::NORMAL_PRIORITY,
                                 &bh));
 
     // The first time through, we miss in the seek and in the ReadBlock().
@@ -898,6 +1172,54 @@ TEST_P(TestCFileBothCacheTypes, TestCacheKeysAreStable) {
   }
 }
 
+// Tests that reading many blocks at once, some of which are already cached,
+// yields the same data as reading them one at a time.
+TEST_P(TestCFileBothCacheTypes, TestReadBlocks) {
+  BlockId block_id;
+  {
+    UInt32DataGenerator<false> generator;
+    WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, 10000,
+                  SMALL_BLOCKSIZE, &block_id);
+  }
+
+  gscoped_ptr<ReadableBlock> source;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(source), ReaderOptions(), &reader));
+
+  vector<BlockPointer> ptrs;
+  gscoped_ptr<IndexTreeIterator> iter;
+  iter.reset(IndexTreeIterator::Create(reader.get(), reader->posidx_root()));
+  ASSERT_OK(iter->SeekToFirst());
+  ptrs.push_back(iter->GetCurrentBlockPointer());
+  while (iter->HasNext()) {
+    ASSERT_OK(iter->Next());
+    ptrs.push_back(iter->GetCurrentBlockPointer());
+  }
+  ASSERT_GT(ptrs.size(), 4U);
+
+  // Cache a block in the middle, so that the misses are split into two runs.
+  BlockHandle cached;
+  ASSERT_OK(reader->ReadBlock(ptrs[2], CFileReader::CACHE_BLOCK,
+                              Cache::NORMAL_PRIORITY, &cached));
+
+  vector<BlockHandle> handles;
+  ASSERT_OK(reader->ReadBlocks(ptrs, CFileReader::CACHE_BLOCK,
+                               Cache::NORMAL_PRIORITY, &handles));
+  ASSERT_EQ(ptrs.size(), handles.size());
+
+  // The file is uncompressed, so each block's data is exactly what's on disk.
+  gscoped_ptr<ReadableBlock> raw;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &raw));
+  for (int i = 0; i < ptrs.size(); i++) {
+    SCOPED_TRACE(ptrs[i].ToString());
+    gscoped_ptr<uint8_t[]> scratch(new uint8_t[ptrs[i].size()]);
+    Slice expected;
+    ASSERT_OK(raw->Read(ptrs[i].offset(), ptrs[i].size(), &expected, scratch.get()));
+    ASSERT_EQ(expected, handles[i].data());
+  }
+}
+
 #if defined(__linux__)
 // Inject failures in nvm allocation and ensure that we can still read a file.
 TEST_P(TestCFileBothCacheTypes, TestNvmAllocationFailure) {
@@ -20,6 +20,8 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <mutex>
+#include <vector>
 
 #include "kudu/cfile/binary_plain_block.h"
 #include "kudu/cfile/block_cache.h"
@@ -29,6 +31,8 @@
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/fs/async_block_reader.h"
+#include "kudu/gutil/bind.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -49,7 +53,31 @@ DEFINE_bool(cfile_lazy_open, true,
             "Allow lazily opening of cfiles");
 TAG_FLAG(cfile_lazy_open, hidden);
 
+DEFINE_int64(cfile_max_coalesced_read_size, 4 * 1024 * 1024,
+             "Maximum number of bytes of physically adjacent cfile blocks which "
+             "are read from disk in a single request. Set to 0 to read each "
+             "block on its own.");
+TAG_FLAG(cfile_max_coalesced_read_size, advanced);
+TAG_FLAG(cfile_max_coalesced_read_size, experimental);
+
+DEFINE_int32(cfile_readahead_max_blocks, 8,
+             "Maximum number of data blocks following each batch which cfile "
+             "iterators read in the background while the batch is being decoded, "
+             "once the iterator's reads look sequential. The number of blocks "
+             "read ahead starts small and doubles with each batch until it "
+             "reaches this limit. Set to 0 to read each block only when it's "
+             "needed.");
+TAG_FLAG(cfile_readahead_max_blocks, advanced);
+TAG_FLAG(cfile_readahead_max_blocks, experimental);
+
+DEFINE_int32(cfile_readahead_min_sequential_blocks, 2,
+             "Number of data blocks a cfile iterator must read in order since "
+             "its last seek before it starts reading blocks ahead of the scan.");
+TAG_FLAG(cfile_readahead_min_sequential_blocks, advanced);
+TAG_FLAG(cfile_readahead_min_sequential_blocks, experimental);
+
 using kudu::fs::ReadableBlock;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -62,6 +90,11 @@ const char* CFILE_CACHE_HIT_BYTES_METRIC_NAME = "cfile_cache_hit_bytes";
 static const size_t kMagicAndLengthSize = 12;
 static const size_t kMaxHeaderFooterPBSize = 64*1024;
 
+// The number of bytes read from each end of the file when opening it. This
+// usually covers the magic, length and protobuf of the header or footer, so
+// that each is read with a single request.
+static const size_t kSpeculativeReadSize = 4*1024;
+
 static Status ParseMagicAndLength(const Slice &data,
                                   uint8_t* cfile_version,
                                   uint32_t *parsed_len) {
@@ -127,18 +160,6 @@ Status CFileReader::OpenNoInit(gscoped_ptr<ReadableBlock> block,
   return Status::OK();
 }
 
-Status CFileReader::ReadMagicAndLength(uint64_t offset, uint32_t *len) {
-  TRACE_EVENT1("io", "CFileReader::ReadMagicAndLength",
-               "cfile", ToString());
-  uint8_t scratch[kMagicAndLengthSize];
-  Slice slice;
-
-  RETURN_NOT_OK(block_->Read(offset, kMagicAndLengthSize,
-                             &slice, scratch));
-
-  return ParseMagicAndLength(slice, &cfile_version_, len);
-}
-
 Status CFileReader::InitOnce() {
   VLOG(1) << "Initializing CFile with ID " << block_->id().ToString();
   TRACE_COUNTER_INCREMENT("cfile_init", 1);
@@ -147,11 +168,10 @@ Status CFileReader::InitOnce() {
 
   RETURN_NOT_OK(ReadAndParseFooter());
 
-  if (PREDICT_FALSE(footer_->incompatible_features() != 0)) {
-    // Currently we do not support any incompatible features.
+  if (PREDICT_FALSE(footer_->incompatible_features() & ~kSupportedIncompatibleFeatures)) {
     return Status::NotSupported(Substitute(
         "cfile uses features from an incompatible version: $0",
-        footer_->incompatible_features()));
+        footer_->incompatible_features() & ~kSupportedIncompatibleFeatures));
   }
 
   type_info_ = GetTypeInfo(footer_->data_type());
@@ -182,17 +202,26 @@ Status CFileReader::ReadAndParseHeader() {
 
   // First read and parse the "pre-header", which lets us know
   // that it is indeed a CFile and tells us the length of the
-  // proper protobuf header.
+  // proper protobuf header. The header itself is usually covered by
+  // the same read.
+  faststring buf;
+  buf.resize(std::min<uint64_t>(file_size_, kSpeculativeReadSize));
+  Slice data;
+  RETURN_NOT_OK(block_->Read(0, buf.size(), &data, buf.data()));
   uint32_t header_size;
-  RETURN_NOT_OK(ReadMagicAndLength(0, &header_size));
-
-  // Now read the protobuf header.
-  uint8_t header_space[header_size];
-  Slice header_slice;
+  RETURN_NOT_OK(ParseMagicAndLength(
+      Slice(data.data(), std::min(data.size(), kMagicAndLengthSize)),
+      &cfile_version_, &header_size));
+
+  // Now read the protobuf header, if it wasn't covered above.
+  if (kMagicAndLengthSize + header_size > data.size()) {
+    buf.resize(header_size);
+    RETURN_NOT_OK(block_->Read(kMagicAndLengthSize, header_size, &data, buf.data()));
+  } else {
+    data = Slice(data.data() + kMagicAndLengthSize, header_size);
+  }
   header_.reset(new CFileHeaderPB());
-  RETURN_NOT_OK(block_->Read(kMagicAndLengthSize, header_size,
-                             &header_slice, header_space));
-  if (!header_->ParseFromArray(header_slice.data(), header_size)) {
+  if (!header_->ParseFromArray(data.data(), header_size)) {
     return Status::Corruption("Invalid cfile pb header");
   }
 
@@ -210,19 +239,30 @@ Status CFileReader::ReadAndParseFooter() {
     "file too short: " << file_size_;
 
   // First read and parse the "post-footer", which has magic
-  // and the length of the actual protobuf footer
+  // and the length of the actual protobuf footer. As with the
+  // header, the footer itself is usually covered by the same read.
+  faststring buf;
+  size_t read_size = std::min<uint64_t>(file_size_, kSpeculativeReadSize);
+  buf.resize(read_size);
+  Slice data;
+  RETURN_NOT_OK_PREPEND(block_->Read(file_size_ - read_size, read_size, &data, buf.data()),
+                        "Failed to read magic and length from end of file");
   uint32_t footer_size;
-  RETURN_NOT_OK_PREPEND(ReadMagicAndLength(file_size_ - kMagicAndLengthSize, &footer_size),
+  RETURN_NOT_OK_PREPEND(ParseMagicAndLength(
+      Slice(data.data() + read_size - kMagicAndLengthSize, kMagicAndLengthSize),
+      &cfile_version_, &footer_size),
                         "Failed to read magic and length from end of file");
 
-  // Now read the protobuf footer.
+  // Now read the protobuf footer, if it wasn't covered above.
+  if (kMagicAndLengthSize + footer_size > read_size) {
+    uint64_t off = file_size_ - kMagicAndLengthSize - footer_size;
+    buf.resize(footer_size);
+    RETURN_NOT_OK(block_->Read(off, footer_size, &data, buf.data()));
+  } else {
+    data = Slice(data.data() + read_size - kMagicAndLengthSize - footer_size, footer_size);
+  }
   footer_.reset(new CFileFooterPB());
-  uint8_t footer_space[footer_size];
-  Slice footer_slice;
-  uint64_t off = file_size_ - kMagicAndLengthSize - footer_size;
-  RETURN_NOT_OK(block_->Read(off, footer_size,
-                             &footer_slice, footer_space));
-  if (!footer_->ParseFromArray(footer_slice.data(), footer_size)) {
+  if (!footer_->ParseFromArray(data.data(), footer_size)) {
     return Status::Corruption("Invalid cfile pb footer");
   }
 
@@ -236,8 +276,6 @@ Status CFileReader::ReadAndParseFooter() {
   return Status::OK();
 }
 
-namespace {
-
 // ScratchMemory acts as a holder for the destination buffer for a block read.
 // The buffer itself could either be allocated on the heap or be the value of
 // a pending block cache entry.
@@ -321,53 +359,51 @@ class ScratchMemory {
   int size_;
   DISALLOW_COPY_AND_ASSIGN(ScratchMemory);
 };
-} // anonymous namespace
 
-Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
-                              BlockHandle *ret) const {
-  DCHECK(init_once_.initted());
-  CHECK(ptr.offset() > 0 &&
-        ptr.offset() + ptr.size() < file_size_) <<
-    "bad offset " << ptr.ToString() << " in file of size "
-                  << file_size_;
+bool CFileReader::LookupBlock(const BlockPointer& ptr, CacheControl cache_control,
+                              BlockHandle* ret) const {
   BlockCacheHandle bc_handle;
   Cache::CacheBehavior cache_behavior = cache_control == CACHE_BLOCK ?
       Cache::EXPECT_IN_CACHE : Cache::NO_EXPECT_IN_CACHE;
-  BlockCache* cache = BlockCache::GetSingleton();
   BlockCache::CacheKey key(block_->id(), ptr.offset());
-  if (cache->Lookup(key, cache_behavior, &bc_handle)) {
-    TRACE_COUNTER_INCREMENT("cfile_cache_hit", 1);
-    TRACE_COUNTER_INCREMENT(CFILE_CACHE_HIT_BYTES_METRIC_NAME, ptr.size());
-    *ret = BlockHandle::WithDataFromCache(&bc_handle);
-    // Cache hit
-    return Status::OK();
+  if (!BlockCache::GetSingleton()->Lookup(key, cache_behavior, &bc_handle)) {
+    return false;
   }
+  TRACE_COUNTER_INCREMENT("cfile_cache_hit", 1);
+  TRACE_COUNTER_INCREMENT(CFILE_CACHE_HIT_BYTES_METRIC_NAME, ptr.size());
+  *ret = BlockHandle::WithDataFromCache(&bc_handle);
+  return true;
+}
 
-  // Cache miss: need to read ourselves.
-  // We issue trace events only in the cache miss case since we expect the
-  // tracing overhead to be small compared to the IO (even if it's a memcpy
-  // from the Linux cache).
-  TRACE_EVENT1("io", "CFileReader::ReadBlock(cache miss)",
-               "cfile", ToString());
+void CFileReader::AllocateBlockScratch(const BlockPointer& ptr, CacheControl cache_control,
+                                       ScratchMemory* scratch) const {
+  CHECK(ptr.offset() > 0 &&
+        ptr.offset() + ptr.size() < file_size_) <<
+    "bad offset " << ptr.ToString() << " in file of size "
+                  << file_size_;
   TRACE_COUNTER_INCREMENT("cfile_cache_miss", 1);
   TRACE_COUNTER_INCREMENT(CFILE_CACHE_MISS_BYTES_METRIC_NAME, ptr.size());
 
-  ScratchMemory scratch;
   // If we are reading uncompressed data and plan to cache the result,
   // then we should allocate our scratch memory directly from the cache.
   // This avoids an extra memory copy in the case of an NVM cache.
   if (codec_ == nullptr && cache_control == CACHE_BLOCK) {
-    scratch.TryAllocateFromCache(cache, key, ptr.size());
+    BlockCache::CacheKey key(block_->id(), ptr.offset());
+    scratch->TryAllocateFromCache(BlockCache::GetSingleton(), key, ptr.size());
   } else {
-    scratch.AllocateFromHeap(ptr.size());
+    scratch->AllocateFromHeap(ptr.size());
   }
-  uint8_t* buf = scratch.get();
+}
 
-  Slice block;
-  RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, buf));
+Status CFileReader::FinishBlockRead(const BlockPointer& ptr, CacheControl cache_control,
+                                    Cache::Priority priority, ScratchMemory* scratch,
+                                    Slice block, BlockHandle* ret) const {
   if (block.size() != ptr.size()) {
     return Status::IOError("Could not read full block length");
   }
+  BlockCache* cache = BlockCache::GetSingleton();
+  BlockCache::CacheKey key(block_->id(), ptr.offset());
+  uint8_t* buf = scratch->get();
 
   // Decompress the block
   if (codec_ != nullptr) {
@@ -400,7 +436,7 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     // Now that we've decompressed, we don't need to keep holding onto the original
     // scratch buffer. Instead, we have to start holding onto our decompression
     // output buffer.
-    scratch.Swap(&decompressed_scratch);
+    scratch->Swap(&decompressed_scratch);
 
     // Set the result block to our decompressed data.
     block = Slice(buf, uncompressed_size);
@@ -409,15 +445,16 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     // and just return a Slice into an mmapped region (or in-memory region).
     // But, this is hard to program against in terms of cache management, etc,
     // so we memcpy into our scratch buffer if necessary.
-    block.relocate(scratch.get());
+    block.relocate(scratch->get());
   }
 
   // It's possible that one of the TryAllocateFromCache() calls above
   // failed, in which case we don't insert it into the cache regardless
   // of what the user requested. The scratch memory includes both the
   // generated key and the data read from disk.
-  if (cache_control == CACHE_BLOCK && scratch.IsFromCache()) {
-    cache->Insert(scratch.mutable_pending_entry(), &bc_handle);
+  if (cache_control == CACHE_BLOCK && scratch->IsFromCache()) {
+    BlockCacheHandle bc_handle;
+    cache->Insert(scratch->mutable_pending_entry(), priority, &bc_handle);
     *ret = BlockHandle::WithDataFromCache(&bc_handle);
   } else {
     // We get here by either not intending to cache the block or
@@ -425,17 +462,171 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     // Since we allocate memory to include the key for the cache entry
     // we must reset the block.
     DCHECK_EQ(block.data(), buf);
-    DCHECK(!scratch.IsFromCache());
-    *ret = BlockHandle::WithOwnedData(scratch.as_slice());
+    DCHECK(!scratch->IsFromCache());
+    *ret = BlockHandle::WithOwnedData(scratch->as_slice());
   }
 
   // The cache or the BlockHandle now has ownership over the memory, so release
   // the scoped pointer.
-  ignore_result(scratch.release());
+  ignore_result(scratch->release());
 
   return Status::OK();
 }
 
+Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
+                              Cache::Priority priority, BlockHandle *ret) const {
+  DCHECK(init_once_.initted());
+  if (LookupBlock(ptr, cache_control, ret)) {
+    // Cache hit
+    return Status::OK();
+  }
+
+  // Cache miss: need to read ourselves.
+  // We issue trace events only in the cache miss case since we expect the
+  // tracing overhead to be small compared to the IO (even if it's a memcpy
+  // from the Linux cache).
+  TRACE_EVENT1("io", "CFileReader::ReadBlock(cache miss)",
+               "cfile", ToString());
+  ScratchMemory scratch;
+  AllocateBlockScratch(ptr, cache_control, &scratch);
+
+  Slice block;
+  if (cache_control == DONT_CACHE_BLOCK) {
+    // The block won't be read again soon, so it needn't go through the page
+    // cache either.
+    vector<Slice> results = { Slice(scratch.get(), ptr.size()) };
+    RETURN_NOT_OK(block_->ReadVUncached(ptr.offset(), &results));
+    block = results[0];
+  } else {
+    RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, scratch.get()));
+  }
+  return FinishBlockRead(ptr, cache_control, priority, &scratch, block, ret);
+}
+
+Status CFileReader::ReadBlocks(const vector<BlockPointer>& ptrs, CacheControl cache_control,
+                               Cache::Priority priority, vector<BlockHandle>* ret) const {
+  PendingBlockReads pending;
+  StartReadBlocks(ptrs, cache_control, priority, /* async= */ false, &pending);
+  return pending.Wait(ret);
+}
+
+void CFileReader::ReadBlocksAsync(const vector<BlockPointer>& ptrs, CacheControl cache_control,
+                                  Cache::Priority priority, PendingBlockReads* pending) const {
+  StartReadBlocks(ptrs, cache_control, priority, /* async= */ true, pending);
+}
+
+void CFileReader::StartReadBlocks(const vector<BlockPointer>& ptrs, CacheControl cache_control,
+                                  Cache::Priority priority, bool async,
+                                  PendingBlockReads* pending) const {
+  DCHECK(init_once_.initted());
+  DCHECK(pending->reader_ == nullptr) << "PendingBlockReads may only be used once";
+  pending->reader_ = this;
+  pending->ptrs_ = ptrs;
+  pending->cache_control_ = cache_control;
+  pending->priority_ = priority;
+  pending->handles_.resize(ptrs.size());
+  pending->scratches_.resize(ptrs.size());
+
+  size_t i = 0;
+  while (i < ptrs.size()) {
+    if (LookupBlock(ptrs[i], cache_control, &pending->handles_[i])) {
+      i++;
+      continue;
+    }
+
+    // Extend the run of cache misses for as long as the blocks are
+    // physically adjacent, so that the whole run is read in one request.
+    size_t end = i + 1;
+    int64_t run_size = ptrs[i].size();
+    bool next_cached = false;
+    while (end < ptrs.size() &&
+           ptrs[end].offset() == ptrs[end - 1].offset() + ptrs[end - 1].size() &&
+           run_size + ptrs[end].size() <= FLAGS_cfile_max_coalesced_read_size) {
+      if (LookupBlock(ptrs[end], cache_control, &pending->handles_[end])) {
+        next_cached = true;
+        break;
+      }
+      run_size += ptrs[end].size();
+      end++;
+    }
+
+    PendingBlockReads::Run run;
+    run.begin = i;
+    run.end = end;
+    for (size_t j = i; j < end; j++) {
+      pending->scratches_[j].reset(new ScratchMemory());
+      AllocateBlockScratch(ptrs[j], cache_control, pending->scratches_[j].get());
+      run.results.emplace_back(pending->scratches_[j]->get(), ptrs[j].size());
+    }
+    pending->runs_.push_back(std::move(run));
+    i = next_cached ? end + 1 : end;
+  }
+
+  // Now that 'runs_' won't be resized, issue the reads into it.
+  // Blocks which won't be cached needn't go through the page cache either.
+  pending->latch_.Reset(pending->runs_.size());
+  bool uncached = cache_control == DONT_CACHE_BLOCK;
+  for (PendingBlockReads::Run& run : pending->runs_) {
+    uint64_t offset = ptrs[run.begin].offset();
+    if (async) {
+      fs::AsyncBlockReader::GetSingleton()->ReadVAsync(
+          block_.get(), offset, &run.results, uncached,
+          Bind(&PendingBlockReads::ReadDone, Unretained(pending)));
+    } else {
+      TRACE_EVENT2("io", "CFileReader::ReadBlocks(cache miss)",
+                   "cfile", ToString(),
+                   "num_blocks", run.end - run.begin);
+      pending->ReadDone(uncached ? block_->ReadVUncached(offset, &run.results)
+                                 : block_->ReadV(offset, &run.results));
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////
+// PendingBlockReads
+////////////////////////////////////////////////////////////
+
+PendingBlockReads::PendingBlockReads()
+    : reader_(nullptr),
+      cache_control_(CFileReader::CACHE_BLOCK),
+      priority_(Cache::NORMAL_PRIORITY),
+      latch_(0) {
+}
+
+PendingBlockReads::~PendingBlockReads() {
+  // The reads may still be writing into 'scratches_'.
+  latch_.Wait();
+}
+
+void PendingBlockReads::ReadDone(const Status& s) {
+  if (PREDICT_FALSE(!s.ok())) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (status_.ok()) {
+      status_ = s;
+    }
+  }
+  latch_.CountDown();
+}
+
+Status PendingBlockReads::Wait(vector<BlockHandle>* ret) {
+  DCHECK(reader_ != nullptr) << "no reads were started";
+  latch_.Wait();
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    RETURN_NOT_OK(status_);
+  }
+  for (Run& run : runs_) {
+    for (size_t i = run.begin; i < run.end; i++) {
+      RETURN_NOT_OK(reader_->FinishBlockRead(ptrs_[i], cache_control_, priority_,
+                                             scratches_[i].get(), run.results[i - run.begin],
+                                             &handles_[i]));
+    }
+  }
+  runs_.clear();
+  *ret = std::move(handles_);
+  return Status::OK();
+}
+
 Status CFileReader::CountRows(rowid_t *count) const {
   *count = footer().num_values();
   return Status::OK();
@@ -457,6 +648,18 @@ bool CFileReader::GetMetadataEntry(const string &key, string *val) {
   return false;
 }
 
+Status CFileReader::ReadBlockZoneMaps(CacheControl cache_control,
+                                      BlockZoneMapsPB* zone_maps) const {
+  DCHECK(has_zone_maps());
+  BlockHandle handle;
+  RETURN_NOT_OK(ReadBlock(BlockPointer(footer().block_zone_maps_ptr()), cache_control,
+                          Cache::HIGH_PRIORITY, &handle));
+  Slice data = handle.data();
+  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(zone_maps, data.data(), data.size()),
+                        Substitute("Unable to parse zone maps of CFile $0", ToString()));
+  return Status::OK();
+}
+
 Status CFileReader::NewIterator(CFileIterator **iter, CacheControl cache_control) {
   *iter = new CFileIterator(this, cache_control);
   return Status::OK();
@@ -533,7 +736,9 @@ CFileIterator::CFileIterator(CFileReader* reader,
     prepared_(false),
     cache_control_(cache_control),
     last_prepare_idx_(-1),
-    last_prepare_count_(-1) {
+    last_prepare_count_(-1),
+    sequential_blocks_(0),
+    readahead_window_(0) {
 }
 
 CFileIterator::~CFileIterator() {
@@ -600,8 +805,16 @@ void CFileIterator::SeekToPositionInBlock(PreparedBlock *pb, uint32_t idx_in_blo
     index_within_nonnulls = idx_in_block;
   }
 
-  pb->dblk_->SeekToPositionInBlock(index_within_nonnulls);
-  DCHECK_EQ(index_within_nonnulls, pb->dblk_->GetCurrentIndex()) << "failed seek";
+  // If only NULLs follow the position, there's no value to seek the data
+  // block to, and not every decoder can seek to the end of its block. Since
+  // no more values will be read from it, leave it where it is.
+  if (index_within_nonnulls < pb->dblk_->Count()) {
+    pb->dblk_->SeekToPositionInBlock(index_within_nonnulls);
+    DCHECK_EQ(index_within_nonnulls, pb->dblk_->GetCurrentIndex()) << "failed seek";
+  } else {
+    DCHECK(reader_->is_nullable());
+    DCHECK_EQ(index_within_nonnulls, pb->dblk_->Count());
+  }
   pb->idx_in_block_ = idx_in_block;
 }
 
@@ -716,7 +929,8 @@ Status CFileIterator::PrepareForNewSeek() {
     BlockPointer bp(reader_->footer().dict_block_ptr());
 
     // Cache the dictionary for performance
-    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, &dict_block_handle_),
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, Cache::HIGH_PRIORITY,
+                                             &dict_block_handle_),
                           "Couldn't read dictionary block");
 
     dict_decoder_.reset(new BinaryPlainBlockDecoder(dict_block_handle_.data()));
@@ -728,6 +942,9 @@ Status CFileIterator::PrepareForNewSeek() {
     prepared_block_pool_.Destroy(pb);
   }
   prepared_blocks_.clear();
+  DiscardPrefetchedBlocks();
+  sequential_blocks_ = 0;
+  readahead_window_ = 0;
 
   return Status::OK();
 }
@@ -763,7 +980,23 @@ Status DecodeNullInfo(Slice *data_block, uint32_t *num_rows_in_block, Slice *nul
 Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                                            PreparedBlock *prep_block) {
   prep_block->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
-  RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_, &prep_block->dblk_data_));
+  if (prefetched_blocks_.empty() && pending_reads_ &&
+      pending_reads_->ptrs().front().offset() == prep_block->dblk_ptr_.offset()) {
+    RETURN_NOT_OK(TakePendingReads());
+  }
+  if (!prefetched_blocks_.empty() &&
+      prefetched_blocks_.front().ptr.offset() == prep_block->dblk_ptr_.offset()) {
+    PrefetchedBlock& block = prefetched_blocks_.front();
+    if (block.read_ahead) {
+      io_stats_.readahead_hits++;
+    }
+    prep_block->dblk_data_ = std::move(block.data);
+    prefetched_blocks_.pop_front();
+  } else {
+    DiscardPrefetchedBlocks();
+    RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_,
+                                     Cache::NORMAL_PRIORITY, &prep_block->dblk_data_));
+  }
 
   uint32_t num_rows_in_block = 0;
   Slice data_block = prep_block->dblk_data_.data();
@@ -806,6 +1039,95 @@ Status CFileIterator::QueueCurrentDataBlock(const IndexTreeIterator &idx_iter) {
   return Status::OK();
 }
 
+Status CFileIterator::FindDataBlocks(rowid_t first_idx, rowid_t end_idx, size_t max_blocks,
+                                     vector<BlockPointer>* ptrs) {
+  gscoped_ptr<IndexTreeIterator> iter(
+      IndexTreeIterator::Create(reader_, reader_->posidx_root()));
+  tmp_buf_.clear();
+  KeyEncoderTraits<UINT32, faststring>::Encode(first_idx, &tmp_buf_);
+  RETURN_NOT_OK(iter->SeekAtOrBefore(Slice(tmp_buf_)));
+
+  ptrs->clear();
+  while (ptrs->size() < max_blocks) {
+    // The positional index is keyed by the ordinal of each block's first row.
+    Slice key = iter->GetCurrentKey();
+    rowid_t block_first_idx;
+    typedef KeyEncoderTraits<UINT32, faststring> Uint32KeyEncoder;
+    RETURN_NOT_OK(Uint32KeyEncoder::DecodeKeyPortion(
+        &key, true, nullptr, reinterpret_cast<uint8_t*>(&block_first_idx)));
+    if (block_first_idx > end_idx) {
+      break;
+    }
+    if (block_first_idx >= first_idx) {
+      ptrs->push_back(iter->GetCurrentBlockPointer());
+    }
+    Status s = iter->Next();
+    if (s.IsNotFound()) {
+      break;
+    }
+    RETURN_NOT_OK(s);
+  }
+  return Status::OK();
+}
+
+Status CFileIterator::PrefetchDataBlocks(rowid_t first_idx, rowid_t end_idx) {
+  vector<BlockPointer> ptrs;
+  RETURN_NOT_OK(FindDataBlocks(first_idx, end_idx, MathLimits<size_t>::kMax, &ptrs));
+  if (ptrs.size() <= 1) {
+    // Nothing to coalesce; the block will be read when it's needed.
+    return Status::OK();
+  }
+
+  vector<BlockHandle> handles;
+  RETURN_NOT_OK(reader_->ReadBlocks(ptrs, cache_control_, Cache::NORMAL_PRIORITY, &handles));
+  for (int i = 0; i < ptrs.size(); i++) {
+    prefetched_blocks_.emplace_back(ptrs[i], std::move(handles[i]), false);
+  }
+  return Status::OK();
+}
+
+Status CFileIterator::StartReadahead() {
+  // Start with a small window so that short scans don't read much more than
+  // they need, and grow it while the scan keeps going.
+  readahead_window_ = std::min(std::max(readahead_window_ * 2, 2),
+                               FLAGS_cfile_readahead_max_blocks);
+  vector<BlockPointer> ptrs;
+  RETURN_NOT_OK(FindDataBlocks(prepared_blocks_.back()->last_row_idx() + 1,
+                               MathLimits<rowid_t>::kMax,
+                               readahead_window_, &ptrs));
+  if (ptrs.empty()) {
+    return Status::OK();
+  }
+  pending_reads_.reset(new PendingBlockReads());
+  reader_->ReadBlocksAsync(ptrs, cache_control_, Cache::NORMAL_PRIORITY, pending_reads_.get());
+  return Status::OK();
+}
+
+Status CFileIterator::TakePendingReads() {
+  gscoped_ptr<PendingBlockReads> pending(pending_reads_.release());
+  vector<BlockHandle> handles;
+  RETURN_NOT_OK(pending->Wait(&handles));
+  for (int i = 0; i < handles.size(); i++) {
+    prefetched_blocks_.emplace_back(pending->ptrs()[i], std::move(handles[i]), true);
+  }
+  return Status::OK();
+}
+
+void CFileIterator::DiscardPrefetchedBlocks() {
+  for (const PrefetchedBlock& block : prefetched_blocks_) {
+    if (block.read_ahead) {
+      io_stats_.readahead_bytes_wasted += block.ptr.size();
+    }
+  }
+  prefetched_blocks_.clear();
+  if (pending_reads_) {
+    for (const BlockPointer& ptr : pending_reads_->ptrs()) {
+      io_stats_.readahead_bytes_wasted += ptr.size();
+    }
+    pending_reads_.reset();
+  }
+}
+
 bool CFileIterator::HasNext() const {
   CHECK(seeked_) << "not seeked";
   CHECK(!prepared_) << "Cannot call HasNext() mid-batch";
@@ -822,6 +1144,17 @@ Status CFileIterator::PrepareBatch(size_t *n) {
   rowid_t start_idx = last_prepare_idx_;
   rowid_t end_idx = start_idx + *n;
 
+  // If the batch probably spans several more data blocks, read them all
+  // up front so that physically adjacent blocks are read together.
+  PreparedBlock* back = prepared_blocks_.back();
+  if (seeked_ == posidx_iter_.get() &&
+      prefetched_blocks_.empty() &&
+      !pending_reads_ &&
+      back->last_row_idx() < end_idx &&
+      end_idx - back->last_row_idx() > back->num_rows_in_block_) {
+    RETURN_NOT_OK(PrefetchDataBlocks(back->last_row_idx() + 1, end_idx));
+  }
+
   // Read blocks until all blocks covering the requested range are in the
   // prepared_blocks_ queue.
   while (prepared_blocks_.back()->last_row_idx() < end_idx) {
@@ -833,6 +1166,7 @@ Status CFileIterator::PrepareBatch(size_t *n) {
       return s;
     }
     RETURN_NOT_OK(QueueCurrentDataBlock(*seeked_));
+    sequential_blocks_++;
   }
 
   // Seek the first block in the queue such that the first value to be read
@@ -848,6 +1182,17 @@ Status CFileIterator::PrepareBatch(size_t *n) {
     *n = size_covered_by_prep_blocks;
   }
 
+  // Start reading the blocks following this batch, so that they're read
+  // while this batch is being decoded.
+  if (FLAGS_cfile_readahead_max_blocks > 0 &&
+      sequential_blocks_ >= FLAGS_cfile_readahead_min_sequential_blocks &&
+      seeked_ == posidx_iter_.get() &&
+      prefetched_blocks_.empty() &&
+      !pending_reads_ &&
+      seeked_->HasNext()) {
+    RETURN_NOT_OK(StartReadahead());
+  }
+
   last_prepare_idx_ = start_idx;
   last_prepare_count_ = *n;
   prepared_ = true;
@@ -938,87 +1283,128 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
       // that might be more efficient (allowing the decoder to save internal state
       // instead of having to reconstruct it)
     }
-    if (reader_->is_nullable()) {
-      DCHECK(ctx->block()->is_nullable());
-
-      size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
-      // Fill column bitmap
-      size_t count = nrows;
-      while (count > 0) {
-        bool not_null = false;
-        size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
-        DCHECK_LE(nblock, count);
-        if (PREDICT_FALSE(nblock == 0)) {
-          return Status::Corruption(
-            Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
-                       count));
-        }
-        size_t this_batch = nblock;
-        if (not_null) {
-          if (ctx->DecoderEvalNotDisabled()) {
-            RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch,
-                                                     ctx,
-                                                     &remaining_sel,
-                                                     &remaining_dst));
-          } else {
-            RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
-          }
-          DCHECK_EQ(nblock, this_batch);
-          pb->needs_rewind_ = true;
+
+    // Fetch as many as we can from the current datablock.
+    size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
+    if (ctx->skip_unselected_rows()) {
+      RETURN_NOT_OK(ScanSelectedRowsInBlock(pb, nrows, ctx, &remaining_sel, &remaining_dst));
+    } else {
+      RETURN_NOT_OK(ScanRowsInBlock(pb, nrows, ctx, &remaining_sel, &remaining_dst));
+    }
+    rem -= nrows;
+    if (rem == 0) {
+      break;
+    }
+  }
+
+  DCHECK_EQ(rem, 0) << "Should have fetched exactly the number of prepared rows";
+  return Status::OK();
+}
+
+Status CFileIterator::ScanRowsInBlock(PreparedBlock* pb,
+                                      size_t nrows,
+                                      ColumnMaterializationContext* ctx,
+                                      SelectionVectorView* sel,
+                                      ColumnDataView* dst) {
+  DCHECK_LE(nrows, pb->num_rows_in_block_ - pb->idx_in_block_);
+  if (reader_->is_nullable()) {
+    DCHECK(ctx->block()->is_nullable());
+
+    // Fill column bitmap
+    size_t count = nrows;
+    while (count > 0) {
+      bool not_null = false;
+      size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
+      DCHECK_LE(nblock, count);
+      if (PREDICT_FALSE(nblock == 0)) {
+        return Status::Corruption(
+          Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
+                     count));
+      }
+      size_t this_batch = nblock;
+      if (not_null) {
+        if (ctx->DecoderEvalNotDisabled()) {
+          RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, sel, dst));
         } else {
+          RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, dst));
+        }
+        DCHECK_EQ(nblock, this_batch);
+        pb->needs_rewind_ = true;
+      } else {
 #ifndef NDEBUG
-          kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst.data()),
-                                     remaining_dst.stride() * nblock,
-                                     "NULLNULLNULLNULLNULL");
+        kudu::OverwriteWithPattern(reinterpret_cast<char *>(dst->data()),
+                                   dst->stride() * nblock,
+                                   "NULLNULLNULLNULLNULL");
 #endif
-          if (ctx->DecoderEvalNotDisabled()) {
-            remaining_sel.ClearBits(this_batch);
-          }
+        if (ctx->DecoderEvalNotDisabled()) {
+          sel->ClearBits(this_batch);
         }
+      }
 
-        // Set the ColumnBlock bitmap
-        remaining_dst.SetNullBits(this_batch, not_null);
+      // Set the ColumnBlock bitmap
+      dst->SetNullBits(this_batch, not_null);
 
-        rem -= this_batch;
-        count -= this_batch;
-        pb->idx_in_block_ += this_batch;
-        remaining_dst.Advance(this_batch);
-        remaining_sel.Advance(this_batch);
-      }
+      count -= this_batch;
+      pb->idx_in_block_ += this_batch;
+      dst->Advance(this_batch);
+      sel->Advance(this_batch);
+    }
+  } else {
+    size_t this_batch = nrows;
+    if (ctx->DecoderEvalNotDisabled()) {
+      RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, sel, dst));
     } else {
-      // Fetch as many as we can from the current datablock.
-      size_t this_batch = rem;
+      RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, dst));
+    }
+    pb->needs_rewind_ = true;
+    DCHECK_EQ(nrows, this_batch) << "dblk stopped yielding values before it was empty.";
 
-      if (ctx->DecoderEvalNotDisabled()) {
-        RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, &remaining_sel, &remaining_dst));
-      } else {
-        RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
-      }
-      pb->needs_rewind_ = true;
-      DCHECK_LE(this_batch, rem);
+    // If the column is nullable, set all bits to true
+    if (ctx->block()->is_nullable()) {
+      dst->SetNullBits(this_batch, true);
+    }
 
-      // If the column is nullable, set all bits to true
-      if (ctx->block()->is_nullable()) {
-        remaining_dst.SetNullBits(this_batch, true);
-      }
+    pb->idx_in_block_ += this_batch;
+    dst->Advance(this_batch);
+    sel->Advance(this_batch);
+  }
+  return Status::OK();
+}
 
-      rem -= this_batch;
-      pb->idx_in_block_ += this_batch;
-      remaining_dst.Advance(this_batch);
-      remaining_sel.Advance(this_batch);
+Status CFileIterator::ScanSelectedRowsInBlock(PreparedBlock* pb,
+                                              size_t nrows,
+                                              ColumnMaterializationContext* ctx,
+                                              SelectionVectorView* sel,
+                                              ColumnDataView* dst) {
+  DCHECK(ctx->DecoderEvalNotSupported());
+  size_t i = 0;
+  while (i < nrows) {
+    // Find the run of rows which are all selected or all unselected.
+    bool selected = sel->TestBit(0);
+    size_t run = 1;
+    while (i + run < nrows && sel->TestBit(run) == selected) {
+      run++;
     }
 
-    // If we didn't fetch as many as requested, then it should
-    // be because the current data block ran out.
-    if (rem > 0) {
-      DCHECK_EQ(pb->dblk_->Count(), pb->dblk_->GetCurrentIndex()) <<
-        "dblk stopped yielding values before it was empty.";
+    if (selected) {
+      RETURN_NOT_OK(ScanRowsInBlock(pb, run, ctx, sel, dst));
     } else {
-      break;
+      uint32_t idx_in_block = pb->idx_in_block_ + run;
+      if (idx_in_block < pb->num_rows_in_block_) {
+        SeekToPositionInBlock(pb, idx_in_block);
+      } else {
+        // Not every decoder can seek to the end of its block, so leave the
+        // decoders where they are. The block can only be read again after
+        // rewinding to an earlier position, which doesn't depend on where
+        // the decoders were left.
+        pb->idx_in_block_ = idx_in_block;
+      }
+      pb->needs_rewind_ = true;
+      dst->Advance(run);
+      sel->Advance(run);
     }
+    i += run;
   }
-
-  DCHECK_EQ(rem, 0) << "Should have fetched exactly the number of prepared rows";
   return Status::OK();
 }
 
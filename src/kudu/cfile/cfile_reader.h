@@ -18,7 +18,10 @@
 #ifndef KUDU_CFILE_CFILE_READER_H
 #define KUDU_CFILE_CFILE_READER_H
 
+#include <deque>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kudu/common/columnblock.h"
@@ -35,6 +38,8 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/object_pool.h"
 #include "kudu/util/once.h"
@@ -53,6 +58,8 @@ class CFileHeaderPB;
 class CFileFooterPB;
 class CFileIterator;
 class BinaryPlainBlockDecoder;
+class PendingBlockReads;
+class ScratchMemory;
 
 class CFileReader {
  public:
@@ -96,8 +103,23 @@ class CFileReader {
 
   // TODO: make this private? should only be used
   // by the iterator and index tree readers, I think.
+  //
+  // 'priority' is the priority of the block in the block cache, if it's
+  // cached. See BlockCache::Insert().
   Status ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
-                   BlockHandle *ret) const;
+                   Cache::Priority priority, BlockHandle *ret) const;
+
+  // Like ReadBlock(), but reads each of the blocks in 'ptrs' into the
+  // corresponding entry of 'ret'. Runs of physically adjacent blocks which
+  // aren't in the block cache are read from disk in a single request.
+  Status ReadBlocks(const std::vector<BlockPointer>& ptrs, CacheControl cache_control,
+                    Cache::Priority priority, std::vector<BlockHandle>* ret) const;
+
+  // Like ReadBlocks(), but the blocks which aren't in the block cache are
+  // read in the background by the fs::AsyncBlockReader. The blocks are
+  // retrieved with pending->Wait(). 'pending' must not outlive this reader.
+  void ReadBlocksAsync(const std::vector<BlockPointer>& ptrs, CacheControl cache_control,
+                       Cache::Priority priority, PendingBlockReads* pending) const;
 
   // Return the number of rows in this cfile.
   // This is assumed to be reasonably fast (i.e does not scan
@@ -167,11 +189,26 @@ class CFileReader {
     return BlockPointer(footer().validx_info().root_block());
   }
 
+  // Return true if there are zone maps on this file.
+  bool has_zone_maps() const {
+    return footer().has_zone_map() && footer().has_block_zone_maps_ptr();
+  }
+
+  // Return the zone map of the whole file.
+  const ZoneMapPB& zone_map() const {
+    DCHECK(has_zone_maps());
+    return footer().zone_map();
+  }
+
+  // Read the zone maps of each of the file's data blocks, in ordinal order.
+  Status ReadBlockZoneMaps(CacheControl cache_control, BlockZoneMapsPB* zone_maps) const;
+
   // Can be called before Init().
   std::string ToString() const { return block_->id().ToString(); }
 
  private:
   DISALLOW_COPY_AND_ASSIGN(CFileReader);
+  friend class PendingBlockReads;
 
   CFileReader(ReaderOptions options,
               uint64_t file_size,
@@ -180,10 +217,32 @@ class CFileReader {
   // Callback used in 'init_once_' to initialize this cfile.
   Status InitOnce();
 
-  Status ReadMagicAndLength(uint64_t offset, uint32_t *len);
   Status ReadAndParseHeader();
   Status ReadAndParseFooter();
 
+  // Looks up the block at 'ptr' in the block cache, setting 'ret' and
+  // returning true on a hit.
+  bool LookupBlock(const BlockPointer& ptr, CacheControl cache_control,
+                   BlockHandle* ret) const;
+
+  // Allocates the buffer into which the block at 'ptr' will be read after
+  // missing in the block cache.
+  void AllocateBlockScratch(const BlockPointer& ptr, CacheControl cache_control,
+                            ScratchMemory* scratch) const;
+
+  // Finishes reading the block at 'ptr', whose on-disk contents 'block' were
+  // read into 'scratch', by decompressing it and inserting it into the block
+  // cache as necessary. Takes ownership of the memory in 'scratch'.
+  Status FinishBlockRead(const BlockPointer& ptr, CacheControl cache_control,
+                         Cache::Priority priority, ScratchMemory* scratch,
+                         Slice block, BlockHandle* ret) const;
+
+  // Looks up 'ptrs' in the block cache, and reads the blocks which missed
+  // into 'pending', either in the background or before returning.
+  void StartReadBlocks(const std::vector<BlockPointer>& ptrs, CacheControl cache_control,
+                       Cache::Priority priority, bool async,
+                       PendingBlockReads* pending) const;
+
   // Returns the memory usage of the object including the object itself.
   size_t memory_footprint() const;
 
@@ -206,6 +265,61 @@ class CFileReader {
   ScopedTrackedConsumption mem_consumption_;
 };
 
+// Blocks being read by CFileReader::ReadBlocks() or ReadBlocksAsync().
+//
+// Destroying this object waits for any outstanding reads to finish, and
+// discards their blocks.
+class PendingBlockReads {
+ public:
+  PendingBlockReads();
+  ~PendingBlockReads();
+
+  // The blocks being read, in order.
+  const std::vector<BlockPointer>& ptrs() const { return ptrs_; }
+
+  // Waits for all of the reads to finish, then moves the blocks into 'ret'
+  // in the order of ptrs(). May only be called once.
+  Status Wait(std::vector<BlockHandle>* ret);
+
+ private:
+  friend class CFileReader;
+
+  // A run of physically adjacent blocks which missed in the block cache,
+  // read with a single request.
+  struct Run {
+    // The indexes in 'ptrs_' of the run's blocks.
+    size_t begin;
+    size_t end;
+
+    // The buffers into which the blocks are read.
+    std::vector<Slice> results;
+  };
+
+  // Records the outcome of the read of a run.
+  void ReadDone(const Status& s);
+
+  const CFileReader* reader_;
+  std::vector<BlockPointer> ptrs_;
+  CFileReader::CacheControl cache_control_;
+  Cache::Priority priority_;
+
+  std::vector<Run> runs_;
+
+  // The blocks which were found in the block cache, and the buffers of those
+  // which weren't, indexed like 'ptrs_'.
+  std::vector<BlockHandle> handles_;
+  std::vector<std::unique_ptr<ScratchMemory>> scratches_;
+
+  // Counted down as the read of each run finishes.
+  CountDownLatch latch_;
+
+  // Protects 'status_', the first error returned by any of the reads.
+  simple_spinlock lock_;
+  Status status_;
+
+  DISALLOW_COPY_AND_ASSIGN(PendingBlockReads);
+};
+
 // Column Iterator interface used by the CFileSet.
 // Implemented by the CFileIterator, DefaultColumnValueIterator
 // and the ColumnValueTypeAdaptorIterator.
@@ -430,6 +544,24 @@ class CFileIterator : public ColumnIterator {
   // Seek the given PreparedBlock to the given index within it.
   void SeekToPositionInBlock(PreparedBlock *pb, uint32_t idx_in_block);
 
+  // Copy the next 'nrows' rows of the given PreparedBlock into 'dst',
+  // evaluating the predicate of 'ctx' in the decoder if possible. Advances
+  // 'sel' and 'dst' past the rows.
+  Status ScanRowsInBlock(PreparedBlock* pb,
+                         size_t nrows,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst);
+
+  // Like ScanRowsInBlock(), but only copies the rows which are selected in
+  // 'sel', seeking the block past runs of unselected rows without decoding
+  // them. The cells of unselected rows are left uninitialized.
+  Status ScanSelectedRowsInBlock(PreparedBlock* pb,
+                                 size_t nrows,
+                                 ColumnMaterializationContext* ctx,
+                                 SelectionVectorView* sel,
+                                 ColumnDataView* dst);
+
   // Read the data block currently pointed to by idx_iter_
   // into the given PreparedBlock structure.
   //
@@ -441,6 +573,28 @@ class CFileIterator : public ColumnIterator {
   // it onto the end of the prepared_blocks_ deque.
   Status QueueCurrentDataBlock(const IndexTreeIterator &idx_iter);
 
+  // Find up to 'max_blocks' data blocks whose first rows are in
+  // [first_idx, end_idx]. The blocks are found using a separate index
+  // iterator, so the position of seeked_ is not changed.
+  Status FindDataBlocks(rowid_t first_idx, rowid_t end_idx, size_t max_blocks,
+                        std::vector<BlockPointer>* ptrs);
+
+  // Read the data blocks whose first rows are in [first_idx, end_idx] with
+  // as few requests as possible, and append them to prefetched_blocks_.
+  Status PrefetchDataBlocks(rowid_t first_idx, rowid_t end_idx);
+
+  // Start reading the data blocks following the last prepared block in the
+  // background, into pending_reads_. The number of blocks read grows with
+  // each call, up to --cfile_readahead_max_blocks.
+  Status StartReadahead();
+
+  // Wait for pending_reads_ and append its blocks to prefetched_blocks_.
+  Status TakePendingReads();
+
+  // Drop prefetched_blocks_ and pending_reads_, accounting for any blocks
+  // which were read ahead but never used.
+  void DiscardPrefetchedBlocks();
+
   // Fully initialize the underlying cfile reader if needed, and clear any
   // seek-related state.
   Status PrepareForNewSeek();
@@ -469,6 +623,30 @@ class CFileIterator : public ColumnIterator {
   ObjectPool<PreparedBlock> prepared_block_pool_;
   typedef ObjectPool<PreparedBlock>::scoped_ptr pblock_pool_scoped_ptr;
 
+  struct PrefetchedBlock {
+    PrefetchedBlock(const BlockPointer& ptr, BlockHandle data, bool read_ahead)
+        : ptr(ptr),
+          data(std::move(data)),
+          read_ahead(read_ahead) {
+    }
+
+    BlockPointer ptr;
+    BlockHandle data;
+
+    // Whether the block was read ahead of the batch which needed it by
+    // StartReadahead(), rather than as part of the batch.
+    bool read_ahead;
+  };
+
+  // Data blocks that were read ahead of seeked_ by PrefetchDataBlocks() or
+  // StartReadahead(), in order. ReadCurrentDataBlock() consumes the front
+  // block if it's the one being read.
+  std::deque<PrefetchedBlock> prefetched_blocks_;
+
+  // Data blocks following prefetched_blocks_ which are being read in the
+  // background, if any.
+  gscoped_ptr<PendingBlockReads> pending_reads_;
+
   // True if PrepareBatch() has been called more recently than FinishBatch().
   bool prepared_;
 
@@ -483,6 +661,14 @@ class CFileIterator : public ColumnIterator {
   // Otherwise, 0.
   uint32_t last_prepare_count_;
 
+  // Number of data blocks read in order by PrepareBatch() since the last
+  // seek. Readahead only starts once the scan looks sequential.
+  int sequential_blocks_;
+
+  // Number of blocks requested by the last StartReadahead() since the last
+  // seek, or 0 if none.
+  int readahead_window_;
+
   IteratorStats io_stats_;
 
   // a temporary buffer for encoding
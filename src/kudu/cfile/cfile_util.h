@@ -35,6 +35,15 @@ namespace cfile {
 class CFileReader;
 class CFileIterator;
 
+// Bits of CFileFooterPB::incompatible_features.
+enum CFileIncompatibleFeatures : uint32_t {
+  // Some of the file's bloom blocks use BLOCKED_BLOOM_FILTER.
+  BLOCKED_BLOOM_FILTERS = 1 << 0,
+};
+
+// The incompatible features which this version can read.
+const uint32_t kSupportedIncompatibleFeatures = BLOCKED_BLOOM_FILTERS;
+
 struct WriterOptions {
   // Approximate size of index blocks.
   //
@@ -60,6 +69,19 @@ struct WriterOptions {
   // instead of entire keys.
   bool optimize_index_keys;
 
+  // Whether to write zone maps (min/max values and NULL counts) for each
+  // data block and for the whole file. These are only meaningful for files
+  // whose values are appended with AppendEntries() or AppendNullableEntries().
+  //
+  // Default: false
+  bool write_zone_maps;
+
+  // Bits of CFileIncompatibleFeatures to set in the footer, for features
+  // which the file's writer uses and which readers must support.
+  //
+  // Default: 0
+  uint32_t incompatible_features;
+
   // Column storage attributes.
   //
   // Default: all default values as specified in the constructor in
@@ -26,6 +26,7 @@
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/common/key_encoder.h"
 #include "kudu/gutil/endian.h"
 #include "kudu/util/coding.h"
@@ -87,7 +88,9 @@ WriterOptions::WriterOptions()
     block_restart_interval(16),
     write_posidx(false),
     write_validx(false),
-    optimize_index_keys(true) {
+    optimize_index_keys(true),
+    write_zone_maps(false),
+    incompatible_features(0) {
 }
 
 
@@ -183,6 +186,11 @@ Status CFileWriter::Start() {
     null_bitmap_builder_.reset(new NullBitmapBuilder(nrows * 8));
   }
 
+  if (options_.write_zone_maps) {
+    block_zone_map_.reset(new ZoneMapBuilder(typeinfo_));
+    file_zone_map_.reset(new ZoneMapBuilder(typeinfo_));
+  }
+
   state_ = kWriterWriting;
 
   return Status::OK();
@@ -212,6 +220,9 @@ Status CFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer) {
   footer.set_encoding(type_encoding_info_->encoding_type());
   footer.set_num_values(value_count_);
   footer.set_compression(compression_);
+  if (options_.incompatible_features != 0) {
+    footer.set_incompatible_features(options_.incompatible_features);
+  }
 
   // Write out any pending positional index blocks.
   if (options_.write_posidx) {
@@ -227,6 +238,10 @@ Status CFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer) {
     footer.mutable_validx_info()->CopyFrom(validx_info);
   }
 
+  if (options_.write_zone_maps && block_zone_maps_.zone_maps_size() > 0) {
+    RETURN_NOT_OK_PREPEND(WriteZoneMaps(&footer), "Couldn't write zone maps");
+  }
+
   // Optionally append extra information to the end of cfile.
   // Example: dictionary block for dictionary encoding
   RETURN_NOT_OK(data_block_->AppendExtraInfo(this, &footer));
@@ -294,6 +309,9 @@ Status CFileWriter::AppendEntries(const void *entries, size_t count) {
     int n = data_block_->Add(ptr, rem);
     DCHECK_GE(n, 0);
 
+    if (block_zone_map_ != nullptr) {
+      block_zone_map_->AddValues(ptr, n);
+    }
     ptr += typeinfo_->size() * n;
     rem -= n;
     value_count_ += n;
@@ -325,6 +343,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
         DCHECK_GE(n, 0);
 
         null_bitmap_builder_->AddRun(true, n);
+        if (block_zone_map_ != nullptr) {
+          block_zone_map_->AddValues(ptr, n);
+        }
         ptr += n * typeinfo_->size();
         value_count_ += n;
         rem -= n;
@@ -336,6 +357,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       } while (rem > 0);
     } else {
       null_bitmap_builder_->AddRun(false, nblock);
+      if (block_zone_map_ != nullptr) {
+        block_zone_map_->AddNulls(nblock);
+      }
       ptr += nblock * typeinfo_->size();
       value_count_ += nblock;
     }
@@ -391,6 +415,13 @@ Status CFileWriter::FinishCurDataBlock() {
     null_bitmap_builder_->Reset();
   }
 
+  if (block_zone_map_ != nullptr) {
+    DCHECK_EQ(block_zone_map_->num_rows(), num_elems_in_block);
+    block_zone_map_->ToPB(block_zone_maps_.add_zone_maps());
+    file_zone_map_->Merge(*block_zone_map_);
+    block_zone_map_->Reset();
+  }
+
   if (validx_builder_ != nullptr) {
     RETURN_NOT_OK(data_block_->GetLastKey(key_tmp_space));
     key_encoder_->ResetAndEncode(key_tmp_space, &last_key_);
@@ -442,6 +473,19 @@ Status CFileWriter::AppendRawBlock(const vector<Slice> &data_slices,
   return s;
 }
 
+Status CFileWriter::WriteZoneMaps(CFileFooterPB* footer) {
+  faststring buf;
+  pb_util::SerializeToString(block_zone_maps_, &buf);
+  vector<Slice> v;
+  v.push_back(Slice(buf));
+
+  BlockPointer ptr;
+  RETURN_NOT_OK(AddBlock(v, &ptr, "zone maps block"));
+  ptr.CopyToPB(footer->mutable_block_zone_maps_ptr());
+  file_zone_map_->ToPB(footer->mutable_zone_map());
+  return Status::OK();
+}
+
 size_t CFileWriter::written_size() const {
   // This is a low estimate, but that's OK -- this is checked after every block
   // write during flush/compact, so better to give a fast slightly-inaccurate result
@@ -49,6 +49,7 @@ using std::unordered_map;
 class BlockPointer;
 class BTreeInfoPB;
 class IndexTreeBuilder;
+class ZoneMapBuilder;
 
 // Magic used in header/footer
 extern const char kMagicStringV1[];
@@ -181,6 +182,10 @@ class CFileWriter {
 
   Status FinishCurDataBlock();
 
+  // Append the zone maps of the data blocks to the file, and add them and the
+  // zone map of the whole file to 'footer'.
+  Status WriteZoneMaps(CFileFooterPB* footer);
+
   // Flush the current unflushed_metadata_ entries into the given protobuf
   // field, clearing the buffer.
   void FlushMetadataToPB(google::protobuf::RepeatedPtrField<FileMetadataPairPB> *field);
@@ -222,6 +227,12 @@ class CFileWriter {
   gscoped_ptr<NullBitmapBuilder> null_bitmap_builder_;
   gscoped_ptr<CompressedBlockBuilder> block_compressor_;
 
+  // Only set if the writer is writing zone maps. The zone maps of finished
+  // data blocks are accumulated in 'block_zone_maps_' until Finish().
+  gscoped_ptr<ZoneMapBuilder> block_zone_map_;
+  gscoped_ptr<ZoneMapBuilder> file_zone_map_;
+  BlockZoneMapsPB block_zone_maps_;
+
   enum State {
     kWriterInitialized,
     kWriterWriting,
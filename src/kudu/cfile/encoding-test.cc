@@ -30,7 +30,11 @@
 #include "kudu/cfile/rle_block.h"
 #include "kudu/cfile/binary_plain_block.h"
 #include "kudu/cfile/binary_prefix_block.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/util/group_varint-inl.h"
@@ -631,6 +635,56 @@ class TestEncoding : public KuduTest {
     }
   }
 
+  // Decodes a block of runs of random values with CopyNextAndEval(), and
+  // checks that exactly the rows matching 'pred' are selected, with their
+  // values copied.
+  template <class BuilderType, class DecoderType, DataType Type>
+  void TestCopyNextAndEval(const ColumnPredicate& pred, int max_value) {
+    typedef typename TypeTraits<Type>::cpp_type CppType;
+    const size_t kNumRows = 10000;
+    // Not a vector, which would be bit-packed for bools.
+    unique_ptr<CppType[]> to_insert(new CppType[kNumRows]);
+    for (size_t i = 0; i < kNumRows; ) {
+      size_t run_size = std::min<size_t>(random() % 100 + 1, kNumRows - i);
+      CppType val = static_cast<CppType>(random() % (max_value + 1));
+      std::fill(&to_insert[i], &to_insert[i] + run_size, val);
+      i += run_size;
+    }
+
+    unique_ptr<WriterOptions> opts(NewWriterOptions());
+    BuilderType bb(opts.get());
+    bb.Add(reinterpret_cast<const uint8_t *>(to_insert.get()), kNumRows);
+    Slice s = bb.Finish(0);
+    DecoderType bd(s);
+    ASSERT_OK(bd.ParseHeader());
+
+    unique_ptr<CppType[]> decoded(new CppType[kNumRows]);
+    ColumnBlock dst_block(GetTypeInfo(Type), nullptr, decoded.get(), kNumRows, &arena_);
+    SelectionVector sel(kNumRows);
+    sel.SetAllTrue();
+    ColumnMaterializationContext ctx(0, &pred, &dst_block, &sel);
+
+    size_t dec_count = 0;
+    while (bd.HasNext()) {
+      size_t n = std::min(kNumRows - dec_count, static_cast<size_t>((random() % 300) + 1));
+      ColumnDataView dst_data(&dst_block, dec_count);
+      SelectionVectorView sel_view(&sel);
+      sel_view.Advance(dec_count);
+      ASSERT_OK(bd.CopyNextAndEval(&n, &ctx, &sel_view, &dst_data));
+      ASSERT_FALSE(ctx.DecoderEvalNotSupported());
+      dec_count += n;
+    }
+    ASSERT_EQ(kNumRows, dec_count);
+
+    for (size_t i = 0; i < kNumRows; i++) {
+      bool matches = pred.EvaluateCell<Type>(&to_insert[i]);
+      ASSERT_EQ(matches, sel.IsRowSelected(i)) << "row " << i;
+      if (matches) {
+        ASSERT_EQ(to_insert[i], decoded[i]) << "row " << i;
+      }
+    }
+  }
+
   Arena arena_;
 };
 
@@ -713,6 +767,24 @@ TEST_F(TestEncoding, TestRleBitMapRoundTrip) {
   TestBoolBlockRoundTrip<RleBitMapBlockBuilder, RleBitMapBlockDecoder>();
 }
 
+TEST_F(TestEncoding, TestRleIntCopyNextAndEval) {
+  ColumnSchema col("c", INT32);
+  int32_t lower = 3;
+  int32_t upper = 7;
+  TestCopyNextAndEval<RleIntBlockBuilder<INT32>, RleIntBlockDecoder<INT32>, INT32>(
+      ColumnPredicate::Range(col, &lower, &upper), 10);
+
+  vector<const void*> values = { &lower, &upper };
+  TestCopyNextAndEval<RleIntBlockBuilder<INT32>, RleIntBlockDecoder<INT32>, INT32>(
+      ColumnPredicate::InList(col, &values), 10);
+}
+
+TEST_F(TestEncoding, TestRleBitMapCopyNextAndEval) {
+  bool val = true;
+  TestCopyNextAndEval<RleBitMapBlockBuilder, RleBitMapBlockDecoder, BOOL>(
+      ColumnPredicate::Equality(ColumnSchema("c", BOOL), &val), 1);
+}
+
 // Test seeking to a value in a small block.
 // Regression test for a bug seen in development where this would
 // infinite loop when there are no 'restarts' in a given block.
@@ -24,7 +24,10 @@
 #include "kudu/gutil/port.h"
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/common/column_materialization_context.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/coding-inl.h"
 #include "kudu/util/hexdump.h"
@@ -42,6 +45,38 @@ enum {
   kRleBitmapBlockHeaderSize = 8
 };
 
+// Copies the next 'n' values from 'decoder' into 'dst', evaluating the
+// predicate of 'ctx' once per run of repeated values rather than once per
+// row. Rows of runs which don't match the predicate are cleared from 'sel'
+// and are not copied.
+template <DataType Type>
+Status CopyNextAndEvalRuns(RleDecoder<typename TypeTraits<Type>::cpp_type>* decoder,
+                           size_t n,
+                           ColumnMaterializationContext* ctx,
+                           SelectionVectorView sel,
+                           ColumnDataView dst) {
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  DCHECK_EQ(dst.stride(), sizeof(CppType));
+  while (n > 0) {
+    CppType val;
+    size_t run = decoder->GetNextRun(&val, n);
+    if (PREDICT_FALSE(run == 0)) {
+      return Status::Corruption(
+          strings::Substitute("Unexpected end of RLE data. Expected $0 more values", n));
+    }
+    if (ctx->pred()->EvaluateCell<Type>(&val)) {
+      CppType* out = reinterpret_cast<CppType*>(dst.data());
+      std::fill(out, out + run, val);
+    } else {
+      sel.ClearBits(run);
+    }
+    sel.Advance(run);
+    dst.Advance(run);
+    n -= run;
+  }
+  return Status::OK();
+}
+
 //
 // RLE encoder for the BOOL datatype: uses an RLE-encoded bitmap to
 // represent a bool column.
@@ -185,6 +220,26 @@ class RleBitMapBlockDecoder final : public BlockDecoder {
     return Status::OK();
   }
 
+  virtual Status CopyNextAndEval(size_t* n,
+                                 ColumnMaterializationContext* ctx,
+                                 SelectionVectorView* sel,
+                                 ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    ctx->SetDecoderEvalSupported();
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t bits_to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    RETURN_NOT_OK(CopyNextAndEvalRuns<BOOL>(&rle_decoder_, bits_to_fetch, ctx, *sel, *dst));
+    cur_idx_ += bits_to_fetch;
+    *n = bits_to_fetch;
+    return Status::OK();
+  }
+
   virtual Status SeekAtOrAfterValue(const void *value,
                                     bool *exact_match) OVERRIDE {
     return Status::NotSupported("BOOL keys are not supported!");
@@ -409,6 +464,26 @@ class RleIntBlockDecoder final : public BlockDecoder {
     return Status::OK();
   }
 
+  virtual Status CopyNextAndEval(size_t* n,
+                                 ColumnMaterializationContext* ctx,
+                                 SelectionVectorView* sel,
+                                 ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    ctx->SetDecoderEvalSupported();
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    RETURN_NOT_OK(CopyNextAndEvalRuns<IntType>(&rle_decoder_, to_fetch, ctx, *sel, *dst));
+    cur_idx_ += to_fetch;
+    *n = to_fetch;
+    return Status::OK();
+  }
+
   virtual bool HasNext() const OVERRIDE {
     return cur_idx_ < num_elems_;
   }
@@ -0,0 +1,210 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/secondary_block_cache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/cfile/block_cache.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/env.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int64(block_cache_secondary_max_queued_mb);
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+
+class SecondaryBlockCacheTest : public KuduTest {
+ public:
+  SecondaryBlockCacheTest()
+      : cache_(NewLRUCache(DRAM_CACHE, 1024 * 1024, "test")),
+        dir_(GetTestPath("secondary")) {
+  }
+
+ protected:
+  static string Key(int i) {
+    BlockCache::CacheKey key(BlockId(i), i * 100);
+    return string(reinterpret_cast<const char*>(&key), sizeof(key));
+  }
+
+  static string Value(int i) {
+    return Substitute("block $0 $1", i, string(i % 50, 'x'));
+  }
+
+  void OpenCache(uint64_t capacity, bool persistent, const string& fs_uuid = "fs") {
+    secondary_.reset();
+    ASSERT_OK(SecondaryBlockCache::Open(env_, dir_, capacity, persistent, fs_uuid,
+                                        &secondary_));
+  }
+
+  void Insert(int i) {
+    secondary_->EvictedEntry(Key(i), Value(i));
+    secondary_->WaitForPendingWrites();
+  }
+
+  // Returns whether block 'i' is found, checking its contents if it is.
+  bool LookupAndCheck(int i) {
+    string key = Key(i);
+    Cache::PendingHandle* ph = secondary_->Lookup(key, cache_.get());
+    if (ph == nullptr) {
+      return false;
+    }
+    string value = Value(i);
+    EXPECT_EQ(value, Slice(cache_->MutableValue(ph), value.size()).ToString());
+    cache_->Free(ph);
+    return true;
+  }
+
+  unique_ptr<Cache> cache_;
+  const string dir_;
+  gscoped_ptr<SecondaryBlockCache> secondary_;
+};
+
+TEST_F(SecondaryBlockCacheTest, TestInsertAndLookup) {
+  OpenCache(1024 * 1024, false);
+  for (int i = 0; i < 100; i++) {
+    Insert(i);
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(LookupAndCheck(i)) << i;
+  }
+  ASSERT_FALSE(LookupAndCheck(100));
+
+  // Inserting a block again is a no-op.
+  Insert(5);
+  ASSERT_TRUE(LookupAndCheck(5));
+}
+
+// Blocks evicted while the write queue is full are dropped rather than
+// blocking the thread which evicted them.
+TEST_F(SecondaryBlockCacheTest, TestFullQueueDropsBlocks) {
+  OpenCache(1024 * 1024, false);
+  FLAGS_block_cache_secondary_max_queued_mb = 0;
+  Insert(0);
+  ASSERT_FALSE(LookupAndCheck(0));
+
+  FLAGS_block_cache_secondary_max_queued_mb = 1;
+  Insert(0);
+  ASSERT_TRUE(LookupAndCheck(0));
+}
+
+// Once the file is full, the oldest blocks are overwritten first.
+TEST_F(SecondaryBlockCacheTest, TestWrapAround) {
+  OpenCache(4096, false);
+  const int kNumBlocks = 1000;
+  for (int i = 0; i < kNumBlocks; i++) {
+    Insert(i);
+  }
+  ASSERT_FALSE(LookupAndCheck(0));
+  ASSERT_TRUE(LookupAndCheck(kNumBlocks - 1));
+
+  // The blocks which are still cached are the most recently inserted ones.
+  int first_found = kNumBlocks - 1;
+  while (first_found > 0 && LookupAndCheck(first_found - 1)) {
+    first_found--;
+  }
+  ASSERT_GT(first_found, 0);
+  for (int i = 0; i < first_found; i++) {
+    ASSERT_FALSE(LookupAndCheck(i)) << i;
+  }
+}
+
+// Blocks which don't match their checksum are treated as misses.
+TEST_F(SecondaryBlockCacheTest, TestRecordsAreChecksummed) {
+  OpenCache(1024 * 1024, false);
+  Insert(1);
+  Insert(2);
+
+  // Corrupt the last byte of block 1, which is the last byte of its record.
+  vector<string> children;
+  ASSERT_OK(env_->GetChildren(dir_, &children));
+  string data_path;
+  for (const auto& child : children) {
+    if (HasSuffixString(child, ".data")) {
+      data_path = JoinPathSegments(dir_, child);
+    }
+  }
+  ASSERT_FALSE(data_path.empty());
+  unique_ptr<RWFile> file;
+  RWFileOptions opts;
+  opts.mode = Env::OPEN_EXISTING;
+  ASSERT_OK(env_->NewRWFile(opts, data_path, &file));
+  uint64_t record_len = 3 * sizeof(uint32_t) + Key(1).size() + Value(1).size();
+  ASSERT_OK(file->Write(record_len - 1, Slice("?")));
+
+  ASSERT_FALSE(LookupAndCheck(1));
+  ASSERT_TRUE(LookupAndCheck(2));
+}
+
+TEST_F(SecondaryBlockCacheTest, TestPersistence) {
+  OpenCache(1024 * 1024, true);
+  for (int i = 0; i < 10; i++) {
+    Insert(i);
+  }
+
+  // The index is saved when the cache is destroyed.
+  OpenCache(1024 * 1024, true);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(LookupAndCheck(i)) << i;
+  }
+
+  // Blocks written after reopening go after the existing ones.
+  Insert(10);
+  ASSERT_OK(secondary_->SaveIndex());
+  OpenCache(1024 * 1024, true);
+  for (int i = 0; i <= 10; i++) {
+    ASSERT_TRUE(LookupAndCheck(i)) << i;
+  }
+
+  // The index can't be used with a different capacity.
+  OpenCache(512 * 1024, true);
+  ASSERT_FALSE(LookupAndCheck(0));
+
+  // Nor can it be used with a different filesystem, whose blocks have
+  // unrelated IDs.
+  OpenCache(1024 * 1024, true);
+  Insert(0);
+  OpenCache(1024 * 1024, true, "other fs");
+  ASSERT_FALSE(LookupAndCheck(0));
+  Insert(0);
+  OpenCache(1024 * 1024, true, "other fs");
+  ASSERT_TRUE(LookupAndCheck(0));
+
+  // Opening the cache without persistence discards its contents.
+  OpenCache(1024 * 1024, false);
+  ASSERT_FALSE(LookupAndCheck(0));
+  OpenCache(1024 * 1024, true);
+  ASSERT_FALSE(LookupAndCheck(0));
+}
+
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,556 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/secondary_block_cache.h"
+
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/crc.h"
+#include "kudu/util/env.h"
+#include "kudu/util/env_util.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/thread.h"
+
+DEFINE_int32(block_cache_secondary_index_save_interval_ms, 60 * 1000,
+             "Period of time (in ms) between saves of the index of a persistent "
+             "secondary block cache. Blocks written to the secondary cache since "
+             "the index was last saved are lost on restart.");
+TAG_FLAG(block_cache_secondary_index_save_interval_ms, advanced);
+TAG_FLAG(block_cache_secondary_index_save_interval_ms, experimental);
+
+DEFINE_int64(block_cache_secondary_max_queued_mb, 64,
+             "Maximum size (in MB) of the blocks waiting to be written to the "
+             "secondary block cache. Blocks evicted from the block cache while "
+             "the queue is full aren't written to the secondary block cache.");
+TAG_FLAG(block_cache_secondary_max_queued_mb, advanced);
+TAG_FLAG(block_cache_secondary_max_queued_mb, experimental);
+
+METRIC_DEFINE_counter(server, block_cache_secondary_inserts,
+                      "Secondary Block Cache Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of blocks evicted from the block cache that were written "
+                      "to the secondary block cache");
+METRIC_DEFINE_counter(server, block_cache_secondary_evictions,
+                      "Secondary Block Cache Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of blocks overwritten in the secondary block cache");
+METRIC_DEFINE_counter(server, block_cache_secondary_hits,
+                      "Secondary Block Cache Hits", kudu::MetricUnit::kBlocks,
+                      "Number of block cache misses that were served from the "
+                      "secondary block cache");
+METRIC_DEFINE_counter(server, block_cache_secondary_misses,
+                      "Secondary Block Cache Misses", kudu::MetricUnit::kBlocks,
+                      "Number of block cache misses that the secondary block cache "
+                      "couldn't serve");
+METRIC_DEFINE_counter(server, block_cache_secondary_checksum_failures,
+                      "Secondary Block Cache Checksum Failures", kudu::MetricUnit::kBlocks,
+                      "Number of blocks read from the secondary block cache that didn't "
+                      "match their checksum, usually because they had been overwritten");
+METRIC_DEFINE_counter(server, block_cache_secondary_dropped_writes,
+                      "Secondary Block Cache Dropped Writes", kudu::MetricUnit::kBlocks,
+                      "Number of blocks evicted from the block cache that weren't written "
+                      "to the secondary block cache because too many blocks were already "
+                      "waiting to be written");
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+const char kDataFileName[] = "block_cache.data";
+const char kIndexFileName[] = "block_cache.index";
+
+// Each record in the data file is laid out as:
+//
+//   checksum (fixed32), key length (fixed32), value length (fixed32), key, value
+//
+// where the checksum is the CRC32C of everything following it.
+const size_t kRecordHeaderSize = 3 * sizeof(uint32_t);
+
+// The saved index is laid out as:
+//
+//   version (fixed32), capacity (fixed64), write offset (fixed64),
+//   filesystem UUID (fixed32 length-prefixed), entries..., checksum (fixed32)
+//
+// where each entry is:
+//
+//   offset (fixed64), value length (fixed32), record checksum (fixed32),
+//   key (fixed32 length-prefixed)
+//
+// in the order the records were written, and the checksum is the CRC32C of
+// everything preceding it.
+const uint32_t kIndexVersion = 2;
+const size_t kIndexHeaderSize = sizeof(uint32_t) + 2 * sizeof(uint64_t);
+const size_t kIndexEntryFixedSize = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+uint32_t RecordChecksum(const Slice& key, const Slice& value) {
+  uint8_t lengths[2 * sizeof(uint32_t)];
+  EncodeFixed32(lengths, key.size());
+  EncodeFixed32(lengths + sizeof(uint32_t), value.size());
+  crc::Crc* crc32c = crc::GetCrc32cInstance();
+  uint64_t crc = 0;
+  crc32c->Compute(lengths, sizeof(lengths), &crc, nullptr);
+  crc32c->Compute(key.data(), key.size(), &crc, nullptr);
+  crc32c->Compute(value.data(), value.size(), &crc, nullptr);
+  return static_cast<uint32_t>(crc);
+}
+
+} // anonymous namespace
+
+#define MINIT(member, x) member(METRIC_##x.Instantiate(entity))
+SecondaryBlockCache::Metrics::Metrics(const scoped_refptr<MetricEntity>& entity)
+  : MINIT(inserts, block_cache_secondary_inserts),
+    MINIT(evictions, block_cache_secondary_evictions),
+    MINIT(hits, block_cache_secondary_hits),
+    MINIT(misses, block_cache_secondary_misses),
+    MINIT(checksum_failures, block_cache_secondary_checksum_failures),
+    MINIT(dropped_writes, block_cache_secondary_dropped_writes) {
+}
+#undef MINIT
+
+uint64_t SecondaryBlockCache::Entry::record_len(size_t key_len) const {
+  return kRecordHeaderSize + key_len + value_len;
+}
+
+SecondaryBlockCache::SecondaryBlockCache(Env* env, string dir, uint64_t capacity,
+                                         bool persistent, string fs_uuid)
+    : env_(env),
+      dir_(std::move(dir)),
+      capacity_(capacity),
+      persistent_(persistent),
+      fs_uuid_(std::move(fs_uuid)),
+      queue_cond_(&queue_lock_),
+      idle_cond_(&queue_lock_),
+      queued_bytes_(0),
+      writing_(false),
+      shutting_down_(false),
+      write_offset_(0),
+      dirty_(false),
+      shutdown_latch_(1) {
+}
+
+SecondaryBlockCache::~SecondaryBlockCache() {
+  if (writer_thread_) {
+    {
+      MutexLock l(queue_lock_);
+      shutting_down_ = true;
+      queue_cond_.Signal();
+    }
+    // The writer finishes writing the queued blocks first, so that they're
+    // in the index saved below.
+    writer_thread_->Join();
+  }
+  shutdown_latch_.CountDown();
+  if (index_saver_thread_) {
+    index_saver_thread_->Join();
+    WARN_NOT_OK(SaveIndex(), "Unable to save secondary block cache index");
+  }
+}
+
+Status SecondaryBlockCache::Open(Env* env, const string& dir, uint64_t capacity,
+                                 bool persistent, const string& fs_uuid,
+                                 gscoped_ptr<SecondaryBlockCache>* cache) {
+  gscoped_ptr<SecondaryBlockCache> c(new SecondaryBlockCache(env, dir, capacity, persistent,
+                                                             fs_uuid));
+  RETURN_NOT_OK_PREPEND(c->Init(), Substitute("Unable to open secondary block cache in $0",
+                                              dir));
+  *cache = c.Pass();
+  return Status::OK();
+}
+
+Status SecondaryBlockCache::Init() {
+  RETURN_NOT_OK(env_util::CreateDirIfMissing(env_, dir_));
+
+  string data_path = JoinPathSegments(dir_, kDataFileName);
+  string index_path = JoinPathSegments(dir_, kIndexFileName);
+  RWFileOptions opts;
+  if (persistent_ && env_->FileExists(data_path)) {
+    opts.mode = Env::OPEN_EXISTING;
+  } else {
+    opts.mode = Env::CREATE_IF_NON_EXISTING_TRUNCATE;
+  }
+  RETURN_NOT_OK(env_->NewRWFile(opts, data_path, &file_));
+
+  if (!persistent_) {
+    // The data file was just truncated, so any saved index is invalid.
+    if (env_->FileExists(index_path)) {
+      RETURN_NOT_OK(env_->DeleteFile(index_path));
+    }
+  } else {
+    if (opts.mode == Env::OPEN_EXISTING) {
+      LoadIndex();
+    }
+    RETURN_NOT_OK(Thread::Create("cfile", "secondary-block-cache-index-saver",
+                                 &SecondaryBlockCache::RunIndexSaver, this,
+                                 &index_saver_thread_));
+  }
+  return Thread::Create("cfile", "secondary-block-cache-writer",
+                        &SecondaryBlockCache::RunWriter, this, &writer_thread_);
+}
+
+void SecondaryBlockCache::LoadIndex() {
+  string index_path = JoinPathSegments(dir_, kIndexFileName);
+  if (!env_->FileExists(index_path)) {
+    return;
+  }
+  faststring data;
+  Status s = ReadFileToString(env_, index_path, &data);
+  if (s.ok()) {
+    s = ParseIndex(Slice(data));
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to load secondary block cache index " << index_path << ": "
+                 << s.ToString() << "; starting with an empty cache";
+    index_.clear();
+    fifo_.clear();
+    write_offset_ = 0;
+    return;
+  }
+  LOG(INFO) << Substitute("Loaded $0 blocks into the secondary block cache in $1",
+                          index_.size(), dir_);
+}
+
+Status SecondaryBlockCache::ParseIndex(const Slice& data) {
+  if (data.size() < kIndexHeaderSize + sizeof(uint32_t)) {
+    return Status::Corruption("index is truncated");
+  }
+  Slice body(data.data(), data.size() - sizeof(uint32_t));
+  if (crc::Crc32c(body.data(), body.size()) != DecodeFixed32(body.data() + body.size())) {
+    return Status::Corruption("index checksum mismatch");
+  }
+  uint32_t version = DecodeFixed32(body.data());
+  if (version != kIndexVersion) {
+    return Status::NotSupported(Substitute("unknown index version $0", version));
+  }
+  uint64_t capacity = DecodeFixed64(body.data() + sizeof(uint32_t));
+  if (capacity != capacity_) {
+    return Status::IllegalState(Substitute(
+        "index is for a cache of $0 bytes, but the capacity is now $1 bytes",
+        capacity, capacity_));
+  }
+  uint64_t write_offset = DecodeFixed64(body.data() + sizeof(uint32_t) + sizeof(uint64_t));
+  body.remove_prefix(kIndexHeaderSize);
+
+  // Block IDs are only unique within a filesystem, so an index written for
+  // another filesystem would map keys to unrelated blocks.
+  if (body.size() < sizeof(uint32_t)) {
+    return Status::Corruption("index is truncated");
+  }
+  uint32_t uuid_len = DecodeFixed32(body.data());
+  body.remove_prefix(sizeof(uint32_t));
+  if (body.size() < uuid_len) {
+    return Status::Corruption("index is truncated");
+  }
+  Slice fs_uuid(body.data(), uuid_len);
+  if (fs_uuid != fs_uuid_) {
+    return Status::IllegalState(Substitute(
+        "index is for filesystem $0, but the filesystem is now $1",
+        fs_uuid.ToString(), fs_uuid_));
+  }
+  body.remove_prefix(uuid_len);
+
+  while (!body.empty()) {
+    if (body.size() < kIndexEntryFixedSize + sizeof(uint32_t)) {
+      return Status::Corruption("index entry is truncated");
+    }
+    Entry e;
+    e.offset = DecodeFixed64(body.data());
+    e.value_len = DecodeFixed32(body.data() + sizeof(uint64_t));
+    e.checksum = DecodeFixed32(body.data() + sizeof(uint64_t) + sizeof(uint32_t));
+    uint32_t key_len = DecodeFixed32(body.data() + kIndexEntryFixedSize);
+    body.remove_prefix(kIndexEntryFixedSize + sizeof(uint32_t));
+    if (body.size() < key_len) {
+      return Status::Corruption("index entry is truncated");
+    }
+    string key(reinterpret_cast<const char*>(body.data()), key_len);
+    body.remove_prefix(key_len);
+    if (e.offset + e.record_len(key_len) > capacity_) {
+      return Status::Corruption(Substitute("index entry at offset $0 is out of bounds",
+                                           e.offset));
+    }
+    index_[key] = e;
+    fifo_.emplace_back(e.offset, std::move(key));
+  }
+  write_offset_ = write_offset;
+  return Status::OK();
+}
+
+Status SecondaryBlockCache::SaveIndex() {
+  if (!persistent_) {
+    return Status::OK();
+  }
+  faststring data;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (!dirty_) {
+      return Status::OK();
+    }
+    PutFixed32(&data, kIndexVersion);
+    PutFixed64(&data, capacity_);
+    PutFixed64(&data, write_offset_);
+    PutFixed32LengthPrefixedSlice(&data, fs_uuid_);
+    for (const auto& record : fifo_) {
+      const Entry* e = FindOrNull(index_, record.second);
+      if (e == nullptr || e->offset != record.first) {
+        continue;
+      }
+      PutFixed64(&data, e->offset);
+      PutFixed32(&data, e->value_len);
+      PutFixed32(&data, e->checksum);
+      PutFixed32LengthPrefixedSlice(&data, record.second);
+    }
+    dirty_ = false;
+  }
+  PutFixed32(&data, crc::Crc32c(data.data(), data.size()));
+
+  // Write the index to a temporary file first, so that a crash can't leave
+  // a partially written index behind.
+  string index_path = JoinPathSegments(dir_, kIndexFileName);
+  string tmp_path = StrCat(index_path, kTmpInfix);
+  Status s = WriteStringToFileSync(env_, Slice(data), tmp_path);
+  if (s.ok()) {
+    s = env_->RenameFile(tmp_path, index_path);
+  }
+  if (s.ok()) {
+    s = env_->SyncDir(dir_);
+  }
+  if (!s.ok()) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    dirty_ = true;
+  }
+  return s;
+}
+
+void SecondaryBlockCache::RunIndexSaver() {
+  MonoDelta interval = MonoDelta::FromMilliseconds(
+      FLAGS_block_cache_secondary_index_save_interval_ms);
+  while (!shutdown_latch_.WaitFor(interval)) {
+    WARN_NOT_OK(SaveIndex(), "Unable to save secondary block cache index");
+  }
+}
+
+Cache::PendingHandle* SecondaryBlockCache::Lookup(const Slice& key, Cache* cache) {
+  string key_str = key.ToString();
+  Entry e;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    const Entry* found = FindOrNull(index_, key_str);
+    if (found == nullptr) {
+      if (metrics_) metrics_->misses->Increment();
+      return nullptr;
+    }
+    e = *found;
+  }
+
+  Cache::PendingHandle* ph = cache->Allocate(key, e.value_len, e.value_len);
+  if (ph == nullptr) {
+    return nullptr;
+  }
+
+  // The record is read without holding any lock, so it may be overwritten
+  // while it's being read. The checksum catches that.
+  faststring header;
+  header.resize(kRecordHeaderSize + key.size());
+  vector<Slice> results = { Slice(header.data(), header.size()),
+                            Slice(cache->MutableValue(ph), e.value_len) };
+  Status s = file_->ReadV(e.offset, &results);
+  if (s.ok()) {
+    if (DecodeFixed32(header.data()) != e.checksum ||
+        DecodeFixed32(header.data() + sizeof(uint32_t)) != key.size() ||
+        DecodeFixed32(header.data() + 2 * sizeof(uint32_t)) != e.value_len ||
+        Slice(header.data() + kRecordHeaderSize, key.size()) != key ||
+        RecordChecksum(key, results[1]) != e.checksum) {
+      s = Status::Corruption("checksum mismatch");
+    }
+  }
+  if (!s.ok()) {
+    VLOG(1) << Substitute("Unable to read block from secondary block cache at offset $0: $1",
+                          e.offset, s.ToString());
+    if (metrics_) {
+      metrics_->checksum_failures->Increment();
+      metrics_->misses->Increment();
+    }
+    EraseIfAtOffset(key_str, e.offset);
+    cache->Free(ph);
+    return nullptr;
+  }
+  if (metrics_) metrics_->hits->Increment();
+  return ph;
+}
+
+void SecondaryBlockCache::EvictedEntry(Slice key, Slice value) {
+  Entry e;
+  e.value_len = value.size();
+  if (e.record_len(key.size()) > capacity_) {
+    return;
+  }
+  string key_str = key.ToString();
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (ContainsKey(index_, key_str)) {
+      return;
+    }
+  }
+
+  // This is called on the threads reading from the block cache, so the
+  // block is only copied here, and written by the writer thread. The space
+  // is reserved before the value is copied, so that blocks which are going
+  // to be dropped aren't copied.
+  uint64_t bytes = key.size() + value.size();
+  {
+    MutexLock l(queue_lock_);
+    uint64_t max_queued_bytes = FLAGS_block_cache_secondary_max_queued_mb * 1024 * 1024;
+    if (queued_bytes_ + bytes > max_queued_bytes) {
+      if (metrics_) metrics_->dropped_writes->Increment();
+      return;
+    }
+    queued_bytes_ += bytes;
+  }
+  string value_str = value.ToString();
+  MutexLock l(queue_lock_);
+  queue_.emplace_back(std::move(key_str), std::move(value_str));
+  queue_cond_.Signal();
+}
+
+void SecondaryBlockCache::WaitForPendingWrites() {
+  MutexLock l(queue_lock_);
+  while (queued_bytes_ > 0) {
+    idle_cond_.Wait();
+  }
+}
+
+void SecondaryBlockCache::RunWriter() {
+  string key;
+  string value;
+  while (true) {
+    {
+      MutexLock l(queue_lock_);
+      if (writing_) {
+        writing_ = false;
+        queued_bytes_ -= key.size() + value.size();
+        if (queued_bytes_ == 0) {
+          idle_cond_.Broadcast();
+        }
+      }
+      while (queue_.empty() && !shutting_down_) {
+        queue_cond_.Wait();
+      }
+      if (queue_.empty()) {
+        return;
+      }
+      key = std::move(queue_.front().first);
+      value = std::move(queue_.front().second);
+      queue_.pop_front();
+      writing_ = true;
+    }
+    WriteRecord(key, value);
+  }
+}
+
+void SecondaryBlockCache::WriteRecord(const string& key, const Slice& value) {
+  Entry e;
+  e.value_len = value.size();
+  uint64_t record_len = e.record_len(key.size());
+
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (ContainsKey(index_, key)) {
+      return;
+    }
+    if (write_offset_ + record_len > capacity_) {
+      // Wrap around, dropping the records at the end of the file.
+      EvictRangeUnlocked(write_offset_, capacity_ - write_offset_);
+      write_offset_ = 0;
+    }
+    EvictRangeUnlocked(write_offset_, record_len);
+  }
+
+  // Records are written outside of 'lock_' so that lookups aren't blocked.
+  // Nothing else can write to this range, since this is the only writer.
+  e.offset = write_offset_;
+  e.checksum = RecordChecksum(key, value);
+  faststring header;
+  PutFixed32(&header, e.checksum);
+  PutFixed32(&header, key.size());
+  PutFixed32(&header, value.size());
+  header.append(key.data(), key.size());
+  Status s = file_->Write(e.offset, Slice(header));
+  if (s.ok()) {
+    s = file_->Write(e.offset + header.size(), value);
+  }
+  if (!s.ok()) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << "Unable to write block to secondary block cache: "
+                                   << s.ToString() << THROTTLE_MSG;
+    return;
+  }
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  write_offset_ += record_len;
+  index_.emplace(key, e);
+  fifo_.emplace_back(e.offset, key);
+  dirty_ = true;
+  if (metrics_) metrics_->inserts->Increment();
+}
+
+void SecondaryBlockCache::EvictRangeUnlocked(uint64_t offset, uint64_t length) {
+  // The oldest record always starts at or after the write head, unless it
+  // was written after the last wrap-around, in which case no records written
+  // before the wrap-around remain and there's nothing to evict.
+  uint64_t end = offset + length;
+  while (!fifo_.empty()) {
+    const auto& record = fifo_.front();
+    if (record.first < offset || record.first >= end) {
+      break;
+    }
+    const Entry* e = FindOrNull(index_, record.second);
+    if (e != nullptr && e->offset == record.first) {
+      index_.erase(record.second);
+      dirty_ = true;
+      if (metrics_) metrics_->evictions->Increment();
+    }
+    fifo_.pop_front();
+  }
+}
+
+void SecondaryBlockCache::EraseIfAtOffset(const string& key, uint64_t offset) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  const Entry* e = FindOrNull(index_, key);
+  if (e != nullptr && e->offset == offset) {
+    index_.erase(key);
+    dirty_ = true;
+  }
+}
+
+void SecondaryBlockCache::SetMetrics(const scoped_refptr<MetricEntity>& metric_entity) {
+  metrics_.reset(new Metrics(metric_entity));
+}
+
+} // namespace cfile
+} // namespace kudu
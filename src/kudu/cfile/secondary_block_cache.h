@@ -0,0 +1,213 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CFILE_SECONDARY_BLOCK_CACHE_H
+#define KUDU_CFILE_SECONDARY_BLOCK_CACHE_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Env;
+class RWFile;
+class Thread;
+
+namespace cfile {
+
+// A second tier for the block cache which keeps blocks evicted from memory
+// in a file, typically on a local SSD.
+//
+// The file is used as a ring buffer: evicted blocks are appended at the
+// write head, and once the file is full the oldest blocks are overwritten
+// (i.e. eviction is FIFO). Evicted blocks are queued and written by a
+// background thread, so that evictions don't block the threads reading from
+// the block cache; blocks evicted while the queue is full are dropped.
+//
+// An in-memory index maps each key to the location of its block. Each
+// record is checksummed, and a block is only returned if it is read back
+// intact; otherwise the lookup is treated as a miss.
+//
+// If 'persistent' is set, the index is periodically saved next to the data
+// file and reloaded when the cache is reopened, so that the cached blocks
+// survive restarts. This relies on the keys identifying the same block
+// across restarts, which holds for BlockCache::CacheKey as long as the
+// server keeps the same filesystem. Block IDs are only unique within a
+// filesystem, so the index records the UUID of the filesystem it was
+// written for, and is discarded if it doesn't match. Since blocks written
+// after the index was last saved may have overwritten blocks it refers to,
+// the checksums are what keep a stale index from returning the wrong data.
+//
+// This class is thread-safe.
+class SecondaryBlockCache : public Cache::EvictionCallback {
+ public:
+  // Opens the cache in the directory 'dir', creating it if it doesn't
+  // exist, with space for 'capacity' bytes of records. 'fs_uuid' is the UUID
+  // of the filesystem whose blocks are cached.
+  static Status Open(Env* env, const std::string& dir, uint64_t capacity,
+                     bool persistent, const std::string& fs_uuid,
+                     gscoped_ptr<SecondaryBlockCache>* cache);
+
+  ~SecondaryBlockCache();
+
+  // Looks up 'key'. If it is found, allocates an entry for it in 'cache',
+  // reads the block into the entry and returns it, ready to be inserted.
+  //
+  // Returns nullptr if the key isn't found, if the block couldn't be read
+  // back intact, or if 'cache' can't allocate the entry.
+  Cache::PendingHandle* Lookup(const Slice& key, Cache* cache);
+
+  // Queues the evicted block to be written to the cache, unless it's already
+  // there. Blocks are immutable, so a block with the same key has the same
+  // contents. If too many bytes are already queued, the block is dropped.
+  void EvictedEntry(Slice key, Slice value) override;
+
+  // Waits until the blocks queued so far have been written. For tests.
+  void WaitForPendingWrites();
+
+  // Saves the index, if the cache is persistent.
+  Status SaveIndex();
+
+  void SetMetrics(const scoped_refptr<MetricEntity>& metric_entity);
+
+  uint64_t capacity() const { return capacity_; }
+
+ private:
+  // The location of a record in the data file.
+  struct Entry {
+    uint64_t offset;
+    uint32_t value_len;
+    uint32_t checksum;
+
+    uint64_t record_len(size_t key_len) const;
+  };
+
+  struct Metrics {
+    explicit Metrics(const scoped_refptr<MetricEntity>& entity);
+
+    scoped_refptr<Counter> inserts;
+    scoped_refptr<Counter> evictions;
+    scoped_refptr<Counter> hits;
+    scoped_refptr<Counter> misses;
+    scoped_refptr<Counter> checksum_failures;
+    scoped_refptr<Counter> dropped_writes;
+  };
+
+  SecondaryBlockCache(Env* env, std::string dir, uint64_t capacity, bool persistent,
+                      std::string fs_uuid);
+
+  Status Init();
+
+  // Reads the saved index, if there is one. Any problem with it is logged
+  // and leaves the cache empty.
+  void LoadIndex();
+  Status ParseIndex(const Slice& data);
+
+  // Periodically saves the index until the cache is destroyed.
+  void RunIndexSaver();
+
+  // Writes the queued blocks until the cache is destroyed.
+  void RunWriter();
+
+  // Writes a block to the data file and adds it to the index, unless it's
+  // already there. Only called by the writer thread.
+  void WriteRecord(const std::string& key, const Slice& value);
+
+  // Removes the entries whose records overlap [offset, offset + length)
+  // from the index.
+  void EvictRangeUnlocked(uint64_t offset, uint64_t length);
+
+  // Removes 'key' from the index if it still refers to the record at
+  // 'offset'.
+  void EraseIfAtOffset(const std::string& key, uint64_t offset);
+
+  Env* const env_;
+  const std::string dir_;
+  const uint64_t capacity_;
+  const bool persistent_;
+  const std::string fs_uuid_;
+
+  std::unique_ptr<RWFile> file_;
+
+  // Protects the queue of blocks waiting to be written.
+  Mutex queue_lock_;
+
+  // Signaled when a block is queued, or when the cache is being destroyed.
+  ConditionVariable queue_cond_;
+
+  // Signaled when all the queued blocks have been written.
+  ConditionVariable idle_cond_;
+
+  // The keys and values of the blocks waiting to be written, oldest first.
+  std::deque<std::pair<std::string, std::string>> queue_;
+
+  // The total size of the keys and values in 'queue_', plus that of the
+  // block being written, if any, and of the blocks being queued.
+  uint64_t queued_bytes_;
+
+  // Whether the writer thread is writing a block taken from 'queue_'.
+  bool writing_;
+
+  bool shutting_down_;
+
+  // The offset at which the next record will be written. Only modified by
+  // the writer thread, with 'lock_' held.
+  uint64_t write_offset_;
+
+  // Protects the index.
+  mutable simple_spinlock lock_;
+
+  // Maps each key to its record.
+  std::unordered_map<std::string, Entry> index_;
+
+  // The keys and offsets of the records in the order they were written, so
+  // that records can be evicted as the write head overwrites them. May hold
+  // records which were already removed from 'index_'.
+  std::deque<std::pair<uint64_t, std::string>> fifo_;
+
+  // Whether the index changed since it was last saved.
+  bool dirty_;
+
+  std::unique_ptr<Metrics> metrics_;
+
+  CountDownLatch shutdown_latch_;
+  scoped_refptr<Thread> index_saver_thread_;
+  scoped_refptr<Thread> writer_thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(SecondaryBlockCache);
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif // KUDU_CFILE_SECONDARY_BLOCK_CACHE_H
@@ -0,0 +1,275 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/zone_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+// Binary bounds larger than this are not stored, so that a few large values
+// can't bloat the zone maps. Ranges containing them are treated as unbounded.
+const size_t kMaxBoundSize = 1024;
+
+template<typename T>
+bool IsNaN(T /* val */) {
+  return false;
+}
+
+bool IsNaN(float val) {
+  return std::isnan(val);
+}
+
+bool IsNaN(double val) {
+  return std::isnan(val);
+}
+
+// A cell decoded from a bound stored in a ZoneMapPB.
+class BoundCell {
+ public:
+  // Returns false if 'bound' is not a valid value of 'type_info'.
+  bool Init(const TypeInfo* type_info, const Slice& bound) {
+    if (type_info->physical_type() == BINARY) {
+      slice_ = bound;
+      cell_ = &slice_;
+      return true;
+    }
+    if (bound.size() != type_info->size() || bound.size() > sizeof(buf_)) {
+      return false;
+    }
+    memcpy(buf_, bound.data(), bound.size());
+    cell_ = buf_;
+    return true;
+  }
+
+  const void* cell() const { return cell_; }
+
+ private:
+  Slice slice_;
+  uint64_t buf_[2];
+  const void* cell_ = nullptr;
+};
+
+} // anonymous namespace
+
+////////////////////////////////////////////////////////////
+// ZoneMapBuilder
+////////////////////////////////////////////////////////////
+
+ZoneMapBuilder::ZoneMapBuilder(const TypeInfo* type_info)
+    : type_info_(type_info) {
+  Reset();
+}
+
+void ZoneMapBuilder::AddValues(const void* cells, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  num_rows_ += count;
+
+  switch (type_info_->physical_type()) {
+    case BOOL: AddFixedValues(static_cast<const bool*>(cells), count); break;
+    case INT8: AddFixedValues(static_cast<const int8_t*>(cells), count); break;
+    case UINT8: AddFixedValues(static_cast<const uint8_t*>(cells), count); break;
+    case INT16: AddFixedValues(static_cast<const int16_t*>(cells), count); break;
+    case UINT16: AddFixedValues(static_cast<const uint16_t*>(cells), count); break;
+    case INT32: AddFixedValues(static_cast<const int32_t*>(cells), count); break;
+    case UINT32: AddFixedValues(static_cast<const uint32_t*>(cells), count); break;
+    case INT64: AddFixedValues(static_cast<const int64_t*>(cells), count); break;
+    case UINT64: AddFixedValues(static_cast<const uint64_t*>(cells), count); break;
+    case FLOAT: AddFixedValues(static_cast<const float*>(cells), count); break;
+    case DOUBLE: AddFixedValues(static_cast<const double*>(cells), count); break;
+    case BINARY: AddBinaryValues(cells, count); break;
+    default:
+      // Other types can't be compared by value here.
+      unbounded_ = true;
+      break;
+  }
+}
+
+void ZoneMapBuilder::AddNulls(size_t count) {
+  num_rows_ += count;
+  null_count_ += count;
+}
+
+template<typename T>
+void ZoneMapBuilder::AddFixedValues(const T* cells, size_t count) {
+  // The ordering of the physical types' C++ types matches
+  // DataTypeTraits<Type>::Compare(), so the bounds can be computed directly.
+  bool have_bounds = has_bounds_;
+  T lo = T();
+  T hi = T();
+  if (have_bounds) {
+    memcpy(&lo, min_.data(), sizeof(T));
+    memcpy(&hi, max_.data(), sizeof(T));
+  }
+  for (size_t i = 0; i < count; i++) {
+    const T val = cells[i];
+    if (PREDICT_FALSE(IsNaN(val))) {
+      unbounded_ = true;
+      continue;
+    }
+    if (PREDICT_FALSE(!have_bounds)) {
+      lo = hi = val;
+      have_bounds = true;
+      continue;
+    }
+    if (val < lo) lo = val;
+    if (hi < val) hi = val;
+  }
+  if (have_bounds) {
+    min_.assign_copy(reinterpret_cast<const uint8_t*>(&lo), sizeof(T));
+    max_.assign_copy(reinterpret_cast<const uint8_t*>(&hi), sizeof(T));
+    has_bounds_ = true;
+  }
+}
+
+void ZoneMapBuilder::AddBinaryValues(const void* cells, size_t count) {
+  const Slice* slices = static_cast<const Slice*>(cells);
+  const Slice* lo = &slices[0];
+  const Slice* hi = &slices[0];
+  for (size_t i = 1; i < count; i++) {
+    if (slices[i].compare(*lo) < 0) lo = &slices[i];
+    if (slices[i].compare(*hi) > 0) hi = &slices[i];
+  }
+  // Copy the bounds, since the cells' data is only valid for this call.
+  if (!has_bounds_ || lo->compare(Slice(min_)) < 0) {
+    min_.assign_copy(lo->data(), lo->size());
+  }
+  if (!has_bounds_ || hi->compare(Slice(max_)) > 0) {
+    max_.assign_copy(hi->data(), hi->size());
+  }
+  has_bounds_ = true;
+}
+
+int ZoneMapBuilder::CompareBounds(const faststring& a, const faststring& b) const {
+  BoundCell a_cell;
+  BoundCell b_cell;
+  CHECK(a_cell.Init(type_info_, Slice(a)));
+  CHECK(b_cell.Init(type_info_, Slice(b)));
+  return type_info_->Compare(a_cell.cell(), b_cell.cell());
+}
+
+void ZoneMapBuilder::Merge(const ZoneMapBuilder& other) {
+  DCHECK_EQ(type_info_->physical_type(), other.type_info_->physical_type());
+  num_rows_ += other.num_rows_;
+  null_count_ += other.null_count_;
+  unbounded_ |= other.unbounded_;
+  if (!other.has_bounds_) {
+    return;
+  }
+  if (!has_bounds_ || CompareBounds(other.min_, min_) < 0) {
+    min_.assign_copy(other.min_.data(), other.min_.size());
+  }
+  if (!has_bounds_ || CompareBounds(other.max_, max_) > 0) {
+    max_.assign_copy(other.max_.data(), other.max_.size());
+  }
+  has_bounds_ = true;
+}
+
+void ZoneMapBuilder::ToPB(ZoneMapPB* pb) const {
+  pb->Clear();
+  pb->set_num_rows(num_rows_);
+  pb->set_null_count(null_count_);
+  if (has_bounds_ && !unbounded_ &&
+      min_.size() <= kMaxBoundSize && max_.size() <= kMaxBoundSize) {
+    pb->set_min_value(min_.data(), min_.size());
+    pb->set_max_value(max_.data(), max_.size());
+  }
+}
+
+void ZoneMapBuilder::Reset() {
+  num_rows_ = 0;
+  null_count_ = 0;
+  has_bounds_ = false;
+  unbounded_ = false;
+  min_.clear();
+  max_.clear();
+}
+
+////////////////////////////////////////////////////////////
+// Predicate evaluation
+////////////////////////////////////////////////////////////
+
+bool ZoneMapMayMatch(const TypeInfo* type_info,
+                     const ZoneMapPB& zone_map,
+                     const ColumnPredicate& pred) {
+  if (!zone_map.has_num_rows() || !zone_map.has_null_count()) {
+    return true;
+  }
+  int64_t non_null_count = zone_map.num_rows() - zone_map.null_count();
+
+  switch (pred.predicate_type()) {
+    case PredicateType::None: return false;
+    case PredicateType::IsNull: return zone_map.null_count() > 0;
+    case PredicateType::IsNotNull: return non_null_count > 0;
+    default: break;
+  }
+
+  // The remaining predicates only match non-NULL values.
+  if (non_null_count == 0) {
+    return false;
+  }
+  BoundCell min;
+  BoundCell max;
+  if (!zone_map.has_min_value() || !zone_map.has_max_value() ||
+      !min.Init(type_info, zone_map.min_value()) ||
+      !max.Init(type_info, zone_map.max_value())) {
+    return true;
+  }
+
+  switch (pred.predicate_type()) {
+    case PredicateType::Equality:
+      return type_info->Compare(pred.raw_lower(), min.cell()) >= 0 &&
+             type_info->Compare(pred.raw_lower(), max.cell()) <= 0;
+    case PredicateType::Range:
+    case PredicateType::InBloomFilter:
+      // The range is [lower, upper), and either bound may be missing.
+      return (pred.raw_lower() == nullptr ||
+              type_info->Compare(max.cell(), pred.raw_lower()) >= 0) &&
+             (pred.raw_upper() == nullptr ||
+              type_info->Compare(min.cell(), pred.raw_upper()) < 0);
+    case PredicateType::InList: {
+      // The values are sorted, so only the smallest value which isn't less
+      // than the minimum needs to be checked against the maximum.
+      const auto& values = pred.raw_values();
+      auto it = std::lower_bound(values.begin(), values.end(), min.cell(),
+                                 [&] (const void* a, const void* b) {
+                                   return type_info->Compare(a, b) < 0;
+                                 });
+      return it != values.end() && type_info->Compare(*it, max.cell()) <= 0;
+    }
+    default:
+      return true;
+  }
+}
+
+} // namespace cfile
+} // namespace kudu
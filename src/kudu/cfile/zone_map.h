@@ -0,0 +1,98 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Zone maps summarize the values of a range of rows of a CFile (a data
+// block, or the whole file) by their minimum and maximum non-NULL values and
+// their number of NULLs, so that readers can skip ranges which cannot
+// contain any rows satisfying a predicate.
+#ifndef KUDU_CFILE_ZONE_MAP_H
+#define KUDU_CFILE_ZONE_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+
+namespace kudu {
+
+class ColumnPredicate;
+class TypeInfo;
+
+namespace cfile {
+
+class ZoneMapPB;
+
+// Accumulates the zone map of a range of cells.
+class ZoneMapBuilder {
+ public:
+  explicit ZoneMapBuilder(const TypeInfo* type_info);
+
+  // Adds 'count' contiguous non-NULL cells, in their in-memory format.
+  void AddValues(const void* cells, size_t count);
+
+  // Adds 'count' NULL cells.
+  void AddNulls(size_t count);
+
+  // Adds all of the cells summarized by 'other', which must be of the same
+  // type.
+  void Merge(const ZoneMapBuilder& other);
+
+  // Returns the number of cells added since the last Reset().
+  int64_t num_rows() const { return num_rows_; }
+
+  void ToPB(ZoneMapPB* pb) const;
+
+  void Reset();
+
+ private:
+  template<typename T>
+  void AddFixedValues(const T* cells, size_t count);
+  void AddBinaryValues(const void* cells, size_t count);
+
+  // Compares two bounds stored in the format of ZoneMapPB.
+  int CompareBounds(const faststring& a, const faststring& b) const;
+
+  const TypeInfo* type_info_;
+
+  int64_t num_rows_;
+  int64_t null_count_;
+
+  // Whether 'min_' and 'max_' hold the bounds of the non-NULL cells.
+  bool has_bounds_;
+
+  // Set if any cell can't be ordered (i.e. is a NaN), in which case the
+  // bounds must not be used.
+  bool unbounded_;
+
+  faststring min_;
+  faststring max_;
+
+  DISALLOW_COPY_AND_ASSIGN(ZoneMapBuilder);
+};
+
+// Returns false if none of the rows summarized by 'zone_map' can satisfy
+// 'pred', whose column's values have type 'type_info'. Returns true if some
+// might.
+bool ZoneMapMayMatch(const TypeInfo* type_info,
+                     const ZoneMapPB& zone_map,
+                     const ColumnPredicate& pred);
+
+} // namespace cfile
+} // namespace kudu
+
+#endif // KUDU_CFILE_ZONE_MAP_H
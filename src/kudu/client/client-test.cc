@@ -62,6 +62,8 @@
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/ts_tablet_manager.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/scoped_cleanup.h"
@@ -74,6 +76,7 @@ DECLARE_bool(fail_dns_resolution);
 DECLARE_bool(log_inject_latency);
 DECLARE_bool(master_support_connect_to_master_rpc);
 DECLARE_bool(allow_unsafe_replication_factor);
+DECLARE_bool(scanner_inject_service_unavailable_on_continue_scan);
 DECLARE_int32(heartbeat_interval_ms);
 DECLARE_int32(leader_failure_exp_backoff_max_delta_ms);
 DECLARE_int32(log_inject_latency_ms_mean);
@@ -934,6 +937,143 @@ TEST_F(ClientTest, TestScanEmptyProjection) {
   }
 }
 
+// Test scanning with the columnar row format, using a small batch size so
+// that the scan spans several continuation RPCs.
+TEST_F(ClientTest, TestColumnarScan) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(),
+                                         FLAGS_test_scan_num_rows));
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetProjectedColumns({ "key", "string_val" }));
+  ASSERT_OK(scanner.SetBatchSizeBytes(1024));
+  ASSERT_OK(scanner.SetRowFormatFlags(KuduScanner::COLUMNAR_LAYOUT));
+  ASSERT_OK(scanner.Open());
+
+  // Fetching a row-wise batch from a columnar scanner is not allowed.
+  KuduScanBatch rowwise_batch;
+  Status s = scanner.NextBatch(&rowwise_batch);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+
+  KuduColumnarScanBatch batch;
+  int count = 0;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    Slice keys;
+    ASSERT_OK(batch.GetFixedLengthColumn(0, &keys));
+    ASSERT_EQ(batch.NumRows() * sizeof(int32_t), keys.size());
+    Slice offsets, strings;
+    ASSERT_OK(batch.GetVariableLengthColumn(1, &offsets, &strings));
+    ASSERT_EQ((batch.NumRows() + 1) * sizeof(uint32_t), offsets.size());
+    Slice non_null_bitmap;
+    ASSERT_OK(batch.GetNonNullBitmapForColumn(1, &non_null_bitmap));
+
+    for (int i = 0; i < batch.NumRows(); i++) {
+      int32_t key = UNALIGNED_LOAD32(keys.data() + i * sizeof(int32_t));
+      uint32_t start = UNALIGNED_LOAD32(offsets.data() + i * sizeof(uint32_t));
+      uint32_t end = UNALIGNED_LOAD32(offsets.data() + (i + 1) * sizeof(uint32_t));
+      ASSERT_TRUE(BitmapTest(non_null_bitmap.data(), i));
+      ASSERT_EQ(StringPrintf("hello %d", key),
+                Slice(strings.data() + start, end - start).ToString());
+    }
+    count += batch.NumRows();
+  }
+  ASSERT_EQ(FLAGS_test_scan_num_rows, count);
+
+  // Accessing a column with the wrong accessor is an error.
+  Slice data, offsets;
+  ASSERT_TRUE(batch.GetFixedLengthColumn(1, &data).IsInvalidArgument());
+  ASSERT_TRUE(batch.GetVariableLengthColumn(0, &offsets, &data).IsInvalidArgument());
+  ASSERT_TRUE(batch.GetNonNullBitmapForColumn(0, &data).IsInvalidArgument());
+  ASSERT_TRUE(batch.GetFixedLengthColumn(2, &data).IsInvalidArgument());
+}
+
+// Test scanning with prefetching enabled, using a small batch size so that
+// several batches are fetched ahead of the caller.
+TEST_F(ClientTest, TestScanWithPrefetch) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(),
+                                         FLAGS_test_scan_num_rows));
+  KuduScanner scanner(client_table_.get());
+  ASSERT_TRUE(scanner.SetPrefetchDepth(-1).IsInvalidArgument());
+  ASSERT_OK(scanner.SetPrefetchDepth(3));
+  ASSERT_OK(scanner.SetBatchSizeBytes(1024));
+  ASSERT_OK(scanner.Open());
+  ASSERT_TRUE(scanner.SetPrefetchDepth(1).IsIllegalState());
+
+  // Every row must be returned exactly once.
+  KuduScanBatch batch;
+  set<int32_t> keys;
+  int count = 0;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    for (int i = 0; i < batch.NumRows(); i++) {
+      int32_t key;
+      ASSERT_OK(batch.Row(i).GetInt32(0, &key));
+      keys.insert(key);
+    }
+    count += batch.NumRows();
+  }
+  ASSERT_EQ(FLAGS_test_scan_num_rows, count);
+  ASSERT_EQ(count, keys.size());
+
+  // Closing a scanner which stopped part-way through must not wait for the
+  // outstanding prefetch.
+  KuduScanner partial(client_table_.get());
+  ASSERT_OK(partial.SetPrefetchDepth(2));
+  ASSERT_OK(partial.SetBatchSizeBytes(1));
+  ASSERT_OK(partial.Open());
+  ASSERT_OK(partial.NextBatch(&batch));
+  partial.Close();
+}
+
+// Test that a prefetched batch which fails is retried with its call sequence
+// ID, and that no rows are lost or duplicated along the way.
+TEST_F(ClientTest, TestScanWithPrefetchRetriesFailedBatch) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(),
+                                         FLAGS_test_scan_num_rows));
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetPrefetchDepth(3));
+  ASSERT_OK(scanner.SetBatchSizeBytes(1));
+  ASSERT_OK(scanner.SetTimeoutMillis(60 * 1000));
+  ASSERT_OK(scanner.Open());
+
+  KuduScanBatch batch;
+  vector<int32_t> keys;
+  auto read_batch = [&]() {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    for (int i = 0; i < batch.NumRows(); i++) {
+      int32_t key;
+      ASSERT_OK(batch.Row(i).GetInt32(0, &key));
+      keys.push_back(key);
+    }
+  };
+  ASSERT_TRUE(scanner.HasMoreRows());
+  NO_FATALS(read_batch());
+  ASSERT_TRUE(scanner.HasMoreRows());
+
+  // Fail the continuation requests for a while. The requests the prefetcher
+  // sends from now on fail with ERROR_SERVER_TOO_BUSY, and the scanner has to
+  // retry them itself once it has consumed the batches buffered so far.
+  FLAGS_scanner_inject_service_unavailable_on_continue_scan = true;
+  thread recover([]() {
+    SleepFor(MonoDelta::FromMilliseconds(500));
+    FLAGS_scanner_inject_service_unavailable_on_continue_scan = false;
+  });
+  auto cleanup = MakeScopedCleanup([&]() {
+    recover.join();
+  });
+
+  while (scanner.HasMoreRows()) {
+    NO_FATALS(read_batch());
+  }
+  scanner.Close();
+
+  // Every row must be returned exactly once.
+  ASSERT_EQ(FLAGS_test_scan_num_rows, keys.size());
+  std::sort(keys.begin(), keys.end());
+  for (int i = 0; i < keys.size(); i++) {
+    ASSERT_EQ(i, keys[i]);
+  }
+}
+
 TEST_F(ClientTest, TestProjectInvalidColumn) {
   KuduScanner scanner(client_table_.get());
   Status s = scanner.SetProjectedColumns({ "column-doesnt-exist" });
@@ -1055,6 +1195,38 @@ TEST_F(ClientTest, TestInvalidPredicates) {
             "32-bit signed integer column 'int_val'", s.ToString());
 }
 
+// Scans with a bloom filter predicate require the servers to support it, so
+// that servers which don't support it reject them up front.
+TEST_F(ClientTest, TestBloomFilterPredicateRequiresServerFeature) {
+  NO_FATALS(InsertTestRows(client_table_.get(), 10));
+  KuduScanner scanner(client_table_.get());
+  auto requires_feature = [&]() {
+    vector<uint32_t> features = scanner.data_->RequiredServerFeatures();
+    return std::find(features.begin(), features.end(),
+                     tserver::TabletServerFeatures::BLOOM_FILTER_PREDICATE) != features.end();
+  };
+  ASSERT_FALSE(requires_feature());
+  ASSERT_OK(scanner.AddConjunctPredicate(
+      client_table_->NewComparisonPredicate("int_val", KuduPredicate::GREATER_EQUAL,
+                                            KuduValue::FromInt(0))));
+  ASSERT_FALSE(requires_feature());
+
+  KuduBloomFilter* bloom_filter;
+  KuduBloomFilterBuilder builder(10);
+  ASSERT_OK(builder.Build(&bloom_filter));
+  for (int32_t v = 0; v < 10; v++) {
+    bloom_filter->Insert(Slice(reinterpret_cast<const uint8_t*>(&v), sizeof(v)));
+  }
+  vector<KuduBloomFilter*> bloom_filters = { bloom_filter };
+  ASSERT_OK(scanner.AddConjunctPredicate(
+      client_table_->NewInBloomFilterPredicate("key", &bloom_filters)));
+  ASSERT_TRUE(requires_feature());
+
+  // The bloom filter matches every inserted key and the servers support it.
+  vector<string> rows;
+  ASSERT_OK(ScanToStrings(&scanner, &rows));
+  ASSERT_EQ(10, rows.size());
+}
 
 // Check that the tserver proxy is reset on close, even for empty tables.
 TEST_F(ClientTest, TestScanCloseProxy) {
@@ -1094,10 +1266,13 @@ static void ReadBatchToStrings(KuduScanner* scanner, vector<string>* rows) {
 
 static void DoScanWithCallback(KuduTable* table,
                                const vector<string>& expected_rows,
+                               int prefetch_depth,
                                const boost::function<Status(const string&)>& cb) {
   // Initialize fault-tolerant snapshot scanner.
   KuduScanner scanner(table);
   ASSERT_OK(scanner.SetFaultTolerant());
+  // With prefetching, the callback runs while batches are buffered or in flight.
+  ASSERT_OK(scanner.SetPrefetchDepth(prefetch_depth));
   // Set a long timeout as we'll be restarting nodes while performing snapshot scans.
   ASSERT_OK(scanner.SetTimeoutMillis(60 * 1000 /* 60 seconds */))
   // Set a small batch size so it reads in multiple batches.
@@ -1174,39 +1349,47 @@ TEST_F(ClientTest, TestScanFaultTolerance) {
       FlushTablet(tablet_id);
     }
 
-    // Test a few different recoverable server-side error conditions.
-    // Since these are recoverable, the scan will succeed when retried elsewhere.
-
-    // Restarting and waiting should result in a SCANNER_EXPIRED error.
-    LOG(INFO) << "Doing a scan while restarting a tserver and waiting for it to come up...";
-    ASSERT_NO_FATAL_FAILURE(internal::DoScanWithCallback(table.get(), expected_rows,
-        boost::bind(&ClientTest_TestScanFaultTolerance_Test::RestartTServerAndWait,
-                    this, _1)));
-
-    // Restarting and not waiting means the tserver is hopefully bootstrapping, leading to
-    // a TABLET_NOT_RUNNING error.
-    LOG(INFO) << "Doing a scan while restarting a tserver...";
-    ASSERT_NO_FATAL_FAILURE(internal::DoScanWithCallback(table.get(), expected_rows,
-        boost::bind(&ClientTest_TestScanFaultTolerance_Test::RestartTServerAsync,
-                    this, _1)));
-    for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
-      MiniTabletServer* ts = cluster_->mini_tablet_server(i);
-      ASSERT_OK(ts->WaitStarted());
-    }
-
-    // Killing the tserver should lead to an RPC timeout.
-    LOG(INFO) << "Doing a scan while killing a tserver...";
-    ASSERT_NO_FATAL_FAILURE(internal::DoScanWithCallback(table.get(), expected_rows,
-        boost::bind(&ClientTest_TestScanFaultTolerance_Test::KillTServer,
-                    this, _1)));
-
-    // Restart the server that we killed.
-    for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
-      MiniTabletServer* ts = cluster_->mini_tablet_server(i);
-      if (!ts->is_started()) {
-        ASSERT_OK(ts->Start());
+    // Test both without prefetching and with batches prefetched when the
+    // failure happens.
+    for (int prefetch_depth : { 0, 3 }) {
+      SCOPED_TRACE(Substitute("prefetch depth $0", prefetch_depth));
+      // Test a few different recoverable server-side error conditions.
+      // Since these are recoverable, the scan will succeed when retried elsewhere.
+
+      // Restarting and waiting should result in a SCANNER_EXPIRED error.
+      LOG(INFO) << "Doing a scan while restarting a tserver and waiting for it to come up...";
+      ASSERT_NO_FATAL_FAILURE(internal::DoScanWithCallback(
+          table.get(), expected_rows, prefetch_depth,
+          boost::bind(&ClientTest_TestScanFaultTolerance_Test::RestartTServerAndWait,
+                      this, _1)));
+
+      // Restarting and not waiting means the tserver is hopefully bootstrapping, leading to
+      // a TABLET_NOT_RUNNING error.
+      LOG(INFO) << "Doing a scan while restarting a tserver...";
+      ASSERT_NO_FATAL_FAILURE(internal::DoScanWithCallback(
+          table.get(), expected_rows, prefetch_depth,
+          boost::bind(&ClientTest_TestScanFaultTolerance_Test::RestartTServerAsync,
+                      this, _1)));
+      for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+        MiniTabletServer* ts = cluster_->mini_tablet_server(i);
         ASSERT_OK(ts->WaitStarted());
       }
+
+      // Killing the tserver should lead to an RPC timeout.
+      LOG(INFO) << "Doing a scan while killing a tserver...";
+      ASSERT_NO_FATAL_FAILURE(internal::DoScanWithCallback(
+          table.get(), expected_rows, prefetch_depth,
+          boost::bind(&ClientTest_TestScanFaultTolerance_Test::KillTServer,
+                      this, _1)));
+
+      // Restart the server that we killed.
+      for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+        MiniTabletServer* ts = cluster_->mini_tablet_server(i);
+        if (!ts->is_started()) {
+          ASSERT_OK(ts->Start());
+          ASSERT_OK(ts->WaitStarted());
+        }
+      }
     }
   }
 }
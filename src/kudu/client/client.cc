@@ -737,6 +737,20 @@ KuduPredicate* KuduTable::NewInListPredicate(const Slice& col_name,
   });
 }
 
+KuduPredicate* KuduTable::NewInBloomFilterPredicate(const Slice& col_name,
+                                                    vector<KuduBloomFilter*>* bloom_filters) {
+  // We always take ownership of bloom_filters; this ensures cleanup if the
+  // predicate is invalid.
+  auto cleanup = MakeScopedCleanup([&]() {
+    STLDeleteElements(bloom_filters);
+  });
+  return data_->MakePredicate(col_name, [&](const ColumnSchema& col_schema) {
+    // Ownership of the bloom filters is passed to the valid returned predicate.
+    cleanup.cancel();
+    return new KuduPredicate(new InBloomFilterPredicateData(col_schema, bloom_filters));
+  });
+}
+
 KuduPredicate* KuduTable::NewIsNotNullPredicate(const Slice& col_name) {
   return data_->MakePredicate(col_name, [&](const ColumnSchema& col_schema) {
     return new KuduPredicate(new IsNotNullPredicateData(col_schema));
@@ -1032,6 +1046,9 @@ Status KuduTableAlterer::Alter() {
 // KuduScanner
 ////////////////////////////////////////////////////////////
 
+const uint64_t KuduScanner::NO_FLAGS = 0;
+const uint64_t KuduScanner::COLUMNAR_LAYOUT = 1 << 0;
+
 KuduScanner::KuduScanner(KuduTable* table)
   : data_(new KuduScanner::Data(table)) {
 }
@@ -1063,6 +1080,20 @@ Status KuduScanner::SetBatchSizeBytes(uint32_t batch_size) {
   return data_->mutable_configuration()->SetBatchSizeBytes(batch_size);
 }
 
+Status KuduScanner::SetPrefetchDepth(int depth) {
+  if (data_->open_) {
+    return Status::IllegalState("Prefetch depth must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetPrefetchDepth(depth);
+}
+
+Status KuduScanner::SetRowFormatFlags(uint64_t flags) {
+  if (data_->open_) {
+    return Status::IllegalState("Row format flags must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetRowFormatFlags(flags);
+}
+
 Status KuduScanner::SetReadMode(ReadMode read_mode) {
   if (data_->open_) {
     return Status::IllegalState("Read mode must be set before Open()");
@@ -1234,6 +1265,10 @@ void KuduScanner::Close() {
 
   VLOG(2) << "Ending " << data_->DebugString();
 
+  // Stop prefetching first, so that no more requests are sent to the
+  // scanner once it's closed.
+  data_->StopPrefetch();
+
   // Close the scanner on the server-side, if necessary.
   //
   // If the scan did not match any rows, the tserver will not assign a scanner ID.
@@ -1270,91 +1305,45 @@ Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
 }
 
 Status KuduScanner::NextBatch(KuduScanBatch* batch) {
-  // TODO: do some double-buffering here -- when we return this batch
-  // we should already have fired off the RPC for the next batch, but
-  // need to do some swapping of the response objects around to avoid
-  // stomping on the memory the user is looking at.
   CHECK(data_->open_);
   CHECK(data_->proxy_);
+  if (PREDICT_FALSE(data_->configuration().row_format_flags() & COLUMNAR_LAYOUT)) {
+    return Status::IllegalState("Cannot fetch a row-wise batch from a scanner "
+                                "with the COLUMNAR_LAYOUT row format flag");
+  }
 
   batch->data_->Clear();
 
-  if (data_->short_circuit_) {
+  bool has_data;
+  RETURN_NOT_OK(data_->FetchNextBatch(&has_data));
+  if (!has_data) {
     return Status::OK();
   }
+  return batch->data_->Reset(&data_->controller_,
+                             data_->configuration().projection(),
+                             data_->configuration().client_projection(),
+                             make_gscoped_ptr(data_->last_response_.release_data()));
+}
 
-  if (data_->data_in_open_) {
-    // We have data from a previous scan.
-    VLOG(2) << "Extracting data from " << data_->DebugString();
-    data_->data_in_open_ = false;
-    return batch->data_->Reset(&data_->controller_,
-                               data_->configuration().projection(),
-                               data_->configuration().client_projection(),
-                                make_gscoped_ptr(data_->last_response_.release_data()));
-  } else if (data_->last_response_.has_more_results()) {
-    // More data is available in this tablet.
-    VLOG(2) << "Continuing " << data_->DebugString();
-
-    MonoTime batch_deadline = MonoTime::Now() + data_->configuration().timeout();
-    data_->PrepareRequest(KuduScanner::Data::CONTINUE);
-
-    while (true) {
-      bool allow_time_for_failover = data_->configuration().is_fault_tolerant();
-      ScanRpcStatus result = data_->SendScanRpc(batch_deadline, allow_time_for_failover);
-
-      // Success case.
-      if (result.result == ScanRpcStatus::OK) {
-        if (data_->last_response_.has_last_primary_key()) {
-          data_->last_primary_key_ = data_->last_response_.last_primary_key();
-        }
-        data_->scan_attempts_ = 0;
-        return batch->data_->Reset(&data_->controller_,
-                                   data_->configuration().projection(),
-                                   data_->configuration().client_projection(),
-                                   make_gscoped_ptr(data_->last_response_.release_data()));
-      }
-
-      data_->scan_attempts_++;
-
-      // Error handling.
-      set<string> blacklist;
-      Status s = data_->HandleError(result, batch_deadline, &blacklist);
-      if (!s.ok()) {
-        LOG(WARNING) << "Scan at tablet server " << data_->ts_->ToString() << " of tablet "
-                     << data_->DebugString() << " failed: " << result.status.ToString();
-        return s;
-      }
-
-      if (data_->configuration().is_fault_tolerant()) {
-        LOG(WARNING) << "Attempting to retry scan of tablet " << data_->DebugString()
-                     << " elsewhere.";
-        return data_->ReopenCurrentTablet(batch_deadline, &blacklist);
-      }
-
-      if (blacklist.empty()) {
-        // If we didn't blacklist the current server, we can just retry again.
-        continue;
-      }
-      // If we blacklisted the current server, and it's not fault-tolerant, we can't
-      // retry anywhere, so just propagate the error.
-      return result.status;
-    }
-  } else if (data_->MoreTablets()) {
-    // More data may be available in other tablets.
-    // No need to close the current tablet; we scanned all the data so the
-    // server closed it for us.
-    VLOG(2) << "Scanning next tablet " << data_->DebugString();
-    data_->last_primary_key_.clear();
-    MonoTime deadline = MonoTime::Now() + data_->configuration().timeout();
-    set<string> blacklist;
-
-    RETURN_NOT_OK(data_->OpenNextTablet(deadline, &blacklist));
-    // No rows written, the next invocation will pick them up.
-    return Status::OK();
-  } else {
-    // No more data anywhere.
+Status KuduScanner::NextBatch(KuduColumnarScanBatch* batch) {
+  CHECK(data_->open_);
+  CHECK(data_->proxy_);
+  if (PREDICT_FALSE(!(data_->configuration().row_format_flags() & COLUMNAR_LAYOUT))) {
+    return Status::IllegalState("Cannot fetch a columnar batch from a scanner "
+                                "without the COLUMNAR_LAYOUT row format flag");
+  }
+
+  batch->data_->Clear();
+
+  bool has_data;
+  RETURN_NOT_OK(data_->FetchNextBatch(&has_data));
+  if (!has_data) {
     return Status::OK();
   }
+  return batch->data_->Reset(&data_->controller_,
+                             data_->configuration().projection(),
+                             data_->configuration().client_projection(),
+                             make_gscoped_ptr(data_->last_response_.release_columnar_data()));
 }
 
 Status KuduScanner::GetCurrentServer(KuduTabletServer** server) {
@@ -1459,6 +1448,11 @@ Status KuduScanTokenBuilder::SetTimeoutMillis(int millis) {
   return Status::OK();
 }
 
+Status KuduScanTokenBuilder::SetSplitSizeBytes(uint64_t split_size_bytes) {
+  data_->SetSplitSizeBytes(split_size_bytes);
+  return Status::OK();
+}
+
 Status KuduScanTokenBuilder::AddConjunctPredicate(KuduPredicate* pred) {
   return data_->mutable_configuration()->AddConjunctPredicate(pred);
 }
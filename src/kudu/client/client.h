@@ -29,6 +29,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/client/columnar_scan_batch.h"
 #include "kudu/client/resource_metrics.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/scan_batch.h"
@@ -895,6 +896,31 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
   KuduPredicate* NewInListPredicate(const Slice& col_name,
                                     std::vector<KuduValue*>* values);
 
+  /// Create a new IN BLOOM FILTER predicate which can be used for scanners
+  /// on this table.
+  ///
+  /// The IN BLOOM FILTER predicate is used to push a filter built from a set
+  /// of values, such as the join keys of the build side of a join, into the
+  /// scan. A row is filtered from the scan if the value of the column is
+  /// not contained in every one of the bloom filters. Since bloom filters
+  /// have false positives, some rows whose values were never inserted into
+  /// the filters may still be returned. NULL values never match.
+  ///
+  /// @param [in] col_name
+  ///   Name of the column to which the predicate applies.
+  /// @param [in] bloom_filters
+  ///   Vector of bloom filters which the column will be matched against. The
+  ///   values inserted into the filters must be encoded as described in
+  ///   KuduBloomFilter::Insert() for the type of the column.
+  /// @return Raw pointer to an IN BLOOM FILTER predicate. The caller owns the
+  ///   predicate until it is passed into KuduScanner::AddConjunctPredicate().
+  ///   The returned predicate takes ownership of the bloom filters vector's
+  ///   elements. In the case of an error (e.g. an invalid column name), a
+  ///   non-NULL value is still returned. The error will be returned when
+  ///   attempting to add this predicate to a KuduScanner.
+  KuduPredicate* NewInBloomFilterPredicate(const Slice& col_name,
+                                           std::vector<KuduBloomFilter*>* bloom_filters);
+
   /// Create a new IS NOT NULL predicate which can be used for scanners on this
   /// table.
   ///
@@ -1690,6 +1716,21 @@ class KUDU_EXPORT KuduScanner {
   /// KuduClientBuilder::default_rpc_timeout().
   enum { kScanTimeoutMillis = 30000 };
 
+  /// @name Row format flags
+  ///
+  /// Flags which may be passed to SetRowFormatFlags(), combined with
+  /// a bitwise OR.
+  ///
+  ///@{
+  /// No flags: rows are returned in the default row-wise format, to be
+  /// fetched with NextBatch(KuduScanBatch*).
+  static const uint64_t NO_FLAGS;
+  /// Rows are returned in a columnar format, to be fetched with
+  /// NextBatch(KuduColumnarScanBatch*). This lets the tablet server and
+  /// the client copy whole columns at once rather than individual cells.
+  static const uint64_t COLUMNAR_LAYOUT;
+  ///@}
+
   /// Constructor for KuduScanner.
   ///
   /// @param [in] table
@@ -1873,6 +1914,19 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status NextBatch(KuduScanBatch* batch);
 
+  /// Fetch the next batch of columnar results for this scanner.
+  ///
+  /// This variant may only be used if the scanner was configured with the
+  /// COLUMNAR_LAYOUT row format flag.
+  ///
+  /// A single KuduColumnarScanBatch object may be reused. Each subsequent
+  /// call replaces the data from the previous call, and invalidates any
+  /// slices previously obtained from the batch.
+  /// @param [out] batch
+  ///   Placeholder for the result.
+  /// @return Operation result status.
+  Status NextBatch(KuduColumnarScanBatch* batch);
+
   /// Get the KuduTabletServer that is currently handling the scan.
   ///
   /// More concretely, this is the server that handled the most recent
@@ -1894,6 +1948,35 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetBatchSizeBytes(uint32_t batch_size);
 
+  /// Set the number of batches to fetch ahead of the application.
+  ///
+  /// With a non-zero prefetch depth, the scanner requests the next batches
+  /// of a tablet in the background while the application processes the
+  /// current one, so that NextBatch() doesn't have to wait for a round trip
+  /// to the tablet server. At most @c depth batches are buffered or being
+  /// fetched at a time, so the memory used for them is bounded by the batch
+  /// size (see SetBatchSizeBytes()) times @c depth.
+  ///
+  /// @note This method must be called before Open().
+  ///
+  /// @param [in] depth
+  ///   The number of batches to fetch ahead. The default is 0, which only
+  ///   fetches a batch when the application asks for it.
+  /// @return Operation result status.
+  Status SetPrefetchDepth(int depth);
+
+  /// Set the format of the rows returned by the scanner.
+  ///
+  /// @note This method must be called before Open().
+  ///
+  /// @param [in] flags
+  ///   A bitwise OR of the row format flags defined above, e.g.
+  ///   COLUMNAR_LAYOUT. The default is NO_FLAGS. Scanning with any flags
+  ///   other than NO_FLAGS requires tablet servers which support them.
+  /// @return Operation result status. Returns an error if unknown flags
+  ///   are set.
+  Status SetRowFormatFlags(uint64_t flags) WARN_UNUSED_RESULT;
+
   /// Set the replica selection policy while scanning.
   ///
   /// @param [in] selection
@@ -1975,6 +2058,7 @@ class KUDU_EXPORT KuduScanner {
   class KUDU_NO_EXPORT Data;
 
   friend class KuduScanToken;
+  FRIEND_TEST(ClientTest, TestBloomFilterPredicateRequiresServerFeature);
   FRIEND_TEST(ClientTest, TestScanCloseProxy);
   FRIEND_TEST(ClientTest, TestScanFaultTolerance);
   FRIEND_TEST(ClientTest, TestScanNoBlockCaching);
@@ -2148,6 +2232,24 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   /// @copydoc KuduScanner::SetTimeoutMillis
   Status SetTimeoutMillis(int millis) WARN_UNUSED_RESULT;
 
+  /// Split the tokens of large tablets by primary key range.
+  ///
+  /// By default, one token is built for each tablet. With a non-zero split
+  /// size, the tablet servers are asked to split the primary key range of
+  /// each tablet into chunks of roughly @c split_size_bytes of on-disk data,
+  /// and a token is built for each chunk, so that the scan can be spread
+  /// over more tasks than there are tablets.
+  ///
+  /// @note The chunks are estimated from the layout of the tablets' data on
+  ///   disk when the tokens are built, so they aren't exact. Rows which are
+  ///   only held in memory aren't taken into account.
+  ///
+  /// @param [in] split_size_bytes
+  ///   The target size of the data scanned by each token, in bytes. The
+  ///   default is 0, which doesn't split tablets.
+  /// @return Operation result status.
+  Status SetSplitSizeBytes(uint64_t split_size_bytes) WARN_UNUSED_RESULT;
+
   /// Build the set of scan tokens.
   ///
   /// The builder may be reused after this call.
@@ -0,0 +1,85 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/columnar_scan_batch.h"
+
+#include "kudu/client/scanner-internal.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/wire_protocol.pb.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using strings::Substitute;
+
+namespace kudu {
+namespace client {
+
+KuduColumnarScanBatch::KuduColumnarScanBatch() : data_(new Data()) {}
+
+KuduColumnarScanBatch::~KuduColumnarScanBatch() {
+  delete data_;
+}
+
+int KuduColumnarScanBatch::NumRows() const {
+  return data_->num_rows();
+}
+
+Status KuduColumnarScanBatch::GetFixedLengthColumn(int idx, Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnIndex(idx));
+  const ColumnSchema& col = data_->projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() == BINARY)) {
+    return Status::InvalidArgument(Substitute(
+        "Column $0 ($1) is not a fixed-length column", idx, col.name()));
+  }
+  const ColumnarRowBlockPB::Column& pb = data_->resp_data_.columns(idx);
+  *data = Slice(data_->data_.data() + pb.data_offset(), pb.data_size());
+  return Status::OK();
+}
+
+Status KuduColumnarScanBatch::GetVariableLengthColumn(int idx, Slice* offsets,
+                                                      Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnIndex(idx));
+  const ColumnSchema& col = data_->projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() != BINARY)) {
+    return Status::InvalidArgument(Substitute(
+        "Column $0 ($1) is not a variable-length column", idx, col.name()));
+  }
+  const ColumnarRowBlockPB::Column& pb = data_->resp_data_.columns(idx);
+  *offsets = Slice(data_->data_.data() + pb.data_offset(), pb.data_size());
+  *data = Slice(data_->varlen_data_.data() + pb.varlen_data_offset(),
+                pb.varlen_data_size());
+  return Status::OK();
+}
+
+Status KuduColumnarScanBatch::GetNonNullBitmapForColumn(int idx, Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnIndex(idx));
+  const ColumnSchema& col = data_->projection_->column(idx);
+  if (PREDICT_FALSE(!col.is_nullable())) {
+    return Status::InvalidArgument(Substitute(
+        "Column $0 ($1) is not nullable", idx, col.name()));
+  }
+  const ColumnarRowBlockPB::Column& pb = data_->resp_data_.columns(idx);
+  *data = Slice(data_->non_null_bitmaps_.data() + pb.non_null_bitmap_offset(),
+                pb.non_null_bitmap_size());
+  return Status::OK();
+}
+
+const KuduSchema* KuduColumnarScanBatch::projection_schema() const {
+  return data_->client_projection_;
+}
+
+} // namespace client
+} // namespace kudu
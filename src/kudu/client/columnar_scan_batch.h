@@ -0,0 +1,120 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CLIENT_COLUMNAR_SCAN_BATCH_H
+#define KUDU_CLIENT_COLUMNAR_SCAN_BATCH_H
+
+#ifdef KUDU_HEADERS_NO_STUBS
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#else
+#include "kudu/client/stubs.h"
+#endif
+
+#include "kudu/util/kudu_export.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace client {
+class KuduSchema;
+
+/// @brief A batch of columnar data returned from a scanner.
+///
+/// This batch is filled by KuduScanner::NextBatch(KuduColumnarScanBatch*)
+/// when the scanner was configured with the KuduScanner::COLUMNAR_LAYOUT
+/// row format flag. Rather than exposing rows, it exposes one contiguous
+/// buffer of cell data per projected column, which may be consumed in bulk.
+///
+/// The data in the batch is laid out as follows:
+///
+/// - Fixed-length columns are stored as an array of NumRows() values, each
+///   in the native (little-endian) in-memory format of the column's type.
+///   The values of NULL cells are undefined.
+///
+/// - STRING and BINARY columns are stored as an array of NumRows() + 1
+///   uint32_t offsets plus a buffer of the concatenated values. The value
+///   of row @c i spans from offset @c i (inclusive) to offset @c i+1
+///   (exclusive) within the buffer. NULL cells have zero length.
+///
+/// - Nullable columns additionally have a bitmap with one bit per row, in
+///   which a set bit indicates that the cell is non-NULL. The bits are
+///   stored in little-endian order: bit @c i is
+///   <tt>(bitmap[i / 8] >> (i % 8)) & 1</tt>.
+///
+/// All returned slices refer to memory owned by the batch, and are
+/// invalidated by the next call to NextBatch() or by destroying the batch.
+/// The data returned by GetFixedLengthColumn() is not guaranteed to be
+/// suitably aligned for direct access as an array of its type; callers
+/// requiring aligned access should copy it first.
+class KUDU_EXPORT KuduColumnarScanBatch {
+ public:
+  KuduColumnarScanBatch();
+  ~KuduColumnarScanBatch();
+
+  /// @return The number of rows in this batch.
+  int NumRows() const;
+
+  /// Get the raw cell data of a fixed-length column.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection.
+  /// @param [out] data
+  ///   The cell data of the column: NumRows() values of the column's type.
+  /// @return Operation result status. Returns an error if the index is out
+  ///   of range or if the column is of a variable-length type.
+  Status GetFixedLengthColumn(int idx, Slice* data) const WARN_UNUSED_RESULT;
+
+  /// Get the raw data of a variable-length (STRING or BINARY) column.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection.
+  /// @param [out] offsets
+  ///   NumRows() + 1 uint32_t offsets into @c data.
+  /// @param [out] data
+  ///   The concatenated cell values of the column.
+  /// @return Operation result status. Returns an error if the index is out
+  ///   of range or if the column is of a fixed-length type.
+  Status GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const
+      WARN_UNUSED_RESULT;
+
+  /// Get the non-NULL bitmap of a nullable column.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection.
+  /// @param [out] data
+  ///   The bitmap, in which a set bit indicates that the corresponding
+  ///   cell is non-NULL.
+  /// @return Operation result status. Returns an error if the index is out
+  ///   of range or if the column is not nullable.
+  Status GetNonNullBitmapForColumn(int idx, Slice* data) const WARN_UNUSED_RESULT;
+
+  /// @return The projection schema for this batch.
+  const KuduSchema* projection_schema() const;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+  friend class KuduScanner;
+
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduColumnarScanBatch);
+};
+
+} // namespace client
+} // namespace kudu
+
+#endif
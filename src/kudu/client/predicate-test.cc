@@ -974,5 +974,68 @@ TEST_F(PredicateTest, TestBinaryPredicates) {
   CheckStringPredicates(table);
 }
 
+TEST_F(PredicateTest, TestInBloomFilterPredicates) {
+  shared_ptr<KuduTable> table = CreateAndOpenTable(KuduColumnSchema::INT32);
+  shared_ptr<KuduSession> session = CreateSession();
+
+  const int kNumRows = 1000;
+  for (int32_t i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("key", i));
+    ASSERT_OK(insert->mutable_row()->SetInt32("value", i));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  unique_ptr<KuduInsert> null_insert(table->NewInsert());
+  ASSERT_OK(null_insert->mutable_row()->SetInt64("key", kNumRows));
+  ASSERT_OK(null_insert->mutable_row()->SetNull("value"));
+  ASSERT_OK(session->Apply(null_insert.release()));
+  ASSERT_OK(session->Flush());
+
+  // Builds a bloom filter containing the even values below 100.
+  auto build_filter = [] (KuduBloomFilter** bloom_filter) {
+    KuduBloomFilterBuilder builder(50);
+    RETURN_NOT_OK(builder.false_positive_probability(0.01).Build(bloom_filter));
+    for (int32_t v = 0; v < 100; v += 2) {
+      (*bloom_filter)->Insert(Slice(reinterpret_cast<const uint8_t*>(&v), sizeof(v)));
+    }
+    return Status::OK();
+  };
+
+  { // Every inserted value matches, and the filter excludes most others.
+    KuduBloomFilter* bloom_filter;
+    ASSERT_OK(build_filter(&bloom_filter));
+    vector<KuduBloomFilter*> bloom_filters = { bloom_filter };
+    int count = CountRows(table, { table->NewInBloomFilterPredicate("value", &bloom_filters) });
+    ASSERT_GE(count, 50);
+    ASSERT_LT(count, 100);
+  }
+
+  { // Combined with a range predicate on the same column.
+    KuduBloomFilter* bloom_filter;
+    ASSERT_OK(build_filter(&bloom_filter));
+    vector<KuduBloomFilter*> bloom_filters = { bloom_filter };
+    int count = CountRows(table, {
+        table->NewInBloomFilterPredicate("value", &bloom_filters),
+        table->NewComparisonPredicate("value", KuduPredicate::LESS, KuduValue::FromInt(50)) });
+    ASSERT_GE(count, 25);
+    ASSERT_LE(count, 50);
+  }
+
+  { // An empty filter matches no rows.
+    KuduBloomFilter* bloom_filter;
+    KuduBloomFilterBuilder builder(50);
+    ASSERT_OK(builder.Build(&bloom_filter));
+    vector<KuduBloomFilter*> bloom_filters = { bloom_filter };
+    ASSERT_EQ(0, CountRows(table, { table->NewInBloomFilterPredicate("value", &bloom_filters) }));
+  }
+
+  { // Invalid builder parameters.
+    KuduBloomFilter* bloom_filter;
+    KuduBloomFilterBuilder builder(50);
+    ASSERT_TRUE(builder.false_positive_probability(1).Build(&bloom_filter).IsInvalidArgument());
+    ASSERT_TRUE(KuduBloomFilterBuilder(0).Build(&bloom_filter).IsInvalidArgument());
+  }
+}
+
 } // namespace client
 } // namespace kudu
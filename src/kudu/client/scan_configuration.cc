@@ -41,6 +41,8 @@ ScanConfiguration::ScanConfiguration(KuduTable* table)
       client_projection_(*table->schema().schema_),
       has_batch_size_bytes_(false),
       batch_size_bytes_(0),
+      prefetch_depth_(0),
+      row_format_flags_(KuduScanner::NO_FLAGS),
       selection_(KuduClient::CLOSEST_REPLICA),
       read_mode_(KuduScanner::READ_LATEST),
       is_fault_tolerant_(false),
@@ -146,6 +148,22 @@ Status ScanConfiguration::SetBatchSizeBytes(uint32_t batch_size) {
   return Status::OK();
 }
 
+Status ScanConfiguration::SetPrefetchDepth(int depth) {
+  if (depth < 0) {
+    return Status::InvalidArgument(strings::Substitute("Invalid prefetch depth: $0", depth));
+  }
+  prefetch_depth_ = depth;
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetRowFormatFlags(uint64_t flags) {
+  if (flags & ~KuduScanner::COLUMNAR_LAYOUT) {
+    return Status::InvalidArgument(strings::Substitute("Invalid row format flags: $0", flags));
+  }
+  row_format_flags_ = flags;
+  return Status::OK();
+}
+
 Status ScanConfiguration::SetSelection(KuduClient::ReplicaSelection selection) {
   selection_ = selection;
   return Status::OK();
@@ -63,6 +63,10 @@ class ScanConfiguration {
 
   Status SetBatchSizeBytes(uint32_t batch_size);
 
+  Status SetPrefetchDepth(int depth) WARN_UNUSED_RESULT;
+
+  Status SetRowFormatFlags(uint64_t flags) WARN_UNUSED_RESULT;
+
   Status SetSelection(KuduClient::ReplicaSelection selection) WARN_UNUSED_RESULT;
 
   Status SetReadMode(KuduScanner::ReadMode read_mode) WARN_UNUSED_RESULT;
@@ -108,6 +112,14 @@ class ScanConfiguration {
     return batch_size_bytes_;
   }
 
+  int prefetch_depth() const {
+    return prefetch_depth_;
+  }
+
+  uint64_t row_format_flags() const {
+    return row_format_flags_;
+  }
+
   KuduClient::ReplicaSelection selection() const {
     return selection_;
   }
@@ -157,6 +169,11 @@ class ScanConfiguration {
   bool has_batch_size_bytes_;
   uint32 batch_size_bytes_;
 
+  // The maximum number of batches to fetch ahead of the application.
+  int prefetch_depth_;
+
+  uint64_t row_format_flags_;
+
   KuduClient::ReplicaSelection selection_;
 
   KuduScanner::ReadMode read_mode_;
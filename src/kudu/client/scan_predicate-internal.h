@@ -17,13 +17,16 @@
 #ifndef KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 #define KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 
+#include <string>
 #include <vector>
 
 #include "kudu/client/scan_predicate.h"
 #include "kudu/client/value-internal.h"
 #include "kudu/client/value.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/status.h"
 
@@ -116,6 +119,60 @@ class InListPredicateData : public KuduPredicate::Data {
   std::vector<KuduValue*> vals_;
 };
 
+class KuduBloomFilter::Data {
+ public:
+  explicit Data(const BloomFilterSizing& sizing)
+      : builder(sizing) {
+  }
+
+  BloomFilterBuilder builder;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+class KuduBloomFilterBuilder::Data {
+ public:
+  explicit Data(size_t num_keys)
+      : num_keys(num_keys),
+        false_positive_probability(0.01) {
+  }
+
+  size_t num_keys;
+  double false_positive_probability;
+};
+
+// A predicate for selecting values which may be in all of a set of bloom
+// filters.
+class InBloomFilterPredicateData : public KuduPredicate::Data {
+ public:
+  // Takes ownership of the bloom filters.
+  InBloomFilterPredicateData(ColumnSchema col, std::vector<KuduBloomFilter*>* bloom_filters);
+
+  Status AddToScanSpec(ScanSpec* spec, Arena* arena) override;
+
+  InBloomFilterPredicateData* Clone() const override {
+    return new InBloomFilterPredicateData(col_, bloom_filters_);
+  }
+
+ private:
+  friend class KuduScanner;
+
+  // A copy of a bloom filter's bitmap and its number of hash functions.
+  struct SerializedBloomFilter {
+    std::string data;
+    size_t n_hashes;
+  };
+
+  InBloomFilterPredicateData(ColumnSchema col, std::vector<SerializedBloomFilter> bloom_filters)
+      : col_(std::move(col)),
+        bloom_filters_(std::move(bloom_filters)) {
+  }
+
+  ColumnSchema col_;
+  std::vector<SerializedBloomFilter> bloom_filters_;
+};
+
 // A predicate for selecting non-null values.
 class IsNotNullPredicateData : public KuduPredicate::Data {
  public:
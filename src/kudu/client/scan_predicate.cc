@@ -29,6 +29,7 @@
 #include "kudu/gutil/strings/substitute.h"
 
 using std::move;
+using std::string;
 using std::vector;
 using boost::optional;
 
@@ -139,5 +140,65 @@ Status InListPredicateData::AddToScanSpec(ScanSpec* spec, Arena* /*arena*/) {
   return Status::OK();
 }
 
+InBloomFilterPredicateData::InBloomFilterPredicateData(ColumnSchema col,
+                                                       vector<KuduBloomFilter*>* bloom_filters)
+    : col_(move(col)) {
+  bloom_filters_.reserve(bloom_filters->size());
+  for (KuduBloomFilter* bloom_filter : *bloom_filters) {
+    const BloomFilterBuilder& builder = bloom_filter->data_->builder;
+    bloom_filters_.push_back({ builder.slice().ToString(), builder.n_hashes() });
+  }
+  STLDeleteElements(bloom_filters);
+}
+
+Status InBloomFilterPredicateData::AddToScanSpec(ScanSpec* spec, Arena* /*arena*/) {
+  vector<BloomFilter> bloom_filters;
+  bloom_filters.reserve(bloom_filters_.size());
+  for (const auto& bloom_filter : bloom_filters_) {
+    bloom_filters.emplace_back(Slice(bloom_filter.data), bloom_filter.n_hashes);
+  }
+  spec->AddPredicate(ColumnPredicate::InBloomFilter(col_, &bloom_filters, nullptr, nullptr));
+  return Status::OK();
+}
+
+KuduBloomFilter::KuduBloomFilter(Data* d)
+  : data_(d) {
+}
+
+KuduBloomFilter::~KuduBloomFilter() {
+  delete data_;
+}
+
+void KuduBloomFilter::Insert(const Slice& value) {
+  data_->builder.AddKey(BloomKeyProbe(value));
+}
+
+KuduBloomFilterBuilder::KuduBloomFilterBuilder(size_t num_keys)
+  : data_(new Data(num_keys)) {
+}
+
+KuduBloomFilterBuilder::~KuduBloomFilterBuilder() {
+  delete data_;
+}
+
+KuduBloomFilterBuilder& KuduBloomFilterBuilder::false_positive_probability(double fpp) {
+  data_->false_positive_probability = fpp;
+  return *this;
+}
+
+Status KuduBloomFilterBuilder::Build(KuduBloomFilter** bloom_filter) {
+  if (data_->num_keys == 0) {
+    return Status::InvalidArgument("bloom filter must be sized for at least one key");
+  }
+  double fpp = data_->false_positive_probability;
+  if (!(fpp > 0 && fpp < 1)) {
+    return Status::InvalidArgument(
+        Substitute("invalid bloom filter false positive probability: $0", fpp));
+  }
+  *bloom_filter = new KuduBloomFilter(new KuduBloomFilter::Data(
+      BloomFilterSizing::ByCountAndFPRate(data_->num_keys, fpp)));
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
@@ -26,6 +26,7 @@
 
 #include "kudu/client/schema.h"
 #include "kudu/util/kudu_export.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 namespace client {
@@ -57,6 +58,7 @@ class KUDU_EXPORT KuduPredicate {
  private:
   friend class ComparisonPredicateData;
   friend class ErrorPredicateData;
+  friend class InBloomFilterPredicateData;
   friend class InListPredicateData;
   friend class IsNotNullPredicateData;
   friend class IsNullPredicateData;
@@ -69,6 +71,68 @@ class KUDU_EXPORT KuduPredicate {
   DISALLOW_COPY_AND_ASSIGN(KuduPredicate);
 };
 
+/// @brief A bloom filter over the values of a column, which can be pushed
+///   into scans with KuduTable::NewInBloomFilterPredicate().
+///
+/// Call KuduBloomFilterBuilder::Build() to create a bloom filter object.
+class KUDU_EXPORT KuduBloomFilter {
+ public:
+  ~KuduBloomFilter();
+
+  /// Insert a value into the bloom filter.
+  ///
+  /// @param [in] value
+  ///   The value to insert. Values of STRING and BINARY columns are given by
+  ///   their contents. Values of other columns are given by their
+  ///   little-endian in-memory representation: for example, a Slice over an
+  ///   @c int32_t for an INT32 column, or over an @c int64_t holding
+  ///   microseconds since the Unix epoch for a UNIXTIME_MICROS column.
+  void Insert(const Slice& value);
+
+  /// @brief Forward declaration for the embedded PIMPL class.
+  class KUDU_NO_EXPORT Data;
+ private:
+  friend class InBloomFilterPredicateData;
+  friend class KuduBloomFilterBuilder;
+
+  explicit KuduBloomFilter(Data* d);
+
+  Data* data_;
+  DISALLOW_COPY_AND_ASSIGN(KuduBloomFilter);
+};
+
+/// @brief A builder of KuduBloomFilter objects.
+class KUDU_EXPORT KuduBloomFilterBuilder {
+ public:
+  /// @param [in] num_keys
+  ///   The expected number of values to be inserted into the bloom filter.
+  explicit KuduBloomFilterBuilder(size_t num_keys);
+  ~KuduBloomFilterBuilder();
+
+  /// Set the desired false positive probability of the bloom filter once
+  /// @c num_keys values have been inserted. The default is 0.01.
+  ///
+  /// @param [in] fpp
+  ///   The false positive probability, which must be in the range (0, 1).
+  /// @return Reference to the updated object.
+  KuduBloomFilterBuilder& false_positive_probability(double fpp);
+
+  /// Build a new, empty bloom filter.
+  ///
+  /// @param [out] bloom_filter
+  ///   The newly built bloom filter. The caller owns it until it is passed
+  ///   into KuduTable::NewInBloomFilterPredicate().
+  /// @return Operation result status. In particular, a bad status is
+  ///   returned if the builder's parameters are invalid.
+  Status Build(KuduBloomFilter** bloom_filter);
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  Data* data_;
+  DISALLOW_COPY_AND_ASSIGN(KuduBloomFilterBuilder);
+};
+
 } // namespace client
 } // namespace kudu
 #endif // KUDU_CLIENT_SCAN_PREDICATE_H
@@ -21,6 +21,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <set>
 
 #include "kudu/client/client-internal.h"
 #include "kudu/client/client.h"
@@ -32,15 +33,23 @@
 #include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 
+using std::set;
 using std::string;
 using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
 
 namespace kudu {
+
+using tserver::KeyRangePB;
+using tserver::SplitKeyRangeRequestPB;
+using tserver::SplitKeyRangeResponsePB;
+
 namespace client {
 
 KuduScanToken::Data::Data(KuduTable* table,
@@ -162,7 +171,43 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
 }
 
 KuduScanTokenBuilder::Data::Data(KuduTable* table)
-    : configuration_(table) {
+    : configuration_(table),
+      split_size_bytes_(0) {
+}
+
+Status KuduScanTokenBuilder::Data::SplitKeyRange(
+    KuduClient* client,
+    const scoped_refptr<internal::RemoteTablet>& tablet,
+    const ScanTokenPB& pb,
+    const MonoTime& deadline,
+    vector<KeyRangePB>* ranges) {
+  internal::RemoteTabletServer* ts;
+  vector<internal::RemoteTabletServer*> candidates;
+  RETURN_NOT_OK(client->data_->GetTabletServer(client, tablet, configuration_.selection(),
+                                               set<string>(), &candidates, &ts));
+
+  SplitKeyRangeRequestPB req;
+  req.set_tablet_id(tablet->tablet_id());
+  if (pb.has_lower_bound_primary_key()) {
+    req.set_start_primary_key(pb.lower_bound_primary_key());
+  }
+  if (pb.has_upper_bound_primary_key()) {
+    req.set_stop_primary_key(pb.upper_bound_primary_key());
+  }
+  req.set_target_chunk_size_bytes(split_size_bytes_);
+
+  SplitKeyRangeResponsePB resp;
+  rpc::RpcController controller;
+  controller.set_deadline(deadline);
+  RETURN_NOT_OK_PREPEND(ts->proxy()->SplitKeyRange(req, &resp, &controller),
+                        Substitute("Unable to split the key range of tablet $0",
+                                   tablet->tablet_id()));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status()).CloneAndPrepend(
+        Substitute("Unable to split the key range of tablet $0", tablet->tablet_id()));
+  }
+  ranges->assign(resp.ranges().begin(), resp.ranges().end());
+  return Status::OK();
 }
 
 Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
@@ -253,49 +298,76 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
       continue;
     }
 
+    // The primary key ranges to build tokens for, within the tablet.
+    vector<KeyRangePB> ranges;
+    if (split_size_bytes_ > 0) {
+      RETURN_NOT_OK(SplitKeyRange(client, tablet, pb, deadline, &ranges));
+    } else {
+      KeyRangePB range;
+      if (pb.has_lower_bound_primary_key()) {
+        range.set_start_primary_key(pb.lower_bound_primary_key());
+      }
+      if (pb.has_upper_bound_primary_key()) {
+        range.set_stop_primary_key(pb.upper_bound_primary_key());
+      }
+      ranges.push_back(range);
+    }
+
     vector<internal::RemoteReplica> replicas;
     tablet->GetRemoteReplicas(&replicas);
 
-    vector<const KuduReplica*> client_replicas;
-    ElementDeleter deleter(&client_replicas);
-
-    // Convert the replicas from their internal format to something appropriate
-    // for clients.
-    for (const auto& r : replicas) {
-      vector<HostPort> host_ports;
-      r.ts->GetHostPorts(&host_ports);
-      if (host_ports.empty()) {
-        return Status::IllegalState(Substitute(
-            "No host found for tablet server $0", r.ts->ToString()));
+    for (const KeyRangePB& range : ranges) {
+      vector<const KuduReplica*> client_replicas;
+      ElementDeleter deleter(&client_replicas);
+
+      // Convert the replicas from their internal format to something appropriate
+      // for clients.
+      for (const auto& r : replicas) {
+        vector<HostPort> host_ports;
+        r.ts->GetHostPorts(&host_ports);
+        if (host_ports.empty()) {
+          return Status::IllegalState(Substitute(
+              "No host found for tablet server $0", r.ts->ToString()));
+        }
+        unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
+        client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
+                                                      host_ports[0]);
+        bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
+        unique_ptr<KuduReplica> client_replica(new KuduReplica);
+        client_replica->data_ = new KuduReplica::Data(is_leader,
+                                                      std::move(client_ts));
+        client_replicas.push_back(client_replica.release());
       }
-      unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
-      client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
-                                                    host_ports[0]);
-      bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
-      unique_ptr<KuduReplica> client_replica(new KuduReplica);
-      client_replica->data_ = new KuduReplica::Data(is_leader,
-                                                    std::move(client_ts));
-      client_replicas.push_back(client_replica.release());
-    }
 
-    unique_ptr<KuduTablet> client_tablet(new KuduTablet);
-    client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
-                                                std::move(client_replicas));
-    client_replicas.clear();
-
-    // Create the scan token itself.
-    ScanTokenPB message;
-    message.CopyFrom(pb);
-    message.set_lower_bound_partition_key(
-        tablet->partition().partition_key_start());
-    message.set_upper_bound_partition_key(
-        tablet->partition().partition_key_end());
-    unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
-    client_scan_token->data_ =
-        new KuduScanToken::Data(table,
-                                std::move(message),
-                                std::move(client_tablet));
-    tokens->push_back(client_scan_token.release());
+      unique_ptr<KuduTablet> client_tablet(new KuduTablet);
+      client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
+                                                  std::move(client_replicas));
+      client_replicas.clear();
+
+      // Create the scan token itself.
+      ScanTokenPB message;
+      message.CopyFrom(pb);
+      message.set_lower_bound_partition_key(
+          tablet->partition().partition_key_start());
+      message.set_upper_bound_partition_key(
+          tablet->partition().partition_key_end());
+      if (range.has_start_primary_key()) {
+        message.set_lower_bound_primary_key(range.start_primary_key());
+      } else {
+        message.clear_lower_bound_primary_key();
+      }
+      if (range.has_stop_primary_key()) {
+        message.set_upper_bound_primary_key(range.stop_primary_key());
+      } else {
+        message.clear_upper_bound_primary_key();
+      }
+      unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
+      client_scan_token->data_ =
+          new KuduScanToken::Data(table,
+                                  std::move(message),
+                                  std::move(client_tablet));
+      tokens->push_back(client_scan_token.release());
+    }
     pruner.RemovePartitionKeyRange(tablet->partition().partition_key_end());
   }
   return Status::OK();
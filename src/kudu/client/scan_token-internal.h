@@ -24,10 +24,17 @@
 #include "kudu/client/client.h"
 #include "kudu/client/client.pb.h"
 #include "kudu/client/scan_configuration.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/monotime.h"
 
 namespace kudu {
 namespace client {
 
+namespace internal {
+class RemoteTablet;
+} // namespace internal
+
 class KuduScanToken::Data {
  public:
   explicit Data(KuduTable* table,
@@ -71,8 +78,24 @@ class KuduScanTokenBuilder::Data {
     return &configuration_;
   }
 
+  void SetSplitSizeBytes(uint64_t split_size_bytes) {
+    split_size_bytes_ = split_size_bytes;
+  }
+
  private:
+  // Asks a replica of 'tablet' to split the primary key range of 'pb' into
+  // chunks of about 'split_size_bytes_' each.
+  Status SplitKeyRange(KuduClient* client,
+                       const scoped_refptr<internal::RemoteTablet>& tablet,
+                       const ScanTokenPB& pb,
+                       const MonoTime& deadline,
+                       std::vector<tserver::KeyRangePB>* ranges);
+
   ScanConfiguration configuration_;
+
+  // The target size of each token's key range, or 0 to build one token per
+  // tablet.
+  uint64_t split_size_bytes_;
 };
 
 } // namespace client
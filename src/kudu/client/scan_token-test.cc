@@ -26,10 +26,15 @@
 #include "kudu/client/client.pb.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_peer.h"
+#include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/mini_tablet_server.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(cfile_default_block_size);
+
 namespace kudu {
 namespace client {
 
@@ -40,6 +45,7 @@ using std::thread;
 using std::unique_ptr;
 using std::unordered_set;
 using std::vector;
+using tablet::TabletPeer;
 using tserver::MiniTabletServer;
 
 class ScanTokenTest : public KuduTest {
@@ -237,6 +243,78 @@ TEST_F(ScanTokenTest, TestScanTokens) {
   }
 }
 
+// Test that tokens split by key range within the tablets cover all of the
+// rows exactly once.
+TEST_F(ScanTokenTest, TestScanTokensSplitByKeyRange) {
+  // Use small blocks, so that the key index of each rowset has several entries
+  // to split on.
+  FLAGS_cfile_default_block_size = 1024;
+
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("col")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .add_hash_partitions({ "col" }, 2)
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(10000);
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+  for (int i = 0; i < 10000; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("col", i));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  // Flush the tablets, so that the rows are in DiskRowSets.
+  vector<scoped_refptr<TabletPeer>> peers;
+  cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletPeers(&peers);
+  ASSERT_EQ(2, peers.size());
+  for (const auto& peer : peers) {
+    ASSERT_OK(peer->tablet()->Flush());
+  }
+
+  { // no bounds
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetSplitSizeBytes(1024));
+    ASSERT_OK(builder.Build(&tokens));
+
+    ASSERT_GT(tokens.size(), 2);
+    ASSERT_EQ(10000, CountRows(tokens));
+  }
+
+  { // primary key bounds
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    unique_ptr<KuduPartialRow> lower_bound(schema.NewRow());
+    ASSERT_OK(lower_bound->SetInt64("col", 1000));
+    ASSERT_OK(builder.AddLowerBound(*lower_bound));
+    unique_ptr<KuduPartialRow> upper_bound(schema.NewRow());
+    ASSERT_OK(upper_bound->SetInt64("col", 9000));
+    ASSERT_OK(builder.AddUpperBound(*upper_bound));
+    ASSERT_OK(builder.SetSplitSizeBytes(1024));
+    ASSERT_OK(builder.Build(&tokens));
+
+    ASSERT_GE(tokens.size(), 2);
+    ASSERT_EQ(8000, CountRows(tokens));
+  }
+}
+
 TEST_F(ScanTokenTest, TestScanTokensWithNonCoveringRange) {
   // Create schema
   KuduSchema schema;
@@ -38,6 +38,7 @@ using google::protobuf::Reflection;
 
 using std::set;
 using std::string;
+using std::unique_ptr;
 
 namespace kudu {
 
@@ -61,6 +62,7 @@ KuduScanner::Data::Data(KuduTable* table)
 }
 
 KuduScanner::Data::~Data() {
+  StopPrefetch();
 }
 
 Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
@@ -238,8 +240,8 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
 
   controller_.Reset();
   controller_.set_deadline(rpc_deadline);
-  if (!configuration_.spec().predicates().empty()) {
-    controller_.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
+  for (uint32_t feature : RequiredServerFeatures()) {
+    controller_.RequireServerFeature(feature);
   }
   ScanRpcStatus scan_status = AnalyzeResponse(
       proxy_->Scan(next_req_,
@@ -252,9 +254,53 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
   return scan_status;
 }
 
+vector<uint32_t> KuduScanner::Data::RequiredServerFeatures() const {
+  vector<uint32_t> features;
+  if (!configuration_.spec().predicates().empty()) {
+    features.push_back(TabletServerFeatures::COLUMN_PREDICATES);
+  }
+  for (const auto& predicate : configuration_.spec().predicates()) {
+    if (predicate.second.predicate_type() == PredicateType::InBloomFilter) {
+      features.push_back(TabletServerFeatures::BLOOM_FILTER_PREDICATE);
+      break;
+    }
+  }
+  if (configuration_.row_format_flags() & KuduScanner::COLUMNAR_LAYOUT) {
+    features.push_back(TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE);
+  }
+  return features;
+}
+
+ScanRpcStatus KuduScanner::Data::TakePrefetchedBatch(const MonoTime& overall_deadline) {
+  unique_ptr<ScanPrefetcher::Batch> batch;
+  Status s = prefetcher_->Take(overall_deadline, &batch);
+  if (!s.ok()) {
+    // The request may still be processed by the server, so the scanner's
+    // call sequence ID is no longer known, and the scan can't continue.
+    StopPrefetch();
+    return ScanRpcStatus{ScanRpcStatus::OVERALL_DEADLINE_EXCEEDED, s};
+  }
+
+  // Pick up where the prefetcher left off, so that a retry of a failed
+  // request resends it with the same call sequence ID.
+  next_req_.set_call_seq_id(batch->call_seq_id);
+  last_response_.Swap(&batch->response);
+  controller_.Swap(&batch->controller);
+  ScanRpcStatus scan_status = AnalyzeResponse(controller_.status(),
+                                              overall_deadline, batch->deadline);
+  if (scan_status.result == ScanRpcStatus::OK) {
+    UpdateResourceMetrics();
+  }
+  if (scan_status.result != ScanRpcStatus::OK || !last_response_.has_more_results()) {
+    StopPrefetch();
+  }
+  return scan_status;
+}
+
 Status KuduScanner::Data::OpenTablet(const string& partition_key,
                                      const MonoTime& deadline,
                                      set<string>* blacklist) {
+  StopPrefetch();
 
   PrepareRequest(KuduScanner::Data::NEW);
   next_req_.clear_scanner_id();
@@ -291,6 +337,7 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   }
 
   scan->set_cache_blocks(configuration_.spec().cache_blocks());
+  scan->set_row_format_flags(configuration_.row_format_flags());
 
   // For consistent operations, propagate the timestamp among all operations
   // performed the context of the same client.
@@ -394,16 +441,17 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
 
   next_req_.clear_new_scan_request();
-  data_in_open_ = last_response_.has_data();
+  data_in_open_ = last_response_.has_data() || last_response_.has_columnar_data();
   if (last_response_.has_more_results()) {
     next_req_.set_scanner_id(last_response_.scanner_id());
     VLOG(2) << "Opened tablet " << remote_->tablet_id()
             << ", scanner ID " << last_response_.scanner_id();
-  } else if (last_response_.has_data()) {
+  } else if (data_in_open_) {
     VLOG(2) << "Opened tablet " << remote_->tablet_id() << ", no scanner ID assigned";
   } else {
     VLOG(2) << "Opened tablet " << remote_->tablet_id() << " (no rows), no scanner ID assigned";
   }
+  MaybeStartPrefetch();
 
   // If present in the response, set the snapshot timestamp and the encoded last
   // primary key.  This is used when retrying the scan elsewhere.  The last
@@ -431,6 +479,89 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   return Status::OK();
 }
 
+Status KuduScanner::Data::FetchNextBatch(bool* has_data) {
+  *has_data = false;
+
+  if (short_circuit_) {
+    return Status::OK();
+  }
+
+  if (data_in_open_) {
+    // We have data from a previous scan.
+    VLOG(2) << "Extracting data from " << DebugString();
+    data_in_open_ = false;
+    *has_data = true;
+    return Status::OK();
+  } else if (last_response_.has_more_results()) {
+    // More data is available in this tablet.
+    VLOG(2) << "Continuing " << DebugString();
+
+    MonoTime batch_deadline = MonoTime::Now() + configuration().timeout();
+    bool allow_time_for_failover = configuration().is_fault_tolerant();
+    ScanRpcStatus result;
+    if (prefetcher_) {
+      result = TakePrefetchedBatch(batch_deadline);
+    } else {
+      PrepareRequest(KuduScanner::Data::CONTINUE);
+      result = SendScanRpc(batch_deadline, allow_time_for_failover);
+    }
+
+    while (true) {
+      // Success case.
+      if (result.result == ScanRpcStatus::OK) {
+        if (last_response_.has_last_primary_key()) {
+          last_primary_key_ = last_response_.last_primary_key();
+        }
+        scan_attempts_ = 0;
+        *has_data = true;
+        MaybeStartPrefetch();
+        return Status::OK();
+      }
+
+      scan_attempts_++;
+
+      // Error handling.
+      set<string> blacklist;
+      Status s = HandleError(result, batch_deadline, &blacklist);
+      if (!s.ok()) {
+        LOG(WARNING) << "Scan at tablet server " << ts_->ToString() << " of tablet "
+                     << DebugString() << " failed: " << result.status.ToString();
+        return s;
+      }
+
+      if (configuration().is_fault_tolerant()) {
+        LOG(WARNING) << "Attempting to retry scan of tablet " << DebugString()
+                     << " elsewhere.";
+        return ReopenCurrentTablet(batch_deadline, &blacklist);
+      }
+
+      if (blacklist.empty()) {
+        // If we didn't blacklist the current server, we can just retry again.
+        result = SendScanRpc(batch_deadline, allow_time_for_failover);
+        continue;
+      }
+      // If we blacklisted the current server, and it's not fault-tolerant, we can't
+      // retry anywhere, so just propagate the error.
+      return result.status;
+    }
+  } else if (MoreTablets()) {
+    // More data may be available in other tablets.
+    // No need to close the current tablet; we scanned all the data so the
+    // server closed it for us.
+    VLOG(2) << "Scanning next tablet " << DebugString();
+    last_primary_key_.clear();
+    MonoTime deadline = MonoTime::Now() + configuration().timeout();
+    set<string> blacklist;
+
+    RETURN_NOT_OK(OpenNextTablet(deadline, &blacklist));
+    // No rows written, the next invocation will pick them up.
+    return Status::OK();
+  } else {
+    // No more data anywhere.
+    return Status::OK();
+  }
+}
+
 Status KuduScanner::Data::KeepAlive() {
   if (!open_) return Status::IllegalState("Scanner was not open.");
   // If there is no scanner to keep alive, we still return Status::OK().
@@ -473,12 +604,138 @@ void KuduScanner::Data::PrepareRequest(RequestType state) {
   }
 }
 
+void KuduScanner::Data::MaybeStartPrefetch() {
+  if (prefetcher_ || configuration_.prefetch_depth() == 0 ||
+      !last_response_.has_more_results() || !next_req_.has_scanner_id()) {
+    return;
+  }
+  VLOG(2) << "Prefetching up to " << configuration_.prefetch_depth() << " batches for "
+          << DebugString();
+  prefetcher_ = std::make_shared<ScanPrefetcher>(proxy_, next_req_, RequiredServerFeatures(),
+                                                 configuration_.prefetch_depth(),
+                                                 configuration_.timeout());
+  prefetcher_->Start();
+}
+
+void KuduScanner::Data::StopPrefetch() {
+  if (prefetcher_) {
+    prefetcher_->Stop();
+    prefetcher_.reset();
+  }
+}
+
 void KuduScanner::Data::UpdateLastError(const Status& error) {
   if (last_error_.ok() || last_error_.IsTimedOut()) {
     last_error_ = error;
   }
 }
 
+////////////////////////////////////////////////////////////
+// ScanPrefetcher
+////////////////////////////////////////////////////////////
+
+ScanPrefetcher::ScanPrefetcher(std::shared_ptr<tserver::TabletServerServiceProxy> proxy,
+                               const tserver::ScanRequestPB& last_req,
+                               vector<uint32_t> required_features,
+                               int depth,
+                               MonoDelta timeout)
+    : proxy_(std::move(proxy)),
+      required_features_(std::move(required_features)),
+      depth_(depth),
+      timeout_(timeout),
+      cond_(&lock_),
+      req_(last_req),
+      done_(false) {
+  DCHECK_GT(depth, 0);
+  DCHECK(req_.has_scanner_id());
+  DCHECK(!req_.has_new_scan_request());
+}
+
+void ScanPrefetcher::Start() {
+  tserver::ScanRequestPB req;
+  Batch* batch;
+  {
+    MutexLock l(lock_);
+    batch = PrepareNextRequestUnlocked(&req);
+  }
+  if (batch) {
+    SendRequest(batch, req);
+  }
+}
+
+Status ScanPrefetcher::Take(const MonoTime& deadline, unique_ptr<Batch>* batch) {
+  tserver::ScanRequestPB req;
+  Batch* next;
+  {
+    MutexLock l(lock_);
+    while (batches_.empty()) {
+      MonoDelta remaining = deadline - MonoTime::Now();
+      if (remaining.ToNanoseconds() <= 0 || !cond_.TimedWait(remaining)) {
+        if (batches_.empty()) {
+          return Status::TimedOut("timed out waiting for a prefetched scan batch");
+        }
+      }
+    }
+    *batch = std::move(batches_.front());
+    batches_.pop_front();
+    next = PrepareNextRequestUnlocked(&req);
+  }
+  if (next) {
+    SendRequest(next, req);
+  }
+  return Status::OK();
+}
+
+void ScanPrefetcher::Stop() {
+  MutexLock l(lock_);
+  done_ = true;
+}
+
+ScanPrefetcher::Batch* ScanPrefetcher::PrepareNextRequestUnlocked(tserver::ScanRequestPB* req) {
+  lock_.AssertAcquired();
+  if (done_ || in_flight_ || batches_.size() >= depth_) {
+    return nullptr;
+  }
+  req_.set_call_seq_id(req_.call_seq_id() + 1);
+  in_flight_.reset(new Batch);
+  in_flight_->call_seq_id = req_.call_seq_id();
+  in_flight_->deadline = MonoTime::Now() + timeout_;
+  in_flight_->controller.set_deadline(in_flight_->deadline);
+  for (uint32_t feature : required_features_) {
+    in_flight_->controller.RequireServerFeature(feature);
+  }
+  *req = req_;
+  return in_flight_.get();
+}
+
+void ScanPrefetcher::SendRequest(Batch* batch, const tserver::ScanRequestPB& req) {
+  // The request is sent outside of 'lock_', since the callback may be run
+  // synchronously if the request fails immediately. The callback holds a
+  // reference to the prefetcher, so that it outlives the request.
+  proxy_->ScanAsync(req, &batch->response, &batch->controller,
+                    boost::bind(&ScanPrefetcher::RequestDone, shared_from_this()));
+}
+
+void ScanPrefetcher::RequestDone() {
+  tserver::ScanRequestPB req;
+  Batch* next;
+  {
+    MutexLock l(lock_);
+    DCHECK(in_flight_);
+    if (!in_flight_->controller.status().ok() ||
+        in_flight_->response.has_error() ||
+        !in_flight_->response.has_more_results()) {
+      done_ = true;
+    }
+    batches_.emplace_back(std::move(in_flight_));
+    cond_.Broadcast();
+    next = PrepareNextRequestUnlocked(&req);
+  }
+  if (next) {
+    SendRequest(next, req);
+  }
+}
+
 ////////////////////////////////////////////////////////////
 // KuduScanBatch
 ////////////////////////////////////////////////////////////
@@ -557,5 +814,69 @@ void KuduScanBatch::Data::Clear() {
   controller_.Reset();
 }
 
+////////////////////////////////////////////////////////////
+// KuduColumnarScanBatch
+////////////////////////////////////////////////////////////
+
+KuduColumnarScanBatch::Data::Data()
+    : projection_(nullptr),
+      client_projection_(nullptr) {
+}
+
+KuduColumnarScanBatch::Data::~Data() {}
+
+Status KuduColumnarScanBatch::Data::Reset(RpcController* controller,
+                                          const Schema* projection,
+                                          const KuduSchema* client_projection,
+                                          gscoped_ptr<ColumnarRowBlockPB> resp_data) {
+  CHECK(controller->finished());
+  controller_.Swap(controller);
+  projection_ = projection;
+  client_projection_ = client_projection;
+  resp_data_.Swap(resp_data.get());
+
+  if (PREDICT_FALSE(!resp_data_.has_data_sidecar())) {
+    return Status::Corruption("Server sent invalid response: no columnar data");
+  }
+  Status s = controller_.GetSidecar(resp_data_.data_sidecar(), &data_);
+  if (!s.ok()) {
+    return Status::Corruption("Server sent invalid response: columnar data "
+                              "sidecar index corrupt", s.ToString());
+  }
+  if (resp_data_.has_varlen_data_sidecar()) {
+    s = controller_.GetSidecar(resp_data_.varlen_data_sidecar(), &varlen_data_);
+    if (!s.ok()) {
+      return Status::Corruption("Server sent invalid response: varlen data "
+                                "sidecar index corrupt", s.ToString());
+    }
+  }
+  if (resp_data_.has_non_null_bitmap_sidecar()) {
+    s = controller_.GetSidecar(resp_data_.non_null_bitmap_sidecar(), &non_null_bitmaps_);
+    if (!s.ok()) {
+      return Status::Corruption("Server sent invalid response: non-null bitmap "
+                                "sidecar index corrupt", s.ToString());
+    }
+  }
+
+  return ValidateColumnarRowBlockPB(*projection_, resp_data_, data_, varlen_data_,
+                                    non_null_bitmaps_);
+}
+
+Status KuduColumnarScanBatch::Data::CheckColumnIndex(int idx) const {
+  if (PREDICT_FALSE(idx < 0 || idx >= resp_data_.columns_size())) {
+    return Status::InvalidArgument(Substitute("Bad column index $0 ($1 columns present)",
+                                              idx, resp_data_.columns_size()));
+  }
+  return Status::OK();
+}
+
+void KuduColumnarScanBatch::Data::Clear() {
+  resp_data_.Clear();
+  data_.clear();
+  varlen_data_.clear();
+  non_null_bitmaps_.clear();
+  controller_.Reset();
+}
+
 } // namespace client
 } // namespace kudu
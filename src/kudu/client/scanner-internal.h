@@ -17,11 +17,14 @@
 #ifndef KUDU_CLIENT_SCANNER_INTERNAL_H
 #define KUDU_CLIENT_SCANNER_INTERNAL_H
 
+#include <deque>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
 #include "kudu/client/client.h"
+#include "kudu/client/columnar_scan_batch.h"
 #include "kudu/client/resource_metrics.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/scan_configuration.h"
@@ -30,6 +33,9 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/auto_release_pool.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
 
 namespace kudu {
 
@@ -77,6 +83,88 @@ struct ScanRpcStatus {
   Status status;
 };
 
+// Fetches the batches of a tablet scan ahead of the application, so that
+// the next batch has likely arrived by the time it's asked for.
+//
+// A tablet server processes the requests for a scanner one at a time and in
+// call sequence order, so the prefetcher has at most one request in flight:
+// each response triggers the request for the following batch, until 'depth'
+// batches are buffered or the tablet has no more results.
+class ScanPrefetcher : public std::enable_shared_from_this<ScanPrefetcher> {
+ public:
+  // A batch requested by the prefetcher.
+  struct Batch {
+    // The call sequence ID of the request.
+    uint32_t call_seq_id;
+
+    // The deadline of the request.
+    MonoTime deadline;
+
+    rpc::RpcController controller;
+    tserver::ScanResponsePB response;
+  };
+
+  // 'last_req' is the last continuation request (or new scan request, with
+  // the new scan fields cleared) which was sent for the scanner. Requests are
+  // sent to 'proxy' with the given required server features and timeout.
+  ScanPrefetcher(std::shared_ptr<tserver::TabletServerServiceProxy> proxy,
+                 const tserver::ScanRequestPB& last_req,
+                 std::vector<uint32_t> required_features,
+                 int depth,
+                 MonoDelta timeout);
+
+  // Requests the first batch.
+  void Start();
+
+  // Waits until 'deadline' for the next batch, and moves it into '*batch'.
+  // Returns TimedOut if it didn't arrive in time, in which case its request
+  // is still in flight.
+  //
+  // The batch may hold a failed response, after which no more batches are
+  // requested.
+  Status Take(const MonoTime& deadline, std::unique_ptr<Batch>* batch);
+
+  // Stops requesting batches. A request which is already in flight is
+  // abandoned.
+  void Stop();
+
+ private:
+  // If another batch should be requested, returns the batch to fill and
+  // sets '*req' to its request. Otherwise, returns nullptr.
+  //
+  // 'lock_' must be held.
+  Batch* PrepareNextRequestUnlocked(tserver::ScanRequestPB* req);
+
+  // Sends a request prepared by PrepareNextRequestUnlocked().
+  void SendRequest(Batch* batch, const tserver::ScanRequestPB& req);
+
+  // Callback for the request in flight.
+  void RequestDone();
+
+  const std::shared_ptr<tserver::TabletServerServiceProxy> proxy_;
+  const std::vector<uint32_t> required_features_;
+  const size_t depth_;
+  const MonoDelta timeout_;
+
+  Mutex lock_;
+  ConditionVariable cond_;
+
+  // The request for the last batch, updated as more are requested.
+  tserver::ScanRequestPB req_;
+
+  // The batch whose request is in flight, if any.
+  std::unique_ptr<Batch> in_flight_;
+
+  // The batches which have arrived but haven't been taken yet.
+  std::deque<std::unique_ptr<Batch>> batches_;
+
+  // Set once no more batches should be requested: a response ended the
+  // scan of the tablet or failed, or the prefetcher was stopped.
+  bool done_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanPrefetcher);
+};
+
 class KuduScanner::Data {
  public:
 
@@ -123,6 +211,13 @@ class KuduScanner::Data {
 
   Status KeepAlive();
 
+  // Fetches the next batch of results for this scan, opening the next tablet
+  // or sending a continuation RPC as needed.
+  //
+  // Sets 'has_data' to true if 'last_response_' and 'controller_' then hold
+  // a batch of results which should be handed to the caller.
+  Status FetchNextBatch(bool* has_data);
+
   // Returns whether there may exist more tablets to scan.
   //
   // This method does not take into account any non-covered range partitions
@@ -148,6 +243,14 @@ class KuduScanner::Data {
   // Modifies fields in 'next_req_' in preparation for a new request.
   void PrepareRequest(RequestType state);
 
+  // Starts prefetching the following batches of the current tablet, if
+  // prefetching is enabled, 'last_response_' has more results, and it isn't
+  // running already.
+  void MaybeStartPrefetch();
+
+  // Stops prefetching, abandoning any prefetched batches.
+  void StopPrefetch();
+
   // Update 'last_error_' if need be. Should be invoked whenever a
   // non-fatal (i.e. retriable) scan error is encountered.
   void UpdateLastError(const Status& error);
@@ -189,6 +292,10 @@ class KuduScanner::Data {
   // RPC controller for the last in-flight RPC.
   rpc::RpcController controller_;
 
+  // Prefetches the batches following 'last_response_' from the current
+  // tablet, if prefetching is enabled.
+  std::shared_ptr<ScanPrefetcher> prefetcher_;
+
   // The table we're scanning.
   sp::shared_ptr<KuduTable> table_;
 
@@ -245,6 +352,14 @@ class KuduScanner::Data {
 
   void UpdateResourceMetrics();
 
+  // Returns the server features required by the scan's requests.
+  std::vector<uint32_t> RequiredServerFeatures() const;
+
+  // Moves the next prefetched batch into 'last_response_' and 'controller_',
+  // waiting for it until 'overall_deadline', and analyzes it like
+  // SendScanRpc() does.
+  ScanRpcStatus TakePrefetchedBatch(const MonoTime& overall_deadline);
+
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
 
@@ -297,6 +412,43 @@ class KuduScanBatch::Data {
   size_t projected_row_size_;
 };
 
+class KuduColumnarScanBatch::Data {
+ public:
+  Data();
+  ~Data();
+
+  Status Reset(rpc::RpcController* controller,
+               const Schema* projection,
+               const KuduSchema* client_projection,
+               gscoped_ptr<ColumnarRowBlockPB> resp_data);
+
+  // Returns a bad Status if 'idx' is not a valid column index.
+  Status CheckColumnIndex(int idx) const;
+
+  int num_rows() const {
+    return resp_data_.num_rows();
+  }
+
+  void Clear();
+
+  // The RPC controller for the RPC which returned this batch.
+  // Holding on to the controller ensures we hold on to the sidecars
+  // which contain the column data.
+  rpc::RpcController controller_;
+
+  // The PB which describes where each column lives in the sidecars.
+  ColumnarRowBlockPB resp_data_;
+
+  // Slices of the data, varlen data and non-null bitmap sidecars, whose
+  // lifetime is ensured by the members above.
+  Slice data_, varlen_data_, non_null_bitmaps_;
+
+  // The projection being scanned.
+  const Schema* projection_;
+  // The KuduSchema version of 'projection_'
+  const KuduSchema* client_projection_;
+};
+
 } // namespace client
 } // namespace kudu
 
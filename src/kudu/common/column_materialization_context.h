@@ -38,7 +38,8 @@ class ColumnMaterializationContext {
       pred_(pred),
       block_(block),
       sel_(sel),
-      decoder_eval_status_(kNotSet) {
+      decoder_eval_status_(kNotSet),
+      skip_unselected_rows_(false) {
       if (!pred_ || !sel || !block) {
         decoder_eval_status_ = kDecoderEvalNotSupported;
       }
@@ -61,6 +62,16 @@ class ColumnMaterializationContext {
   // cover the number of rows being scanned.
   SelectionVector* sel() { return sel_; }
 
+  // Whether the cells of rows which are already unselected in sel() may be
+  // left unmaterialized. Only valid for columns without a predicate, which
+  // are materialized after all predicates have been evaluated.
+  bool skip_unselected_rows() const { return skip_unselected_rows_; }
+
+  void SetSkipUnselectedRows() {
+    DCHECK(pred_ == nullptr && sel_ != nullptr);
+    skip_unselected_rows_ = true;
+  }
+
   // Checked after returning from the decoder to determine whether or not the
   // block must still be evaluated (on true).
   bool DecoderEvalNotSupported() const {
@@ -132,6 +143,8 @@ class ColumnMaterializationContext {
   SelectionVector* const sel_;
 
   DecoderEvalStatus decoder_eval_status_;
+
+  bool skip_unselected_rows_;
 };
 
 } // namespace kudu
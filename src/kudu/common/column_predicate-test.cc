@@ -25,6 +25,7 @@
 
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/test_util.h"
 
 DECLARE_bool(log_redact_user_data);
@@ -1040,6 +1041,123 @@ TEST_F(TestColumnPredicate, TestInList) {
   }
 }
 
+TEST_F(TestColumnPredicate, TestInBloomFilter) {
+  ColumnSchema column("c", INT32, true);
+  int32_t values[] = { 0, 5, 7, 10, 20 };
+
+  // A filter containing all of the values, and one containing none of them.
+  BloomFilterBuilder builder(BloomFilterSizing::ByCountAndFPRate(10, 0.01));
+  for (int32_t value : values) {
+    builder.AddKey(BloomKeyProbe(Slice(reinterpret_cast<const uint8_t*>(&value),
+                                       sizeof(value))));
+  }
+  BloomFilterBuilder empty_builder(BloomFilterSizing::ByCountAndFPRate(10, 0.01));
+  BloomFilter full_filter(builder.slice(), builder.n_hashes());
+  BloomFilter empty_filter(empty_builder.slice(), empty_builder.n_hashes());
+  auto in_bloom = [&] (const BloomFilter& filter, const void* lower, const void* upper) {
+    vector<BloomFilter> filters = { filter };
+    return ColumnPredicate::InBloomFilter(column, &filters, lower, upper);
+  };
+
+  // Simplification.
+  vector<BloomFilter> filters;
+  ASSERT_EQ(PredicateType::IsNotNull,
+            ColumnPredicate::InBloomFilter(column, &filters, nullptr, nullptr).predicate_type());
+  ASSERT_EQ(PredicateType::Range,
+            ColumnPredicate::InBloomFilter(column, &filters, &values[1], nullptr).predicate_type());
+  ASSERT_EQ(PredicateType::InBloomFilter,
+            in_bloom(full_filter, nullptr, nullptr).predicate_type());
+  ASSERT_EQ(PredicateType::InBloomFilter,
+            in_bloom(full_filter, &values[0], &values[3]).predicate_type());
+  ASSERT_EQ(PredicateType::None,
+            in_bloom(full_filter, &values[3], &values[0]).predicate_type());
+  int32_t six = 6;
+  ASSERT_EQ(ColumnPredicate::Equality(column, &values[1]),
+            in_bloom(full_filter, &values[1], &six));
+  ASSERT_EQ(PredicateType::None,
+            in_bloom(empty_filter, &values[1], &six).predicate_type());
+
+  // Evaluation.
+  ColumnPredicate full = in_bloom(full_filter, nullptr, nullptr);
+  ColumnPredicate bounded = in_bloom(full_filter, &values[1], &values[3]);
+  ColumnPredicate empty = in_bloom(empty_filter, nullptr, nullptr);
+  for (int32_t value : values) {
+    ASSERT_TRUE(full.EvaluateCell<INT32>(&value));
+    ASSERT_EQ(value >= 5 && value < 10, bounded.EvaluateCell<INT32>(&value));
+    ASSERT_FALSE(empty.EvaluateCell<INT32>(&value));
+  }
+
+  // Merges with other predicate types.
+  TestMerge(full,
+            ColumnPredicate::None(column),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+  TestMerge(full,
+            ColumnPredicate::IsNull(column),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+  TestMerge(full,
+            ColumnPredicate::IsNotNull(column),
+            full,
+            PredicateType::InBloomFilter);
+  TestMerge(full,
+            ColumnPredicate::Equality(column, &values[2]),
+            ColumnPredicate::Equality(column, &values[2]),
+            PredicateType::Equality);
+  TestMerge(empty,
+            ColumnPredicate::Equality(column, &values[2]),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+  TestMerge(bounded,
+            ColumnPredicate::Equality(column, &values[4]),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+  TestMerge(full,
+            ColumnPredicate::Range(column, &values[1], &values[3]),
+            bounded,
+            PredicateType::InBloomFilter);
+  TestMerge(bounded,
+            ColumnPredicate::Range(column, &values[2], nullptr),
+            in_bloom(full_filter, &values[2], &values[3]),
+            PredicateType::InBloomFilter);
+
+  vector<const void*> in_list = { &values[1], &values[2], &values[4] };
+  vector<const void*> in_list_bounded = { &values[1], &values[2] };
+  TestMerge(bounded,
+            ColumnPredicate::InList(column, &in_list),
+            ColumnPredicate::InList(column, &in_list_bounded),
+            PredicateType::InList);
+  in_list = { &values[1], &values[2], &values[4] };
+  TestMerge(empty,
+            ColumnPredicate::InList(column, &in_list),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+
+  // Merging bloom filter predicates requires values to be in both filters.
+  ColumnPredicate both = full;
+  both.Merge(bounded);
+  ASSERT_EQ(PredicateType::InBloomFilter, both.predicate_type());
+  ASSERT_EQ(2, both.bloom_filters().size());
+  ASSERT_EQ("`c` IN 2 BLOOM FILTER(S) AND `c` >= 5 AND `c` < 10", both.ToString());
+  both.Merge(empty);
+  ASSERT_EQ(3, both.bloom_filters().size());
+  for (int32_t value : values) {
+    ASSERT_FALSE(both.EvaluateCell<INT32>(&value));
+  }
+
+  // Binary values are hashed by their contents.
+  ColumnSchema string_column("s", STRING);
+  Slice foo("foo");
+  BloomFilterBuilder string_builder(BloomFilterSizing::ByCountAndFPRate(10, 0.01));
+  string_builder.AddKey(BloomKeyProbe(foo));
+  filters = { BloomFilter(string_builder.slice(), string_builder.n_hashes()) };
+  ColumnPredicate string_pred = ColumnPredicate::InBloomFilter(string_column, &filters,
+                                                               nullptr, nullptr);
+  string foo_copy = "foo";
+  Slice foo_copy_slice(foo_copy);
+  ASSERT_TRUE(string_pred.EvaluateCell<BINARY>(&foo_copy_slice));
+}
+
 // Test that column predicate comparison works correctly: ordered by predicate
 // type first, then size of the column type.
 TEST_F(TestColumnPredicate, TestSelectivity) {
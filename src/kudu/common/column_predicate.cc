@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <utility>
 
+#include "kudu/common/column_predicate_kernels.h"
 #include "kudu/common/key_util.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
@@ -149,6 +150,17 @@ ColumnPredicate ColumnPredicate::IsNull(ColumnSchema column) {
          None(move(column));
 }
 
+ColumnPredicate ColumnPredicate::InBloomFilter(ColumnSchema column,
+                                               vector<BloomFilter>* bloom_filters,
+                                               const void* lower,
+                                               const void* upper) {
+  CHECK(bloom_filters != nullptr);
+  ColumnPredicate pred(PredicateType::InBloomFilter, move(column), lower, upper);
+  pred.bloom_filters_.swap(*bloom_filters);
+  pred.Simplify();
+  return pred;
+}
+
 ColumnPredicate ColumnPredicate::None(ColumnSchema column) {
   return ColumnPredicate(PredicateType::None, move(column), nullptr, nullptr);
 }
@@ -157,6 +169,7 @@ void ColumnPredicate::SetToNone() {
   predicate_type_ = PredicateType::None;
   lower_ = nullptr;
   upper_ = nullptr;
+  bloom_filters_.clear();
 }
 
 void ColumnPredicate::Simplify() {
@@ -219,6 +232,33 @@ void ColumnPredicate::Simplify() {
       }
       return;
     };
+    case PredicateType::InBloomFilter: {
+      if (bloom_filters_.empty()) {
+        // Without any filters, only the range is left.
+        if (lower_ == nullptr && upper_ == nullptr) {
+          predicate_type_ = PredicateType::IsNotNull;
+        } else {
+          predicate_type_ = PredicateType::Range;
+          Simplify();
+        }
+      } else if (lower_ != nullptr && upper_ != nullptr) {
+        if (type_info->Compare(lower_, upper_) >= 0) {
+          // If the range bounds are empty then no results can be returned.
+          SetToNone();
+        } else if (type_info->AreConsecutive(lower_, upper_)) {
+          // If the values are consecutive, then only the lower bound can
+          // match, if it's in the filters.
+          if (CheckValueInBloomFilters(lower_)) {
+            predicate_type_ = PredicateType::Equality;
+            upper_ = nullptr;
+            bloom_filters_.clear();
+          } else {
+            SetToNone();
+          }
+        }
+      }
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -247,6 +287,10 @@ void ColumnPredicate::Merge(const ColumnPredicate& other) {
       MergeIntoInList(other);
       return;
     };
+    case PredicateType::InBloomFilter: {
+      MergeIntoInBloomFilter(other);
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -313,6 +357,13 @@ void ColumnPredicate::MergeIntoRange(const ColumnPredicate& other) {
       Simplify();
       return;
     };
+    case PredicateType::InBloomFilter: {
+      // Turn this into a bloom filter predicate with no filters, so that the
+      // other's bounds and filters can be merged into it.
+      predicate_type_ = PredicateType::InBloomFilter;
+      MergeIntoInBloomFilter(other);
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -350,6 +401,12 @@ void ColumnPredicate::MergeIntoEquality(const ColumnPredicate& other) {
       }
       return;
     };
+    case PredicateType::InBloomFilter: {
+      if (!other.CheckValueInBloomFilterRange(lower_)) {
+        SetToNone();
+      }
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -368,6 +425,7 @@ void ColumnPredicate::MergeIntoIsNotNull(const ColumnPredicate &other) {
       lower_ = other.lower_;
       upper_ = other.upper_;
       values_ = other.values_;
+      bloom_filters_ = other.bloom_filters_;
       return;
     }
   }
@@ -489,6 +547,77 @@ void ColumnPredicate::MergeIntoInList(const ColumnPredicate &other) {
       Simplify();
       return;
     };
+    case PredicateType::InBloomFilter: {
+      // Only values which may be in the filters should be retained.
+      values_.erase(std::remove_if(values_.begin(), values_.end(),
+                                   [&] (const void* v) {
+                                     return !other.CheckValueInBloomFilterRange(v);
+                                   }), values_.end());
+      Simplify();
+      return;
+    };
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
+void ColumnPredicate::MergeIntoInBloomFilter(const ColumnPredicate& other) {
+  CHECK(predicate_type_ == PredicateType::InBloomFilter);
+
+  switch (other.predicate_type()) {
+    case PredicateType::None: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::Range:
+    case PredicateType::InBloomFilter: {
+      // Set the lower bound to the larger of the two.
+      if (other.lower_ != nullptr &&
+          (lower_ == nullptr || column_.type_info()->Compare(lower_, other.lower_) < 0)) {
+        lower_ = other.lower_;
+      }
+
+      // Set the upper bound to the smaller of the two.
+      if (other.upper_ != nullptr &&
+          (upper_ == nullptr || column_.type_info()->Compare(upper_, other.upper_) > 0)) {
+        upper_ = other.upper_;
+      }
+
+      // A value must be in the filters of both predicates.
+      bloom_filters_.insert(bloom_filters_.end(),
+                            other.bloom_filters_.begin(), other.bloom_filters_.end());
+      Simplify();
+      return;
+    };
+    case PredicateType::Equality: {
+      if (CheckValueInBloomFilterRange(other.lower_)) {
+        predicate_type_ = PredicateType::Equality;
+        lower_ = other.lower_;
+        upper_ = nullptr;
+        bloom_filters_.clear();
+      } else {
+        SetToNone();
+      }
+      return;
+    };
+    case PredicateType::IsNotNull: return;
+    case PredicateType::IsNull: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::InList: {
+      // The InList values which may be in the filters become the new InList.
+      values_ = other.values_;
+      values_.erase(std::remove_if(values_.begin(), values_.end(),
+                                   [this] (const void* v) {
+                                     return !CheckValueInBloomFilterRange(v);
+                                   }), values_.end());
+      predicate_type_ = PredicateType::InList;
+      lower_ = nullptr;
+      upper_ = nullptr;
+      bloom_filters_.clear();
+      Simplify();
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -514,13 +643,64 @@ void ApplyPredicate(const ColumnBlock& block, SelectionVector* sel, P p) {
     }
   }
 }
+
+// ANDs 'op' of each byte of the block's non-null bitmap into the selection
+// vector, leaving the bits past the end of the block untouched.
+template <typename Op>
+void ApplyNullBitmap(const ColumnBlock& block, SelectionVector* sel, Op op) {
+  DCHECK(block.is_nullable());
+  const uint8_t* non_null = block.null_bitmap();
+  uint8_t* sel_bytes = sel->mutable_bitmap();
+  size_t full_bytes = block.nrows() / 8;
+  for (size_t i = 0; i < full_bytes; i++) {
+    sel_bytes[i] &= op(non_null[i]);
+  }
+  size_t tail_bits = block.nrows() % 8;
+  if (tail_bits != 0) {
+    uint8_t tail_mask = (1 << tail_bits) - 1;
+    sel_bytes[full_bytes] &= op(non_null[full_bytes]) | ~tail_mask;
+  }
+}
+
+uint8_t SelectNonNull(uint8_t non_null) { return non_null; }
+uint8_t SelectNull(uint8_t non_null) { return ~non_null; }
 } // anonymous namespace
 
+bool ColumnPredicate::EvaluateWithKernels(const ColumnBlock& block, SelectionVector* sel) const {
+  namespace kernels = column_predicate_kernels;
+  DataType physical_type = block.type_info()->physical_type();
+  if (!kernels::SupportsType(physical_type)) return false;
+
+  // The kernels evaluate the cells of NULL rows like any other, so deselect
+  // those first.
+  if (block.is_nullable()) {
+    ApplyNullBitmap(block, sel, SelectNonNull);
+  }
+  kernels::Isa isa = kernels::BestSupportedIsa();
+  switch (predicate_type()) {
+    case PredicateType::Range:
+      kernels::EvaluateRange(isa, physical_type, block.data(), block.nrows(),
+                             lower_, upper_, sel->mutable_bitmap());
+      return true;
+    case PredicateType::Equality:
+      kernels::EvaluateEquality(isa, physical_type, block.data(), block.nrows(),
+                                lower_, sel->mutable_bitmap());
+      return true;
+    case PredicateType::InList:
+      kernels::EvaluateInList(isa, physical_type, block.data(), block.nrows(),
+                              values_, sel->mutable_bitmap());
+      return true;
+    default: LOG(FATAL) << "unexpected predicate type: " << ToString();
+  }
+  return false;
+}
+
 template <DataType PhysicalType>
 void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
                                               SelectionVector* sel) const {
   switch (predicate_type()) {
     case PredicateType::Range: {
+      if (EvaluateWithKernels(block, sel)) return;
       if (lower_ == nullptr) {
         ApplyPredicate(block, sel, [this] (const void* cell) {
           return DataTypeTraits<PhysicalType>::Compare(cell, this->upper_) < 0;
@@ -538,6 +718,7 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
       return;
     };
     case PredicateType::Equality: {
+      if (EvaluateWithKernels(block, sel)) return;
       ApplyPredicate(block, sel, [this] (const void* cell) {
         return DataTypeTraits<PhysicalType>::Compare(cell, this->lower_) == 0;
       });
@@ -545,13 +726,7 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
     };
     case PredicateType::IsNotNull: {
       if (!block.is_nullable()) return;
-      // TODO: make this more efficient by using bitwise operations on the
-      // null and selection vectors.
-      for (size_t i = 0; i < block.nrows(); i++) {
-        if (sel->IsRowSelected(i) && block.is_null(i)) {
-          BitmapClear(sel->mutable_bitmap(), i);
-        }
-      }
+      ApplyNullBitmap(block, sel, SelectNonNull);
       return;
     };
     case PredicateType::IsNull: {
@@ -559,16 +734,11 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
         BitmapChangeBits(sel->mutable_bitmap(), 0, block.nrows(), false);
         return;
       }
-      // TODO(wdberkeley): make this more efficient by using bitwise operations on the
-      // null and selection vectors.
-      for (size_t i = 0; i < block.nrows(); i++) {
-        if (sel->IsRowSelected(i) && !block.is_null(i)) {
-          BitmapClear(sel->mutable_bitmap(), i);
-        }
-      }
+      ApplyNullBitmap(block, sel, SelectNull);
       return;
     }
     case PredicateType::InList: {
+      if (EvaluateWithKernels(block, sel)) return;
       ApplyPredicate(block, sel, [this] (const void* cell) {
         return std::binary_search(values_.begin(), values_.end(), cell,
                                   [] (const void* lhs, const void* rhs) {
@@ -577,6 +747,12 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
       });
       return;
     };
+    case PredicateType::InBloomFilter: {
+      ApplyPredicate(block, sel, [this] (const void* cell) {
+        return this->EvaluateCell<PhysicalType>(cell);
+      });
+      return;
+    };
     case PredicateType::None: LOG(FATAL) << "NONE predicate evaluation";
   }
   LOG(FATAL) << "unknown predicate type";
@@ -641,6 +817,19 @@ string ColumnPredicate::ToString() const {
       ss.append(")");
       return ss;
     };
+    case PredicateType::InBloomFilter: {
+      string ss = strings::Substitute("`$0` IN $1 BLOOM FILTER(S)",
+                                      column_.name(), bloom_filters_.size());
+      if (lower_ != nullptr) {
+        ss.append(strings::Substitute(" AND `$0` >= $1",
+                                      column_.name(), column_.Stringify(lower_)));
+      }
+      if (upper_ != nullptr) {
+        ss.append(strings::Substitute(" AND `$0` < $1",
+                                      column_.name(), column_.Stringify(upper_)));
+      }
+      return ss;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -652,6 +841,16 @@ bool ColumnPredicate::operator==(const ColumnPredicate& other) const {
   }
   switch (predicate_type_) {
     case PredicateType::Equality: return column_.type_info()->Compare(lower_, other.lower_) == 0;
+    case PredicateType::InBloomFilter: {
+      if (bloom_filters_.size() != other.bloom_filters_.size()) return false;
+      for (int i = 0; i < bloom_filters_.size(); i++) {
+        if (bloom_filters_[i].n_hashes() != other.bloom_filters_[i].n_hashes() ||
+            bloom_filters_[i].data() != other.bloom_filters_[i].data()) {
+          return false;
+        }
+      }
+      // Fall through to compare the bounds.
+    }
     case PredicateType::Range: {
       return (lower_ == other.lower_ ||
               (lower_ != nullptr && other.lower_ != nullptr &&
@@ -687,6 +886,27 @@ bool ColumnPredicate::CheckValueInList(const void* value) const {
                             });
 }
 
+bool ColumnPredicate::CheckValueInBloomFilters(const void* value) const {
+  const TypeInfo* type_info = column_.type_info();
+  Slice key = type_info->physical_type() == BINARY ?
+      *static_cast<const Slice*>(value) :
+      Slice(static_cast<const uint8_t*>(value), type_info->size());
+  BloomKeyProbe probe(key);
+  for (const BloomFilter& bloom_filter : bloom_filters_) {
+    if (!bloom_filter.MayContainKey(probe)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ColumnPredicate::CheckValueInBloomFilterRange(const void* value) const {
+  CHECK(predicate_type_ == PredicateType::InBloomFilter);
+  return (lower_ == nullptr || column_.type_info()->Compare(lower_, value) <= 0) &&
+         (upper_ == nullptr || column_.type_info()->Compare(upper_, value) > 0) &&
+         CheckValueInBloomFilters(value);
+}
+
 namespace {
 int SelectivityRank(const ColumnPredicate& predicate) {
   int rank;
@@ -695,8 +915,9 @@ int SelectivityRank(const ColumnPredicate& predicate) {
     case PredicateType::IsNull: rank = 1; break;
     case PredicateType::Equality: rank = 2; break;
     case PredicateType::InList: rank = 3; break;
-    case PredicateType::Range: rank = 4; break;
-    case PredicateType::IsNotNull: rank = 5; break;
+    case PredicateType::InBloomFilter: rank = 4; break;
+    case PredicateType::Range: rank = 5; break;
+    case PredicateType::IsNotNull: rank = 6; break;
     default: LOG(FATAL) << "unknown predicate type";
   }
   return rank * (kLargestTypeSize + 1) + predicate.column().type_info()->size();
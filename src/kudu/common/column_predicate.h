@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "kudu/common/schema.h"
+#include "kudu/util/bloom_filter.h"
 
 namespace kudu {
 
@@ -52,6 +53,12 @@ enum class PredicateType {
   // A predicate which evaluates to true if the column value is present in
   // a value list.
   InList,
+
+  // A predicate which evaluates to true if the column value may be present
+  // in every one of a set of bloom filters, and falls within an optional
+  // range. Rows whose values are not in the filters may still match, with
+  // the filters' false positive rate.
+  InBloomFilter,
 };
 
 // A predicate which can be evaluated over a block of column values.
@@ -126,6 +133,22 @@ class ColumnPredicate {
   // The InList will be simplified into an Equality, Range or None if possible.
   static ColumnPredicate InList(ColumnSchema column, std::vector<const void*>* values);
 
+  // Creates a new IN BLOOM FILTER predicate for the column, optionally
+  // constrained to the range [lower, upper) as well. Either bound may be a
+  // nullptr.
+  //
+  // The filters must have been built by hashing the values with
+  // BloomKeyProbe: BINARY values by their contents, and other values by their
+  // in-memory representation. Neither the filters' data nor the bounds are
+  // copied, and they must outlive the returned predicate.
+  //
+  // The predicate will be simplified into a Range, IsNotNull or None if
+  // possible.
+  static ColumnPredicate InBloomFilter(ColumnSchema column,
+                                       std::vector<BloomFilter>* bloom_filters,
+                                       const void* lower,
+                                       const void* upper);
+
   // Creates a new predicate which matches no values.
   static ColumnPredicate None(ColumnSchema column);
 
@@ -192,6 +215,15 @@ class ColumnPredicate {
                                     return DataTypeTraits<PhysicalType>::Compare(lhs, rhs) < 0;
                                   });
       };
+      case PredicateType::InBloomFilter: {
+        if (lower_ != nullptr && DataTypeTraits<PhysicalType>::Compare(cell, lower_) < 0) {
+          return false;
+        }
+        if (upper_ != nullptr && DataTypeTraits<PhysicalType>::Compare(cell, upper_) >= 0) {
+          return false;
+        }
+        return CheckValueInBloomFilters(cell);
+      };
     }
     LOG(FATAL) << "unknown predicate type";
   }
@@ -204,13 +236,13 @@ class ColumnPredicate {
   // Predicates over different columns are not equal.
   bool operator==(const ColumnPredicate& other) const;
 
-  // Returns the raw lower bound value if this is a range predicate, or the
-  // equality value if this is an equality predicate.
+  // Returns the raw lower bound value if this is a range or bloom filter
+  // predicate, or the equality value if this is an equality predicate.
   const void* raw_lower() const {
     return lower_;
   }
 
-  // Returns the raw upper bound if this is a range predicate.
+  // Returns the raw upper bound if this is a range or bloom filter predicate.
   const void* raw_upper() const {
     return upper_;
   }
@@ -226,6 +258,11 @@ class ColumnPredicate {
     return values_;
   }
 
+  // Returns the bloom filters if this is a bloom filter predicate.
+  const std::vector<BloomFilter>& bloom_filters() const {
+    return bloom_filters_;
+  }
+
  private:
 
   friend class TestColumnPredicate;
@@ -265,9 +302,17 @@ class ColumnPredicate {
   void EvaluateForPhysicalType(const ColumnBlock& block,
                                SelectionVector* sel) const;
 
+  // Evaluates a Range, Equality or InList predicate using the batch kernels
+  // in column_predicate_kernels.h. Returns false without modifying 'sel' if
+  // the column's type has no kernels.
+  bool EvaluateWithKernels(const ColumnBlock& block, SelectionVector* sel) const;
+
   // Merge another predicate into this InList predicate.
   void MergeIntoInList(const ColumnPredicate& other);
 
+  // Merge another predicate into this InBloomFilter predicate.
+  void MergeIntoInBloomFilter(const ColumnPredicate& other);
+
   // For a Range type predicate, this helper function checks
   // whether a given value is in the range.
   bool CheckValueInRange(const void* value) const;
@@ -276,6 +321,15 @@ class ColumnPredicate {
   // whether a given value is in the list.
   bool CheckValueInList(const void* value) const;
 
+  // For an InBloomFilter type predicate, this helper function checks
+  // whether a given value may be in all of the bloom filters. The range
+  // bounds are not checked.
+  bool CheckValueInBloomFilters(const void* value) const;
+
+  // For an InBloomFilter type predicate, this helper function checks whether
+  // a given value is in the range and may be in all of the bloom filters.
+  bool CheckValueInBloomFilterRange(const void* value) const;
+
   // The type of this predicate.
   PredicateType predicate_type_;
 
@@ -291,6 +345,10 @@ class ColumnPredicate {
 
   // The list of values to check column against if this is an InList predicate.
   std::vector<const void*> values_;
+
+  // The bloom filters to check column against if this is an InBloomFilter
+  // predicate.
+  std::vector<BloomFilter> bloom_filters_;
 };
 
 // Compares predicates according to selectivity. Predicates that match fewer
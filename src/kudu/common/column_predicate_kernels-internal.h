@@ -0,0 +1,181 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Shared implementation of the predicate kernels declared in
+// column_predicate_kernels.h.
+//
+// The templates here are instantiated in translation units compiled for
+// different instruction sets. To avoid the linker picking, say, an AVX2
+// instantiation for use on a CPU without AVX2, every instantiation must
+// involve an 'Ops' type which is local to its translation unit (i.e. defined
+// in an anonymous namespace), and the code here must not call any inline
+// functions shared with other translation units (including glog's CHECKs
+// and std::vector's members).
+#ifndef KUDU_COMMON_COLUMN_PREDICATE_KERNELS_INTERNAL_H
+#define KUDU_COMMON_COLUMN_PREDICATE_KERNELS_INTERNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "kudu/common/common.pb.h"
+
+namespace kudu {
+namespace column_predicate_kernels {
+namespace internal {
+
+// InList predicates with more values than this are evaluated by binary
+// search rather than by comparing each cell against every value.
+constexpr size_t kMaxVectorizedInListSize = 16;
+
+// Loads a predicate bound of the cell type of 'Ops'. Like all the code here,
+// this is templated on 'Ops' so that each instruction set gets its own copy.
+template<class Ops>
+inline typename Ops::T LoadValue(const void* ptr) {
+  typename Ops::T val;
+  memcpy(&val, ptr, sizeof(val));
+  return val;
+}
+
+// Evaluates 'match' over 'cells' and ANDs the result into 'sel'.
+//
+// 'Ops' describes a vector of 'Ops::kLanes' cells of type 'Ops::T':
+//
+//   typedef ... T;     // The cell type.
+//   typedef ... Vec;   // A vector of cells.
+//   typedef ... Mask;  // The result of comparing two vectors.
+//   static const int kLanes;
+//   static Vec Load(const T* cells);  // Need not be aligned.
+//   static Vec Set1(T val);
+//   static Mask Ge(Vec a, Vec b);     // !(a < b)
+//   static Mask Lt(Vec a, Vec b);     // a < b
+//   static Mask Eq(Vec a, Vec b);     // !(a < b) && !(b < a)
+//   static Mask And(Mask a, Mask b);
+//   static Mask Or(Mask a, Mask b);
+//   static uint32_t MoveMask(Mask m); // One bit per lane.
+//
+// 'match' maps a Vec to a Mask.
+template<class Ops, class Match>
+inline void ApplyKernel(const typename Ops::T* cells, size_t nrows, const Match& match,
+                        uint8_t* sel) {
+  typedef typename Ops::T T;
+  // Each step produces at least one whole byte of the selection vector.
+  constexpr size_t kRowsPerStep = Ops::kLanes < 8 ? 8 : Ops::kLanes;
+  constexpr size_t kBytesPerStep = kRowsPerStep / 8;
+  static_assert(kRowsPerStep <= 32, "step must fit in a uint32_t mask");
+
+  size_t i = 0;
+  for (; i + kRowsPerStep <= nrows; i += kRowsPerStep) {
+    uint8_t* sel_bytes = sel + i / 8;
+    uint8_t any_selected = 0;
+    for (size_t b = 0; b < kBytesPerStep; b++) {
+      any_selected |= sel_bytes[b];
+    }
+    if (any_selected == 0) continue;
+
+    uint32_t bits = 0;
+    for (size_t j = 0; j < kRowsPerStep; j += Ops::kLanes) {
+      bits |= Ops::MoveMask(match(Ops::Load(cells + i + j))) << j;
+    }
+    for (size_t b = 0; b < kBytesPerStep; b++) {
+      sel_bytes[b] &= static_cast<uint8_t>(bits >> (8 * b));
+    }
+  }
+  if (i == nrows) return;
+
+  // Evaluate the remaining cells by copying them into a full step, and leave
+  // the bits past 'nrows' untouched.
+  size_t remaining = nrows - i;
+  T tail[kRowsPerStep];
+  memset(tail, 0, sizeof(tail));
+  memcpy(tail, cells + i, remaining * sizeof(T));
+  uint32_t bits = 0;
+  for (size_t j = 0; j < kRowsPerStep; j += Ops::kLanes) {
+    bits |= Ops::MoveMask(match(Ops::Load(tail + j))) << j;
+  }
+  bits |= ~((1U << remaining) - 1);
+  uint8_t* sel_bytes = sel + i / 8;
+  for (size_t b = 0; b < (remaining + 7) / 8; b++) {
+    sel_bytes[b] &= static_cast<uint8_t>(bits >> (8 * b));
+  }
+}
+
+template<class Ops>
+void RangeKernel(const void* cells, size_t nrows, const void* lower, const void* upper,
+                 uint8_t* sel) {
+  typedef typename Ops::T T;
+  typedef typename Ops::Vec Vec;
+  const T* c = reinterpret_cast<const T*>(cells);
+  if (lower != nullptr && upper != nullptr) {
+    Vec lo = Ops::Set1(LoadValue<Ops>(lower));
+    Vec hi = Ops::Set1(LoadValue<Ops>(upper));
+    ApplyKernel<Ops>(c, nrows, [&] (Vec v) {
+        return Ops::And(Ops::Ge(v, lo), Ops::Lt(v, hi));
+      }, sel);
+  } else if (lower != nullptr) {
+    Vec lo = Ops::Set1(LoadValue<Ops>(lower));
+    ApplyKernel<Ops>(c, nrows, [&] (Vec v) { return Ops::Ge(v, lo); }, sel);
+  } else {
+    Vec hi = Ops::Set1(LoadValue<Ops>(upper));
+    ApplyKernel<Ops>(c, nrows, [&] (Vec v) { return Ops::Lt(v, hi); }, sel);
+  }
+}
+
+template<class Ops>
+void EqualityKernel(const void* cells, size_t nrows, const void* value, uint8_t* sel) {
+  typedef typename Ops::T T;
+  typedef typename Ops::Vec Vec;
+  Vec val = Ops::Set1(LoadValue<Ops>(value));
+  ApplyKernel<Ops>(reinterpret_cast<const T*>(cells), nrows,
+                   [&] (Vec v) { return Ops::Eq(v, val); }, sel);
+}
+
+// Compares each cell against every value, so is only suitable for short
+// lists of between 1 and kMaxVectorizedInListSize values.
+template<class Ops>
+void InListKernel(const void* cells, size_t nrows, const void* const* values,
+                  size_t num_values, uint8_t* sel) {
+  typedef typename Ops::T T;
+  typedef typename Ops::Vec Vec;
+  Vec vals[kMaxVectorizedInListSize];
+  for (size_t i = 0; i < num_values; i++) {
+    vals[i] = Ops::Set1(LoadValue<Ops>(values[i]));
+  }
+  ApplyKernel<Ops>(reinterpret_cast<const T*>(cells), nrows, [&] (Vec v) {
+      auto m = Ops::Eq(v, vals[0]);
+      for (size_t i = 1; i < num_values; i++) {
+        m = Ops::Or(m, Ops::Eq(v, vals[i]));
+      }
+      return m;
+    }, sel);
+}
+
+// Entry points of the AVX2 kernels, defined in column_predicate_kernels_avx2.cc,
+// which is compiled with -mavx2. Return false if 'physical_type' has no AVX2
+// kernel, in which case 'sel' is unmodified.
+bool EvaluateRangeAvx2(DataType physical_type, const void* cells, size_t nrows,
+                       const void* lower, const void* upper, uint8_t* sel);
+bool EvaluateEqualityAvx2(DataType physical_type, const void* cells, size_t nrows,
+                          const void* value, uint8_t* sel);
+bool EvaluateInListAvx2(DataType physical_type, const void* cells, size_t nrows,
+                        const void* const* values, size_t num_values, uint8_t* sel);
+
+} // namespace internal
+} // namespace column_predicate_kernels
+} // namespace kudu
+
+#endif // KUDU_COMMON_COLUMN_PREDICATE_KERNELS_INTERNAL_H
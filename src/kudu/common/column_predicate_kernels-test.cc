@@ -0,0 +1,203 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/column_predicate_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/random.h"
+#include "kudu/util/test_util.h"
+
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace column_predicate_kernels {
+
+class ColumnPredicateKernelsTest : public KuduTest {
+ public:
+  ColumnPredicateKernelsTest() : rng_(SeedRandom()) {}
+
+  // Evaluates random predicates over random cells of 'Type' with every
+  // supported instruction set, and checks the results against evaluating
+  // each cell with DataTypeTraits<Type>::Compare().
+  template<DataType Type>
+  void TestType() {
+    typedef typename DataTypeTraits<Type>::cpp_type T;
+    SCOPED_TRACE(DataType_Name(Type));
+    for (int iter = 0; iter < 50; iter++) {
+      // Usually not a multiple of the vector width, so that the handling of
+      // the trailing cells is exercised.
+      size_t nrows = 1 + rng_.Uniform(300);
+      vector<T> cells(nrows);
+      for (T& cell : cells) {
+        cell = RandomCell<T>();
+      }
+
+      // Range predicates, with either or both bounds.
+      T lower = RandomValue<T>();
+      T upper = RandomValue<T>();
+      CheckKernel<Type>(cells, [&] (Isa isa, uint8_t* sel) {
+          EvaluateRange(isa, Type, cells.data(), nrows, &lower, &upper, sel);
+        }, [&] (const T* cell) {
+          return Compare<Type>(cell, &lower) >= 0 && Compare<Type>(cell, &upper) < 0;
+        });
+      CheckKernel<Type>(cells, [&] (Isa isa, uint8_t* sel) {
+          EvaluateRange(isa, Type, cells.data(), nrows, &lower, nullptr, sel);
+        }, [&] (const T* cell) {
+          return Compare<Type>(cell, &lower) >= 0;
+        });
+      CheckKernel<Type>(cells, [&] (Isa isa, uint8_t* sel) {
+          EvaluateRange(isa, Type, cells.data(), nrows, nullptr, &upper, sel);
+        }, [&] (const T* cell) {
+          return Compare<Type>(cell, &upper) < 0;
+        });
+
+      // Equality predicates.
+      CheckKernel<Type>(cells, [&] (Isa isa, uint8_t* sel) {
+          EvaluateEquality(isa, Type, cells.data(), nrows, &lower, sel);
+        }, [&] (const T* cell) {
+          return Compare<Type>(cell, &lower) == 0;
+        });
+
+      // InList predicates, both short enough to be vectorized and long
+      // enough to be evaluated by binary search.
+      for (int num_values : { 3, 20 }) {
+        vector<T> values;
+        for (int i = 0; i < num_values; i++) {
+          values.push_back(RandomValue<T>());
+        }
+        auto less = [] (const T& a, const T& b) { return Compare<Type>(&a, &b) < 0; };
+        std::sort(values.begin(), values.end(), less);
+        values.erase(std::unique(values.begin(), values.end(), [] (const T& a, const T& b) {
+              return Compare<Type>(&a, &b) == 0;
+            }), values.end());
+        vector<const void*> value_ptrs;
+        for (const T& v : values) {
+          value_ptrs.push_back(&v);
+        }
+        CheckKernel<Type>(cells, [&] (Isa isa, uint8_t* sel) {
+            EvaluateInList(isa, Type, cells.data(), nrows, value_ptrs, sel);
+          }, [&] (const T* cell) {
+            return std::binary_search(values.begin(), values.end(), *cell, less);
+          });
+      }
+    }
+  }
+
+ private:
+  template<DataType Type>
+  static int Compare(const void* a, const void* b) {
+    return DataTypeTraits<Type>::Compare(a, b);
+  }
+
+  // Runs 'kernel' with every supported instruction set on a random selection
+  // vector, and checks that exactly the selected rows which satisfy 'pred'
+  // remain selected, and that the bits past the end of the cells are
+  // untouched.
+  template<DataType Type, class Kernel, class Pred>
+  void CheckKernel(const vector<typename DataTypeTraits<Type>::cpp_type>& cells,
+                   const Kernel& kernel, const Pred& pred) {
+    size_t nrows = cells.size();
+    vector<uint8_t> initial(BitmapSize(nrows) + 1);
+    for (uint8_t& b : initial) {
+      // Mostly-selected bytes, with some fully unselected ones.
+      b = rng_.OneIn(8) ? 0 : rng_.Next();
+    }
+
+    for (Isa isa : { Isa::SCALAR, Isa::SSE4_2, Isa::AVX2 }) {
+      if (!IsaSupported(isa)) continue;
+      SCOPED_TRACE(Substitute("isa: $0, nrows: $1", static_cast<int>(isa), nrows));
+      vector<uint8_t> sel(initial);
+      kernel(isa, sel.data());
+      for (size_t i = 0; i < nrows; i++) {
+        bool expected = BitmapTest(initial.data(), i) && pred(&cells[i]);
+        ASSERT_EQ(expected, BitmapTest(sel.data(), i)) << "row " << i;
+      }
+      for (size_t i = nrows; i < sel.size() * 8; i++) {
+        ASSERT_EQ(BitmapTest(initial.data(), i), BitmapTest(sel.data(), i)) << "bit " << i;
+      }
+    }
+  }
+
+  // Returns a value in a small range, so that predicates match some cells,
+  // or occasionally an extreme value of the type.
+  template<typename T>
+  T RandomValue() {
+    switch (rng_.Uniform(16)) {
+      case 0: return std::numeric_limits<T>::lowest();
+      case 1: return std::numeric_limits<T>::max();
+      default: {
+        int v = static_cast<int>(rng_.Uniform(40));
+        return static_cast<T>(std::numeric_limits<T>::is_signed ? v - 20 : v);
+      }
+    }
+  }
+
+  // Like RandomValue(), but occasionally returns arbitrary bits, which for
+  // floating point types may be a NaN.
+  template<typename T>
+  T RandomCell() {
+    if (rng_.OneIn(8)) {
+      uint64_t bits = rng_.Next64();
+      T val;
+      memcpy(&val, &bits, sizeof(val));
+      return val;
+    }
+    return RandomValue<T>();
+  }
+
+  Random rng_;
+};
+
+TEST_F(ColumnPredicateKernelsTest, TestInt8) { TestType<INT8>(); }
+TEST_F(ColumnPredicateKernelsTest, TestInt16) { TestType<INT16>(); }
+TEST_F(ColumnPredicateKernelsTest, TestInt32) { TestType<INT32>(); }
+TEST_F(ColumnPredicateKernelsTest, TestInt64) { TestType<INT64>(); }
+TEST_F(ColumnPredicateKernelsTest, TestUint32) { TestType<UINT32>(); }
+TEST_F(ColumnPredicateKernelsTest, TestUint64) { TestType<UINT64>(); }
+
+TEST_F(ColumnPredicateKernelsTest, TestFloat) { TestType<FLOAT>(); }
+TEST_F(ColumnPredicateKernelsTest, TestDouble) { TestType<DOUBLE>(); }
+
+// NaN cells compare equal to every value, so they satisfy lower bounds and
+// equality predicates, but not upper bounds.
+TEST_F(ColumnPredicateKernelsTest, TestNaN) {
+  vector<double> cells(13, std::nan(""));
+  double lower = 1, upper = 2;
+  for (Isa isa : { Isa::SCALAR, Isa::SSE4_2, Isa::AVX2 }) {
+    if (!IsaSupported(isa)) continue;
+    vector<uint8_t> sel(BitmapSize(cells.size()), 0xff);
+    EvaluateRange(isa, DOUBLE, cells.data(), cells.size(), &lower, nullptr, sel.data());
+    EvaluateEquality(isa, DOUBLE, cells.data(), cells.size(), &lower, sel.data());
+    ASSERT_TRUE(BitMapIsAllSet(sel.data(), 0, cells.size()));
+    EvaluateRange(isa, DOUBLE, cells.data(), cells.size(), nullptr, &upper, sel.data());
+    ASSERT_FALSE(BitmapFindFirstSet(sel.data(), 0, cells.size(), nullptr));
+  }
+}
+
+} // namespace column_predicate_kernels
+} // namespace kudu
@@ -0,0 +1,335 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/column_predicate_kernels.h"
+
+#include <nmmintrin.h>
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "kudu/common/column_predicate_kernels-internal.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/cpu.h"
+#include "kudu/util/bitmap.h"
+
+using std::vector;
+
+namespace kudu {
+namespace column_predicate_kernels {
+
+using internal::ApplyKernel;
+using internal::EqualityKernel;
+using internal::InListKernel;
+using internal::LoadValue;
+using internal::RangeKernel;
+using internal::kMaxVectorizedInListSize;
+
+namespace {
+
+// Compares one cell at a time. The comparisons are written in terms of '<'
+// only, to match GenericCompare() for floating point types.
+template<DataType Type>
+struct ScalarOps {
+  typedef typename DataTypeTraits<Type>::cpp_type T;
+  typedef T Vec;
+  typedef bool Mask;
+  static const int kLanes = 1;
+  static Vec Load(const T* cells) { return LoadValue<ScalarOps>(cells); }
+  static Vec Set1(T val) { return val; }
+  static Mask Ge(Vec a, Vec b) { return !(a < b); }
+  static Mask Lt(Vec a, Vec b) { return a < b; }
+  static Mask Eq(Vec a, Vec b) { return !(a < b) && !(b < a); }
+  static Mask And(Mask a, Mask b) { return a & b; }
+  static Mask Or(Mask a, Mask b) { return a | b; }
+  static uint32_t MoveMask(Mask m) { return m; }
+};
+
+////////////////////////////////////////////////////////////
+// SSE4.2 kernels
+////////////////////////////////////////////////////////////
+
+// Integer comparisons only come in a signed "greater than" flavor, from
+// which the others are derived.
+template<class Derived>
+struct SseIntOps {
+  typedef __m128i Vec;
+  typedef __m128i Mask;
+  static Vec Load(const void* cells) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells));
+  }
+  static Mask Ge(Vec a, Vec b) {
+    return _mm_xor_si128(Derived::Gt(b, a), _mm_set1_epi32(-1));
+  }
+  static Mask Lt(Vec a, Vec b) { return Derived::Gt(b, a); }
+  static Mask And(Mask a, Mask b) { return _mm_and_si128(a, b); }
+  static Mask Or(Mask a, Mask b) { return _mm_or_si128(a, b); }
+};
+
+struct SseInt8Ops : public SseIntOps<SseInt8Ops> {
+  typedef int8_t T;
+  static const int kLanes = 16;
+  static Vec Load(const T* cells) { return SseIntOps::Load(cells); }
+  static Vec Set1(T val) { return _mm_set1_epi8(val); }
+  static Mask Gt(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm_movemask_epi8(m); }
+};
+
+struct SseInt16Ops : public SseIntOps<SseInt16Ops> {
+  typedef int16_t T;
+  static const int kLanes = 8;
+  static Vec Load(const T* cells) { return SseIntOps::Load(cells); }
+  static Vec Set1(T val) { return _mm_set1_epi16(val); }
+  static Mask Gt(Vec a, Vec b) { return _mm_cmpgt_epi16(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm_cmpeq_epi16(a, b); }
+  static uint32_t MoveMask(Mask m) {
+    // Narrow each 16-bit lane to a byte so that there is one bit per lane.
+    return _mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128())) & 0xff;
+  }
+};
+
+struct SseInt32Ops : public SseIntOps<SseInt32Ops> {
+  typedef int32_t T;
+  static const int kLanes = 4;
+  static Vec Load(const T* cells) { return SseIntOps::Load(cells); }
+  static Vec Set1(T val) { return _mm_set1_epi32(val); }
+  static Mask Gt(Vec a, Vec b) { return _mm_cmpgt_epi32(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm_cmpeq_epi32(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm_movemask_ps(_mm_castsi128_ps(m)); }
+};
+
+struct SseInt64Ops : public SseIntOps<SseInt64Ops> {
+  typedef int64_t T;
+  static const int kLanes = 2;
+  static Vec Load(const T* cells) { return SseIntOps::Load(cells); }
+  static Vec Set1(T val) { return _mm_set1_epi64x(val); }
+  static Mask Gt(Vec a, Vec b) { return _mm_cmpgt_epi64(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm_cmpeq_epi64(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm_movemask_pd(_mm_castsi128_pd(m)); }
+};
+
+// The "not less than" comparisons are true for unordered (NaN) operands,
+// matching GenericCompare(), which treats NaN as equal to everything.
+struct SseFloatOps {
+  typedef float T;
+  typedef __m128 Vec;
+  typedef __m128 Mask;
+  static const int kLanes = 4;
+  static Vec Load(const T* cells) { return _mm_loadu_ps(cells); }
+  static Vec Set1(T val) { return _mm_set1_ps(val); }
+  static Mask Ge(Vec a, Vec b) { return _mm_cmpnlt_ps(a, b); }
+  static Mask Lt(Vec a, Vec b) { return _mm_cmplt_ps(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm_and_ps(_mm_cmpnlt_ps(a, b), _mm_cmpngt_ps(a, b)); }
+  static Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+  static Mask Or(Mask a, Mask b) { return _mm_or_ps(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm_movemask_ps(m); }
+};
+
+struct SseDoubleOps {
+  typedef double T;
+  typedef __m128d Vec;
+  typedef __m128d Mask;
+  static const int kLanes = 2;
+  static Vec Load(const T* cells) { return _mm_loadu_pd(cells); }
+  static Vec Set1(T val) { return _mm_set1_pd(val); }
+  static Mask Ge(Vec a, Vec b) { return _mm_cmpnlt_pd(a, b); }
+  static Mask Lt(Vec a, Vec b) { return _mm_cmplt_pd(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm_and_pd(_mm_cmpnlt_pd(a, b), _mm_cmpngt_pd(a, b)); }
+  static Mask And(Mask a, Mask b) { return _mm_and_pd(a, b); }
+  static Mask Or(Mask a, Mask b) { return _mm_or_pd(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm_movemask_pd(m); }
+};
+
+////////////////////////////////////////////////////////////
+// Dispatch
+////////////////////////////////////////////////////////////
+
+// Evaluates an InList predicate by binary search. Used for long lists, for
+// which comparing against every value would be slower.
+template<DataType Type>
+void InListSearchKernel(const void* cells, size_t nrows, const vector<const void*>& values,
+                        uint8_t* sel) {
+  typedef ScalarOps<Type> Ops;
+  typedef typename Ops::T T;
+  vector<T> vals;
+  vals.reserve(values.size());
+  for (const void* v : values) {
+    vals.push_back(LoadValue<Ops>(v));
+  }
+  ApplyKernel<Ops>(reinterpret_cast<const T*>(cells), nrows, [&] (T v) {
+      return std::binary_search(vals.begin(), vals.end(), v);
+    }, sel);
+}
+
+// Returns the SSE4.2 operations for the given type, or ScalarOps if there
+// are none.
+template<DataType Type> struct SseOpsFor { typedef ScalarOps<Type> type; };
+template<> struct SseOpsFor<INT8> { typedef SseInt8Ops type; };
+template<> struct SseOpsFor<INT16> { typedef SseInt16Ops type; };
+template<> struct SseOpsFor<INT32> { typedef SseInt32Ops type; };
+template<> struct SseOpsFor<INT64> { typedef SseInt64Ops type; };
+template<> struct SseOpsFor<FLOAT> { typedef SseFloatOps type; };
+template<> struct SseOpsFor<DOUBLE> { typedef SseDoubleOps type; };
+
+// Runs 'f.template Run<Type>()' for the physical type 'type'.
+template<class F>
+void DispatchOnType(DataType type, const F& f) {
+  switch (type) {
+    case BOOL: return f.template Run<BOOL>();
+    case INT8: return f.template Run<INT8>();
+    case INT16: return f.template Run<INT16>();
+    case INT32: return f.template Run<INT32>();
+    case INT64: return f.template Run<INT64>();
+    case UINT8: return f.template Run<UINT8>();
+    case UINT16: return f.template Run<UINT16>();
+    case UINT32: return f.template Run<UINT32>();
+    case UINT64: return f.template Run<UINT64>();
+    case FLOAT: return f.template Run<FLOAT>();
+    case DOUBLE: return f.template Run<DOUBLE>();
+    default: LOG(FATAL) << "unsupported physical type: " << type;
+  }
+}
+
+struct RangeFunctor {
+  template<DataType Type>
+  void Run() const {
+    if (isa == Isa::SCALAR) {
+      RangeKernel<ScalarOps<Type>>(cells, nrows, lower, upper, sel);
+    } else {
+      RangeKernel<typename SseOpsFor<Type>::type>(cells, nrows, lower, upper, sel);
+    }
+  }
+  Isa isa;
+  const void* cells;
+  size_t nrows;
+  const void* lower;
+  const void* upper;
+  uint8_t* sel;
+};
+
+struct EqualityFunctor {
+  template<DataType Type>
+  void Run() const {
+    if (isa == Isa::SCALAR) {
+      EqualityKernel<ScalarOps<Type>>(cells, nrows, value, sel);
+    } else {
+      EqualityKernel<typename SseOpsFor<Type>::type>(cells, nrows, value, sel);
+    }
+  }
+  Isa isa;
+  const void* cells;
+  size_t nrows;
+  const void* value;
+  uint8_t* sel;
+};
+
+struct InListFunctor {
+  template<DataType Type>
+  void Run() const {
+    if (values.size() > kMaxVectorizedInListSize) {
+      InListSearchKernel<Type>(cells, nrows, values, sel);
+    } else if (isa == Isa::SCALAR) {
+      InListKernel<ScalarOps<Type>>(cells, nrows, values.data(), values.size(), sel);
+    } else {
+      InListKernel<typename SseOpsFor<Type>::type>(cells, nrows, values.data(), values.size(),
+                                                    sel);
+    }
+  }
+  Isa isa;
+  const void* cells;
+  size_t nrows;
+  const vector<const void*>& values;
+  uint8_t* sel;
+};
+
+} // anonymous namespace
+
+bool IsaSupported(Isa isa) {
+  static const bool kHasAvx2 = base::CPU().has_avx2();
+  switch (isa) {
+    case Isa::SCALAR:
+    case Isa::SSE4_2:
+      return true;
+    case Isa::AVX2:
+      return kHasAvx2;
+  }
+  return false;
+}
+
+Isa BestSupportedIsa() {
+  return IsaSupported(Isa::AVX2) ? Isa::AVX2 : Isa::SSE4_2;
+}
+
+bool SupportsType(DataType physical_type) {
+  switch (physical_type) {
+    case BOOL:
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+    case UINT8:
+    case UINT16:
+    case UINT32:
+    case UINT64:
+    case FLOAT:
+    case DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void EvaluateRange(Isa isa, DataType physical_type, const void* cells, size_t nrows,
+                   const void* lower, const void* upper, uint8_t* sel) {
+  DCHECK(IsaSupported(isa));
+  DCHECK(lower != nullptr || upper != nullptr);
+  if (isa == Isa::AVX2 &&
+      internal::EvaluateRangeAvx2(physical_type, cells, nrows, lower, upper, sel)) {
+    return;
+  }
+  DispatchOnType(physical_type, RangeFunctor{ isa, cells, nrows, lower, upper, sel });
+}
+
+void EvaluateEquality(Isa isa, DataType physical_type, const void* cells, size_t nrows,
+                      const void* value, uint8_t* sel) {
+  DCHECK(IsaSupported(isa));
+  if (isa == Isa::AVX2 &&
+      internal::EvaluateEqualityAvx2(physical_type, cells, nrows, value, sel)) {
+    return;
+  }
+  DispatchOnType(physical_type, EqualityFunctor{ isa, cells, nrows, value, sel });
+}
+
+void EvaluateInList(Isa isa, DataType physical_type, const void* cells, size_t nrows,
+                    const vector<const void*>& values, uint8_t* sel) {
+  DCHECK(IsaSupported(isa));
+  if (values.empty()) {
+    BitmapChangeBits(sel, 0, nrows, false);
+    return;
+  }
+  if (isa == Isa::AVX2 && values.size() <= kMaxVectorizedInListSize &&
+      internal::EvaluateInListAvx2(physical_type, cells, nrows, values.data(), values.size(),
+                                   sel)) {
+    return;
+  }
+  DispatchOnType(physical_type, InListFunctor{ isa, cells, nrows, values, sel });
+}
+
+} // namespace column_predicate_kernels
+} // namespace kudu
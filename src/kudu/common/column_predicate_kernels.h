@@ -0,0 +1,81 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Batch kernels which evaluate a column predicate over a whole block of
+// fixed-width cells, producing selection vector bytes directly rather than
+// clearing one bit per row.
+//
+// Each kernel ANDs its result into 'sel', a bitmap with one bit per cell,
+// and never sets a bit. Bits of 'sel' past 'nrows' are left untouched. The
+// cells of NULL rows are evaluated like any other, so callers must clear
+// their bits separately.
+//
+// The comparison semantics match DataTypeTraits<Type>::Compare() exactly,
+// including its treatment of floating point NaNs.
+#ifndef KUDU_COMMON_COLUMN_PREDICATE_KERNELS_H
+#define KUDU_COMMON_COLUMN_PREDICATE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kudu/common/common.pb.h"
+
+namespace kudu {
+namespace column_predicate_kernels {
+
+// The instruction sets for which kernels are available.
+enum class Isa {
+  // Portable code which compares one cell at a time, but still builds whole
+  // selection vector bytes.
+  SCALAR,
+  // 128-bit SSE4.2 vectors. Kudu requires SSE4.2, so this is always
+  // available.
+  SSE4_2,
+  // 256-bit AVX2 vectors.
+  AVX2,
+};
+
+// Returns the most capable instruction set supported by the current CPU.
+Isa BestSupportedIsa();
+
+// Returns true if the current CPU supports 'isa'.
+bool IsaSupported(Isa isa);
+
+// Returns true if the kernels can evaluate cells of the given physical type.
+// All fixed-width types are supported, but only INT8, INT16, INT32, INT64,
+// FLOAT and DOUBLE are vectorized; other types use the SCALAR kernels.
+bool SupportsType(DataType physical_type);
+
+// Clears the bits of rows whose cells do not satisfy 'lower <= cell < upper'.
+// Either bound may be NULL, in which case it is unbounded.
+void EvaluateRange(Isa isa, DataType physical_type, const void* cells, size_t nrows,
+                   const void* lower, const void* upper, uint8_t* sel);
+
+// Clears the bits of rows whose cells are not equal to 'value'.
+void EvaluateEquality(Isa isa, DataType physical_type, const void* cells, size_t nrows,
+                      const void* value, uint8_t* sel);
+
+// Clears the bits of rows whose cells are not equal to any of 'values', which
+// must be sorted in ascending order.
+void EvaluateInList(Isa isa, DataType physical_type, const void* cells, size_t nrows,
+                    const std::vector<const void*>& values, uint8_t* sel);
+
+} // namespace column_predicate_kernels
+} // namespace kudu
+
+#endif // KUDU_COMMON_COLUMN_PREDICATE_KERNELS_H
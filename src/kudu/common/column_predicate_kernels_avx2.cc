@@ -0,0 +1,166 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// AVX2 predicate kernels. This file is compiled with -mavx2, so nothing in
+// it may be called unless the CPU is known to support AVX2 (see
+// column_predicate_kernels::IsaSupported()).
+
+#include <immintrin.h>
+
+#include "kudu/common/column_predicate_kernels-internal.h"
+
+namespace kudu {
+namespace column_predicate_kernels {
+namespace internal {
+
+namespace {
+
+template<class Derived>
+struct Avx2IntOps {
+  typedef __m256i Vec;
+  typedef __m256i Mask;
+  static Vec Load(const void* cells) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells));
+  }
+  static Mask Ge(Vec a, Vec b) {
+    return _mm256_xor_si256(Derived::Gt(b, a), _mm256_set1_epi32(-1));
+  }
+  static Mask Lt(Vec a, Vec b) { return Derived::Gt(b, a); }
+  static Mask And(Mask a, Mask b) { return _mm256_and_si256(a, b); }
+  static Mask Or(Mask a, Mask b) { return _mm256_or_si256(a, b); }
+};
+
+struct Avx2Int8Ops : public Avx2IntOps<Avx2Int8Ops> {
+  typedef int8_t T;
+  static const int kLanes = 32;
+  static Vec Load(const T* cells) { return Avx2IntOps::Load(cells); }
+  static Vec Set1(T val) { return _mm256_set1_epi8(val); }
+  static Mask Gt(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm256_movemask_epi8(m); }
+};
+
+struct Avx2Int16Ops : public Avx2IntOps<Avx2Int16Ops> {
+  typedef int16_t T;
+  static const int kLanes = 16;
+  static Vec Load(const T* cells) { return Avx2IntOps::Load(cells); }
+  static Vec Set1(T val) { return _mm256_set1_epi16(val); }
+  static Mask Gt(Vec a, Vec b) { return _mm256_cmpgt_epi16(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm256_cmpeq_epi16(a, b); }
+  static uint32_t MoveMask(Mask m) {
+    // Narrowing packs within each 128-bit half, so the results for lanes
+    // 0-7 land in bits 0-7 and those for lanes 8-15 in bits 16-23.
+    uint32_t bits = _mm256_movemask_epi8(_mm256_packs_epi16(m, _mm256_setzero_si256()));
+    return (bits & 0xff) | ((bits >> 8) & 0xff00);
+  }
+};
+
+struct Avx2Int32Ops : public Avx2IntOps<Avx2Int32Ops> {
+  typedef int32_t T;
+  static const int kLanes = 8;
+  static Vec Load(const T* cells) { return Avx2IntOps::Load(cells); }
+  static Vec Set1(T val) { return _mm256_set1_epi32(val); }
+  static Mask Gt(Vec a, Vec b) { return _mm256_cmpgt_epi32(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm256_cmpeq_epi32(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm256_movemask_ps(_mm256_castsi256_ps(m)); }
+};
+
+struct Avx2Int64Ops : public Avx2IntOps<Avx2Int64Ops> {
+  typedef int64_t T;
+  static const int kLanes = 4;
+  static Vec Load(const T* cells) { return Avx2IntOps::Load(cells); }
+  static Vec Set1(T val) { return _mm256_set1_epi64x(val); }
+  static Mask Gt(Vec a, Vec b) { return _mm256_cmpgt_epi64(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm256_cmpeq_epi64(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm256_movemask_pd(_mm256_castsi256_pd(m)); }
+};
+
+// See SseFloatOps for the handling of NaNs.
+struct Avx2FloatOps {
+  typedef float T;
+  typedef __m256 Vec;
+  typedef __m256 Mask;
+  static const int kLanes = 8;
+  static Vec Load(const T* cells) { return _mm256_loadu_ps(cells); }
+  static Vec Set1(T val) { return _mm256_set1_ps(val); }
+  static Mask Ge(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_NLT_UQ); }
+  static Mask Lt(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static Mask Eq(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_EQ_UQ); }
+  static Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+  static Mask Or(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm256_movemask_ps(m); }
+};
+
+struct Avx2DoubleOps {
+  typedef double T;
+  typedef __m256d Vec;
+  typedef __m256d Mask;
+  static const int kLanes = 4;
+  static Vec Load(const T* cells) { return _mm256_loadu_pd(cells); }
+  static Vec Set1(T val) { return _mm256_set1_pd(val); }
+  static Mask Ge(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_NLT_UQ); }
+  static Mask Lt(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+  static Mask Eq(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_EQ_UQ); }
+  static Mask And(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+  static Mask Or(Mask a, Mask b) { return _mm256_or_pd(a, b); }
+  static uint32_t MoveMask(Mask m) { return _mm256_movemask_pd(m); }
+};
+
+} // anonymous namespace
+
+bool EvaluateRangeAvx2(DataType physical_type, const void* cells, size_t nrows,
+                       const void* lower, const void* upper, uint8_t* sel) {
+  switch (physical_type) {
+    case INT8: RangeKernel<Avx2Int8Ops>(cells, nrows, lower, upper, sel); return true;
+    case INT16: RangeKernel<Avx2Int16Ops>(cells, nrows, lower, upper, sel); return true;
+    case INT32: RangeKernel<Avx2Int32Ops>(cells, nrows, lower, upper, sel); return true;
+    case INT64: RangeKernel<Avx2Int64Ops>(cells, nrows, lower, upper, sel); return true;
+    case FLOAT: RangeKernel<Avx2FloatOps>(cells, nrows, lower, upper, sel); return true;
+    case DOUBLE: RangeKernel<Avx2DoubleOps>(cells, nrows, lower, upper, sel); return true;
+    default: return false;
+  }
+}
+
+bool EvaluateEqualityAvx2(DataType physical_type, const void* cells, size_t nrows,
+                          const void* value, uint8_t* sel) {
+  switch (physical_type) {
+    case INT8: EqualityKernel<Avx2Int8Ops>(cells, nrows, value, sel); return true;
+    case INT16: EqualityKernel<Avx2Int16Ops>(cells, nrows, value, sel); return true;
+    case INT32: EqualityKernel<Avx2Int32Ops>(cells, nrows, value, sel); return true;
+    case INT64: EqualityKernel<Avx2Int64Ops>(cells, nrows, value, sel); return true;
+    case FLOAT: EqualityKernel<Avx2FloatOps>(cells, nrows, value, sel); return true;
+    case DOUBLE: EqualityKernel<Avx2DoubleOps>(cells, nrows, value, sel); return true;
+    default: return false;
+  }
+}
+
+bool EvaluateInListAvx2(DataType physical_type, const void* cells, size_t nrows,
+                        const void* const* values, size_t num_values, uint8_t* sel) {
+  switch (physical_type) {
+    case INT8: InListKernel<Avx2Int8Ops>(cells, nrows, values, num_values, sel); return true;
+    case INT16: InListKernel<Avx2Int16Ops>(cells, nrows, values, num_values, sel); return true;
+    case INT32: InListKernel<Avx2Int32Ops>(cells, nrows, values, num_values, sel); return true;
+    case INT64: InListKernel<Avx2Int64Ops>(cells, nrows, values, num_values, sel); return true;
+    case FLOAT: InListKernel<Avx2FloatOps>(cells, nrows, values, num_values, sel); return true;
+    case DOUBLE: InListKernel<Avx2DoubleOps>(cells, nrows, values, num_values, sel); return true;
+    default: return false;
+  }
+}
+
+} // namespace internal
+} // namespace column_predicate_kernels
+} // namespace kudu
@@ -29,9 +29,12 @@
 #include "kudu/common/schema.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/mathlimits.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(num_lists, 3, "Number of lists to merge");
 DEFINE_int32(num_rows, 1000, "Number of entries per list");
@@ -50,7 +53,8 @@ class VectorIterator : public ColumnwiseIterator {
   explicit VectorIterator(vector<uint32_t> ints)
       : ints_(std::move(ints)),
         cur_idx_(0),
-        block_size_(ints_.size()) {
+        block_size_(ints_.size()),
+        start_latch_(nullptr) {
   }
 
   // Set the number of rows that will be returned in each
@@ -59,11 +63,24 @@ class VectorIterator : public ColumnwiseIterator {
     block_size_ = block_size;
   }
 
+  // Make each call to PrepareBatch() wait for 'latch' first.
+  void set_start_latch(CountDownLatch* latch) {
+    start_latch_ = latch;
+  }
+
+  // The index of the next row to be returned.
+  int64_t cur_idx() const {
+    return cur_idx_;
+  }
+
   Status Init(ScanSpec *spec) OVERRIDE {
     return Status::OK();
   }
 
   virtual Status PrepareBatch(size_t* nrows) OVERRIDE {
+    if (start_latch_ != nullptr) {
+      start_latch_->Wait();
+    }
     prepared_ = std::min<int64_t>({
         static_cast<int64_t>(ints_.size()) - cur_idx_,
         block_size_,
@@ -108,6 +125,7 @@ class VectorIterator : public ColumnwiseIterator {
 
   virtual void GetIteratorStats(vector<IteratorStats>* stats) const OVERRIDE {
     stats->resize(schema().num_columns());
+    (*stats)[0].cells_read_from_disk = cur_idx_;
   }
 
  private:
@@ -115,6 +133,7 @@ class VectorIterator : public ColumnwiseIterator {
   int cur_idx_;
   int block_size_;
   size_t prepared_;
+  CountDownLatch* start_latch_;
 };
 
 // Test that empty input to a merger behaves correctly.
@@ -307,6 +326,143 @@ TEST(TestPredicateEvaluatingIterator, TestPredicateEvaluation) {
   ASSERT_FALSE(dst.selection_vector()->IsRowSelected(30));
 }
 
+// Test that a parallel union yields exactly the rows of its iterators which
+// pass the predicates, in some order.
+TEST(TestParallelUnionIterator, TestParallelUnion) {
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("scan").set_max_threads(4).Build(&pool));
+
+  TestIntRangePredicate predicate(FLAGS_num_rows / 4, FLAGS_num_rows);
+  ScanSpec spec;
+  spec.AddPredicate(predicate.pred_);
+
+  vector<shared_ptr<RowwiseIterator>> to_union;
+  vector<uint32_t> expected;
+  for (int i = 0; i < 10; i++) {
+    vector<uint32_t> ints;
+    for (int j = 0; j < FLAGS_num_rows; j++) {
+      uint32_t entry = rand() % (2 * FLAGS_num_rows);
+      ints.push_back(entry);
+      if (entry >= predicate.lower_ && entry < predicate.upper_) {
+        expected.push_back(entry);
+      }
+    }
+    shared_ptr<VectorIterator> it(new VectorIterator(ints));
+    it->set_block_size(10);
+    to_union.emplace_back(new MaterializingIterator(it));
+  }
+  std::sort(expected.begin(), expected.end());
+
+  ParallelUnionIterator iter(to_union, pool.get(), 3);
+  ASSERT_OK(iter.Init(&spec));
+  ASSERT_TRUE(spec.predicates().empty()) << "should have accepted all predicates";
+
+  RowBlock dst(kIntSchema, 100, nullptr);
+  vector<uint32_t> results;
+  while (iter.HasNext()) {
+    ASSERT_OK(iter.NextBlock(&dst));
+    for (int i = 0; i < dst.nrows(); i++) {
+      ASSERT_TRUE(dst.selection_vector()->IsRowSelected(i));
+      results.push_back(*kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0));
+    }
+  }
+  std::sort(results.begin(), results.end());
+  ASSERT_EQ(expected, results);
+
+  vector<IteratorStats> stats;
+  iter.GetIteratorStats(&stats);
+  ASSERT_EQ(kIntSchema.num_columns(), stats.size());
+}
+
+// Test that the stats of a parallel union can be fetched while one of its
+// groups is still being read, and that they cover every group once the scan
+// is done.
+TEST(TestParallelUnionIterator, TestStatsDuringScan) {
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("scan").set_max_threads(4).Build(&pool));
+
+  const int kRowsPerIter = 100;
+  CountDownLatch latch(1);
+  vector<shared_ptr<RowwiseIterator>> to_union;
+  for (int i = 0; i < 2; i++) {
+    shared_ptr<VectorIterator> it(new VectorIterator(vector<uint32_t>(kRowsPerIter, i)));
+    it->set_block_size(10);
+    if (i == 1) {
+      it->set_start_latch(&latch);
+    }
+    to_union.emplace_back(new MaterializingIterator(it));
+  }
+
+  ParallelUnionIterator iter(to_union, pool.get(), 2);
+  // Unblock the second group before the iterator waits for it on destruction.
+  auto unblock = MakeScopedCleanup([&] () { latch.CountDown(); });
+  ASSERT_OK(iter.Init(nullptr));
+  RowBlock dst(kIntSchema, 100, nullptr);
+  ASSERT_OK(iter.NextBlock(&dst));
+  ASSERT_GT(dst.nrows(), 0);
+
+  // The second group is blocked, so it hasn't read any rows yet.
+  vector<IteratorStats> stats;
+  iter.GetIteratorStats(&stats);
+  ASSERT_EQ(1, stats.size());
+  ASSERT_GT(stats[0].cells_read_from_disk, 0);
+  ASSERT_LE(stats[0].cells_read_from_disk, kRowsPerIter);
+
+  latch.CountDown();
+  int64_t num_rows = dst.nrows();
+  while (iter.HasNext()) {
+    ASSERT_OK(iter.NextBlock(&dst));
+    num_rows += dst.nrows();
+  }
+  ASSERT_EQ(2 * kRowsPerIter, num_rows);
+  stats.clear();
+  iter.GetIteratorStats(&stats);
+  ASSERT_EQ(2 * kRowsPerIter, stats[0].cells_read_from_disk);
+}
+
+// Test that destroying the iterator in the middle of a scan waits for the
+// tasks reading its groups, which refer to the scan spec it owns.
+TEST(TestParallelUnionIterator, TestDestroyDuringScan) {
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("scan").set_max_threads(4).Build(&pool));
+
+  vector<shared_ptr<VectorIterator>> vector_iters;
+  for (int n = 0; n < 20; n++) {
+    vector<shared_ptr<RowwiseIterator>> to_union;
+    vector_iters.clear();
+    for (int i = 0; i < 8; i++) {
+      vector<uint32_t> ints(FLAGS_num_rows * 10);
+      for (int j = 0; j < ints.size(); j++) {
+        ints[j] = j;
+      }
+      shared_ptr<VectorIterator> it(new VectorIterator(ints));
+      it->set_block_size(10);
+      vector_iters.push_back(it);
+      to_union.emplace_back(new MaterializingIterator(it));
+    }
+
+    {
+      TestIntRangePredicate predicate(0, FLAGS_num_rows);
+      ScanSpec spec;
+      spec.AddPredicate(predicate.pred_);
+      ParallelUnionIterator iter(to_union, pool.get(), 4);
+      ASSERT_OK(iter.Init(&spec));
+      RowBlock dst(kIntSchema, 100, nullptr);
+      ASSERT_OK(iter.NextBlock(&dst));
+    }
+
+    // No task may read the groups once the iterator is gone.
+    vector<int64_t> positions;
+    for (const auto& it : vector_iters) {
+      positions.push_back(it->cur_idx());
+    }
+    pool->Wait();
+    for (int i = 0; i < vector_iters.size(); i++) {
+      ASSERT_EQ(positions[i], vector_iters[i]->cur_idx());
+    }
+  }
+}
+
 // Test that PredicateEvaluatingIterator::InitAndMaybeWrap doesn't wrap an underlying
 // iterator when there are no predicates left.
 TEST(TestPredicateEvaluatingIterator, TestDontWrapWhenNoPredicates) {
@@ -16,6 +16,8 @@
 // under the License.
 
 #include <algorithm>
+#include <boost/bind.hpp>
+#include <deque>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -29,10 +31,14 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/condition_variable.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/threadpool.h"
 
 using std::all_of;
+using std::deque;
 using std::get;
 using std::move;
 using std::remove_if;
@@ -49,6 +55,11 @@ DEFINE_bool(materializing_iterator_decoder_eval, true,
             "Should MaterializingIterator do decoder-level evaluation");
 TAG_FLAG(materializing_iterator_decoder_eval, hidden);
 TAG_FLAG(materializing_iterator_decoder_eval, runtime);
+DEFINE_bool(materializing_iterator_late_materialization, true,
+            "Should MaterializingIterator skip decoding the non-predicate columns "
+            "of rows which don't pass the scan's predicates");
+TAG_FLAG(materializing_iterator_late_materialization, hidden);
+TAG_FLAG(materializing_iterator_late_materialization, runtime);
 
 namespace kudu {
 
@@ -436,6 +447,347 @@ void UnionIterator::GetIteratorStats(std::vector<IteratorStats>* stats) const {
   }
 }
 
+////////////////////////////////////////////////////////////
+// Parallel union iterator
+////////////////////////////////////////////////////////////
+
+// The number of rows in each block read by a ParallelUnionIterator's tasks.
+static const size_t kParallelUnionBlockRows = 1000;
+
+class ParallelUnionState : public std::enable_shared_from_this<ParallelUnionState> {
+ public:
+  ParallelUnionState(ThreadPool* pool, const vector<shared_ptr<RowwiseIterator> >& groups)
+      : pool_(pool),
+        max_buffered_(2 * groups.size()),
+        cond_(&lock_),
+        num_running_(0),
+        num_reading_(0),
+        stopped_(false) {
+    for (const auto& group : groups) {
+      groups_.emplace_back(group);
+    }
+  }
+
+  Status Init(ScanSpec* spec, ObjectPool<ScanSpec>* scan_spec_copies) {
+    for (Group& group : groups_) {
+      ScanSpec *spec_copy = spec != nullptr ? scan_spec_copies->Construct(*spec) : nullptr;
+      RETURN_NOT_OK(group.iter->Init(spec_copy));
+    }
+    schema_.reset(new Schema(groups_.front().iter->schema()));
+    for (Group& group : groups_) {
+      if (!group.iter->schema().Equals(*schema_)) {
+        return Status::InvalidArgument(
+          string("Schemas do not match: ") + schema_->ToString()
+          + " vs " + group.iter->schema().ToString());
+      }
+      group.exhausted = !group.iter->HasNext();
+      group.iter->GetIteratorStats(&group.stats);
+    }
+    return Status::OK();
+  }
+
+  const Schema& schema() const {
+    return *schema_;
+  }
+
+  bool HasNext() const {
+    if (cur_block_ && cur_block_->next_row < cur_block_->block.nrows()) {
+      return true;
+    }
+    MutexLock l(lock_);
+    if (!ready_.empty() || num_running_ > 0) {
+      return true;
+    }
+    for (const Group& group : groups_) {
+      if (!group.exhausted) return true;
+    }
+    return false;
+  }
+
+  Status NextBlock(RowBlock* dst) {
+    if (!cur_block_ || cur_block_->next_row == cur_block_->block.nrows()) {
+      MutexLock l(lock_);
+      if (cur_block_) {
+        free_.emplace_back(std::move(cur_block_));
+      }
+      while (true) {
+        RETURN_NOT_OK(status_);
+        if (!ready_.empty()) {
+          cur_block_ = std::move(ready_.front());
+          ready_.pop_front();
+          break;
+        }
+        ScheduleUnlocked();
+        if (num_running_ == 0) {
+          // Every group is exhausted.
+          dst->Resize(0);
+          return Status::OK();
+        }
+        cond_.Wait();
+      }
+      // Refill the slot which was just freed up.
+      ScheduleUnlocked();
+    }
+
+    // Copy out the selected rows, relocating their indirect data to the
+    // destination's arena.
+    if (dst->arena() != nullptr) {
+      dst->arena()->Reset();
+    }
+    const RowBlock& src = cur_block_->block;
+    const SelectionVector* sel = src.selection_vector();
+    dst->Resize(dst->row_capacity());
+    size_t n = 0;
+    while (cur_block_->next_row < src.nrows() && n < dst->row_capacity()) {
+      size_t i = cur_block_->next_row++;
+      if (!sel->IsRowSelected(i)) continue;
+      RowBlockRow dst_row = dst->row(n++);
+      RETURN_NOT_OK(CopyRow(src.row(i), &dst_row, dst->arena()));
+    }
+    dst->Resize(n);
+    dst->selection_vector()->SetAllTrue();
+    return Status::OK();
+  }
+
+  // Returns the sum of the groups' stats as of their last completed reads.
+  // The groups' iterators can't be looked at while tasks read them, so this
+  // doesn't include the reads in progress.
+  void GetIteratorStats(vector<IteratorStats>* stats) const {
+    MutexLock l(lock_);
+    for (size_t idx = 0; idx < schema_->num_columns(); ++idx) {
+      IteratorStats stats_for_col;
+      for (const Group& group : groups_) {
+        stats_for_col.AddStats(group.stats[idx]);
+      }
+      stats->push_back(stats_for_col);
+    }
+  }
+
+  // Stops scheduling tasks, and waits for the tasks which are reading a
+  // group to finish. Called when the iterator is destroyed, since the groups'
+  // iterators may refer to the scan spec and projection it owns. Tasks which
+  // are still queued find the state stopped and return without reading.
+  void Stop() {
+    MutexLock l(lock_);
+    stopped_ = true;
+    while (num_reading_ > 0) {
+      cond_.Wait();
+    }
+  }
+
+ private:
+  // A block of rows read by a task.
+  struct Block {
+    explicit Block(const Schema& schema)
+        : arena(32 * 1024, 1 * 1024 * 1024),
+          block(schema, kParallelUnionBlockRows, &arena),
+          next_row(0) {
+    }
+
+    Arena arena;
+    RowBlock block;
+
+    // The index of the next row of 'block' to be copied out.
+    size_t next_row;
+  };
+
+  struct Group {
+    explicit Group(shared_ptr<RowwiseIterator> iter)
+        : iter(std::move(iter)),
+          running(false),
+          exhausted(false) {
+    }
+
+    shared_ptr<RowwiseIterator> iter;
+
+    // Whether a task is reading the group.
+    bool running;
+
+    // Whether the group has no more rows.
+    bool exhausted;
+
+    // The stats of 'iter' as of its last completed read.
+    vector<IteratorStats> stats;
+  };
+
+  // Submits tasks to read the groups which aren't exhausted or being read
+  // already, as long as there's room for their blocks.
+  //
+  // 'lock_' must be held.
+  void ScheduleUnlocked() {
+    lock_.AssertAcquired();
+    if (stopped_) {
+      return;
+    }
+    for (Group& group : groups_) {
+      if (!status_.ok() || ready_.size() + num_running_ >= max_buffered_) {
+        return;
+      }
+      if (group.running || group.exhausted) {
+        continue;
+      }
+      Block* block;
+      if (free_.empty()) {
+        block = new Block(*schema_);
+      } else {
+        block = free_.back().release();
+        free_.pop_back();
+      }
+      block->next_row = 0;
+      Status s = pool_->SubmitFunc(boost::bind(&ParallelUnionState::ReadBlock,
+                                               shared_from_this(), &group, block));
+      if (!s.ok()) {
+        delete block;
+        status_ = s.CloneAndPrepend("could not schedule a parallel scan task");
+        return;
+      }
+      group.running = true;
+      num_running_++;
+    }
+  }
+
+  // Reads the next block of 'group' into 'block', which the task takes
+  // ownership of.
+  void ReadBlock(Group* group, Block* block) {
+    unique_ptr<Block> owned(block);
+    {
+      MutexLock l(lock_);
+      if (stopped_) {
+        group->running = false;
+        num_running_--;
+        cond_.Broadcast();
+        return;
+      }
+      num_reading_++;
+    }
+    Status s = group->iter->NextBlock(&owned->block);
+    vector<IteratorStats> stats;
+    group->iter->GetIteratorStats(&stats);
+
+    MutexLock l(lock_);
+    group->stats.swap(stats);
+    group->running = false;
+    num_running_--;
+    if (!s.ok()) {
+      if (status_.ok()) {
+        status_ = s;
+      }
+    } else {
+      group->exhausted = !group->iter->HasNext();
+      if (owned->block.selection_vector()->AnySelected()) {
+        ready_.emplace_back(std::move(owned));
+      } else {
+        free_.emplace_back(std::move(owned));
+      }
+    }
+    num_reading_--;
+    ScheduleUnlocked();
+    cond_.Broadcast();
+  }
+
+  ThreadPool* const pool_;
+  const size_t max_buffered_;
+
+  gscoped_ptr<Schema> schema_;
+
+  // The block whose rows are being copied out by NextBlock(). Only accessed
+  // by the iterator's thread.
+  unique_ptr<Block> cur_block_;
+
+  mutable Mutex lock_;
+  mutable ConditionVariable cond_;
+
+  // The groups of iterators. Fixed in size after construction.
+  vector<Group> groups_;
+
+  // Blocks which have been read, in the order they were completed.
+  deque<unique_ptr<Block> > ready_;
+
+  // Blocks which may be reused.
+  vector<unique_ptr<Block> > free_;
+
+  // The number of tasks which are running or queued.
+  size_t num_running_;
+
+  // The number of tasks which are reading a group's iterator.
+  size_t num_reading_;
+
+  // The first error returned by a group.
+  Status status_;
+
+  bool stopped_;
+};
+
+ParallelUnionIterator::ParallelUnionIterator(const vector<shared_ptr<RowwiseIterator> >& iters,
+                                             ThreadPool* pool,
+                                             int parallelism)
+  : initted_(false) {
+  CHECK_GT(iters.size(), 0);
+  CHECK_GT(parallelism, 0);
+  // Deal the iterators out to the groups in turn, so that each group gets a
+  // similar number of them.
+  size_t num_groups = std::min<size_t>(parallelism, iters.size());
+  vector<vector<shared_ptr<RowwiseIterator> > > iters_by_group(num_groups);
+  for (size_t i = 0; i < iters.size(); i++) {
+    iters_by_group[i % num_groups].push_back(iters[i]);
+  }
+  vector<shared_ptr<RowwiseIterator> > groups;
+  for (const auto& group_iters : iters_by_group) {
+    groups.emplace_back(new UnionIterator(group_iters));
+  }
+  state_ = std::make_shared<ParallelUnionState>(pool, groups);
+  description_ = "ParallelUnion(";
+  bool first = true;
+  for (const auto& group : groups) {
+    if (!first) {
+      description_.append(", ");
+    }
+    first = false;
+    description_.append(group->ToString());
+  }
+  description_.append(")");
+}
+
+ParallelUnionIterator::~ParallelUnionIterator() {
+  // Tasks which are still queued hold their own references to the state.
+  state_->Stop();
+}
+
+Status ParallelUnionIterator::Init(ScanSpec *spec) {
+  CHECK(!initted_);
+  RETURN_NOT_OK(state_->Init(spec, &scan_spec_copies_));
+  // The groups evaluate all of the predicates.
+  if (spec != nullptr) {
+    spec->RemovePredicates();
+  }
+  initted_ = true;
+  return Status::OK();
+}
+
+bool ParallelUnionIterator::HasNext() const {
+  CHECK(initted_);
+  return state_->HasNext();
+}
+
+Status ParallelUnionIterator::NextBlock(RowBlock* dst) {
+  CHECK(initted_);
+  return state_->NextBlock(dst);
+}
+
+string ParallelUnionIterator::ToString() const {
+  return description_;
+}
+
+const Schema& ParallelUnionIterator::schema() const {
+  CHECK(initted_);
+  return state_->schema();
+}
+
+void ParallelUnionIterator::GetIteratorStats(vector<IteratorStats>* stats) const {
+  CHECK(initted_);
+  state_->GetIteratorStats(stats);
+}
+
 ////////////////////////////////////////////////////////////
 // Materializing iterator
 ////////////////////////////////////////////////////////////
@@ -443,7 +795,8 @@ void UnionIterator::GetIteratorStats(std::vector<IteratorStats>* stats) const {
 MaterializingIterator::MaterializingIterator(shared_ptr<ColumnwiseIterator> iter)
     : iter_(move(iter)),
       disallow_pushdown_for_tests_(!FLAGS_materializing_iterator_do_pushdown),
-      disallow_decoder_eval_(!FLAGS_materializing_iterator_decoder_eval) {
+      disallow_decoder_eval_(!FLAGS_materializing_iterator_decoder_eval),
+      late_materialization_(FLAGS_materializing_iterator_late_materialization) {
 }
 
 Status MaterializingIterator::Init(ScanSpec *spec) {
@@ -525,7 +878,10 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
                                      dst->selection_vector());
     // None predicates should be short-circuited in scan spec.
     DCHECK(ctx.pred()->predicate_type() != PredicateType::None);
-    if (disallow_decoder_eval_) {
+    // IS NULL predicates only select NULL cells, which the decoders never
+    // see, so they are always evaluated on the materialized block.
+    if (disallow_decoder_eval_ ||
+        ctx.pred()->predicate_type() == PredicateType::IsNull) {
       ctx.SetDecoderEvalNotSupported();
     }
     RETURN_NOT_OK(iter_->MaterializeColumn(&ctx));
@@ -548,6 +904,11 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
                                      nullptr,
                                      &dst_col,
                                      dst->selection_vector());
+    // Once the predicates have filtered out rows, only the remaining rows
+    // need to be decoded.
+    if (late_materialization_ && !col_idx_predicates_.empty()) {
+      ctx.SetSkipUnselectedRows();
+    }
     RETURN_NOT_OK(iter_->MaterializeColumn(&ctx));
   }
 
@@ -33,6 +33,7 @@ namespace kudu {
 
 class Arena;
 class MergeIterState;
+class ThreadPool;
 
 // An iterator which merges the results of other iterators, comparing
 // based on keys.
@@ -132,6 +133,53 @@ class UnionIterator : public RowwiseIterator {
   ObjectPool<ScanSpec> scan_spec_copies_;
 };
 
+class ParallelUnionState;
+
+// An iterator which, like UnionIterator, yields the rows of other iterators in
+// no particular order, but reads several of them at once on the threads of
+// 'pool'.
+//
+// The iterators are split into 'parallelism' groups, each of which is read by
+// at most one task at a time. The tasks decode and evaluate predicates into
+// blocks of their own, and NextBlock() copies the rows of the completed
+// blocks into its destination. A bounded number of blocks are buffered ahead
+// of the caller.
+//
+// The same requirements as for UnionIterator apply to the passed-in
+// iterators.
+class ParallelUnionIterator : public RowwiseIterator {
+ public:
+  ParallelUnionIterator(const std::vector<std::shared_ptr<RowwiseIterator> >& iters,
+                        ThreadPool* pool,
+                        int parallelism);
+  virtual ~ParallelUnionIterator();
+
+  Status Init(ScanSpec *spec) OVERRIDE;
+
+  bool HasNext() const OVERRIDE;
+
+  string ToString() const OVERRIDE;
+
+  const Schema &schema() const OVERRIDE;
+
+  virtual void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE;
+
+  virtual Status NextBlock(RowBlock* dst) OVERRIDE;
+
+ private:
+  // The state shared with the tasks, which may outlive the iterator if it's
+  // destroyed while they run.
+  std::shared_ptr<ParallelUnionState> state_;
+
+  bool initted_;
+
+  // Describes the groups, since they can't be looked at while tasks run.
+  string description_;
+
+  // See UnionIterator.
+  ObjectPool<ScanSpec> scan_spec_copies_;
+};
+
 // An iterator which wraps a ColumnwiseIterator, materializing it into full rows.
 //
 // Column predicates are pushed down into this iterator. While materializing a
@@ -176,6 +224,10 @@ class MaterializingIterator : public RowwiseIterator {
   // Set only by test code to disallow pushdown.
   bool disallow_pushdown_for_tests_;
   bool disallow_decoder_eval_;
+
+  // Whether to skip materializing the non-predicate columns of rows which
+  // were filtered out by the predicates.
+  bool late_materialization_;
 };
 
 // An iterator which wraps another iterator and evaluates any predicates that the
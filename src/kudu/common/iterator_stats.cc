@@ -28,22 +28,30 @@ using strings::Substitute;
 IteratorStats::IteratorStats()
     : data_blocks_read_from_disk(0),
       bytes_read_from_disk(0),
-      cells_read_from_disk(0) {
+      cells_read_from_disk(0),
+      readahead_hits(0),
+      readahead_bytes_wasted(0) {
 }
 
 string IteratorStats::ToString() const {
   return Substitute("data_blocks_read_from_disk=$0 "
                     "bytes_read_from_disk=$1 "
-                    "cells_read_from_disk=$2",
+                    "cells_read_from_disk=$2 "
+                    "readahead_hits=$3 "
+                    "readahead_bytes_wasted=$4",
                     data_blocks_read_from_disk,
                     bytes_read_from_disk,
-                    cells_read_from_disk);
+                    cells_read_from_disk,
+                    readahead_hits,
+                    readahead_bytes_wasted);
 }
 
 void IteratorStats::AddStats(const IteratorStats& other) {
   data_blocks_read_from_disk += other.data_blocks_read_from_disk;
   bytes_read_from_disk += other.bytes_read_from_disk;
   cells_read_from_disk += other.cells_read_from_disk;
+  readahead_hits += other.readahead_hits;
+  readahead_bytes_wasted += other.readahead_bytes_wasted;
   DCheckNonNegative();
 }
 
@@ -51,6 +59,8 @@ void IteratorStats::SubtractStats(const IteratorStats& other) {
   data_blocks_read_from_disk -= other.data_blocks_read_from_disk;
   bytes_read_from_disk -= other.bytes_read_from_disk;
   cells_read_from_disk -= other.cells_read_from_disk;
+  readahead_hits -= other.readahead_hits;
+  readahead_bytes_wasted -= other.readahead_bytes_wasted;
   DCheckNonNegative();
 }
 
@@ -58,6 +68,8 @@ void IteratorStats::DCheckNonNegative() const {
   DCHECK_GE(data_blocks_read_from_disk, 0);
   DCHECK_GE(bytes_read_from_disk, 0);
   DCHECK_GE(cells_read_from_disk, 0);
+  DCHECK_GE(readahead_hits, 0);
+  DCHECK_GE(readahead_bytes_wasted, 0);
 }
 
 
@@ -37,6 +37,14 @@ struct IteratorStats {
   // they were decoded/materialized.
   int64_t cells_read_from_disk;
 
+  // The number of data blocks which had been read ahead of the iterator
+  // by the time it needed them.
+  int64_t readahead_hits;
+
+  // The number of bytes read ahead by the iterator which were discarded
+  // without being used, e.g. because the iterator was seeked elsewhere.
+  int64_t readahead_bytes_wasted;
+
   // Add statistics contained 'other' to this object (for each field
   // in this object, increment it by the value of the equivalent field
   // in 'other').
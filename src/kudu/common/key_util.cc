@@ -233,7 +233,8 @@ int PushUpperBoundKeyPredicates(ColIdxIter first,
         }
         break;
       case PredicateType::IsNotNull: // Fallthrough intended
-      case PredicateType::IsNull:
+      case PredicateType::IsNull: // Fallthrough intended
+      case PredicateType::InBloomFilter:
         break_loop = true;
         break;
       case PredicateType::InList:
@@ -295,7 +296,8 @@ int PushLowerBoundKeyPredicates(ColIdxIter first,
         pushed_predicates++;
         break;
       case PredicateType::IsNotNull: // Fallthrough intended
-      case PredicateType::IsNull:
+      case PredicateType::IsNull: // Fallthrough intended
+      case PredicateType::InBloomFilter:
         break_loop = true;
         break;
       case PredicateType::InList:
@@ -24,6 +24,9 @@
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
+#include "kudu/common/wire_protocol.pb.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
@@ -290,6 +293,138 @@ TEST_F(WireProtocolTest, TestBlockWithNoColumns) {
   ASSERT_EQ(900, pb.num_rows());
 }
 
+// Serialize a block with some unselected rows and NULL cells into the
+// columnar format, and ensure that the cells can be read back.
+TEST_F(WireProtocolTest, TestRowBlockToColumnarPB) {
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema_, 1000, &arena);
+  FillRowBlockWithTestRows(&block);
+  // Unselect every third row and null out every fifth cell of 'col3'.
+  for (int i = 0; i < block.nrows(); i++) {
+    if (i % 3 == 0) {
+      block.selection_vector()->SetRowUnselected(i);
+    }
+    if (i % 5 == 0) {
+      block.row(i).cell(2).set_null(true);
+    }
+  }
+  const int num_selected = block.selection_vector()->CountSelected();
+
+  // Serialize the block twice to exercise appending to a non-empty batch.
+  ColumnarSerializedBatch batch;
+  ASSERT_EQ(num_selected, SerializeRowBlockColumnar(block, nullptr, &batch));
+  ASSERT_EQ(num_selected, SerializeRowBlockColumnar(block, nullptr, &batch));
+  ASSERT_EQ(num_selected * 2, batch.num_rows);
+
+  ColumnarRowBlockPB pb;
+  faststring data, varlen_data, non_null_bitmaps;
+  FinishColumnarBatch(&batch, &pb, &data, &varlen_data, &non_null_bitmaps);
+  SCOPED_TRACE(SecureDebugString(pb));
+  ASSERT_EQ(num_selected * 2, pb.num_rows());
+  ASSERT_OK(ValidateColumnarRowBlockPB(schema_, pb, data, varlen_data, non_null_bitmaps));
+
+  // Check the contents of each column against the original block.
+  vector<int> selected_rows;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < block.nrows(); i++) {
+      if (block.selection_vector()->IsRowSelected(i)) {
+        selected_rows.push_back(i);
+      }
+    }
+  }
+  for (int col_idx = 0; col_idx < 2; col_idx++) {
+    const ColumnarRowBlockPB::Column& col = pb.columns(col_idx);
+    ASSERT_EQ(0, col.data_offset() % sizeof(uint64_t));
+    ASSERT_FALSE(col.has_non_null_bitmap_offset());
+    const uint8_t* offsets = data.data() + col.data_offset();
+    const uint8_t* values = varlen_data.data() + col.varlen_data_offset();
+    for (int j = 0; j < selected_rows.size(); j++) {
+      uint32_t start = UNALIGNED_LOAD32(offsets + j * sizeof(uint32_t));
+      uint32_t end = UNALIGNED_LOAD32(offsets + (j + 1) * sizeof(uint32_t));
+      const Slice& expected = *reinterpret_cast<const Slice*>(
+          block.row(selected_rows[j]).cell_ptr(col_idx));
+      ASSERT_EQ(expected, Slice(values + start, end - start));
+    }
+  }
+  const ColumnarRowBlockPB::Column& col3 = pb.columns(2);
+  ASSERT_EQ(0, col3.data_offset() % sizeof(uint64_t));
+  ASSERT_FALSE(col3.has_varlen_data_offset());
+  const uint8_t* bitmap = non_null_bitmaps.data() + col3.non_null_bitmap_offset();
+  for (int j = 0; j < selected_rows.size(); j++) {
+    bool expect_null = selected_rows[j] % 5 == 0;
+    ASSERT_EQ(!expect_null, BitmapTest(bitmap, j)) << "row " << j;
+    if (!expect_null) {
+      uint32_t val = UNALIGNED_LOAD32(data.data() + col3.data_offset() + j * sizeof(uint32_t));
+      ASSERT_EQ(selected_rows[j], static_cast<int>(val));
+    }
+  }
+}
+
+// Serialize a block with a client projection into the columnar format.
+TEST_F(WireProtocolTest, TestRowBlockToColumnarPBWithProjection) {
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema_, 10, &arena);
+  FillRowBlockWithTestRows(&block);
+
+  Schema projection({ ColumnSchema("col3", UINT32, true /* nullable */) }, 0);
+  ColumnarSerializedBatch batch;
+  ASSERT_EQ(10, SerializeRowBlockColumnar(block, &projection, &batch));
+  ColumnarRowBlockPB pb;
+  faststring data, varlen_data, non_null_bitmaps;
+  FinishColumnarBatch(&batch, &pb, &data, &varlen_data, &non_null_bitmaps);
+  ASSERT_OK(ValidateColumnarRowBlockPB(projection, pb, data, varlen_data, non_null_bitmaps));
+  ASSERT_EQ(1, pb.columns_size());
+  ASSERT_EQ(0, varlen_data.size());
+  ASSERT_EQ(10 * sizeof(uint32_t), static_cast<size_t>(pb.columns(0).data_size()));
+
+  // The block does not match the full schema.
+  Status s = ValidateColumnarRowBlockPB(schema_, pb, data, varlen_data, non_null_bitmaps);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+}
+
+// Test that validating an invalid columnar block correctly returns
+// Corruption statuses.
+TEST_F(WireProtocolTest, TestInvalidColumnarRowBlock) {
+  Schema schema({ ColumnSchema("col1", STRING) }, 1);
+  ColumnarRowBlockPB pb;
+  ColumnarRowBlockPB::Column* col = pb.add_columns();
+  pb.set_num_rows(1);
+
+  // Offsets which lie outside of the data sidecar.
+  uint32_t offsets[2] = { 0, 4 };
+  Slice data(reinterpret_cast<const uint8_t*>(offsets), sizeof(offsets));
+  col->set_data_offset(4);
+  col->set_data_size(sizeof(offsets));
+  Status s = ValidateColumnarRowBlockPB(schema, pb, data, "xxxx", Slice());
+  ASSERT_STR_CONTAINS(s.ToString(), "has bad data range");
+
+  // Offsets which point past the end of the varlen data.
+  col->set_data_offset(0);
+  col->set_varlen_data_offset(0);
+  col->set_varlen_data_size(2);
+  s = ValidateColumnarRowBlockPB(schema, pb, data, "xx", Slice());
+  ASSERT_STR_CONTAINS(s.ToString(), "has bad varlen offset at row 1");
+
+  // Non-monotonic offsets.
+  offsets[0] = 3;
+  offsets[1] = 1;
+  col->set_varlen_data_size(4);
+  s = ValidateColumnarRowBlockPB(schema, pb, data, "xxxx", Slice());
+  ASSERT_STR_CONTAINS(s.ToString(), "has bad varlen offset at row 1");
+
+  offsets[0] = 0;
+  offsets[1] = 4;
+  ASSERT_OK(ValidateColumnarRowBlockPB(schema, pb, data, "xxxx", Slice()));
+
+  // A row count so large that the expected size of the offsets wraps around
+  // to the size of the data.
+  pb.set_num_rows(1LL << 62);
+  col->set_data_size(sizeof(uint32_t));
+  s = ValidateColumnarRowBlockPB(schema, pb, data, "xxxx", Slice());
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "rows");
+}
+
 TEST_F(WireProtocolTest, TestColumnDefaultValue) {
   Slice write_default_str("Hello Write");
   Slice read_default_str("Hello Read");
@@ -394,4 +529,55 @@ TEST_F(WireProtocolTest, TestColumnPredicateInList) {
     ASSERT_TRUE(ColumnPredicateFromPB(schema, &arena, pb, &predicate).IsInvalidArgument());
   }
 }
+
+TEST_F(WireProtocolTest, TestColumnPredicateInBloomFilter) {
+  ColumnSchema col1("col1", INT32);
+  vector<ColumnSchema> cols = { col1 };
+  Schema schema(cols, 1);
+  Arena arena(1024,1024*1024);
+  boost::optional<ColumnPredicate> predicate;
+
+  int five = 5;
+  int ten = 10;
+  BloomFilterBuilder builder(BloomFilterSizing::ByCountAndFPRate(10, 0.01));
+  builder.AddKey(BloomKeyProbe(Slice(reinterpret_cast<const uint8_t*>(&five), sizeof(five))));
+
+  { // col1 IN BLOOM FILTER AND col1 < 10
+    vector<BloomFilter> bloom_filters = { BloomFilter(builder.slice(), builder.n_hashes()) };
+    ColumnPredicate cp = ColumnPredicate::InBloomFilter(col1, &bloom_filters, nullptr, &ten);
+    ColumnPredicatePB pb;
+    ASSERT_NO_FATAL_FAILURE(ColumnPredicateToPB(cp, &pb));
+
+    ASSERT_OK(ColumnPredicateFromPB(schema, &arena, pb, &predicate));
+    ASSERT_EQ(PredicateType::InBloomFilter, predicate->predicate_type());
+    ASSERT_EQ(1, predicate->bloom_filters().size());
+    ASSERT_EQ(builder.slice(), predicate->bloom_filters()[0].data());
+    ASSERT_EQ(builder.n_hashes(), predicate->bloom_filters()[0].n_hashes());
+    ASSERT_TRUE(predicate->raw_lower() == nullptr);
+    ASSERT_EQ(ten, *static_cast<const int*>(predicate->raw_upper()));
+    ASSERT_TRUE(predicate->EvaluateCell<INT32>(&five));
+  }
+
+  { // Bloom filter without any hash functions.
+    ColumnPredicatePB pb;
+    pb.set_column("col1");
+    pb.mutable_in_bloom_filter()->add_bloom_filters()->set_bloom_data(
+        builder.slice().ToString());
+    ASSERT_TRUE(ColumnPredicateFromPB(schema, &arena, pb, &predicate).IsInvalidArgument());
+  }
+
+  { // Bloom filter with too many hash functions.
+    ColumnPredicatePB pb;
+    pb.set_column("col1");
+    auto* bloom_filter_pb = pb.mutable_in_bloom_filter()->add_bloom_filters();
+    bloom_filter_pb->set_bloom_data(builder.slice().ToString());
+    bloom_filter_pb->set_nhash(1 << 30);
+    Status s = ColumnPredicateFromPB(schema, &arena, pb, &predicate);
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+    ASSERT_STR_CONTAINS(s.ToString(), "too many hash functions");
+
+    bloom_filter_pb->set_nhash(32);
+    ASSERT_OK(ColumnPredicateFromPB(schema, &arena, pb, &predicate));
+  }
+}
 } // namespace kudu
@@ -23,10 +23,13 @@
 #include "kudu/common/column_predicate.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
+#include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/fastmem.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/net/net_util.h"
@@ -37,6 +40,7 @@
 
 using google::protobuf::RepeatedPtrField;
 using std::vector;
+using strings::Substitute;
 
 namespace kudu {
 
@@ -308,6 +312,10 @@ Status SchemaToColumnPBs(const Schema& schema,
 }
 
 namespace {
+// The maximum number of hash functions of a bloom filter predicate, so that
+// a request can't make the server probe each row an unbounded number of times.
+const int kMaxBloomFilterHashes = 32;
+
 // Copies a predicate lower or upper bound from 'bound_src' into 'bound_dst'.
 void CopyPredicateBoundToPB(const ColumnSchema& col, const void* bound_src, string* bound_dst) {
   const void* src;
@@ -396,6 +404,25 @@ void ColumnPredicateToPB(const ColumnPredicate& predicate,
       }
       return;
     };
+    case PredicateType::InBloomFilter: {
+      auto* bloom_pred = pb->mutable_in_bloom_filter();
+      for (const BloomFilter& bloom_filter : predicate.bloom_filters()) {
+        auto* bloom_filter_pb = bloom_pred->add_bloom_filters();
+        bloom_filter_pb->set_nhash(bloom_filter.n_hashes());
+        bloom_filter_pb->set_bloom_data(bloom_filter.data().ToString());
+      }
+      if (predicate.raw_lower() != nullptr) {
+        CopyPredicateBoundToPB(predicate.column(),
+                               predicate.raw_lower(),
+                               bloom_pred->mutable_lower());
+      }
+      if (predicate.raw_upper() != nullptr) {
+        CopyPredicateBoundToPB(predicate.column(),
+                               predicate.raw_upper(),
+                               bloom_pred->mutable_upper());
+      }
+      return;
+    };
     case PredicateType::None: LOG(FATAL) << "None predicate may not be converted to protobuf";
   }
   LOG(FATAL) << "unknown predicate type";
@@ -457,6 +484,38 @@ Status ColumnPredicateFromPB(const Schema& schema,
       *predicate = ColumnPredicate::InList(col, &values);
       break;
     };
+    case ColumnPredicatePB::kInBloomFilter: {
+      const auto& bloom_pred = pb.in_bloom_filter();
+      vector<BloomFilter> bloom_filters;
+      for (const auto& bloom_filter_pb : bloom_pred.bloom_filters()) {
+        if (!bloom_filter_pb.has_nhash() || bloom_filter_pb.nhash() <= 0 ||
+            bloom_filter_pb.bloom_data().empty()) {
+          return Status::InvalidArgument("Invalid bloom filter predicate on column",
+                                         col.name());
+        }
+        if (bloom_filter_pb.nhash() > kMaxBloomFilterHashes) {
+          return Status::InvalidArgument(
+              Substitute("Bloom filter predicate has too many hash functions: $0 (max $1)",
+                         bloom_filter_pb.nhash(), kMaxBloomFilterHashes),
+              col.name());
+        }
+        // Copy the filter, since it must outlive the request.
+        const string& data = bloom_filter_pb.bloom_data();
+        uint8_t* data_copy = static_cast<uint8_t*>(arena->AllocateBytes(data.size()));
+        memcpy(data_copy, data.data(), data.size());
+        bloom_filters.emplace_back(Slice(data_copy, data.size()), bloom_filter_pb.nhash());
+      }
+      const void* lower = nullptr;
+      const void* upper = nullptr;
+      if (bloom_pred.has_lower()) {
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, bloom_pred.lower(), arena, &lower));
+      }
+      if (bloom_pred.has_upper()) {
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, bloom_pred.upper(), arena, &upper));
+      }
+      *predicate = ColumnPredicate::InBloomFilter(col, &bloom_filters, lower, upper);
+      break;
+    };
     case ColumnPredicatePB::kIsNotNull: {
       *predicate = ColumnPredicate::IsNotNull(col);
       break;
@@ -718,4 +777,280 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
   rowblock_pb->set_num_rows(rowblock_pb->num_rows() + num_rows);
 }
 
+int64_t ColumnarSerializedBatch::TotalSize() const {
+  int64_t total = 0;
+  for (const auto& col : columns) {
+    total += col.data->size();
+    if (col.varlen_data) {
+      total += col.varlen_data->size();
+    }
+    if (col.non_null_bitmap) {
+      total += col.non_null_bitmap->size();
+    }
+  }
+  return total;
+}
+
+namespace {
+
+// Append the selected cells of the fixed-length column 'cblock' to 'dst'.
+void CopySelectedCells(const ColumnBlock& cblock, const SelectionVector& sel,
+                       int num_selected, faststring* dst) {
+  size_t cell_size = cblock.stride();
+  size_t old_size = dst->size();
+  dst->resize(old_size + num_selected * cell_size);
+  uint8_t* out = dst->data() + old_size;
+  const uint8_t* src = cblock.data();
+
+  // If every row is selected, the whole block can be copied at once.
+  if (num_selected == cblock.nrows()) {
+    memcpy(out, src, num_selected * cell_size);
+    return;
+  }
+
+  BitmapIterator selected_row_iter(sel.bitmap(), cblock.nrows());
+  int run_size;
+  bool selected;
+  while ((run_size = selected_row_iter.Next(&selected))) {
+    size_t run_bytes = run_size * cell_size;
+    if (selected) {
+      memcpy(out, src, run_bytes);
+      out += run_bytes;
+    }
+    src += run_bytes;
+  }
+}
+
+// Append the selected cells of the BINARY column 'cblock' to 'varlen_data',
+// and their end offsets to 'offsets'.
+template<bool IS_NULLABLE>
+void CopySelectedVarlenCells(const ColumnBlock& cblock, const SelectionVector& sel,
+                             int num_selected, faststring* offsets,
+                             faststring* varlen_data) {
+  size_t old_size = offsets->size();
+  offsets->resize(old_size + num_selected * sizeof(uint32_t));
+  uint32_t* out = reinterpret_cast<uint32_t*>(offsets->data() + old_size);
+  const Slice* cells = reinterpret_cast<const Slice*>(cblock.data());
+
+  BitmapIterator selected_row_iter(sel.bitmap(), cblock.nrows());
+  int run_size;
+  bool selected;
+  int row_idx = 0;
+  while ((run_size = selected_row_iter.Next(&selected))) {
+    if (!selected) {
+      row_idx += run_size;
+      continue;
+    }
+    for (int i = 0; i < run_size; i++, row_idx++) {
+      if (!IS_NULLABLE || !cblock.is_null(row_idx)) {
+        varlen_data->append(cells[row_idx].data(), cells[row_idx].size());
+      }
+      DCHECK_LE(varlen_data->size(), MathLimits<uint32_t>::kMax);
+      *out++ = static_cast<uint32_t>(varlen_data->size());
+    }
+  }
+}
+
+// Append the non-null bits of the selected cells of 'cblock' to 'bitmap',
+// which currently holds 'dst_row' bits.
+void CopySelectedNonNullBits(const ColumnBlock& cblock, const SelectionVector& sel,
+                             int num_selected, int64_t dst_row, faststring* bitmap) {
+  bitmap->resize(BitmapSize(dst_row + num_selected));
+  uint8_t* out = bitmap->data();
+
+  // If every row is selected and the destination is byte-aligned, the whole
+  // bitmap can be copied at once.
+  if (num_selected == cblock.nrows() && dst_row % 8 == 0) {
+    memcpy(out + dst_row / 8, cblock.null_bitmap(), BitmapSize(num_selected));
+    return;
+  }
+
+  BitmapIterator selected_row_iter(sel.bitmap(), cblock.nrows());
+  int run_size;
+  bool selected;
+  int row_idx = 0;
+  while ((run_size = selected_row_iter.Next(&selected))) {
+    if (!selected) {
+      row_idx += run_size;
+      continue;
+    }
+    for (int i = 0; i < run_size; i++, row_idx++) {
+      BitmapChange(out, dst_row++, !cblock.is_null(row_idx));
+    }
+  }
+}
+
+// Append the contents of 'src' to 'dst', after padding 'dst' with zeros to
+// a multiple of 'alignment' bytes. Returns the offset at which 'src' begins.
+int64_t AppendAligned(const faststring& src, size_t alignment, faststring* dst) {
+  size_t padding = (alignment - dst->size() % alignment) % alignment;
+  for (size_t i = 0; i < padding; i++) {
+    dst->push_back(0);
+  }
+  int64_t offset = dst->size();
+  dst->append(src.data(), src.size());
+  return offset;
+}
+
+} // anonymous namespace
+
+int SerializeRowBlockColumnar(const RowBlock& block,
+                              const Schema* projection_schema,
+                              ColumnarSerializedBatch* batch) {
+  const Schema& tablet_schema = block.schema();
+  if (projection_schema == nullptr) {
+    projection_schema = &tablet_schema;
+  }
+
+  // Set up the per-column buffers the first time a block is appended.
+  if (batch->columns.empty() && projection_schema->num_columns() > 0) {
+    batch->columns.resize(projection_schema->num_columns());
+    for (int i = 0; i < projection_schema->num_columns(); i++) {
+      const ColumnSchema& col = projection_schema->column(i);
+      ColumnarSerializedBatch::Column* dst = &batch->columns[i];
+      dst->data.reset(new faststring());
+      if (col.type_info()->physical_type() == BINARY) {
+        // The offsets array always begins with a zero.
+        uint32_t zero = 0;
+        dst->data->append(&zero, sizeof(zero));
+        dst->varlen_data.reset(new faststring());
+      }
+      if (col.is_nullable()) {
+        dst->non_null_bitmap.reset(new faststring());
+      }
+    }
+  }
+  DCHECK_EQ(projection_schema->num_columns(), batch->columns.size());
+
+  const SelectionVector& sel = *block.selection_vector();
+  int num_selected = sel.CountSelected();
+  if (num_selected == 0) {
+    return 0;
+  }
+
+  for (int t_schema_idx = 0; t_schema_idx < tablet_schema.num_columns(); t_schema_idx++) {
+    const ColumnSchema& col = tablet_schema.column(t_schema_idx);
+    int proj_schema_idx = projection_schema->find_column(col.name());
+    if (proj_schema_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    ColumnBlock cblock = block.column_block(t_schema_idx);
+    ColumnarSerializedBatch::Column* dst = &batch->columns[proj_schema_idx];
+
+    if (col.type_info()->physical_type() == BINARY) {
+      if (col.is_nullable()) {
+        CopySelectedVarlenCells<true>(cblock, sel, num_selected,
+                                      dst->data.get(), dst->varlen_data.get());
+      } else {
+        CopySelectedVarlenCells<false>(cblock, sel, num_selected,
+                                       dst->data.get(), dst->varlen_data.get());
+      }
+    } else {
+      CopySelectedCells(cblock, sel, num_selected, dst->data.get());
+    }
+    if (col.is_nullable()) {
+      CopySelectedNonNullBits(cblock, sel, num_selected, batch->num_rows,
+                              dst->non_null_bitmap.get());
+    }
+  }
+  batch->num_rows += num_selected;
+  return num_selected;
+}
+
+void FinishColumnarBatch(ColumnarSerializedBatch* batch,
+                         ColumnarRowBlockPB* columnar_pb,
+                         faststring* data,
+                         faststring* varlen_data,
+                         faststring* non_null_bitmaps) {
+  columnar_pb->Clear();
+  columnar_pb->set_num_rows(batch->num_rows);
+  data->reserve(batch->TotalSize() + batch->columns.size() * sizeof(uint64_t));
+  for (const auto& col : batch->columns) {
+    ColumnarRowBlockPB::Column* col_pb = columnar_pb->add_columns();
+    col_pb->set_data_offset(AppendAligned(*col.data, sizeof(uint64_t), data));
+    col_pb->set_data_size(col.data->size());
+    if (col.varlen_data) {
+      col_pb->set_varlen_data_offset(AppendAligned(*col.varlen_data, 1, varlen_data));
+      col_pb->set_varlen_data_size(col.varlen_data->size());
+    }
+    if (col.non_null_bitmap) {
+      col_pb->set_non_null_bitmap_offset(AppendAligned(*col.non_null_bitmap, 1,
+                                                       non_null_bitmaps));
+      col_pb->set_non_null_bitmap_size(col.non_null_bitmap->size());
+    }
+  }
+}
+
+Status ValidateColumnarRowBlockPB(const Schema& schema,
+                                  const ColumnarRowBlockPB& columnar_pb,
+                                  const Slice& data,
+                                  const Slice& varlen_data,
+                                  const Slice& non_null_bitmaps) {
+  if (PREDICT_FALSE(columnar_pb.columns_size() != schema.num_columns())) {
+    return Status::Corruption(Substitute("Columnar row block has $0 columns but expected $1",
+                                         columnar_pb.columns_size(), schema.num_columns()));
+  }
+  int64_t num_rows = columnar_pb.num_rows();
+  // Each row takes at least a byte of every column's data, so this bounds
+  // 'num_rows' enough that the sizes computed from it below can't overflow.
+  // Without any columns, the rows aren't backed by any data.
+  if (PREDICT_FALSE(num_rows < 0 ||
+                    (schema.num_columns() > 0 && static_cast<uint64_t>(num_rows) > data.size()))) {
+    return Status::Corruption(Substitute("Columnar row block has $0 rows", num_rows));
+  }
+
+  // Checks that the range [offset, offset + size) lies within 'sidecar'.
+  auto check_range = [](int64_t offset, int64_t size, const Slice& sidecar) {
+    bool overflowed = false;
+    uint64_t end = AddWithOverflowCheck<uint64_t>(offset, size, &overflowed);
+    return offset >= 0 && size >= 0 && !overflowed && end <= sidecar.size();
+  };
+
+  for (int i = 0; i < schema.num_columns(); i++) {
+    const ColumnSchema& col = schema.column(i);
+    const ColumnarRowBlockPB::Column& col_pb = columnar_pb.columns(i);
+    bool is_varlen = col.type_info()->physical_type() == BINARY;
+    int64_t expected_size = is_varlen ? (num_rows + 1) * sizeof(uint32_t)
+                                      : num_rows * col.type_info()->size();
+    if (PREDICT_FALSE(col_pb.data_size() != expected_size ||
+                      !check_range(col_pb.data_offset(), col_pb.data_size(), data))) {
+      return Status::Corruption(Substitute("Column $0 has bad data range: ($1, $2)",
+                                           col.ToString(), col_pb.data_offset(),
+                                           col_pb.data_size()));
+    }
+    if (is_varlen) {
+      if (PREDICT_FALSE(!col_pb.has_varlen_data_offset() ||
+                        !check_range(col_pb.varlen_data_offset(), col_pb.varlen_data_size(),
+                                     varlen_data))) {
+        return Status::Corruption(Substitute("Column $0 has bad varlen data range: ($1, $2)",
+                                             col.ToString(), col_pb.varlen_data_offset(),
+                                             col_pb.varlen_data_size()));
+      }
+      // Every cell must lie within the column's varlen data.
+      const uint8_t* offsets = data.data() + col_pb.data_offset();
+      uint32_t prev = 0;
+      for (int64_t row = 0; row <= num_rows; row++) {
+        uint32_t cur = UNALIGNED_LOAD32(offsets + row * sizeof(uint32_t));
+        if (PREDICT_FALSE(cur < prev || cur > col_pb.varlen_data_size())) {
+          return Status::Corruption(Substitute("Column $0 has bad varlen offset at row $1",
+                                               col.ToString(), row));
+        }
+        prev = cur;
+      }
+    }
+    if (col.is_nullable()) {
+      if (PREDICT_FALSE(!col_pb.has_non_null_bitmap_offset() ||
+                        col_pb.non_null_bitmap_size() !=
+                            static_cast<int64_t>(BitmapSize(num_rows)) ||
+                        !check_range(col_pb.non_null_bitmap_offset(),
+                                     col_pb.non_null_bitmap_size(), non_null_bitmaps))) {
+        return Status::Corruption(Substitute("Column $0 has bad non-null bitmap range: ($1, $2)",
+                                             col.ToString(), col_pb.non_null_bitmap_offset(),
+                                             col_pb.non_null_bitmap_size()));
+      }
+    }
+  }
+  return Status::OK();
+}
+
 } // namespace kudu
@@ -20,9 +20,11 @@
 #define KUDU_COMMON_WIRE_PROTOCOL_H
 
 #include <boost/optional.hpp>
+#include <memory>
 #include <vector>
 
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/status.h"
 
 using boost::optional;
@@ -33,7 +35,6 @@ class Arena;
 class ColumnPredicate;
 class ColumnSchema;
 class ConstContiguousRow;
-class faststring;
 class HostPort;
 class RowBlock;
 class RowBlockRow;
@@ -128,6 +129,67 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
                        const Schema* client_projection_schema,
                        faststring* data_buf, faststring* indirect_data);
 
+// The columnar equivalent of the row data and indirect data buffers filled in
+// by SerializeRowBlock(). One or more RowBlocks may be appended to the same
+// batch, as long as they share the same projection.
+//
+// See ColumnarRowBlockPB for a description of the format of each buffer.
+struct ColumnarSerializedBatch {
+  struct Column {
+    // Fixed-length cell data, or the varlen offsets for BINARY columns.
+    std::unique_ptr<faststring> data;
+
+    // Only non-NULL for BINARY columns.
+    std::unique_ptr<faststring> varlen_data;
+
+    // Only non-NULL for nullable columns.
+    std::unique_ptr<faststring> non_null_bitmap;
+  };
+
+  ColumnarSerializedBatch() : num_rows(0) {}
+
+  // Returns the total number of bytes buffered across all columns.
+  int64_t TotalSize() const;
+
+  std::vector<Column> columns;
+  int64_t num_rows;
+};
+
+// Encode the selected rows of the given row block into the columnar batch
+// 'batch', appending to any rows that it already holds.
+//
+// If 'client_projection_schema' is not NULL, then only columns specified in
+// 'client_projection_schema' will be serialized, in the order they appear in
+// that schema.
+//
+// Returns the number of rows appended to the batch.
+int SerializeRowBlockColumnar(const RowBlock& block,
+                              const Schema* client_projection_schema,
+                              ColumnarSerializedBatch* batch);
+
+// Concatenate the columns of 'batch' into a single data buffer, varlen data
+// buffer and non-null bitmap buffer, recording the location of each column
+// in 'columnar_pb'. The sidecar indexes in 'columnar_pb' are left unset.
+//
+// 'batch' is left in an unspecified state.
+void FinishColumnarBatch(ColumnarSerializedBatch* batch,
+                         ColumnarRowBlockPB* columnar_pb,
+                         faststring* data,
+                         faststring* varlen_data,
+                         faststring* non_null_bitmaps);
+
+// Validate that the columnar row block 'columnar_pb', whose columns must have
+// exactly the given Schema, lies within the provided sidecars. Once validated,
+// each column's cell data, varlen data and non-null bitmap may be accessed
+// directly at their recorded offsets in the sidecars.
+//
+// Returns a bad Status if the provided data is invalid or corrupt.
+Status ValidateColumnarRowBlockPB(const Schema& schema,
+                                  const ColumnarRowBlockPB& columnar_pb,
+                                  const Slice& data,
+                                  const Slice& varlen_data,
+                                  const Slice& non_null_bitmaps);
+
 // Rewrites the data pointed-to by row data slice 'row_data_slice' by replacing
 // relative indirect data pointers with absolute ones in 'indirect_data_slice'.
 // At the time of this writing, this rewriting is only done for STRING types.
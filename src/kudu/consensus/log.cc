@@ -35,6 +35,7 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/countdown_latch.h"
@@ -45,6 +46,7 @@
 #include "kudu/util/kernel_stack_watchdog.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random.h"
@@ -77,6 +79,27 @@ DEFINE_int32(group_commit_queue_size_bytes, 4 * 1024 * 1024,
              "Maximum size of the group commit queue in bytes");
 TAG_FLAG(group_commit_queue_size_bytes, advanced);
 
+DEFINE_int32(log_group_commit_max_delay_us, 0,
+             "Maximum number of microseconds the log append thread waits for more "
+             "entries before committing a group smaller than "
+             "--log_group_commit_target_bytes. The wait is also bounded by the "
+             "recent latency of syncing the log, so that it only matters when syncs "
+             "are slow. If 0, groups are committed without waiting.");
+TAG_FLAG(log_group_commit_max_delay_us, experimental);
+TAG_FLAG(log_group_commit_max_delay_us, runtime);
+
+DEFINE_int32(log_group_commit_target_bytes, 256 * 1024,
+             "Size in bytes beyond which a group commit group is committed without "
+             "waiting for more entries. See --log_group_commit_max_delay_us.");
+TAG_FLAG(log_group_commit_target_bytes, experimental);
+TAG_FLAG(log_group_commit_target_bytes, runtime);
+
+DEFINE_bool(log_pipeline_sync, false,
+            "Whether to sync each group commit group on a background thread while "
+            "the log append thread writes the next group, instead of syncing it "
+            "before writing the next group.");
+TAG_FLAG(log_pipeline_sync, experimental);
+
 
 // Compression configuration.
 // -----------------------------
@@ -161,9 +184,24 @@ class Log::AppendThread {
   // method.
   void Shutdown();
 
+  // Waits until any group being synced in the background has been synced
+  // and its callbacks have run.
+  void WaitForPendingSync();
+
  private:
   void RunThread();
 
+  // Drains the next group of entry batches from the queue into
+  // 'entry_batches'. If the group is small, waits for a while for more
+  // batches to join it. Returns false if the queue was shut down.
+  bool DrainGroup(vector<LogEntryBatch*>* entry_batches);
+
+  // Syncs the log if 'needs_sync' is true, runs the callbacks of the batches
+  // in 'entry_batches' and deletes them. 'group_start' is the time at which
+  // the group was drained from the queue.
+  void SyncGroup(vector<LogEntryBatch*>* entry_batches, bool needs_sync,
+                 const MonoTime& group_start);
+
   string LogPrefix() const;
 
   Log* const log_;
@@ -171,21 +209,76 @@ class Log::AppendThread {
   // Lock to protect access to thread_ during shutdown.
   mutable std::mutex lock_;
   scoped_refptr<Thread> thread_;
+
+  // The single-threaded pool which syncs each group while the next one is
+  // written, if --log_pipeline_sync is set.
+  gscoped_ptr<ThreadPool> sync_pool_;
+
+  // A moving average of the time taken to sync a group, in microseconds.
+  AtomicInt<int64_t> avg_sync_micros_;
 };
 
 
 Log::AppendThread::AppendThread(Log *log)
-  : log_(log) {
+  : log_(log),
+    avg_sync_micros_(0) {
 }
 
 Status Log::AppendThread::Init() {
   DCHECK(!thread_) << "Already initialized";
   VLOG_WITH_PREFIX(1) << "Starting log append thread";
+  if (FLAGS_log_pipeline_sync) {
+    RETURN_NOT_OK(ThreadPoolBuilder("log-sync").set_max_threads(1).Build(&sync_pool_));
+  }
   RETURN_NOT_OK(kudu::Thread::Create("log", "appender",
       &AppendThread::RunThread, this, &thread_));
   return Status::OK();
 }
 
+bool Log::AppendThread::DrainGroup(vector<LogEntryBatch*>* entry_batches) {
+  if (PREDICT_FALSE(!log_->entry_queue()->BlockingDrainTo(entry_batches))) {
+    return false;
+  }
+
+  // Waiting for more batches only pays off if it saves syncs which take
+  // longer than the wait, so the delay is bounded by the recent sync latency.
+  int64_t max_delay_us = std::min<int64_t>(FLAGS_log_group_commit_max_delay_us,
+                                           avg_sync_micros_.Load());
+  if (max_delay_us <= 0) {
+    return true;
+  }
+  MonoTime start = MonoTime::Now();
+  MonoTime deadline = start + MonoDelta::FromMicroseconds(max_delay_us);
+  bool ret = true;
+  int64_t group_bytes = 0;
+  bool needs_sync = false;
+  size_t num_seen = 0;
+  while (true) {
+    for (; num_seen < entry_batches->size(); num_seen++) {
+      const LogEntryBatch* entry_batch = (*entry_batches)[num_seen];
+      group_bytes += entry_batch->total_size_bytes();
+      needs_sync |= entry_batch->type_ != COMMIT;
+    }
+    // Groups of COMMITs aren't synced, so there is nothing to save.
+    if (!needs_sync || group_bytes >= FLAGS_log_group_commit_target_bytes) {
+      break;
+    }
+    Status s = log_->entry_queue()->BlockingDrainTo(entry_batches, deadline);
+    if (s.IsTimedOut()) {
+      break;
+    }
+    if (PREDICT_FALSE(s.IsAborted())) {
+      ret = false;
+      break;
+    }
+  }
+  if (log_->metrics_) {
+    log_->metrics_->group_commit_delay->Increment(
+        (MonoTime::Now() - start).ToMicroseconds());
+  }
+  return ret;
+}
+
 void Log::AppendThread::RunThread() {
   bool shutting_down = false;
   while (PREDICT_TRUE(!shutting_down)) {
@@ -197,18 +290,15 @@ void Log::AppendThread::RunThread() {
     // the entry_batches vector with the final set of log entry batches that
     // were enqueued. We finish processing this last bunch of log entry batches
     // before exiting the main RunThread() loop.
-    if (PREDICT_FALSE(!log_->entry_queue()->BlockingDrainTo(&entry_batches))) {
+    if (PREDICT_FALSE(!DrainGroup(&entry_batches))) {
       shutting_down = true;
     }
+    MonoTime group_start = MonoTime::Now();
 
-    if (log_->metrics_) {
-      log_->metrics_->entry_batches_per_group->Increment(entry_batches.size());
-    }
     TRACE_EVENT1("log", "batch", "batch_size", entry_batches.size());
 
-    SCOPED_LATENCY_METRIC(log_->metrics_, group_commit_latency);
-
     bool is_all_commits = true;
+    int64_t group_bytes = 0;
     for (LogEntryBatch* entry_batch : entry_batches) {
       entry_batch->WaitForReady();
       TRACE_EVENT_FLOW_END0("log", "Batch", entry_batch);
@@ -227,39 +317,80 @@ void Log::AppendThread::RunThread() {
       if (is_all_commits && entry_batch->type_ != COMMIT) {
         is_all_commits = false;
       }
+      group_bytes += entry_batch->total_size_bytes();
     }
 
-    Status s;
-    if (!is_all_commits) {
-      s = log_->Sync();
+    if (log_->metrics_) {
+      log_->metrics_->entry_batches_per_group->Increment(entry_batches.size());
+      log_->metrics_->group_commit_bytes->Increment(group_bytes);
     }
-    if (PREDICT_FALSE(!s.ok())) {
-      LOG_WITH_PREFIX(ERROR) << "Error syncing log: " << s.ToString();
-      for (LogEntryBatch* entry_batch : entry_batches) {
-        if (!entry_batch->callback().is_null()) {
-          entry_batch->callback().Run(s);
-        }
-      }
-    } else {
-      TRACE_EVENT0("log", "Callbacks");
-      VLOG_WITH_PREFIX(2) << "Synchronized " << entry_batches.size() << " entry batches";
-      SCOPED_WATCH_STACK(100);
-      for (LogEntryBatch* entry_batch : entry_batches) {
-        if (PREDICT_TRUE(!entry_batch->failed_to_append()
-                         && !entry_batch->callback().is_null())) {
-          entry_batch->callback().Run(Status::OK());
-        }
-        // It's important to delete each batch as we see it, because
-        // deleting it may free up memory from memory trackers, and the
-        // callback of a later batch may want to use that memory.
-        delete entry_batch;
+
+    if (sync_pool_) {
+      // Wait for the previous group to be synced, so that at most one group
+      // is synced while the next one is written and callbacks run in order.
+      sync_pool_->Wait();
+      auto group = std::make_shared<vector<LogEntryBatch*>>();
+      group->swap(entry_batches);
+      Status s = sync_pool_->SubmitFunc([this, group, is_all_commits, group_start]() {
+        SyncGroup(group.get(), !is_all_commits, group_start);
+      });
+      if (PREDICT_TRUE(s.ok())) {
+        continue;
       }
-      entry_batches.clear();
+      LOG_WITH_PREFIX(WARNING) << "Unable to sync log group in the background: "
+                               << s.ToString();
+      group->swap(entry_batches);
     }
+    SyncGroup(&entry_batches, !is_all_commits, group_start);
+  }
+  if (sync_pool_) {
+    sync_pool_->Wait();
   }
   VLOG_WITH_PREFIX(1) << "Exiting AppendThread";
 }
 
+void Log::AppendThread::SyncGroup(vector<LogEntryBatch*>* entry_batches, bool needs_sync,
+                                  const MonoTime& group_start) {
+  ElementDeleter d(entry_batches);
+
+  Status s;
+  if (needs_sync) {
+    MonoTime sync_start = MonoTime::Now();
+    s = log_->Sync();
+    int64_t sync_us = (MonoTime::Now() - sync_start).ToMicroseconds();
+    int64_t avg_us = avg_sync_micros_.Load();
+    avg_sync_micros_.Store(avg_us == 0 ? sync_us : avg_us + (sync_us - avg_us) / 8);
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG_WITH_PREFIX(ERROR) << "Error syncing log: " << s.ToString();
+    for (LogEntryBatch* entry_batch : *entry_batches) {
+      if (!entry_batch->callback().is_null()) {
+        entry_batch->callback().Run(s);
+      }
+    }
+  } else {
+    TRACE_EVENT0("log", "Callbacks");
+    VLOG_WITH_PREFIX(2) << "Synchronized " << entry_batches->size() << " entry batches";
+    SCOPED_WATCH_STACK(100);
+    for (LogEntryBatch* entry_batch : *entry_batches) {
+      if (PREDICT_TRUE(!entry_batch->failed_to_append()
+                       && !entry_batch->callback().is_null())) {
+        entry_batch->callback().Run(Status::OK());
+      }
+      // It's important to delete each batch as we see it, because
+      // deleting it may free up memory from memory trackers, and the
+      // callback of a later batch may want to use that memory.
+      delete entry_batch;
+    }
+    entry_batches->clear();
+  }
+
+  if (log_->metrics_) {
+    log_->metrics_->group_commit_latency->Increment(
+        (MonoTime::Now() - group_start).ToMicroseconds());
+  }
+}
+
 void Log::AppendThread::Shutdown() {
   log_->entry_queue()->Shutdown();
   std::lock_guard<std::mutex> lock_guard(lock_);
@@ -269,6 +400,15 @@ void Log::AppendThread::Shutdown() {
     VLOG_WITH_PREFIX(1) << "Log append thread is shut down";
     thread_.reset();
   }
+  if (sync_pool_) {
+    sync_pool_->Shutdown();
+  }
+}
+
+void Log::AppendThread::WaitForPendingSync() {
+  if (sync_pool_) {
+    sync_pool_->Wait();
+  }
 }
 
 string Log::AppendThread::LogPrefix() const {
@@ -418,6 +558,9 @@ Status Log::RollOver() {
 
   DCHECK_EQ(allocation_state(), kAllocationFinished);
 
+  // A group may still be syncing the active segment in the background.
+  append_thread_->WaitForPendingSync();
+
   RETURN_NOT_OK(Sync());
   RETURN_NOT_OK(CloseCurrentSegment());
 
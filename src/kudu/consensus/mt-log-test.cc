@@ -35,6 +35,9 @@ DEFINE_int32(num_writer_threads, 4, "Number of threads writing to the log");
 DEFINE_int32(num_batches_per_thread, 2000, "Number of batches per thread");
 DEFINE_int32(num_ops_per_batch_avg, 5, "Target average number of ops per batch");
 
+DECLARE_int32(log_group_commit_max_delay_us);
+DECLARE_bool(log_pipeline_sync);
+
 namespace kudu {
 namespace log {
 
@@ -160,6 +163,34 @@ class MultiThreadedLogTest : public LogTestBase {
     stop_reader = true;
     reader_thread.join();
   }
+
+  // Appends entries from several threads, then checks that all of them
+  // were written to the log in order.
+  void AppendAndVerifyEntries() {
+    ASSERT_OK(BuildLog());
+    int start_current_id = current_index_;
+    LOG_TIMING(INFO, strings::Substitute("inserting $0 batches($1 threads, $2 per-thread)",
+                                        FLAGS_num_writer_threads * FLAGS_num_batches_per_thread,
+                                        FLAGS_num_batches_per_thread, FLAGS_num_writer_threads)) {
+      ASSERT_NO_FATAL_FAILURE(Run());
+    }
+    ASSERT_OK(log_->Close());
+
+    shared_ptr<LogReader> reader;
+    ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, kTestTablet, nullptr, &reader));
+    SegmentSequence segments;
+    ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+
+    for (const SegmentSequence::value_type& entry : segments) {
+      ASSERT_OK(entry->ReadEntries(&entries_));
+    }
+    vector<uint32_t> ids;
+    EntriesToIdList(&ids);
+    DVLOG(1) << "Wrote total of " << current_index_ - start_current_id << " ops";
+    ASSERT_EQ(current_index_ - start_current_id, ids.size());
+    ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+  }
+
  private:
   ThreadSafeRandom random_;
   simple_spinlock lock_;
@@ -169,29 +200,17 @@ class MultiThreadedLogTest : public LogTestBase {
 TEST_F(MultiThreadedLogTest, TestAppends) {
   // Roll frequently to stress related code paths.
   options_.segment_size_mb = 1;
+  ASSERT_NO_FATAL_FAILURE(AppendAndVerifyEntries());
+}
 
-  ASSERT_OK(BuildLog());
-  int start_current_id = current_index_;
-  LOG_TIMING(INFO, strings::Substitute("inserting $0 batches($1 threads, $2 per-thread)",
-                                      FLAGS_num_writer_threads * FLAGS_num_batches_per_thread,
-                                      FLAGS_num_batches_per_thread, FLAGS_num_writer_threads)) {
-    ASSERT_NO_FATAL_FAILURE(Run());
-  }
-  ASSERT_OK(log_->Close());
-
-  shared_ptr<LogReader> reader;
-  ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, kTestTablet, nullptr, &reader));
-  SegmentSequence segments;
-  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
-
-  for (const SegmentSequence::value_type& entry : segments) {
-    ASSERT_OK(entry->ReadEntries(&entries_));
-  }
-  vector<uint32_t> ids;
-  EntriesToIdList(&ids);
-  DVLOG(1) << "Wrote total of " << current_index_ - start_current_id << " ops";
-  ASSERT_EQ(current_index_ - start_current_id, ids.size());
-  ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+// Like the above, but syncs each group while the next is written, and waits
+// for groups to fill up before syncing them.
+TEST_F(MultiThreadedLogTest, TestAppendsWithPipelinedGroupCommit) {
+  FLAGS_log_pipeline_sync = true;
+  FLAGS_log_group_commit_max_delay_us = 1000;
+  options_.segment_size_mb = 1;
+  options_.force_fsync_all = true;
+  ASSERT_NO_FATAL_FAILURE(AppendAndVerifyEntries());
 }
 
 } // namespace log
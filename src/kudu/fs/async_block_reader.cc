@@ -0,0 +1,71 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/async_block_reader.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/fs/block_manager.h"
+#include "kudu/gutil/callback.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(async_block_reader_num_threads, 16,
+             "Number of threads which issue background reads of blocks, such as "
+             "the readahead of cfile data blocks. This bounds the number of such "
+             "reads which may be outstanding at once across all disks.");
+TAG_FLAG(async_block_reader_num_threads, advanced);
+TAG_FLAG(async_block_reader_num_threads, experimental);
+
+using std::vector;
+
+namespace kudu {
+namespace fs {
+
+AsyncBlockReader::AsyncBlockReader()
+    : AsyncBlockReader(FLAGS_async_block_reader_num_threads) {
+}
+
+AsyncBlockReader::AsyncBlockReader(int num_threads) {
+  CHECK_OK(ThreadPoolBuilder("async-block-read")
+           .set_min_threads(0)
+           .set_max_threads(num_threads)
+           .Build(&pool_));
+}
+
+AsyncBlockReader::~AsyncBlockReader() {
+  pool_->Shutdown();
+}
+
+void AsyncBlockReader::ReadVAsync(const ReadableBlock* block, uint64_t offset,
+                                  vector<Slice>* results, bool uncached,
+                                  const StatusCallback& cb) {
+  auto read = [block, offset, results, uncached, cb]() {
+    cb.Run(uncached ? block->ReadVUncached(offset, results) : block->ReadV(offset, results));
+  };
+  Status s = pool_->SubmitFunc(read);
+  if (PREDICT_FALSE(!s.ok())) {
+    // The pool is shutting down or its queue is full; read synchronously.
+    read();
+  }
+}
+
+} // namespace fs
+} // namespace kudu
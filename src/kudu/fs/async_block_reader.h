@@ -0,0 +1,74 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_FS_ASYNC_BLOCK_READER_H
+#define KUDU_FS_ASYNC_BLOCK_READER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/singleton.h"
+#include "kudu/util/status_callback.h"
+
+namespace kudu {
+
+class Slice;
+class ThreadPool;
+
+namespace fs {
+
+class ReadableBlock;
+
+// Issues reads of ReadableBlocks which complete in the background, so that a
+// single thread can keep several reads outstanding on a device.
+//
+// Reads are issued by a process-wide pool of threads, each of which performs
+// one synchronous read at a time.
+class AsyncBlockReader {
+ public:
+  static AsyncBlockReader* GetSingleton() {
+    return Singleton<AsyncBlockReader>::get();
+  }
+
+  explicit AsyncBlockReader(int num_threads);
+  ~AsyncBlockReader();
+
+  // Reads into 'results' from 'block', beginning at 'offset', as
+  // ReadableBlock::ReadV() does (or ReadableBlock::ReadVUncached(), if
+  // 'uncached' is set), and invokes 'cb' with the outcome.
+  //
+  // 'cb' is usually invoked on one of the reader's threads, but is invoked on
+  // the calling thread if the read couldn't be queued. 'block' and 'results'
+  // must remain alive until 'cb' has been invoked.
+  void ReadVAsync(const ReadableBlock* block, uint64_t offset,
+                  std::vector<Slice>* results, bool uncached,
+                  const StatusCallback& cb);
+
+ private:
+  friend class Singleton<AsyncBlockReader>;
+  AsyncBlockReader();
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncBlockReader);
+};
+
+} // namespace fs
+} // namespace kudu
+
+#endif
@@ -21,6 +21,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/fs/async_block_reader.h"
 #include "kudu/fs/file_block_manager.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/log_block_manager.h"
@@ -28,12 +29,15 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
+#include "kudu/util/async_util.h"
 #include "kudu/util/env_util.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 #include "kudu/util/thread.h"
@@ -59,7 +63,13 @@ DECLARE_int32(fs_data_dirs_full_disk_cache_seconds);
 
 DECLARE_string(block_manager);
 
+DECLARE_bool(block_manager_direct_io_uncached_reads);
+DECLARE_bool(block_manager_direct_io_writes);
+DECLARE_int32(block_manager_direct_io_write_buffer_bytes);
+
 DECLARE_double(env_inject_io_error_on_write_or_preallocate);
+DECLARE_double(log_container_live_data_before_compact_ratio);
+DECLARE_int32(log_container_compaction_inject_failure_at_step);
 
 // Generic block manager metrics.
 METRIC_DECLARE_gauge_uint64(block_manager_blocks_open_reading);
@@ -74,6 +84,8 @@ METRIC_DECLARE_gauge_uint64(log_block_manager_bytes_under_management);
 METRIC_DECLARE_gauge_uint64(log_block_manager_blocks_under_management);
 METRIC_DECLARE_counter(log_block_manager_containers);
 METRIC_DECLARE_counter(log_block_manager_full_containers);
+METRIC_DECLARE_counter(log_block_manager_metadata_compactions);
+METRIC_DECLARE_counter(log_block_manager_container_compactions);
 
 // Data directory metrics.
 METRIC_DECLARE_gauge_uint64(data_dirs_full);
@@ -441,6 +453,104 @@ TYPED_TEST(BlockManagerTest, EndToEndTest) {
               .IsNotFound());
 }
 
+// Test that vectored reads fill their slices in order and are bounded by
+// the block, even when other blocks follow it in the same file.
+TYPED_TEST(BlockManagerTest, ReadVTest) {
+  gscoped_ptr<WritableBlock> written_block;
+  ASSERT_OK(this->bm_->CreateBlock(&written_block));
+  string test_data = "0123456789abcdef";
+  ASSERT_OK(written_block->Append(test_data));
+  ASSERT_OK(written_block->Close());
+  gscoped_ptr<WritableBlock> other_block;
+  ASSERT_OK(this->bm_->CreateBlock(&other_block));
+  ASSERT_OK(other_block->Append("other data"));
+  ASSERT_OK(other_block->Close());
+
+  gscoped_ptr<ReadableBlock> read_block;
+  ASSERT_OK(this->bm_->OpenBlock(written_block->id(), &read_block));
+  uint8_t scratch[12];
+  vector<Slice> results = { Slice(scratch, 3), Slice(scratch + 3, 0),
+                            Slice(scratch + 3, 9) };
+  ASSERT_OK(read_block->ReadV(2, &results));
+  ASSERT_EQ("234", results[0].ToString());
+  ASSERT_EQ("56789abcd", results[2].ToString());
+
+  // A read past the end of the block fails.
+  ASSERT_FALSE(read_block->ReadV(5, &results).ok());
+
+  // The same reads may be issued in the background.
+  AsyncBlockReader async_reader(2);
+  memset(scratch, 0, sizeof(scratch));
+  Synchronizer s;
+  async_reader.ReadVAsync(read_block.get(), 2, &results, /* uncached= */ false,
+                          s.AsStatusCallback());
+  ASSERT_OK(s.Wait());
+  ASSERT_EQ("234", results[0].ToString());
+  ASSERT_EQ("56789abcd", results[2].ToString());
+  Synchronizer s2;
+  async_reader.ReadVAsync(read_block.get(), 5, &results, /* uncached= */ false,
+                          s2.AsStatusCallback());
+  ASSERT_FALSE(s2.Wait().ok());
+}
+
+// Test that blocks written and read with direct I/O read back the data that
+// was written. Where the filesystem doesn't support direct I/O, both are done
+// through the page cache instead.
+TYPED_TEST(BlockManagerTest, DirectIOTest) {
+  FLAGS_block_manager_direct_io_writes = true;
+  FLAGS_block_manager_direct_io_uncached_reads = true;
+  FLAGS_block_manager_direct_io_write_buffer_bytes = 8192;
+  Random rand(SeedRandom());
+
+  // Write blocks whose sizes aren't aligned, so that each one's padding
+  // would overwrite the start of the next if it weren't placed correctly.
+  vector<BlockId> ids;
+  vector<string> contents;
+  for (int i = 0; i < 10; i++) {
+    gscoped_ptr<WritableBlock> written_block;
+    ASSERT_OK(this->bm_->CreateBlock(&written_block));
+    string data;
+    for (int j = 0; j < 5; j++) {
+      string chunk(1 + rand.Uniform(10000), '\0');
+      RandomString(&chunk[0], chunk.size(), &rand);
+      ASSERT_OK(written_block->Append(chunk));
+      data += chunk;
+    }
+    if (i % 2 == 0) {
+      ASSERT_OK(written_block->FlushDataAsync());
+    }
+    ASSERT_OK(written_block->Close());
+    ids.push_back(written_block->id());
+    contents.push_back(std::move(data));
+  }
+
+  for (int i = 0; i < ids.size(); i++) {
+    const string& data = contents[i];
+    gscoped_ptr<ReadableBlock> read_block;
+    ASSERT_OK(this->bm_->OpenBlock(ids[i], &read_block));
+    uint64_t size;
+    ASSERT_OK(read_block->Size(&size));
+    ASSERT_EQ(data.size(), size);
+
+    unique_ptr<uint8_t[]> scratch(new uint8_t[size]);
+    vector<Slice> results = { Slice(scratch.get(), size) };
+    ASSERT_OK(read_block->ReadV(0, &results));
+    ASSERT_EQ(data, results[0].ToString());
+
+    uint64_t offset = rand.Uniform(size);
+    size_t length = rand.Uniform(size - offset + 1);
+    size_t first = rand.Uniform(length + 1);
+    results = { Slice(scratch.get(), first), Slice(scratch.get() + first, length - first) };
+    ASSERT_OK(read_block->ReadVUncached(offset, &results));
+    ASSERT_EQ(data.substr(offset, length),
+              results[0].ToString() + results[1].ToString());
+
+    // A read past the end of the block fails.
+    results = { Slice(scratch.get(), 2) };
+    ASSERT_FALSE(read_block->ReadVUncached(size - 1, &results).ok());
+  }
+}
+
 // Test that we can still read from an opened block after deleting it
 // (even if we can't open it again).
 TYPED_TEST(BlockManagerTest, ReadAfterDeleteTest) {
@@ -1313,6 +1423,375 @@ TEST_F(LogBlockManagerTest, TestContainerWithManyHoles) {
   }
 }
 
+// Containers whose metadata records are mostly for deleted blocks should have
+// their metadata compacted when the block manager is opened, without losing
+// any of their live blocks.
+TEST_F(LogBlockManagerTest, TestMetadataCompaction) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  // Containers with a block limit are never compacted.
+  FLAGS_log_container_max_blocks = 0;
+
+  // Create some blocks in a single container, and delete most of them,
+  // including the last one.
+  const int kNumBlocks = 20;
+  vector<BlockId> ids;
+  for (int i = 0; i < kNumBlocks; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append(Substitute("block $0", i)));
+    ASSERT_OK(writer->Close());
+    ids.push_back(writer->id());
+  }
+  ASSERT_EQ(1, bm_->all_containers_.size());
+  for (int i = 0; i < kNumBlocks; i++) {
+    if (i % 4 != 1) {
+      ASSERT_OK(bm_->DeleteBlock(ids[i]));
+    }
+  }
+  string metadata_path =
+      LogBlockManager::ContainerPathForTests(bm_->all_containers_.front()) +
+      LogBlockManager::kContainerMetadataFileSuffix;
+  uint64_t old_meta_size;
+  ASSERT_OK(env_->GetFileSize(metadata_path, &old_meta_size));
+
+  auto check_blocks = [&]() {
+    for (int i = 0; i < kNumBlocks; i++) {
+      gscoped_ptr<ReadableBlock> block;
+      Status s = bm_->OpenBlock(ids[i], &block);
+      if (i % 4 != 1) {
+        ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+        continue;
+      }
+      ASSERT_OK(s);
+      string expected = Substitute("block $0", i);
+      Slice data;
+      gscoped_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+      ASSERT_OK(block->Read(0, expected.size(), &data, scratch.get()));
+      ASSERT_EQ(expected, data);
+    }
+  };
+
+  // Reopening the block manager compacts the metadata file.
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(ReopenBlockManager(entity,
+                               shared_ptr<MemTracker>(),
+                               { test_dir_ },
+                               false));
+  ASSERT_EQ(1, down_cast<Counter*>(
+                entity->FindOrNull(METRIC_log_block_manager_metadata_compactions)
+                .get())->value());
+  uint64_t new_meta_size;
+  ASSERT_OK(env_->GetFileSize(metadata_path, &new_meta_size));
+  ASSERT_LT(new_meta_size, old_meta_size);
+  ASSERT_EQ(kNumBlocks / 4, bm_->CountBlocksForTests());
+  NO_FATALS(check_blocks());
+
+  // The container can still be written to after its metadata was replaced,
+  // and there's nothing left to compact the next time it's opened.
+  {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append("new block"));
+    ASSERT_OK(writer->Close());
+  }
+  MetricRegistry new_registry;
+  scoped_refptr<MetricEntity> new_entity = METRIC_ENTITY_server.Instantiate(&new_registry, "test");
+  ASSERT_OK(ReopenBlockManager(new_entity,
+                               shared_ptr<MemTracker>(),
+                               { test_dir_ },
+                               false));
+  ASSERT_EQ(0, down_cast<Counter*>(
+                new_entity->FindOrNull(METRIC_log_block_manager_metadata_compactions)
+                .get())->value());
+  ASSERT_EQ(kNumBlocks / 4 + 1, bm_->CountBlocksForTests());
+  NO_FATALS(check_blocks());
+  NO_FATALS(AssertNumContainers(1));
+}
+
+TEST_F(LogBlockManagerTest, TestContainerCompaction) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  FLAGS_log_container_max_blocks = 10;
+  FLAGS_log_container_live_data_before_compact_ratio = 0.5;
+  auto reopen = [&](scoped_refptr<MetricEntity>* entity, MetricRegistry* registry) {
+    *entity = METRIC_ENTITY_server.Instantiate(registry, "test");
+    return ReopenBlockManager(*entity, shared_ptr<MemTracker>(), { test_dir_ }, false);
+  };
+  auto compactions = [](const scoped_refptr<MetricEntity>& entity) {
+    return down_cast<Counter*>(
+        entity->FindOrNull(METRIC_log_block_manager_container_compactions).get())->value();
+  };
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity;
+  ASSERT_OK(reopen(&entity, &registry));
+
+  // Fill a container, and delete most of its blocks.
+  const int kNumBlocks = 10;
+  vector<BlockId> ids;
+  for (int i = 0; i < kNumBlocks; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append(Substitute("block $0", i)));
+    ASSERT_OK(writer->Close());
+    ids.push_back(writer->id());
+  }
+  ASSERT_EQ(1, bm_->all_containers_.size());
+  for (int i = 0; i < kNumBlocks; i++) {
+    if (i % 4 != 1) {
+      ASSERT_OK(bm_->DeleteBlock(ids[i]));
+    }
+  }
+
+  auto check_blocks = [&]() {
+    for (int i = 0; i < kNumBlocks; i++) {
+      gscoped_ptr<ReadableBlock> block;
+      Status s = bm_->OpenBlock(ids[i], &block);
+      if (i % 4 != 1) {
+        ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+        continue;
+      }
+      ASSERT_OK(s);
+      string expected = Substitute("block $0", i);
+      Slice data;
+      gscoped_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+      ASSERT_OK(block->Read(0, expected.size(), &data, scratch.get()));
+      ASSERT_EQ(expected, data);
+    }
+  };
+
+  // Save the container's files, to simulate a crash before the compaction
+  // deletes them later on.
+  string common_path = LogBlockManager::ContainerPathForTests(bm_->all_containers_.front());
+  vector<string> paths = { common_path + LogBlockManager::kContainerMetadataFileSuffix,
+                           common_path + LogBlockManager::kContainerDataFileSuffix };
+  for (const string& path : paths) {
+    ASSERT_OK(env_util::CopyFile(env_, path, path + ".saved", WritableFileOptions()));
+  }
+
+  // Compact the container while one of its blocks is open. The live blocks
+  // are copied into a new container, and the old one is gone.
+  gscoped_ptr<ReadableBlock> open_block;
+  ASSERT_OK(bm_->OpenBlock(ids[1], &open_block));
+  ASSERT_OK(bm_->CompactSparsestContainer());
+  ASSERT_EQ(1, compactions(entity));
+  ASSERT_EQ(1, bm_->all_containers_.size());
+  ASSERT_NE(common_path,
+            LogBlockManager::ContainerPathForTests(bm_->all_containers_.front()));
+  ASSERT_EQ(kNumBlocks / 4 + 1, bm_->CountBlocksForTests());
+  NO_FATALS(check_blocks());
+
+  // The open block can still be read.
+  {
+    string expected = "block 1";
+    Slice data;
+    gscoped_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+    ASSERT_OK(open_block->Read(0, expected.size(), &data, scratch.get()));
+    ASSERT_EQ(expected, data);
+  }
+  open_block.reset();
+
+  // There's nothing left to compact.
+  ASSERT_OK(bm_->CompactSparsestContainer());
+  ASSERT_EQ(1, compactions(entity));
+
+  // Restore the old container's files, as if the server had crashed before
+  // the compaction deleted them. The copies of the blocks supersede the
+  // originals.
+  bm_.reset();
+  for (const string& path : paths) {
+    ASSERT_OK(env_->RenameFile(path + ".saved", path));
+  }
+  MetricRegistry new_registry;
+  ASSERT_OK(reopen(&entity, &new_registry));
+  ASSERT_EQ(kNumBlocks / 4 + 1, bm_->CountBlocksForTests());
+  NO_FATALS(check_blocks());
+  NO_FATALS(AssertNumContainers(2));
+
+  // The originals' deletion was recorded, so the old container no longer
+  // has any live blocks and is compacted away.
+  MetricRegistry last_registry;
+  ASSERT_OK(reopen(&entity, &last_registry));
+  ASSERT_EQ(kNumBlocks / 4 + 1, bm_->CountBlocksForTests());
+  ASSERT_OK(bm_->CompactSparsestContainer());
+  ASSERT_EQ(1, compactions(entity));
+  NO_FATALS(check_blocks());
+  NO_FATALS(AssertNumContainers(1));
+}
+
+// A compaction that fails after recording the copies of the blocks keeps
+// using the originals, and must leave the copies' data in place unless
+// their deletion is durable: after a crash, a recorded copy supersedes its
+// original.
+TEST_F(LogBlockManagerTest, TestContainerCompactionFailures) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  FLAGS_log_container_max_blocks = 10;
+  FLAGS_log_container_live_data_before_compact_ratio = 0.5;
+  const int kNumBlocks = 10;
+  const int kNumSteps = 4;
+  for (int step = 0; step < kNumSteps; step++) {
+    SCOPED_TRACE(Substitute("failing at step $0", step));
+    FLAGS_log_container_compaction_inject_failure_at_step = -1;
+    string dir = GetTestPath(Substitute("step-$0", step));
+    ASSERT_OK(env_->CreateDir(dir));
+    ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                                 shared_ptr<MemTracker>(),
+                                 { dir },
+                                 true));
+
+    // Fill a container, and delete most of its blocks.
+    vector<BlockId> ids;
+    for (int i = 0; i < kNumBlocks; i++) {
+      gscoped_ptr<WritableBlock> writer;
+      ASSERT_OK(bm_->CreateBlock(&writer));
+      ASSERT_OK(writer->Append(Substitute("block $0", i)));
+      ASSERT_OK(writer->Close());
+      ids.push_back(writer->id());
+    }
+    for (int i = 0; i < kNumBlocks; i++) {
+      if (i % 4 != 1) {
+        ASSERT_OK(bm_->DeleteBlock(ids[i]));
+      }
+    }
+    internal::LogBlockContainer* source = bm_->all_containers_.front();
+
+    auto check_blocks = [&]() {
+      for (int i = 0; i < kNumBlocks; i++) {
+        gscoped_ptr<ReadableBlock> block;
+        Status s = bm_->OpenBlock(ids[i], &block);
+        if (i % 4 != 1) {
+          ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+          continue;
+        }
+        ASSERT_OK(s);
+        string expected = Substitute("block $0", i);
+        Slice data;
+        gscoped_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+        ASSERT_OK(block->Read(0, expected.size(), &data, scratch.get()));
+        ASSERT_EQ(expected, data);
+      }
+    };
+
+    FLAGS_log_container_compaction_inject_failure_at_step = step;
+    Status s = bm_->CompactSparsestContainer();
+    ASSERT_TRUE(s.IsIOError()) << s.ToString();
+    ASSERT_EQ(2, bm_->all_containers_.size());
+    NO_FATALS(check_blocks());
+
+    // When the copies' metadata can't be synced, neither can the deletion of
+    // the copies, so their data must still be there.
+    if (step == 0) {
+      internal::LogBlockContainer* dest = bm_->all_containers_.front() == source ?
+          bm_->all_containers_.back() : bm_->all_containers_.front();
+      faststring data;
+      ASSERT_OK(ReadFileToString(env_, LogBlockManager::ContainerPathForTests(dest) +
+                                 LogBlockManager::kContainerDataFileSuffix, &data));
+      string contents = data.ToString();
+      for (int i = 1; i < kNumBlocks; i += 4) {
+        ASSERT_NE(string::npos, contents.find(Substitute("block $0", i))) << i;
+      }
+    }
+
+    // The originals are used after a restart as well.
+    FLAGS_log_container_compaction_inject_failure_at_step = -1;
+    ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                                 shared_ptr<MemTracker>(),
+                                 { dir },
+                                 false));
+    NO_FATALS(check_blocks());
+
+    // The container can still be compacted.
+    ASSERT_OK(bm_->CompactSparsestContainer());
+    NO_FATALS(check_blocks());
+  }
+}
+
+// The sparsest container is tracked as blocks are deleted, rather than found
+// by scanning all containers.
+TEST_F(LogBlockManagerTest, TestFindSparsestContainer) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  FLAGS_log_container_max_blocks = 4;
+  FLAGS_log_container_live_data_before_compact_ratio = 0.6;
+
+  // Fill two containers, the first with blocks 0-3 and the second with
+  // blocks 4-7.
+  const int kNumBlocks = 8;
+  vector<BlockId> ids;
+  for (int i = 0; i < kNumBlocks; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append(Substitute("block $0", i)));
+    ASSERT_OK(writer->Close());
+    ids.push_back(writer->id());
+  }
+  ASSERT_EQ(2, bm_->all_containers_.size());
+  internal::LogBlockContainer* first = bm_->all_containers_[0];
+  internal::LogBlockContainer* second = bm_->all_containers_[1];
+
+  auto find_sparsest = [&]() {
+    std::lock_guard<simple_spinlock> l(bm_->lock_);
+    int64_t dead_bytes = 0;
+    return bm_->FindSparsestContainerUnlocked(&dead_bytes);
+  };
+  ASSERT_EQ(nullptr, find_sparsest());
+
+  // A container is found once its live data falls below the threshold.
+  ASSERT_OK(bm_->DeleteBlock(ids[0]));
+  ASSERT_EQ(nullptr, find_sparsest());
+  ASSERT_OK(bm_->DeleteBlock(ids[1]));
+  ASSERT_EQ(first, find_sparsest());
+
+  // A sparser container takes over.
+  for (int i = 4; i < 7; i++) {
+    ASSERT_OK(bm_->DeleteBlock(ids[i]));
+  }
+  ASSERT_EQ(second, find_sparsest());
+
+  // It's found again after a restart.
+  string second_path = LogBlockManager::ContainerPathForTests(second);
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { test_dir_ },
+                               false));
+  internal::LogBlockContainer* sparsest = find_sparsest();
+  ASSERT_NE(nullptr, sparsest);
+  ASSERT_EQ(second_path, LogBlockManager::ContainerPathForTests(sparsest));
+
+  // The threshold can change at runtime.
+  FLAGS_log_container_live_data_before_compact_ratio = 0.1;
+  ASSERT_EQ(nullptr, find_sparsest());
+}
+
+// A data file with no metadata file, which a crash during a container
+// compaction leaves behind, is deleted at startup.
+TEST_F(LogBlockManagerTest, TestDeleteOrphanedDataFiles) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  gscoped_ptr<WritableBlock> writer;
+  ASSERT_OK(bm_->CreateBlock(&writer));
+  ASSERT_OK(writer->Append("data"));
+  ASSERT_OK(writer->Close());
+  BlockId id = writer->id();
+  writer.reset();
+
+  string orphan = JoinPathSegments(test_dir_,
+                                   Substitute("orphan$0",
+                                              LogBlockManager::kContainerDataFileSuffix));
+  ASSERT_OK(WriteStringToFile(env_, "garbage", orphan));
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { test_dir_ },
+                               false));
+  ASSERT_FALSE(env_->FileExists(orphan));
+  NO_FATALS(AssertNumContainers(1));
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(bm_->OpenBlock(id, &block));
+}
+
 TEST_F(LogBlockManagerTest, TestParseKernelRelease) {
   ASSERT_TRUE(LogBlockManager::IsBuggyEl6Kernel("1.7.0.0.el6.x86_64"));
 
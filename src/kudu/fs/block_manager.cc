@@ -17,14 +17,18 @@
 
 #include "kudu/fs/block_manager.h"
 
+#include <algorithm>
 #include <mutex>
 
 #include <glog/logging.h>
 
 #include "kudu/gutil/integral_types.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/alignment.h"
+#include "kudu/util/direct_io.h"
 #include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 
 DEFINE_bool(block_coalesce_close, false,
@@ -43,6 +47,32 @@ DEFINE_int64(block_manager_max_open_files, -1,
 TAG_FLAG(block_manager_max_open_files, advanced);
 TAG_FLAG(block_manager_max_open_files, evolving);
 
+DEFINE_bool(block_manager_direct_io_writes, false,
+            "Whether to write data blocks with direct I/O, bypassing the operating "
+            "system's page cache, so that large flushes and compactions don't evict "
+            "data which is being read from it. Where the filesystem doesn't support "
+            "direct I/O, blocks are written through the page cache.");
+TAG_FLAG(block_manager_direct_io_writes, advanced);
+TAG_FLAG(block_manager_direct_io_writes, experimental);
+TAG_FLAG(block_manager_direct_io_writes, runtime);
+
+DEFINE_int32(block_manager_direct_io_write_buffer_bytes, 256 * 1024,
+             "Size of the buffer in which each data block written with direct I/O "
+             "accumulates data before it is written out. Rounded up to a multiple of "
+             "4 KiB.");
+TAG_FLAG(block_manager_direct_io_write_buffer_bytes, advanced);
+TAG_FLAG(block_manager_direct_io_write_buffer_bytes, experimental);
+
+DEFINE_bool(block_manager_direct_io_uncached_reads, false,
+            "Whether to read data which won't be kept in the block cache, such as the "
+            "inputs of compactions, with direct I/O, so that it doesn't evict other "
+            "data from the operating system's page cache.");
+TAG_FLAG(block_manager_direct_io_uncached_reads, advanced);
+TAG_FLAG(block_manager_direct_io_uncached_reads, experimental);
+TAG_FLAG(block_manager_direct_io_uncached_reads, runtime);
+
+using std::string;
+using std::unique_ptr;
 using strings::Substitute;
 
 namespace kudu {
@@ -78,5 +108,36 @@ int64_t GetFileCacheCapacityForBlockManager(Env* env) {
   return FLAGS_block_manager_max_open_files;
 }
 
+void OpenBlockFileForDirectWrite(Env* env, const string& path, unique_ptr<RWFile>* file) {
+  RWFileOptions opts;
+  opts.mode = Env::OPEN_EXISTING;
+  opts.direct_io = true;
+  Status s = env->NewRWFile(opts, path, file);
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << "Unable to write block with direct I/O, "
+                                   << "writing through the page cache instead: "
+                                   << s.ToString() << THROTTLE_MSG;
+    file->reset();
+  }
+}
+
+void OpenBlockFileForDirectRead(Env* env, const string& path,
+                                unique_ptr<RandomAccessFile>* file) {
+  RandomAccessFileOptions opts;
+  opts.direct_io = true;
+  Status s = env->NewRandomAccessFile(opts, path, file);
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << "Unable to read block with direct I/O, "
+                                   << "reading through the page cache instead: "
+                                   << s.ToString() << THROTTLE_MSG;
+    file->reset();
+  }
+}
+
+size_t GetDirectIOWriteBufferSize() {
+  size_t size = std::max(FLAGS_block_manager_direct_io_write_buffer_bytes, 1);
+  return KUDU_ALIGN_UP(size, kDirectIOAlignment);
+}
+
 } // namespace fs
 } // namespace kudu
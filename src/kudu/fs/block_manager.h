@@ -36,8 +36,11 @@ DECLARE_bool(block_coalesce_close);
 namespace kudu {
 
 class Env;
+class MaintenanceManager;
 class MemTracker;
 class MetricEntity;
+class RandomAccessFile;
+class RWFile;
 class Slice;
 
 namespace fs {
@@ -153,6 +156,19 @@ class ReadableBlock : public Block {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const = 0;
 
+  // Like Read(), but reads the sum of the sizes of 'results' contiguous
+  // bytes beginning from 'offset' in a single request, filling each slice's
+  // buffer in turn. Returns an error if fewer bytes exist.
+  virtual Status ReadV(uint64_t offset, std::vector<Slice>* results) const = 0;
+
+  // Like ReadV(), but for data which won't be kept in the block cache, such
+  // as the inputs of a compaction. If --block_manager_direct_io_uncached_reads
+  // is set, the data is read with direct I/O so that it doesn't evict other
+  // data from the operating system's page cache.
+  virtual Status ReadVUncached(uint64_t offset, std::vector<Slice>* results) const {
+    return ReadV(offset, results);
+  }
+
   // Returns the memory usage of this object including the object itself.
   virtual size_t memory_footprint() const = 0;
 };
@@ -238,6 +254,14 @@ class BlockManager {
   //
   // On success, guarantees that outstanding data is durable.
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) = 0;
+
+  // Registers any background maintenance operations that this block manager
+  // needs with 'maintenance_manager'. Does nothing by default.
+  virtual void RegisterMaintenanceOps(MaintenanceManager* maintenance_manager) {}
+
+  // Unregisters the operations registered by RegisterMaintenanceOps(), if
+  // any, waiting for those that are running to finish.
+  virtual void UnregisterMaintenanceOps() {}
 };
 
 // Closes a group of blocks.
@@ -282,6 +306,21 @@ class ScopedWritableBlockCloser {
 // using resource limits obtained from the system.
 int64_t GetFileCacheCapacityForBlockManager(Env* env);
 
+// Opens the existing block file at 'path' for writing with direct I/O.
+// Leaves 'file' unset if that isn't possible (e.g. the filesystem doesn't
+// support direct I/O), in which case the block should be written through the
+// page cache.
+void OpenBlockFileForDirectWrite(Env* env, const std::string& path,
+                                 std::unique_ptr<RWFile>* file);
+
+// Like OpenBlockFileForDirectWrite(), but for reading.
+void OpenBlockFileForDirectRead(Env* env, const std::string& path,
+                                std::unique_ptr<RandomAccessFile>* file);
+
+// Returns the buffer size with which blocks are written with direct I/O. See
+// --block_manager_direct_io_write_buffer_bytes.
+size_t GetDirectIOWriteBufferSize();
+
 } // namespace fs
 } // namespace kudu
 
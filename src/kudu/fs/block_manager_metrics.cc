@@ -49,6 +49,20 @@ METRIC_DEFINE_counter(server, block_manager_total_bytes_read,
                       kudu::MetricUnit::kBytes,
                       "Number of bytes of block data read since service start");
 
+METRIC_DEFINE_counter(server, block_manager_total_bytes_written_direct,
+                      "Block Data Bytes Written With Direct I/O",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of block data written with direct I/O, bypassing "
+                      "the operating system's page cache, since service start. Included "
+                      "in block_manager_total_bytes_written.");
+
+METRIC_DEFINE_counter(server, block_manager_total_bytes_read_direct,
+                      "Block Data Bytes Read With Direct I/O",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of block data read with direct I/O, bypassing "
+                      "the operating system's page cache, since service start. Included "
+                      "in block_manager_total_bytes_read.");
+
 namespace kudu {
 namespace fs {
 namespace internal {
@@ -61,7 +75,9 @@ BlockManagerMetrics::BlockManagerMetrics(const scoped_refptr<MetricEntity>& enti
     MINIT(total_readable_blocks),
     MINIT(total_writable_blocks),
     MINIT(total_bytes_read),
-    MINIT(total_bytes_written) {
+    MINIT(total_bytes_written),
+    MINIT(total_bytes_read_direct),
+    MINIT(total_bytes_written_direct) {
 }
 #undef GINIT
 #undef MINIT
@@ -41,6 +41,8 @@ struct BlockManagerMetrics {
   scoped_refptr<Counter> total_writable_blocks;
   scoped_refptr<Counter> total_bytes_read;
   scoped_refptr<Counter> total_bytes_written;
+  scoped_refptr<Counter> total_bytes_read_direct;
+  scoped_refptr<Counter> total_bytes_written_direct;
 };
 
 } // namespace internal
@@ -25,6 +25,7 @@
 #include "kudu/fs/data_dirs.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/direct_io.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/file_cache.h"
@@ -37,11 +38,14 @@
 
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(block_manager_lock_dirs);
+DECLARE_bool(block_manager_direct_io_uncached_reads);
+DECLARE_bool(block_manager_direct_io_writes);
 
 namespace kudu {
 namespace fs {
@@ -204,10 +208,13 @@ void FileBlockLocation::GetAllParentDirs(vector<string>* parent_dirs) const {
 // at Close() time. Embedding a FileBlockLocation (and not a simpler
 // BlockId) consumes more memory, but the number of outstanding
 // FileWritableBlock instances is expected to be low.
+//
+// If opened with a 'direct_file', the block's data is written with direct
+// I/O through that file rather than through 'writer'.
 class FileWritableBlock : public WritableBlock {
  public:
   FileWritableBlock(FileBlockManager* block_manager, FileBlockLocation location,
-                    shared_ptr<WritableFile> writer);
+                    shared_ptr<WritableFile> writer, unique_ptr<RWFile> direct_file);
 
   virtual ~FileWritableBlock();
 
@@ -247,6 +254,12 @@ class FileWritableBlock : public WritableBlock {
   // The underlying opened file backing this block.
   shared_ptr<WritableFile> writer_;
 
+  // Another handle on the same file, opened with direct I/O, and the writer
+  // which buffers appends to it. Unset if the block is written through
+  // 'writer_'.
+  unique_ptr<RWFile> direct_file_;
+  unique_ptr<DirectFileWriter> direct_writer_;
+
   State state_;
 
   // The number of bytes successfully appended to the block.
@@ -257,12 +270,18 @@ class FileWritableBlock : public WritableBlock {
 
 FileWritableBlock::FileWritableBlock(FileBlockManager* block_manager,
                                      FileBlockLocation location,
-                                     shared_ptr<WritableFile> writer)
+                                     shared_ptr<WritableFile> writer,
+                                     unique_ptr<RWFile> direct_file)
     : block_manager_(block_manager),
       location_(std::move(location)),
       writer_(std::move(writer)),
+      direct_file_(std::move(direct_file)),
       state_(CLEAN),
       bytes_appended_(0) {
+  if (direct_file_) {
+    direct_writer_.reset(new DirectFileWriter(direct_file_.get(), 0,
+                                              GetDirectIOWriteBufferSize()));
+  }
   if (block_manager_->metrics_) {
     block_manager_->metrics_->blocks_open_writing->Increment();
     block_manager_->metrics_->total_writable_blocks->Increment();
@@ -297,7 +316,11 @@ Status FileWritableBlock::Append(const Slice& data) {
   DCHECK(state_ == CLEAN || state_ == DIRTY)
       << "Invalid state: " << state_;
 
-  RETURN_NOT_OK(writer_->Append(data));
+  if (direct_writer_) {
+    RETURN_NOT_OK(direct_writer_->Append(data));
+  } else {
+    RETURN_NOT_OK(writer_->Append(data));
+  }
   RETURN_NOT_OK(location_.data_dir()->RefreshIsFull(
       DataDir::RefreshMode::ALWAYS));
   state_ = DIRTY;
@@ -310,7 +333,13 @@ Status FileWritableBlock::FlushDataAsync() {
       << "Invalid state: " << state_;
   if (state_ == DIRTY) {
     VLOG(3) << "Flushing block " << id();
-    RETURN_NOT_OK(writer_->Flush(WritableFile::FLUSH_ASYNC));
+    if (direct_writer_) {
+      // Direct writes bypass the page cache, so writing out the buffer is
+      // all that's needed to start the data on its way to disk.
+      RETURN_NOT_OK(direct_writer_->Flush());
+    } else {
+      RETURN_NOT_OK(writer_->Flush(WritableFile::FLUSH_ASYNC));
+    }
   }
 
   state_ = FLUSHING;
@@ -331,12 +360,20 @@ Status FileWritableBlock::Close(SyncMode mode) {
   }
 
   Status sync;
-  if (mode == SYNC &&
+  if (direct_writer_) {
+    // Write out whatever is still buffered, then cut off the padding which
+    // follows the data.
+    sync = direct_writer_->Flush();
+    if (sync.ok()) {
+      sync = direct_file_->Truncate(bytes_appended_);
+    }
+  }
+  if (sync.ok() && mode == SYNC &&
       (state_ == CLEAN || state_ == DIRTY || state_ == FLUSHING)) {
     // Safer to synchronize data first, then metadata.
     VLOG(3) << "Syncing block " << id();
     if (FLAGS_enable_data_block_fsync) {
-      sync = writer_->Sync();
+      sync = direct_file_ ? direct_file_->Sync() : writer_->Sync();
     }
     if (sync.ok()) {
       sync = block_manager_->SyncMetadata(location_);
@@ -345,13 +382,24 @@ Status FileWritableBlock::Close(SyncMode mode) {
                                  id().ToString()));
   }
   Status close = writer_->Close();
+  if (direct_file_) {
+    Status direct_close = direct_file_->Close();
+    if (close.ok()) {
+      close = direct_close;
+    }
+  }
 
   state_ = CLOSED;
   writer_.reset();
   if (block_manager_->metrics_) {
     block_manager_->metrics_->blocks_open_writing->Decrement();
     block_manager_->metrics_->total_bytes_written->IncrementBy(BytesAppended());
+    if (direct_writer_) {
+      block_manager_->metrics_->total_bytes_written_direct->IncrementBy(BytesAppended());
+    }
   }
+  direct_writer_.reset();
+  direct_file_.reset();
 
   // Prefer the result of Close() to that of Sync().
   return !close.ok() ? close : sync;
@@ -382,6 +430,10 @@ class FileReadableBlock : public ReadableBlock {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE;
 
+  virtual Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE;
+
+  virtual Status ReadVUncached(uint64_t offset, vector<Slice>* results) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
  private:
@@ -452,6 +504,48 @@ Status FileReadableBlock::Read(uint64_t offset, size_t length,
   return Status::OK();
 }
 
+Status FileReadableBlock::ReadV(uint64_t offset, vector<Slice>* results) const {
+  DCHECK(!closed_.Load());
+
+  RETURN_NOT_OK(reader_->ReadV(offset, results));
+  if (block_manager_->metrics_) {
+    size_t length = 0;
+    for (const Slice& result : *results) {
+      length += result.size();
+    }
+    block_manager_->metrics_->total_bytes_read->IncrementBy(length);
+  }
+
+  return Status::OK();
+}
+
+Status FileReadableBlock::ReadVUncached(uint64_t offset, vector<Slice>* results) const {
+  DCHECK(!closed_.Load());
+
+  // The file is opened for each read rather than kept open alongside
+  // 'reader_', so that blocks don't hold on to more file descriptors or
+  // memory. Uncached reads are large enough for the cost not to matter.
+  unique_ptr<RandomAccessFile> direct_reader;
+  if (FLAGS_block_manager_direct_io_uncached_reads) {
+    OpenBlockFileForDirectRead(block_manager_->env_, reader_->filename(), &direct_reader);
+  }
+  if (!direct_reader) {
+    return ReadV(offset, results);
+  }
+
+  RETURN_NOT_OK(DirectReadV(direct_reader.get(), offset, results));
+  if (block_manager_->metrics_) {
+    size_t length = 0;
+    for (const Slice& result : *results) {
+      length += result.size();
+    }
+    block_manager_->metrics_->total_bytes_read->IncrementBy(length);
+    block_manager_->metrics_->total_bytes_read_direct->IncrementBy(length);
+  }
+
+  return Status::OK();
+}
+
 size_t FileReadableBlock::memory_footprint() const {
   DCHECK(reader_);
   return kudu_malloc_usable_size(this) + reader_->memory_footprint();
@@ -602,7 +696,12 @@ Status FileBlockManager::CreateBlock(const CreateBlockOptions& opts,
       }
       dirty_dirs_.insert(DirName(path));
     }
-    block->reset(new internal::FileWritableBlock(this, location, writer));
+    unique_ptr<RWFile> direct_file;
+    if (FLAGS_block_manager_direct_io_writes) {
+      OpenBlockFileForDirectWrite(env_, path, &direct_file);
+    }
+    block->reset(new internal::FileWritableBlock(this, location, writer,
+                                                 std::move(direct_file)));
   }
   return s;
 }
@@ -66,6 +66,22 @@ class CountingReadableBlock : public ReadableBlock {
     return Status::OK();
   }
 
+  virtual Status ReadV(uint64_t offset, std::vector<Slice>* results) const OVERRIDE {
+    RETURN_NOT_OK(block_->ReadV(offset, results));
+    for (const Slice& result : *results) {
+      *bytes_read_ += result.size();
+    }
+    return Status::OK();
+  }
+
+  virtual Status ReadVUncached(uint64_t offset, std::vector<Slice>* results) const OVERRIDE {
+    RETURN_NOT_OK(block_->ReadVUncached(offset, results));
+    for (const Slice& result : *results) {
+      *bytes_read_ += result.size();
+    }
+    return Status::OK();
+  }
+
   virtual size_t memory_footprint() const OVERRIDE {
     return block_->memory_footprint();
   }
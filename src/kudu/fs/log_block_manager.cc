@@ -21,6 +21,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <unordered_set>
 
 #include "kudu/fs/block_manager_metrics.h"
 #include "kudu/fs/block_manager_util.h"
@@ -37,13 +38,16 @@
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/alignment.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/direct_io.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/file_cache.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/maintenance_manager.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
@@ -52,10 +56,13 @@
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util_prod.h"
 #include "kudu/util/threadpool.h"
+#include "kudu/util/throttler.h"
 #include "kudu/util/trace.h"
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(block_manager_lock_dirs);
+DECLARE_bool(block_manager_direct_io_uncached_reads);
+DECLARE_bool(block_manager_direct_io_writes);
 
 // TODO(unknown): How should this be configured? Should provide some guidance.
 DEFINE_uint64(log_container_max_size, 10LU * 1024 * 1024 * 1024,
@@ -78,6 +85,44 @@ DEFINE_bool(log_block_manager_test_hole_punching, true,
 TAG_FLAG(log_block_manager_test_hole_punching, advanced);
 TAG_FLAG(log_block_manager_test_hole_punching, unsafe);
 
+DEFINE_int32(log_block_manager_startup_threads_per_data_dir, 4,
+             "Number of threads per data directory used to open log block "
+             "containers and load their metadata at startup");
+TAG_FLAG(log_block_manager_startup_threads_per_data_dir, advanced);
+
+DEFINE_double(log_container_live_metadata_before_compact_ratio, 0.5,
+              "If the ratio of live blocks to metadata records in a log block "
+              "container falls below this value, the container's metadata file "
+              "is rewritten at startup with just the records of its live "
+              "blocks. Set to 0 to never compact container metadata.");
+TAG_FLAG(log_container_live_metadata_before_compact_ratio, advanced);
+TAG_FLAG(log_container_live_metadata_before_compact_ratio, experimental);
+
+DEFINE_double(log_container_live_data_before_compact_ratio, 0.2,
+              "If the ratio of live block data to total data written in a full "
+              "log block container falls below this value, the container is "
+              "compacted in the background by copying its live blocks into other "
+              "containers and deleting it. Set to 0 to never compact containers.");
+TAG_FLAG(log_container_live_data_before_compact_ratio, advanced);
+TAG_FLAG(log_container_live_data_before_compact_ratio, experimental);
+TAG_FLAG(log_container_live_data_before_compact_ratio, runtime);
+
+DEFINE_int64(log_container_compaction_max_bytes_per_sec, 20 * 1024 * 1024,
+             "Maximum rate (bytes/s) at which log block container compaction "
+             "copies block data. 0 means no limit.");
+TAG_FLAG(log_container_compaction_max_bytes_per_sec, advanced);
+TAG_FLAG(log_container_compaction_max_bytes_per_sec, experimental);
+TAG_FLAG(log_container_compaction_max_bytes_per_sec, runtime);
+
+DEFINE_int32(log_container_compaction_inject_failure_at_step, -1,
+             "If non-negative, log block container compactions fail at this step "
+             "once the copies of the blocks have been recorded: 0 when syncing "
+             "the copies' metadata, 1 when syncing their directories, 2 when "
+             "truncating their containers, 3 when deleting the compacted "
+             "container's metadata. For testing only!");
+TAG_FLAG(log_container_compaction_inject_failure_at_step, hidden);
+TAG_FLAG(log_container_compaction_inject_failure_at_step, unsafe);
+
 METRIC_DEFINE_gauge_uint64(server, log_block_manager_bytes_under_management,
                            "Bytes Under Management",
                            kudu::MetricUnit::kBytes,
@@ -104,6 +149,52 @@ METRIC_DEFINE_counter(server, log_block_manager_unavailable_containers,
                       "Number of non-full log block containers that are under root paths "
                       "whose disks are full");
 
+METRIC_DEFINE_counter(server, log_block_manager_metadata_compactions,
+                      "Block Container Metadata Compactions",
+                      kudu::MetricUnit::kLogBlockContainers,
+                      "Number of log block container metadata files rewritten to drop "
+                      "the records of deleted blocks");
+
+METRIC_DEFINE_counter(server, log_block_manager_container_compactions,
+                      "Block Container Compactions",
+                      kudu::MetricUnit::kLogBlockContainers,
+                      "Number of sparse log block containers whose live blocks were "
+                      "copied into other containers so that they could be deleted");
+
+METRIC_DEFINE_counter(server, log_block_manager_container_compaction_bytes,
+                      "Block Container Compaction Bytes Copied",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of live blocks copied out of sparse log block "
+                      "containers by container compaction");
+
+METRIC_DEFINE_gauge_uint32(server, log_block_manager_container_compaction_running,
+                           "Block Container Compactions Running",
+                           kudu::MetricUnit::kMaintenanceOperations,
+                           "Number of log block container compactions currently running");
+
+METRIC_DEFINE_histogram(server, log_block_manager_container_compaction_duration,
+                        "Block Container Compaction Duration",
+                        kudu::MetricUnit::kMilliseconds,
+                        "Time spent compacting sparse log block containers", 3600000LU, 1);
+
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_startup_find_containers_duration,
+                           "Startup Container Discovery Duration",
+                           kudu::MetricUnit::kMilliseconds,
+                           "Time spent finding the log block containers in the data "
+                           "directories at startup");
+
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_startup_load_containers_duration,
+                           "Startup Container Loading Duration",
+                           kudu::MetricUnit::kMilliseconds,
+                           "Time spent opening log block containers and loading their "
+                           "metadata at startup, including metadata compaction");
+
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_startup_compact_metadata_duration,
+                           "Startup Container Metadata Compaction Duration",
+                           kudu::MetricUnit::kMilliseconds,
+                           "Time spent compacting log block container metadata files at "
+                           "startup, summed across all of the threads loading containers");
+
 namespace kudu {
 
 namespace fs {
@@ -140,6 +231,16 @@ struct LogBlockManagerMetrics {
 
   scoped_refptr<Counter> containers;
   scoped_refptr<Counter> full_containers;
+  scoped_refptr<Counter> metadata_compactions;
+  scoped_refptr<Counter> container_compactions;
+  scoped_refptr<Counter> container_compaction_bytes;
+
+  scoped_refptr<AtomicGauge<uint32_t> > container_compaction_running;
+  scoped_refptr<Histogram> container_compaction_duration;
+
+  scoped_refptr<AtomicGauge<uint64_t> > startup_find_containers_duration;
+  scoped_refptr<AtomicGauge<uint64_t> > startup_load_containers_duration;
+  scoped_refptr<AtomicGauge<uint64_t> > startup_compact_metadata_duration;
 };
 
 #define MINIT(x) x(METRIC_log_block_manager_##x.Instantiate(metric_entity))
@@ -149,7 +250,15 @@ LogBlockManagerMetrics::LogBlockManagerMetrics(const scoped_refptr<MetricEntity>
     GINIT(bytes_under_management),
     GINIT(blocks_under_management),
     MINIT(containers),
-    MINIT(full_containers) {
+    MINIT(full_containers),
+    MINIT(metadata_compactions),
+    MINIT(container_compactions),
+    MINIT(container_compaction_bytes),
+    GINIT(container_compaction_running),
+    MINIT(container_compaction_duration),
+    GINIT(startup_find_containers_duration),
+    GINIT(startup_load_containers_duration),
+    GINIT(startup_compact_metadata_duration) {
 }
 #undef GINIT
 #undef MINIT
@@ -220,10 +329,18 @@ class LogBlockContainer {
   // The on-disk effects of this call are made durable only after SyncData().
   Status WriteData(int64_t offset, const Slice& data);
 
+  // Like WriteData(), but writes with direct I/O through 'writer', which
+  // must be positioned at 'offset' in another handle on this container's
+  // data file.
+  Status WriteDataDirect(int64_t offset, const Slice& data, DirectFileWriter* writer);
+
   // See RWFile::Read().
   Status ReadData(int64_t offset, size_t length,
                   Slice* result, uint8_t* scratch) const;
 
+  // See RWFile::ReadV().
+  Status ReadVData(int64_t offset, vector<Slice>* results) const;
+
   // Appends 'pb' to this container's metadata file.
   //
   // The on-disk effects of this call are made durable only after SyncMetadata().
@@ -268,6 +385,18 @@ class LogBlockContainer {
   // returning the records.
   Status ReadContainerRecords(deque<BlockRecordPB>* records) const;
 
+  // Reads the IDs of the blocks created in this container from its
+  // metadata. Unlike ReadContainerRecords(), may be called while blocks are
+  // being deleted from the container: a partial trailing record is ignored
+  // rather than truncated.
+  Status ReadCreatedBlockIds(vector<BlockId>* block_ids) const;
+
+  // Atomically replaces the container's metadata file with one containing
+  // just 'records', and resumes appending to the new file.
+  //
+  // This function is thread unsafe.
+  Status RewriteMetadata(const vector<BlockRecordPB>& records);
+
   // Updates 'total_bytes_written_' and 'total_blocks_written_', marking this
   // container as full if needed. Should only be called when a block is fully
   // written, as it will round up the container data file's position.
@@ -285,9 +414,26 @@ class LogBlockContainer {
   // Produces a debug-friendly string representation of this container.
   string ToString() const;
 
+  // Accounts for a block in this container being added to or removed from
+  // the block manager's in-memory maps. Must hold the block manager's lock.
+  void AddLiveBlock(int64_t length);
+  void RemoveLiveBlock(int64_t length);
+
+  // Accounts for the creation and destruction of LogBlocks that refer to
+  // this container. A compacted container can't be destroyed until there
+  // are none left.
+  void LogBlockCreated() { num_log_blocks_.Increment(); }
+  void LogBlockDestroyed() { num_log_blocks_.IncrementBy(-1); }
+
   // Simple accessors.
   LogBlockManager* block_manager() const { return block_manager_; }
+  Env* env() const { return block_manager_->env(); }
   int64_t total_bytes_written() const { return total_bytes_written_; }
+  int64_t live_bytes() const { return live_bytes_; }
+  int64_t live_blocks() const { return live_blocks_; }
+  int64_t num_log_blocks() const { return num_log_blocks_.Load(); }
+  string metadata_path() const { return metadata_file_->filename(); }
+  string data_path() const { return data_file_->filename(); }
   bool full() const {
     return total_bytes_written_ >= FLAGS_log_container_max_size ||
         (max_num_blocks_ && (total_blocks_written_ >= max_num_blocks_));
@@ -297,6 +443,22 @@ class LogBlockContainer {
   DataDir* mutable_data_dir() const { return data_dir_; }
   const PathInstanceMetadataPB* instance() const { return data_dir_->instance()->metadata(); }
 
+  // Whether the container is full and will no longer be written to, and
+  // whether it is being compacted. Must hold the block manager's lock.
+  bool sealed() const { return sealed_; }
+  void set_sealed();
+  bool compacting() const { return compacting_; }
+  void set_compacting(bool compacting);
+
+  // Whether the container may be compacted, and the fraction of its data
+  // that is live. Must hold the block manager's lock.
+  bool compactable() const {
+    return sealed_ && !compacting_ && total_bytes_written_ > 0;
+  }
+  double live_data_ratio() const {
+    return static_cast<double>(live_bytes_) / total_bytes_written_;
+  }
+
  private:
   LogBlockContainer(LogBlockManager* block_manager, DataDir* data_dir,
                     unique_ptr<WritablePBContainerFile> metadata_file,
@@ -328,6 +490,19 @@ class LogBlockContainer {
   // The number of blocks written thus far in the container.
   int64_t total_blocks_written_ = 0;
 
+  // The number of live blocks in the container, and the number of bytes
+  // they occupy (rounded up to filesystem blocks, like
+  // 'total_bytes_written_'). Protected by the block manager's lock.
+  int64_t live_blocks_ = 0;
+  int64_t live_bytes_ = 0;
+
+  // Protected by the block manager's lock.
+  bool sealed_ = false;
+  bool compacting_ = false;
+
+  // The number of LogBlocks referring to this container.
+  AtomicInt<int64_t> num_log_blocks_;
+
   // The metrics. Not owned by the log container; it has the same lifespan
   // as the block manager.
   const LogBlockManagerMetrics* metrics_;
@@ -346,7 +521,8 @@ LogBlockContainer::LogBlockContainer(
                                 data_dir)),
       metadata_file_(std::move(metadata_file)),
       data_file_(std::move(data_file)),
-      metrics_(block_manager->metrics()) {
+      metrics_(block_manager->metrics()),
+      num_log_blocks_(0) {
 }
 
 Status LogBlockContainer::Create(LogBlockManager* block_manager,
@@ -595,6 +771,76 @@ Status LogBlockContainer::ReadContainerRecords(deque<BlockRecordPB>* records) co
   return read_status;
 }
 
+Status LogBlockContainer::ReadCreatedBlockIds(vector<BlockId>* block_ids) const {
+  unique_ptr<RandomAccessFile> metadata_reader;
+  RETURN_NOT_OK(block_manager()->env()->NewRandomAccessFile(metadata_file_->filename(),
+                                                            &metadata_reader));
+  ReadablePBContainerFile pb_reader(std::move(metadata_reader));
+  RETURN_NOT_OK(pb_reader.Open());
+
+  Status read_status;
+  while (true) {
+    BlockRecordPB record;
+    read_status = pb_reader.ReadNextPB(&record);
+    if (!read_status.ok()) {
+      break;
+    }
+    if (record.op_type() == CREATE) {
+      block_ids->push_back(BlockId::FromPB(record.block_id()));
+    }
+  }
+  if (read_status.IsEndOfFile() || read_status.IsIncomplete()) {
+    return Status::OK();
+  }
+  return read_status;
+}
+
+Status LogBlockContainer::RewriteMetadata(const vector<BlockRecordPB>& records) {
+  Env* env = block_manager_->env();
+  string metadata_path = metadata_file_->filename();
+  string tmp_path = StrCat(metadata_path, kTmpInfix);
+
+  // Write the records to a temporary file, and then rename it over the
+  // existing metadata file so that a crash can't leave a partial file behind.
+  {
+    RWFileOptions opts;
+    opts.mode = Env::CREATE_IF_NON_EXISTING_TRUNCATE;
+    unique_ptr<RWFile> tmp_file;
+    RETURN_NOT_OK(env->NewRWFile(opts, tmp_path, &tmp_file));
+    auto cleanup = MakeScopedCleanup([&]() {
+      WARN_NOT_OK(env->DeleteFile(tmp_path),
+                  Substitute("Could not delete temporary metadata file $0", tmp_path));
+    });
+    WritablePBContainerFile pb_file(std::move(tmp_file));
+    RETURN_NOT_OK(pb_file.Init(BlockRecordPB()));
+    for (const BlockRecordPB& record : records) {
+      RETURN_NOT_OK(pb_file.Append(record));
+    }
+    if (FLAGS_enable_data_block_fsync) {
+      RETURN_NOT_OK(pb_file.Sync());
+    }
+    RETURN_NOT_OK(pb_file.Close());
+    RETURN_NOT_OK(env->RenameFile(tmp_path, metadata_path));
+    cleanup.cancel();
+  }
+  if (FLAGS_enable_data_block_fsync) {
+    RETURN_NOT_OK(env->SyncDir(data_dir_->dir()));
+  }
+
+  // The metadata writer still refers to the replaced file.
+  if (block_manager_->file_cache_) {
+    block_manager_->file_cache_->Invalidate(metadata_path);
+  } else {
+    RWFileOptions opts;
+    opts.mode = Env::OPEN_EXISTING;
+    unique_ptr<RWFile> metadata_writer;
+    RETURN_NOT_OK(env->NewRWFile(opts, metadata_path, &metadata_writer));
+    RETURN_NOT_OK(metadata_file_->Close());
+    metadata_file_.reset(new WritablePBContainerFile(std::move(metadata_writer)));
+  }
+  return metadata_file_->Reopen();
+}
+
 Status LogBlockContainer::CheckBlockRecord(const BlockRecordPB& record,
                                            uint64_t data_file_size,
                                            uint64_t fs_block_size) const {
@@ -700,6 +946,19 @@ Status LogBlockContainer::WriteData(int64_t offset, const Slice& data) {
   return Status::OK();
 }
 
+Status LogBlockContainer::WriteDataDirect(int64_t offset, const Slice& data,
+                                          DirectFileWriter* writer) {
+  DCHECK_GE(offset, total_bytes_written_);
+
+  RETURN_NOT_OK(writer->Append(data));
+
+  // See WriteData().
+  if (offset + data.size() > preallocated_offset_) {
+    RETURN_NOT_OK(data_dir_->RefreshIsFull(DataDir::RefreshMode::ALWAYS));
+  }
+  return Status::OK();
+}
+
 Status LogBlockContainer::ReadData(int64_t offset, size_t length,
                                    Slice* result, uint8_t* scratch) const {
   DCHECK_GE(offset, 0);
@@ -707,6 +966,12 @@ Status LogBlockContainer::ReadData(int64_t offset, size_t length,
   return data_file_->Read(offset, length, result, scratch);
 }
 
+Status LogBlockContainer::ReadVData(int64_t offset, vector<Slice>* results) const {
+  DCHECK_GE(offset, 0);
+
+  return data_file_->ReadV(offset, results);
+}
+
 Status LogBlockContainer::AppendMetadata(const BlockRecordPB& pb) {
   // Note: We don't check for sufficient disk space for metadata writes in
   // order to allow for block deletion on full disks.
@@ -794,6 +1059,34 @@ void LogBlockContainer::UpdateBytesWrittenAndTotalBlocks(int64_t block_offset,
   }
 }
 
+void LogBlockContainer::AddLiveBlock(int64_t length) {
+  DCHECK(block_manager_->lock_.is_locked());
+  live_blocks_++;
+  live_bytes_ += KUDU_ALIGN_UP(length, instance()->filesystem_block_size_bytes());
+  block_manager_->UpdateSparsestContainerUnlocked(this);
+}
+
+void LogBlockContainer::RemoveLiveBlock(int64_t length) {
+  DCHECK(block_manager_->lock_.is_locked());
+  live_blocks_--;
+  live_bytes_ -= KUDU_ALIGN_UP(length, instance()->filesystem_block_size_bytes());
+  DCHECK_GE(live_blocks_, 0);
+  DCHECK_GE(live_bytes_, 0);
+  block_manager_->UpdateSparsestContainerUnlocked(this);
+}
+
+void LogBlockContainer::set_sealed() {
+  DCHECK(block_manager_->lock_.is_locked());
+  sealed_ = true;
+  block_manager_->UpdateSparsestContainerUnlocked(this);
+}
+
+void LogBlockContainer::set_compacting(bool compacting) {
+  DCHECK(block_manager_->lock_.is_locked());
+  compacting_ = compacting;
+  block_manager_->UpdateSparsestContainerUnlocked(this);
+}
+
 void LogBlockContainer::ExecClosure(const Closure& task) {
   data_dir_->ExecClosure(task);
 }
@@ -824,13 +1117,14 @@ string LogBlockContainer::ToString() const {
 class LogBlock : public RefCountedThreadSafe<LogBlock> {
  public:
   LogBlock(LogBlockContainer* container, BlockId block_id, int64_t offset,
-           int64_t length);
+           int64_t length, uint32_t relocation_count);
   ~LogBlock();
 
   const BlockId& block_id() const { return block_id_; }
   LogBlockContainer* container() const { return container_; }
   int64_t offset() const { return offset_; }
   int64_t length() const { return length_; }
+  uint32_t relocation_count() const { return relocation_count_; }
 
   // Delete the block. Actual deletion takes place when the
   // block is destructed.
@@ -852,18 +1146,24 @@ class LogBlock : public RefCountedThreadSafe<LogBlock> {
   // Whether the block has been marked for deletion.
   bool deleted_;
 
+  // The number of times the block has been copied by container compaction.
+  // See BlockRecordPB.
+  const uint32_t relocation_count_;
+
   DISALLOW_COPY_AND_ASSIGN(LogBlock);
 };
 
 LogBlock::LogBlock(LogBlockContainer* container, BlockId block_id,
-                   int64_t offset, int64_t length)
+                   int64_t offset, int64_t length, uint32_t relocation_count)
     : container_(container),
       block_id_(block_id),
       offset_(offset),
       length_(length),
-      deleted_(false) {
+      deleted_(false),
+      relocation_count_(relocation_count) {
   DCHECK_GE(offset, 0);
   DCHECK_GE(length, 0);
+  container_->LogBlockCreated();
 }
 
 static void DeleteBlockAsync(LogBlockContainer* container,
@@ -883,6 +1183,7 @@ LogBlock::~LogBlock() {
     container_->ExecClosure(Bind(&DeleteBlockAsync, container_, block_id_,
                                  offset_, length_));
   }
+  container_->LogBlockDestroyed();
 }
 
 void LogBlock::Delete() {
@@ -949,6 +1250,15 @@ class LogWritableBlock : public WritableBlock {
   // The block's length. Changes with each Append().
   int64_t block_length_;
 
+  // If --block_manager_direct_io_writes is set, another handle on the
+  // container's data file, opened with direct I/O, and the writer which
+  // buffers the block's appends to it.
+  //
+  // Blocks begin on filesystem block boundaries, so the padding which the
+  // writer adds to the end of the block's data never overlaps the next block.
+  unique_ptr<RWFile> direct_file_;
+  unique_ptr<DirectFileWriter> direct_writer_;
+
   // The state of the block describing where it is in the write lifecycle,
   // for example, has it been synchronized to disk?
   WritableBlock::State state_;
@@ -969,6 +1279,16 @@ LogWritableBlock::LogWritableBlock(LogBlockContainer* container,
     container->metrics()->generic_metrics.blocks_open_writing->Increment();
     container->metrics()->generic_metrics.total_writable_blocks->Increment();
   }
+  // Direct writes must be aligned, which is only guaranteed of the block's
+  // padding if filesystem blocks are at least as large as the alignment.
+  if (FLAGS_block_manager_direct_io_writes &&
+      container->instance()->filesystem_block_size_bytes() % kDirectIOAlignment == 0) {
+    OpenBlockFileForDirectWrite(container->env(), container->data_path(), &direct_file_);
+    if (direct_file_) {
+      direct_writer_.reset(new DirectFileWriter(direct_file_.get(), block_offset,
+                                                GetDirectIOWriteBufferSize()));
+    }
+  }
 }
 
 LogWritableBlock::~LogWritableBlock() {
@@ -1010,7 +1330,11 @@ Status LogWritableBlock::Append(const Slice& data) {
   RETURN_NOT_OK(container_->EnsurePreallocated(cur_block_offset, data.size()));
 
   MicrosecondsInt64 start_time = GetMonoTimeMicros();
-  RETURN_NOT_OK(container_->WriteData(cur_block_offset, data));
+  if (direct_writer_) {
+    RETURN_NOT_OK(container_->WriteDataDirect(cur_block_offset, data, direct_writer_.get()));
+  } else {
+    RETURN_NOT_OK(container_->WriteData(cur_block_offset, data));
+  }
   MicrosecondsInt64 end_time = GetMonoTimeMicros();
 
   int64_t dur = end_time - start_time;
@@ -1028,7 +1352,13 @@ Status LogWritableBlock::FlushDataAsync() {
       << "Invalid state: " << state_;
   if (state_ == DIRTY) {
     VLOG(3) << "Flushing block " << id();
-    RETURN_NOT_OK(container_->FlushData(block_offset_, block_length_));
+    if (direct_writer_) {
+      // Direct writes bypass the page cache, so writing out the buffer is
+      // all that's needed to start the data on its way to disk.
+      RETURN_NOT_OK(direct_writer_->Flush());
+    } else {
+      RETURN_NOT_OK(container_->FlushData(block_offset_, block_length_));
+    }
 
     RETURN_NOT_OK_PREPEND(AppendMetadata(), "Unable to append block metadata");
 
@@ -1068,11 +1398,23 @@ Status LogWritableBlock::DoClose(SyncMode mode) {
           container_->metrics()->generic_metrics.blocks_open_writing->Decrement();
           container_->metrics()->generic_metrics.total_bytes_written->IncrementBy(
               BytesAppended());
+          if (direct_writer_) {
+            container_->metrics()->generic_metrics.total_bytes_written_direct->IncrementBy(
+                BytesAppended());
+          }
         }
+        direct_writer_.reset();
+        direct_file_.reset();
 
         state_ = CLOSED;
         s = container_->FinishBlock(s, this);
       });
+    // Write out the end of the data before it's recorded in the metadata.
+    if (direct_writer_) {
+      s = direct_writer_->Flush();
+      RETURN_NOT_OK_PREPEND(s, "Unable to write block data during close");
+    }
+
     // FlushDataAsync() was not called; append the metadata now.
     if (state_ == CLEAN || state_ == DIRTY) {
       s = AppendMetadata();
@@ -1084,7 +1426,16 @@ Status LogWritableBlock::DoClose(SyncMode mode) {
       VLOG(3) << "Syncing block " << id();
 
       // TODO(unknown): Sync just this block's dirty data.
-      s = container_->SyncData();
+      //
+      // Data written with direct I/O must be synced through the handle it
+      // was written with, which alone knows that it has unsynced writes.
+      if (direct_file_) {
+        if (FLAGS_enable_data_block_fsync) {
+          s = direct_file_->Sync();
+        }
+      } else {
+        s = container_->SyncData();
+      }
       RETURN_NOT_OK(s);
 
       // TODO(unknown): Sync just this block's dirty metadata.
@@ -1129,9 +1480,20 @@ class LogReadableBlock : public ReadableBlock {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE;
 
+  virtual Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE;
+
+  virtual Status ReadVUncached(uint64_t offset, vector<Slice>* results) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
  private:
+  // Returns an error if [offset, offset + length) isn't within the block.
+  Status CheckReadBounds(uint64_t offset, size_t length) const;
+
+  // Records the latency of a read that began at 'start_time' and the number
+  // of bytes it read.
+  void RecordRead(MicrosecondsInt64 start_time, size_t length) const;
+
   // The owning container. Must outlive this block.
   LogBlockContainer* container_;
 
@@ -1163,10 +1525,12 @@ LogReadableBlock::~LogReadableBlock() {
 
 Status LogReadableBlock::Close() {
   if (closed_.CompareAndSet(false, true)) {
-    log_block_.reset();
     if (container_->metrics()) {
       container_->metrics()->generic_metrics.blocks_open_reading->Decrement();
     }
+    // The container may be destroyed once its last block is released, if it
+    // has been compacted.
+    log_block_.reset();
   }
 
   return Status::OK();
@@ -1186,9 +1550,61 @@ Status LogReadableBlock::Size(uint64_t* sz) const {
 Status LogReadableBlock::Read(uint64_t offset, size_t length,
                               Slice* result, uint8_t* scratch) const {
   DCHECK(!closed_.Load());
+  RETURN_NOT_OK(CheckReadBounds(offset, length));
+
+  MicrosecondsInt64 start_time = GetMonoTimeMicros();
+  RETURN_NOT_OK(container_->ReadData(log_block_->offset() + offset, length,
+                                     result, scratch));
+  RecordRead(start_time, length);
+  return Status::OK();
+}
+
+Status LogReadableBlock::ReadV(uint64_t offset, vector<Slice>* results) const {
+  DCHECK(!closed_.Load());
+  size_t length = 0;
+  for (const Slice& result : *results) {
+    length += result.size();
+  }
+  RETURN_NOT_OK(CheckReadBounds(offset, length));
+
+  MicrosecondsInt64 start_time = GetMonoTimeMicros();
+  RETURN_NOT_OK(container_->ReadVData(log_block_->offset() + offset, results));
+  RecordRead(start_time, length);
+  return Status::OK();
+}
+
+Status LogReadableBlock::ReadVUncached(uint64_t offset, vector<Slice>* results) const {
+  DCHECK(!closed_.Load());
+
+  // The data file is opened for each read rather than kept open, so that
+  // the number of open files remains bounded by the file cache. Uncached
+  // reads are large enough for the cost not to matter.
+  unique_ptr<RandomAccessFile> direct_reader;
+  if (FLAGS_block_manager_direct_io_uncached_reads) {
+    OpenBlockFileForDirectRead(container_->env(), container_->data_path(), &direct_reader);
+  }
+  if (!direct_reader) {
+    return ReadV(offset, results);
+  }
 
-  uint64_t read_offset = log_block_->offset() + offset;
+  size_t length = 0;
+  for (const Slice& result : *results) {
+    length += result.size();
+  }
+  RETURN_NOT_OK(CheckReadBounds(offset, length));
+
+  MicrosecondsInt64 start_time = GetMonoTimeMicros();
+  RETURN_NOT_OK(DirectReadV(direct_reader.get(), log_block_->offset() + offset, results));
+  RecordRead(start_time, length);
+  if (container_->metrics()) {
+    container_->metrics()->generic_metrics.total_bytes_read_direct->IncrementBy(length);
+  }
+  return Status::OK();
+}
+
+Status LogReadableBlock::CheckReadBounds(uint64_t offset, size_t length) const {
   if (log_block_->length() < offset + length) {
+    uint64_t read_offset = log_block_->offset() + offset;
     return Status::IOError("Out-of-bounds read",
                            Substitute("read of [$0-$1) in block [$2-$3)",
                                       read_offset,
@@ -1196,12 +1612,11 @@ Status LogReadableBlock::Read(uint64_t offset, size_t length,
                                       log_block_->offset(),
                                       log_block_->offset() + log_block_->length()));
   }
+  return Status::OK();
+}
 
-  MicrosecondsInt64 start_time = GetMonoTimeMicros();
-  RETURN_NOT_OK(container_->ReadData(read_offset, length, result, scratch));
-  MicrosecondsInt64 end_time = GetMonoTimeMicros();
-
-  int64_t dur = end_time - start_time;
+void LogReadableBlock::RecordRead(MicrosecondsInt64 start_time, size_t length) const {
+  int64_t dur = GetMonoTimeMicros() - start_time;
   TRACE_COUNTER_INCREMENT("lbm_read_time_us", dur);
 
   const char* counter = BUCKETED_COUNTER_NAME("lbm_reads", dur);
@@ -1210,13 +1625,78 @@ Status LogReadableBlock::Read(uint64_t offset, size_t length,
   if (container_->metrics()) {
     container_->metrics()->generic_metrics.total_bytes_read->IncrementBy(length);
   }
-  return Status::OK();
 }
 
 size_t LogReadableBlock::memory_footprint() const {
   return kudu_malloc_usable_size(this);
 }
 
+////////////////////////////////////////////////////////////
+// LogBlockContainerCompactionOp
+////////////////////////////////////////////////////////////
+
+// Maintenance op that compacts the sparsest full container, if it's sparse
+// enough. At most one instance runs at a time.
+class LogBlockContainerCompactionOp : public MaintenanceOp {
+ public:
+  explicit LogBlockContainerCompactionOp(LogBlockManager* block_manager)
+      : MaintenanceOp("LogBlockContainerCompactionOp", MaintenanceOp::HIGH_IO_USAGE),
+        block_manager_(block_manager),
+        running_(false) {
+  }
+
+  virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
+
+  virtual bool Prepare() OVERRIDE;
+
+  virtual void Perform() OVERRIDE;
+
+  virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE;
+
+  virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
+
+ private:
+  LogBlockManager* const block_manager_;
+
+  // Whether a compaction is running.
+  AtomicBool running_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogBlockContainerCompactionOp);
+};
+
+void LogBlockContainerCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
+  int64_t dead_bytes = 0;
+  bool found;
+  {
+    std::lock_guard<simple_spinlock> l(block_manager_->lock_);
+    found = block_manager_->FindSparsestContainerUnlocked(&dead_bytes) != nullptr;
+  }
+  stats->set_runnable(found && !running_.Load());
+
+  // Compacting a container of the maximum size that holds no live data at
+  // all is worth 1.
+  stats->set_perf_improvement(
+      static_cast<double>(dead_bytes) / std::max<uint64_t>(FLAGS_log_container_max_size, 1));
+}
+
+bool LogBlockContainerCompactionOp::Prepare() {
+  return running_.CompareAndSet(false, true);
+}
+
+void LogBlockContainerCompactionOp::Perform() {
+  WARN_NOT_OK(block_manager_->CompactSparsestContainer(),
+              "Could not compact log block container");
+  running_.Store(false);
+}
+
+scoped_refptr<Histogram> LogBlockContainerCompactionOp::DurationHistogram() const {
+  return block_manager_->metrics()->container_compaction_duration;
+}
+
+scoped_refptr<AtomicGauge<uint32_t> > LogBlockContainerCompactionOp::RunningGauge() const {
+  return block_manager_->metrics()->container_compaction_running;
+}
+
 } // namespace internal
 
 ////////////////////////////////////////////////////////////
@@ -1247,7 +1727,11 @@ LogBlockManager::LogBlockManager(Env* env, const BlockManagerOptions& opts)
     env_(DCHECK_NOTNULL(env)),
     read_only_(opts.read_only),
     buggy_el6_kernel_(IsBuggyEl6Kernel(env->GetKernelRelease())),
-    next_block_id_(1) {
+    next_block_id_(1),
+    sparsest_container_(nullptr),
+    sparsest_container_ratio_(0),
+    sparsest_container_stale_(true),
+    compaction_cancelled_(false) {
 
   int64_t file_cache_capacity = GetFileCacheCapacityForBlockManager(env_);
   if (file_cache_capacity != kint64max) {
@@ -1275,6 +1759,10 @@ LogBlockManager::LogBlockManager(Env* env, const BlockManagerOptions& opts)
 }
 
 LogBlockManager::~LogBlockManager() {
+  // The compaction op refers to the block manager, so it must be stopped
+  // before anything is torn down.
+  UnregisterMaintenanceOps();
+
   // Release all of the memory accounted by the blocks.
   int64_t mem = 0;
   for (const auto& entry : blocks_by_block_id_) {
@@ -1291,6 +1779,7 @@ LogBlockManager::~LogBlockManager() {
   dd_manager_.Shutdown();
 
   STLDeleteElements(&all_containers_);
+  STLDeleteElements(&dead_containers_);
 }
 
 Status LogBlockManager::Create() {
@@ -1357,30 +1846,109 @@ Status LogBlockManager::Open() {
     InsertOrDie(&block_limits_by_data_dir_, dd.get(), limit);
   }
 
-  vector<Status> statuses(dd_manager_.data_dirs().size());
-  int i = 0;
-  for (const auto& dd : dd_manager_.data_dirs()) {
-    // Open the data dir asynchronously.
-    dd->ExecClosure(
-        Bind(&LogBlockManager::OpenDataDir,
+  const auto& dds = dd_manager_.data_dirs();
+  MonoTime start = MonoTime::Now();
+
+  // Find the containers in each data dir asynchronously.
+  vector<vector<string>> container_ids(dds.size());
+  vector<Status> statuses(dds.size());
+  for (int i = 0; i < dds.size(); i++) {
+    dds[i]->ExecClosure(
+        Bind(&LogBlockManager::FindContainers,
              Unretained(this),
-             dd.get(),
+             dds[i].get(),
+             &container_ids[i],
              &statuses[i]));
-    i++;
   }
-
-  // Wait for the opens to complete.
-  for (const auto& dd : dd_manager_.data_dirs()) {
+  for (const auto& dd : dds) {
     dd->WaitOnClosures();
   }
+  for (const auto& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
+  MonoTime found = MonoTime::Now();
+
+  // Open the containers. A data dir may hold many thousands of them, so each
+  // data dir gets several threads rather than just its own single-threaded
+  // pool.
+  vector<unique_ptr<ThreadPool>> pools;
+  vector<vector<Status>> container_statuses(dds.size());
+  AtomicInt<int64_t> compact_metadata_micros(0);
+  Status submit_status;
+  for (int i = 0; i < dds.size() && submit_status.ok(); i++) {
+    gscoped_ptr<ThreadPool> pool;
+    submit_status = ThreadPoolBuilder(Substitute("lbm startup $0", i))
+        .set_max_threads(FLAGS_log_block_manager_startup_threads_per_data_dir)
+        .Build(&pool);
+    if (!submit_status.ok()) {
+      break;
+    }
+    pools.emplace_back(pool.release());
+    container_statuses[i].resize(container_ids[i].size());
+    for (int j = 0; j < container_ids[i].size() && submit_status.ok(); j++) {
+      submit_status = pools.back()->SubmitClosure(
+          Bind(&LogBlockManager::OpenContainer,
+               Unretained(this),
+               dds[i].get(),
+               container_ids[i][j],
+               &compact_metadata_micros,
+               &container_statuses[i][j]));
+    }
+  }
+
+  // Wait for the opens to complete, even if some couldn't be started.
+  for (const auto& pool : pools) {
+    pool->Wait();
+  }
+  RETURN_NOT_OK_PREPEND(submit_status, "Could not start opening containers");
 
   // Ensure that no open failed.
-  for (const auto& s : statuses) {
-    if (!s.ok()) {
-      return s;
+  for (const auto& dir_statuses : container_statuses) {
+    for (const auto& s : dir_statuses) {
+      RETURN_NOT_OK(s);
     }
   }
 
+  // Record the deletion of blocks that were superseded by copies made by a
+  // container compaction that didn't finish. This is done once all of the
+  // containers are open, since a container may have blocks superseded by
+  // copies in several others.
+  if (!superseded_blocks_.empty()) {
+    LOG(INFO) << Substitute("Found $0 blocks superseded by copies in other containers",
+                            superseded_blocks_.size());
+  }
+  if (!read_only_) {
+    for (const auto& lb : superseded_blocks_) {
+      BlockRecordPB record;
+      lb->block_id().CopyToPB(record.mutable_block_id());
+      record.set_op_type(DELETE);
+      record.set_timestamp_us(GetCurrentTimeMicros());
+      RETURN_NOT_OK_PREPEND(lb->container()->AppendMetadata(record), Substitute(
+          "Unable to append deletion record for superseded block $0 to container $1",
+          lb->block_id().ToString(), lb->container()->ToString()));
+      lb->Delete();
+    }
+  }
+  superseded_blocks_.clear();
+  MonoTime loaded = MonoTime::Now();
+
+  MonoDelta find_time = found - start;
+  MonoDelta load_time = loaded - found;
+  MonoDelta compact_time = MonoDelta::FromMicroseconds(compact_metadata_micros.Load());
+  LOG(INFO) << Substitute("Opened $0 log block containers in $1 ms ($2 ms finding "
+                          "containers, $3 ms loading them, of which $4 ms was "
+                          "spent compacting metadata across all threads)",
+                          all_containers_.size(),
+                          (loaded - start).ToMilliseconds(),
+                          find_time.ToMilliseconds(),
+                          load_time.ToMilliseconds(),
+                          compact_time.ToMilliseconds());
+  if (metrics()) {
+    metrics()->startup_find_containers_duration->set_value(find_time.ToMilliseconds());
+    metrics()->startup_load_containers_duration->set_value(load_time.ToMilliseconds());
+    metrics()->startup_compact_metadata_duration->set_value(compact_time.ToMilliseconds());
+  }
+
   return Status::OK();
 }
 
@@ -1481,6 +2049,289 @@ Status LogBlockManager::CloseBlocks(const std::vector<WritableBlock*>& blocks) {
   return Status::OK();
 }
 
+void LogBlockManager::RegisterMaintenanceOps(MaintenanceManager* maintenance_manager) {
+  if (read_only_ || !metrics_) {
+    return;
+  }
+  CHECK(!compaction_op_);
+  compaction_cancelled_.Store(false);
+  compaction_op_.reset(new internal::LogBlockContainerCompactionOp(this));
+  maintenance_manager->RegisterOp(compaction_op_.get());
+}
+
+void LogBlockManager::UnregisterMaintenanceOps() {
+  if (!compaction_op_) {
+    return;
+  }
+  compaction_cancelled_.Store(true);
+  compaction_op_->Unregister();
+  compaction_op_.reset();
+}
+
+namespace {
+
+// The steps of a container compaction that follow the recording of the
+// copies, at which failures can be injected.
+enum CompactionStep {
+  kSyncCopyMetadata = 0,
+  kSyncCopyDirs = 1,
+  kTruncateCopyContainers = 2,
+  kDeleteSourceMetadata = 3,
+};
+
+Status MaybeInjectCompactionFailure(CompactionStep step) {
+  if (PREDICT_FALSE(FLAGS_log_container_compaction_inject_failure_at_step == step)) {
+    return Status::IOError(Substitute("Injected failure at container compaction step $0",
+                                      step));
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+Status LogBlockManager::CompactSparsestContainer() {
+  CHECK(!read_only_);
+
+  // Containers compacted earlier may no longer be in use.
+  DeleteDeadContainers();
+
+  LogBlockContainer* source;
+  int64_t dead_bytes;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    source = FindSparsestContainerUnlocked(&dead_bytes);
+    if (!source) {
+      return Status::OK();
+    }
+    source->set_compacting(true);
+  }
+  VLOG(1) << Substitute("Compacting container $0 to free $1 bytes",
+                        source->ToString(), dead_bytes);
+
+  // Find the container's live blocks. The IDs of blocks created in the
+  // container are read from its metadata, rather than searching the entire
+  // block map while holding the lock.
+  struct Relocation {
+    // The block being copied.
+    scoped_refptr<LogBlock> old_block;
+
+    // The container the block is copied to, and the copy's offset in it.
+    LogBlockContainer* dest;
+    int64_t offset;
+
+    // The copy, once its metadata has been written.
+    scoped_refptr<LogBlock> new_block;
+  };
+  vector<Relocation> relocations;
+  {
+    vector<BlockId> block_ids;
+    RETURN_NOT_OK_PREPEND(source->ReadCreatedBlockIds(&block_ids), Substitute(
+        "Could not read records from container $0", source->ToString()));
+    std::unordered_set<BlockId, BlockIdHash> seen;
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (const BlockId& block_id : block_ids) {
+      scoped_refptr<LogBlock> lb = FindPtrOrNull(blocks_by_block_id_, block_id);
+      if (lb && lb->container() == source && InsertIfNotPresent(&seen, block_id)) {
+        relocations.push_back({ lb, nullptr, 0, nullptr });
+      }
+    }
+  }
+
+  // Records the deletion of the given copies. Their space is only reclaimed
+  // once the deletion records are durable: a copy whose CREATE record
+  // survives a crash supersedes the original, so it must still hold the
+  // block's data. If the records can't be synced, the copies are left in
+  // place as garbage, and the copies that survive a crash are used.
+  auto delete_copies = [&](const vector<Relocation*>& copies) {
+    std::map<LogBlockContainer*, vector<Relocation*>> copies_by_dest;
+    for (Relocation* r : copies) {
+      copies_by_dest[r->dest].push_back(r);
+    }
+    for (const auto& e : copies_by_dest) {
+      LogBlockContainer* dest = e.first;
+      Status s;
+      for (Relocation* r : e.second) {
+        BlockRecordPB record;
+        r->new_block->block_id().CopyToPB(record.mutable_block_id());
+        record.set_op_type(DELETE);
+        record.set_timestamp_us(GetCurrentTimeMicros());
+        s = dest->AppendMetadata(record);
+        if (!s.ok()) {
+          break;
+        }
+      }
+      if (s.ok()) {
+        s = MaybeInjectCompactionFailure(kSyncCopyMetadata);
+      }
+      if (s.ok()) {
+        s = dest->SyncMetadata();
+      }
+      if (!s.ok()) {
+        LOG(WARNING) << Substitute("Unable to record deletion of $0 block copies in "
+                                   "container $1, leaving them in place: $2",
+                                   e.second.size(), dest->ToString(), s.ToString());
+        continue;
+      }
+      for (Relocation* r : e.second) {
+        r->new_block->Delete();
+      }
+    }
+  };
+
+  // The containers that the blocks are copied to. They're in use by this
+  // compaction until it's done.
+  vector<LogBlockContainer*> dests;
+  auto cleanup = MakeScopedCleanup([&]() {
+    // The originals are still in use, so the copies are garbage.
+    vector<Relocation*> abandoned;
+    for (Relocation& r : relocations) {
+      if (r.new_block) {
+        abandoned.push_back(&r);
+      }
+    }
+    delete_copies(abandoned);
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (LogBlockContainer* dest : dests) {
+      MakeContainerAvailableUnlocked(dest);
+    }
+    source->set_compacting(false);
+  });
+
+  // Copy the blocks, in chunks no larger than the throttler admits at once.
+  const int64_t kMaxChunkSize = 1024 * 1024;
+  int64_t max_bytes_per_sec = FLAGS_log_container_compaction_max_bytes_per_sec;
+  Throttler throttler(MonoTime::Now(), 0, max_bytes_per_sec, 1.0);
+  int64_t chunk_size = kMaxChunkSize;
+  if (max_bytes_per_sec > 0) {
+    chunk_size = std::min(chunk_size, std::max<int64_t>(
+        1, max_bytes_per_sec * Throttler::kRefillPeriodMicros /
+           MonoTime::kMicrosecondsPerSecond));
+  }
+  unique_ptr<uint8_t[]> scratch(new uint8_t[chunk_size]);
+  LogBlockContainer* dest = nullptr;
+  int64_t bytes_copied = 0;
+  for (Relocation& r : relocations) {
+    if (!dest || dest->full()) {
+      RETURN_NOT_OK_PREPEND(GetOrCreateContainer(&dest),
+                            "Could not find a container to copy blocks into");
+      dests.push_back(dest);
+    }
+    const LogBlock* lb = r.old_block.get();
+    r.dest = dest;
+    r.offset = dest->total_bytes_written();
+    RETURN_NOT_OK(dest->EnsurePreallocated(r.offset, lb->length()));
+    for (int64_t pos = 0; pos < lb->length(); pos += chunk_size) {
+      if (compaction_cancelled_.Load()) {
+        return Status::Aborted("container compaction cancelled");
+      }
+      int64_t len = std::min(chunk_size, lb->length() - pos);
+      while (!throttler.Take(MonoTime::Now(), 0, len)) {
+        SleepFor(MonoDelta::FromMicroseconds(Throttler::kRefillPeriodMicros));
+      }
+      Slice data;
+      RETURN_NOT_OK(source->ReadData(lb->offset() + pos, len, &data, scratch.get()));
+      RETURN_NOT_OK(dest->WriteData(r.offset + pos, data));
+    }
+    dest->UpdateBytesWrittenAndTotalBlocks(r.offset, lb->length());
+    bytes_copied += lb->length();
+  }
+
+  // The copies must be durable before they're recorded, since a recorded
+  // copy supersedes the original after a crash.
+  for (LogBlockContainer* d : dests) {
+    RETURN_NOT_OK(d->SyncData());
+  }
+  for (Relocation& r : relocations) {
+    const LogBlock* lb = r.old_block.get();
+    BlockRecordPB record;
+    lb->block_id().CopyToPB(record.mutable_block_id());
+    record.set_op_type(CREATE);
+    record.set_timestamp_us(GetCurrentTimeMicros());
+    record.set_offset(r.offset);
+    record.set_length(lb->length());
+    record.set_relocation_count(lb->relocation_count() + 1);
+    RETURN_NOT_OK_PREPEND(r.dest->AppendMetadata(record),
+                          "Unable to append block metadata");
+    r.new_block = new LogBlock(r.dest, lb->block_id(), r.offset, lb->length(),
+                               lb->relocation_count() + 1);
+  }
+  for (LogBlockContainer* d : dests) {
+    RETURN_NOT_OK(MaybeInjectCompactionFailure(kSyncCopyMetadata));
+    RETURN_NOT_OK(d->SyncMetadata());
+    RETURN_NOT_OK(MaybeInjectCompactionFailure(kSyncCopyDirs));
+    RETURN_NOT_OK(SyncContainer(*d));
+    RETURN_NOT_OK(MaybeInjectCompactionFailure(kTruncateCopyContainers));
+    RETURN_NOT_OK(d->TruncateDataToTotalBytesWritten());
+  }
+
+  // Delete the container's metadata before switching to the copies. Were it
+  // deleted after, a copy could be deleted in the meantime, and a crash
+  // would bring the original back. The metadata file is deleted directly
+  // rather than through the file cache, which would defer the deletion
+  // until the container is destroyed.
+  RETURN_NOT_OK(MaybeInjectCompactionFailure(kDeleteSourceMetadata));
+  RETURN_NOT_OK_PREPEND(env_->DeleteFile(source->metadata_path()), Substitute(
+      "Could not delete metadata of container $0", source->ToString()));
+  cleanup.cancel();
+  if (FLAGS_enable_data_block_fsync) {
+    WARN_NOT_OK(env_->SyncDir(source->data_dir()->dir()), Substitute(
+        "Could not sync data directory $0", source->data_dir()->dir()));
+  }
+
+  // Switch to the copies. Blocks deleted during the compaction are left out.
+  vector<Relocation*> deleted;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    int64_t old_mem = 0;
+    int64_t new_mem = 0;
+    for (Relocation& r : relocations) {
+      scoped_refptr<LogBlock>* lb = FindOrNull(blocks_by_block_id_,
+                                               r.old_block->block_id());
+      if (!lb || lb->get() != r.old_block.get()) {
+        deleted.push_back(&r);
+        continue;
+      }
+      *lb = r.new_block;
+      source->RemoveLiveBlock(r.old_block->length());
+      r.dest->AddLiveBlock(r.new_block->length());
+      old_mem += kudu_malloc_usable_size(r.old_block.get());
+      new_mem += kudu_malloc_usable_size(r.new_block.get());
+    }
+    mem_tracker_->Consume(new_mem);
+    mem_tracker_->Release(old_mem);
+
+    for (LogBlockContainer* d : dests) {
+      if (d->full() && metrics()) {
+        metrics()->full_containers->Increment();
+      }
+      MakeContainerAvailableUnlocked(d);
+    }
+    all_containers_.erase(std::find(all_containers_.begin(), all_containers_.end(), source));
+    dead_containers_.push_back(source);
+  }
+  delete_copies(deleted);
+
+  // Readers of the original blocks may still be using the data file, so its
+  // deletion is deferred until they're done when going through the file
+  // cache. Otherwise, their open file descriptors keep it alive.
+  string data_path = source->data_path();
+  WARN_NOT_OK(file_cache_ ? file_cache_->DeleteFile(data_path) : env_->DeleteFile(data_path),
+              Substitute("Could not delete data file $0", data_path));
+
+  LOG(INFO) << Substitute("Compacted container $0: copied $1 blocks ($2 bytes) "
+                          "into $3 containers",
+                          source->ToString(), relocations.size() - deleted.size(),
+                          bytes_copied, dests.size());
+  if (metrics()) {
+    metrics()->container_compactions->Increment();
+    metrics()->container_compaction_bytes->IncrementBy(bytes_copied);
+  }
+
+  relocations.clear();
+  DeleteDeadContainers();
+  return Status::OK();
+}
+
 int64_t LogBlockManager::CountBlocksForTests() const {
   std::lock_guard<simple_spinlock> l(lock_);
   return blocks_by_block_id_.size();
@@ -1534,6 +2385,8 @@ void LogBlockManager::MakeContainerAvailable(LogBlockContainer* container) {
 void LogBlockManager::MakeContainerAvailableUnlocked(LogBlockContainer* container) {
   DCHECK(lock_.is_locked());
   if (container->full()) {
+    // The container will never be written to again, so it may be compacted.
+    container->set_sealed();
     return;
   }
   available_containers_by_data_dir_[container->data_dir()].push_back(container);
@@ -1582,7 +2435,7 @@ bool LogBlockManager::AddLogBlock(LogBlockContainer* container,
                                   int64_t offset,
                                   int64_t length) {
   std::lock_guard<simple_spinlock> l(lock_);
-  scoped_refptr<LogBlock> lb(new LogBlock(container, block_id, offset, length));
+  scoped_refptr<LogBlock> lb(new LogBlock(container, block_id, offset, length, 0));
   mem_tracker_->Consume(kudu_malloc_usable_size(lb.get()));
 
   return AddLogBlockUnlocked(lb);
@@ -1601,6 +2454,7 @@ bool LogBlockManager::AddLogBlockUnlocked(const scoped_refptr<LogBlock>& lb) {
   // There may already be an entry in open_block_ids_ (e.g. we just finished
   // writing out a block).
   open_block_ids_.erase(lb->block_id());
+  lb->container()->AddLiveBlock(lb->length());
   if (metrics()) {
     metrics()->blocks_under_management->Increment();
     metrics()->bytes_under_management->IncrementBy(lb->length());
@@ -1610,6 +2464,11 @@ bool LogBlockManager::AddLogBlockUnlocked(const scoped_refptr<LogBlock>& lb) {
 
 scoped_refptr<LogBlock> LogBlockManager::RemoveLogBlock(const BlockId& block_id) {
   std::lock_guard<simple_spinlock> l(lock_);
+  return RemoveLogBlockUnlocked(block_id);
+}
+
+scoped_refptr<LogBlock> LogBlockManager::RemoveLogBlockUnlocked(const BlockId& block_id) {
+  DCHECK(lock_.is_locked());
   scoped_refptr<LogBlock> result =
       EraseKeyReturnValuePtr(&blocks_by_block_id_, block_id);
   if (result) {
@@ -1617,6 +2476,7 @@ scoped_refptr<LogBlock> LogBlockManager::RemoveLogBlock(const BlockId& block_id)
                           result->offset(), result->length());
 
     mem_tracker_->Release(kudu_malloc_usable_size(result.get()));
+    result->container()->RemoveLiveBlock(result->length());
 
     if (metrics()) {
       metrics()->blocks_under_management->Decrement();
@@ -1627,9 +2487,9 @@ scoped_refptr<LogBlock> LogBlockManager::RemoveLogBlock(const BlockId& block_id)
   return result;
 }
 
-void LogBlockManager::OpenDataDir(DataDir* dir,
-                                  Status* result_status) {
-  // Find all containers and open them.
+void LogBlockManager::FindContainers(DataDir* dir,
+                                     vector<string>* container_ids,
+                                     Status* result_status) {
   vector<string> children;
   Status s = env_->GetChildren(dir->dir(), &children);
   if (!s.ok()) {
@@ -1637,93 +2497,182 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
         "Could not list children of $0", dir->dir()));
     return;
   }
+  std::unordered_set<string> data_ids;
   for (const string& child : children) {
     string id;
-    if (!TryStripSuffixString(child, LogBlockManager::kContainerMetadataFileSuffix, &id)) {
-      continue;
-    }
-    unique_ptr<LogBlockContainer> container;
-    s = LogBlockContainer::Open(this, dir, id, &container);
-    if (s.IsAborted()) {
-      // Skip the container. Open() already handled logging for us.
-      continue;
+    if (TryStripSuffixString(child, LogBlockManager::kContainerMetadataFileSuffix, &id)) {
+      container_ids->push_back(id);
+    } else if (TryStripSuffixString(child, LogBlockManager::kContainerDataFileSuffix, &id)) {
+      data_ids.insert(id);
     }
-    if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not open container $0", id));
-      return;
+  }
+
+  // A compacted container's metadata file is deleted before its data file,
+  // so a crash in between leaves a data file behind. Without the metadata,
+  // no block refers to its data, so it can be deleted.
+  for (const string& id : *container_ids) {
+    data_ids.erase(id);
+  }
+  for (const string& id : data_ids) {
+    string data_path = JoinPathSegments(dir->dir(),
+                                        StrCat(id, LogBlockManager::kContainerDataFileSuffix));
+    LOG(WARNING) << Substitute("Found data file $0 with no metadata file: $1", data_path,
+                               read_only_ ? "ignoring" : "deleting");
+    if (!read_only_) {
+      WARN_NOT_OK(env_->DeleteFile(data_path),
+                  Substitute("Could not delete orphaned data file $0", data_path));
     }
+  }
+  *result_status = Status::OK();
+}
 
-    // Populate the in-memory block maps using each container's records.
-    deque<BlockRecordPB> records;
-    s = container->ReadContainerRecords(&records);
+void LogBlockManager::OpenContainer(DataDir* dir,
+                                    const string& id,
+                                    AtomicInt<int64_t>* compact_metadata_micros,
+                                    Status* result_status) {
+  unique_ptr<LogBlockContainer> container;
+  Status s = LogBlockContainer::Open(this, dir, id, &container);
+  if (s.IsAborted()) {
+    // Skip the container. Open() already handled logging for us.
+    *result_status = Status::OK();
+    return;
+  }
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend(Substitute(
+        "Could not open container $0", id));
+    return;
+  }
+
+  // Populate the in-memory block maps using each container's records.
+  deque<BlockRecordPB> records;
+  s = container->ReadContainerRecords(&records);
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend(Substitute(
+        "Could not read records from container $0", container->ToString()));
+    return;
+  }
+
+  // Process the records, building a container-local map.
+  //
+  // It's important that we don't try to add these blocks to the global map
+  // incrementally as we see each record, since it's possible that one container
+  // has a "CREATE <b>" while another has a "CREATE <b> ; DELETE <b>" pair.
+  // If we processed those two containers in this order, then upon processing
+  // the second container, we'd think there was a duplicate block. Building
+  // the container-local map first ensures that we discount deleted blocks
+  // before checking for duplicate IDs.
+  //
+  // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
+  // exceedingly unlikely. However, we might have old data which still exhibits
+  // the above issue.
+  UntrackedBlockMap blocks_in_container;
+  uint64_t max_block_id = 0;
+  for (const BlockRecordPB& r : records) {
+    s = ProcessBlockRecord(r, container.get(), &blocks_in_container);
     if (!s.ok()) {
       *result_status = s.CloneAndPrepend(Substitute(
-          "Could not read records from container $0", container->ToString()));
+          "Could not process record in container $0", container->ToString()));
       return;
     }
+    max_block_id = std::max(max_block_id, r.block_id().id());
+  }
 
-    // Process the records, building a container-local map.
-    //
-    // It's important that we don't try to add these blocks to the global map
-    // incrementally as we see each record, since it's possible that one container
-    // has a "CREATE <b>" while another has a "CREATE <b> ; DELETE <b>" pair.
-    // If we processed those two containers in this order, then upon processing
-    // the second container, we'd think there was a duplicate block. Building
-    // the container-local map first ensures that we discount deleted blocks
-    // before checking for duplicate IDs.
-    //
-    // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
-    // exceedingly unlikely. However, we might have old data which still exhibits
-    // the above issue.
-    UntrackedBlockMap blocks_in_container;
-    uint64_t max_block_id = 0;
-    for (const BlockRecordPB& r : records) {
-      s = ProcessBlockRecord(r, container.get(), &blocks_in_container);
-      if (!s.ok()) {
-        *result_status = s.CloneAndPrepend(Substitute(
-            "Could not process record in container $0", container->ToString()));
-        return;
+  // If most of the records are for deleted blocks, rewrite the metadata file
+  // so that they needn't be read again the next time the container is opened.
+  //
+  // The records of the last block created are kept even if it was deleted,
+  // so that the container's size (and thus the offset of its next block) is
+  // unchanged when it's next opened. Containers with a limit on their number
+  // of blocks aren't compacted, since that limit counts deleted blocks too.
+  if (!read_only_ &&
+      !FindOrDie(block_limits_by_data_dir_, dir) &&
+      blocks_in_container.size() <
+          records.size() * FLAGS_log_container_live_metadata_before_compact_ratio) {
+    MonoTime start = MonoTime::Now();
+    int last_create = -1;
+    for (int i = 0; i < records.size(); i++) {
+      if (records[i].op_type() == CREATE) {
+        last_create = i;
       }
-      max_block_id = std::max(max_block_id, r.block_id().id());
     }
-
-    // Having processed the block records, it is now safe to truncate the
-    // preallocated space off of the end of the container. This is a no-op for
-    // non-full containers, where excess preallocated space is expected to be
-    // (eventually) used.
-    if (!read_only_) {
-      s = container->TruncateDataToTotalBytesWritten();
+    vector<BlockRecordPB> live_records;
+    for (int i = 0; i < records.size(); i++) {
+      const BlockRecordPB& r = records[i];
+      BlockId block_id(BlockId::FromPB(r.block_id()));
+      const scoped_refptr<LogBlock>* lb = FindOrNull(blocks_in_container, block_id);
+      bool live = r.op_type() == CREATE && lb && (*lb)->offset() == r.offset();
+      bool last = i >= last_create && last_create != -1 &&
+          r.block_id().id() == records[last_create].block_id().id();
+      if (live || last) {
+        live_records.push_back(r);
+      }
+    }
+    // A container whose blocks were all deleted may already be as compact
+    // as it can be.
+    if (live_records.size() < records.size()) {
+      s = container->RewriteMetadata(live_records);
       if (!s.ok()) {
         *result_status = s.CloneAndPrepend(Substitute(
-            "Could not truncate container $0", container->ToString()));
+            "Could not compact metadata of container $0", container->ToString()));
         return;
       }
+      VLOG(1) << Substitute("Compacted metadata of container $0 from $1 to $2 records",
+                            container->ToString(), records.size(), live_records.size());
+      compact_metadata_micros->IncrementBy((MonoTime::Now() - start).ToMicroseconds());
+      if (metrics()) {
+        metrics()->metadata_compactions->Increment();
+      }
     }
+  }
 
-    next_block_id_.StoreMax(max_block_id + 1);
+  // Having processed the block records, it is now safe to truncate the
+  // preallocated space off of the end of the container. This is a no-op for
+  // non-full containers, where excess preallocated space is expected to be
+  // (eventually) used.
+  if (!read_only_) {
+    s = container->TruncateDataToTotalBytesWritten();
+    if (!s.ok()) {
+      *result_status = s.CloneAndPrepend(Substitute(
+          "Could not truncate container $0", container->ToString()));
+      return;
+    }
+  }
 
-    // Under the lock, merge this map into the main block map and add
-    // the container.
-    {
-      std::lock_guard<simple_spinlock> l(lock_);
-      // To avoid cacheline contention during startup, we aggregate all of the
-      // memory in a local and add it to the mem-tracker in a single increment
-      // at the end of this loop.
-      int64_t mem_usage = 0;
-      for (const UntrackedBlockMap::value_type& e : blocks_in_container) {
-        if (!AddLogBlockUnlocked(e.second)) {
+  next_block_id_.StoreMax(max_block_id + 1);
+
+  // Under the lock, merge this map into the main block map and add
+  // the container.
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    // To avoid cacheline contention during startup, we aggregate all of the
+    // memory in a local and add it to the mem-tracker in a single increment
+    // at the end of this loop.
+    int64_t mem_usage = 0;
+    for (const UntrackedBlockMap::value_type& e : blocks_in_container) {
+      if (!AddLogBlockUnlocked(e.second)) {
+        // The block may have been copied by a container compaction that
+        // didn't finish, in which case the copy with the higher relocation
+        // count supersedes the other.
+        scoped_refptr<LogBlock> existing = FindOrDie(blocks_by_block_id_, e.first);
+        if (existing->relocation_count() == e.second->relocation_count()) {
           LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
                      << " which already is alive from another container when "
                      << " processing container " << container->ToString();
         }
-        mem_usage += kudu_malloc_usable_size(e.second.get());
+        if (existing->relocation_count() > e.second->relocation_count()) {
+          superseded_blocks_.push_back(e.second);
+          continue;
+        }
+        RemoveLogBlockUnlocked(e.first);
+        CHECK(AddLogBlockUnlocked(e.second));
+        superseded_blocks_.push_back(existing);
       }
-
-      mem_tracker_->Consume(mem_usage);
-      AddNewContainerUnlocked(container.get());
-      MakeContainerAvailableUnlocked(container.release());
+      mem_usage += kudu_malloc_usable_size(e.second.get());
     }
+
+    mem_tracker_->Consume(mem_usage);
+    AddNewContainerUnlocked(container.get());
+    MakeContainerAvailableUnlocked(container.release());
   }
 
   *result_status = Status::OK();
@@ -1736,7 +2685,8 @@ Status LogBlockManager::ProcessBlockRecord(const BlockRecordPB& record,
   switch (record.op_type()) {
     case CREATE: {
       scoped_refptr<LogBlock> lb(new LogBlock(container, block_id,
-                                              record.offset(), record.length()));
+                                              record.offset(), record.length(),
+                                              record.relocation_count()));
       if (!InsertIfNotPresent(block_map, block_id, lb)) {
         return Status::Corruption(Substitute(
             "found duplicate CREATE record for block $0 in container $1: $2",
@@ -1775,6 +2725,73 @@ Status LogBlockManager::ProcessBlockRecord(const BlockRecordPB& record,
   return Status::OK();
 }
 
+LogBlockContainer* LogBlockManager::FindSparsestContainerUnlocked(int64_t* dead_bytes) {
+  DCHECK(lock_.is_locked());
+  if (sparsest_container_stale_) {
+    sparsest_container_ = nullptr;
+    for (LogBlockContainer* container : all_containers_) {
+      if (container->compactable() &&
+          (!sparsest_container_ || container->live_data_ratio() < sparsest_container_ratio_)) {
+        sparsest_container_ = container;
+        sparsest_container_ratio_ = container->live_data_ratio();
+      }
+    }
+    sparsest_container_stale_ = false;
+  }
+  if (!sparsest_container_ ||
+      sparsest_container_ratio_ >= FLAGS_log_container_live_data_before_compact_ratio) {
+    return nullptr;
+  }
+  *dead_bytes = sparsest_container_->total_bytes_written() - sparsest_container_->live_bytes();
+  return sparsest_container_;
+}
+
+void LogBlockManager::UpdateSparsestContainerUnlocked(LogBlockContainer* container) {
+  DCHECK(lock_.is_locked());
+  if (sparsest_container_stale_) {
+    return;
+  }
+  if (container == sparsest_container_) {
+    // If the container became denser, or can no longer be compacted, some
+    // other container may now be the sparsest.
+    if (!container->compactable() ||
+        container->live_data_ratio() > sparsest_container_ratio_) {
+      sparsest_container_stale_ = true;
+    } else {
+      sparsest_container_ratio_ = container->live_data_ratio();
+    }
+    return;
+  }
+  if (container->compactable() &&
+      (!sparsest_container_ || container->live_data_ratio() < sparsest_container_ratio_)) {
+    sparsest_container_ = container;
+    sparsest_container_ratio_ = container->live_data_ratio();
+  }
+}
+
+void LogBlockManager::DeleteDeadContainers() {
+  vector<LogBlockContainer*> to_delete;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    auto it = dead_containers_.begin();
+    while (it != dead_containers_.end()) {
+      if ((*it)->num_log_blocks() == 0) {
+        to_delete.push_back(*it);
+        it = dead_containers_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (LogBlockContainer* container : to_delete) {
+    // Hole punching tasks for the container's deleted blocks may still be
+    // outstanding.
+    container->mutable_data_dir()->WaitOnClosures();
+    VLOG(1) << "Destroying compacted container " << container->ToString();
+    delete container;
+  }
+}
+
 std::string LogBlockManager::ContainerPathForTests(internal::LogBlockContainer* container) {
   return container->ToString();
 }
@@ -54,6 +54,7 @@ namespace fs {
 namespace internal {
 class LogBlock;
 class LogBlockContainer;
+class LogBlockContainerCompactionOp;
 
 struct LogBlockManagerMetrics;
 } // namespace internal
@@ -81,9 +82,18 @@ struct LogBlockManagerMetrics;
 // orphaned data can be reclaimed instantaneously via hole punching, or
 // later via garbage collection. The latter is used when hole punching is
 // not supported on the filesystem, or on next boot if there's a crash
-// after deletion but before hole punching. The metadata file itself is not
-// compacted, as it is expected to remain quite small even after a great
-// many create/delete cycles.
+// after deletion but before hole punching. A container's metadata file is
+// compacted when the container is opened if most of its records describe
+// deleted blocks.
+//
+// Hole punching leaves a container's files in place for as long as any of
+// its blocks are alive, however. To bound the number of containers (and thus
+// open files and metadata to read at startup), a background maintenance op
+// compacts full containers whose live data has fallen below a threshold: the
+// live blocks are copied into other containers, after which the container's
+// files are deleted. Each copy is recorded with an incremented relocation
+// count so that, if there's a crash before the original container is
+// deleted, the copy supersedes the original at startup.
 //
 // Data and metadata operations are carefully ordered to ensure the
 // correctness of the persistent representation at all times. During the
@@ -180,16 +190,40 @@ class LogBlockManager : public BlockManager {
 
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) OVERRIDE;
 
+  // Registers the container compaction op. Does nothing if the block manager
+  // is read-only or has no metrics.
+  virtual void RegisterMaintenanceOps(MaintenanceManager* maintenance_manager) OVERRIDE;
+
+  // Unregisters the container compaction op, aborting any compaction that is
+  // in progress.
+  virtual void UnregisterMaintenanceOps() OVERRIDE;
+
+  // Compacts the full container with the smallest fraction of live data, if
+  // that fraction is below --log_container_live_data_before_compact_ratio.
+  // The container's live blocks are copied into other containers, at a rate
+  // limited by --log_container_compaction_max_bytes_per_sec, and then the
+  // container is deleted.
+  //
+  // Blocks may be read, created, and deleted throughout. Readers that opened
+  // a block before it was copied continue to read the original.
+  Status CompactSparsestContainer();
+
   // Return the number of blocks stored in the block manager.
   int64_t CountBlocksForTests() const;
 
  private:
+  FRIEND_TEST(LogBlockManagerTest, TestContainerCompaction);
+  FRIEND_TEST(LogBlockManagerTest, TestContainerCompactionFailures);
+  FRIEND_TEST(LogBlockManagerTest, TestDeleteOrphanedDataFiles);
+  FRIEND_TEST(LogBlockManagerTest, TestFindSparsestContainer);
   FRIEND_TEST(LogBlockManagerTest, TestLookupBlockLimit);
+  FRIEND_TEST(LogBlockManagerTest, TestMetadataCompaction);
   FRIEND_TEST(LogBlockManagerTest, TestMetadataTruncation);
   FRIEND_TEST(LogBlockManagerTest, TestParseKernelRelease);
   FRIEND_TEST(LogBlockManagerTest, TestReuseBlockIds);
 
   friend class internal::LogBlockContainer;
+  friend class internal::LogBlockContainerCompactionOp;
 
   // Simpler typedef for a block map which isn't tracked in the memory tracker.
   // Used during startup.
@@ -253,6 +287,26 @@ class LogBlockManager : public BlockManager {
   // already gone.
   scoped_refptr<internal::LogBlock> RemoveLogBlock(const BlockId& block_id);
 
+  // Unlocked variant of RemoveLogBlock(). Must hold 'lock_'.
+  scoped_refptr<internal::LogBlock> RemoveLogBlockUnlocked(const BlockId& block_id);
+
+  // Returns the full container that CompactSparsestContainer() should
+  // compact, or null if there is none. If not null, 'dead_bytes' is set to
+  // the number of bytes that compacting it would free.
+  //
+  // Must hold 'lock_'.
+  internal::LogBlockContainer* FindSparsestContainerUnlocked(int64_t* dead_bytes);
+
+  // Accounts for a change to the container's live data, or to whether it
+  // can be compacted, in 'sparsest_container_'.
+  //
+  // Must hold 'lock_'.
+  void UpdateSparsestContainerUnlocked(internal::LogBlockContainer* container);
+
+  // Destroys the compacted containers in 'dead_containers_' that no blocks
+  // refer to anymore.
+  void DeleteDeadContainers();
+
   // Parses a block record, adding or removing it in 'block_map', and
   // accounting for it in the metadata for 'container'.
   //
@@ -261,10 +315,26 @@ class LogBlockManager : public BlockManager {
                             internal::LogBlockContainer* container,
                             UntrackedBlockMap* block_map);
 
-  // Open a particular data directory belonging to the block manager.
+  // Finds the ids of the containers in a particular data directory belonging
+  // to the block manager. Data files without a metadata file, which a crash
+  // during a container compaction can leave behind, are deleted.
   //
   // Success or failure is set in 'result_status'.
-  void OpenDataDir(DataDir* dir, Status* result_status);
+  void FindContainers(DataDir* dir,
+                      std::vector<std::string>* container_ids,
+                      Status* result_status);
+
+  // Opens the container 'id' in 'dir' and adds its blocks to the in-memory
+  // maps. If most of the container's metadata records are for deleted
+  // blocks, the metadata file is compacted, and the time spent doing so is
+  // added to 'compact_metadata_micros'.
+  //
+  // Thread safe, so that many containers in a data directory can be opened
+  // at once. Success or failure is set in 'result_status'.
+  void OpenContainer(DataDir* dir,
+                     const std::string& id,
+                     AtomicInt<int64_t>* compact_metadata_micros,
+                     Status* result_status);
 
   // Perform basic initialization.
   Status Init();
@@ -322,6 +392,26 @@ class LogBlockManager : public BlockManager {
   // Holds (and owns) all containers loaded from disk.
   std::vector<internal::LogBlockContainer*> all_containers_;
 
+  // Holds (and owns) containers that were compacted, and whose files have
+  // been deleted, but which may still be referenced by open blocks.
+  std::vector<internal::LogBlockContainer*> dead_containers_;
+
+  // The compactable container with the smallest fraction of live data, and
+  // that fraction, so that finding the container to compact doesn't require
+  // scanning all containers. Kept up to date as containers change by
+  // UpdateSparsestContainerUnlocked(), and recomputed from scratch only when
+  // 'sparsest_container_stale_' is set.
+  //
+  // Protected by 'lock_'.
+  internal::LogBlockContainer* sparsest_container_;
+  double sparsest_container_ratio_;
+  bool sparsest_container_stale_;
+
+  // Blocks found at startup to have been superseded by a relocated copy in
+  // another container. Their deletion is recorded once all of the containers
+  // have been opened.
+  std::vector<scoped_refptr<internal::LogBlock>> superseded_blocks_;
+
   // Holds only those containers that are currently available for writing,
   // excluding containers that are either in use or full.
   //
@@ -354,6 +444,13 @@ class LogBlockManager : public BlockManager {
   // May be null if instantiated without metrics.
   gscoped_ptr<internal::LogBlockManagerMetrics> metrics_;
 
+  // The container compaction op, if registered.
+  std::unique_ptr<internal::LogBlockContainerCompactionOp> compaction_op_;
+
+  // Set when the compaction op is unregistered, aborting any compaction in
+  // progress.
+  AtomicBool compaction_cancelled_;
+
   DISALLOW_COPY_AND_ASSIGN(LogBlockManager);
 };
 
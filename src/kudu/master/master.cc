@@ -95,6 +95,7 @@ Status Master::Init() {
   RETURN_NOT_OK(ThreadPoolBuilder("init").set_max_threads(1).Build(&init_pool_));
 
   RETURN_NOT_OK(ServerBase::Init());
+  cfile::BlockCache::GetSingleton()->StartSecondaryCache(fs_manager_->uuid());
 
   RETURN_NOT_OK(path_handlers_->Register(web_server_.get()));
 
@@ -16,6 +16,7 @@
 // under the License.
 
 #include <memory>
+#include <set>
 #include <gtest/gtest.h>
 #include <glog/logging.h>
 
@@ -24,8 +25,10 @@
 #include "kudu/tablet/diskrowset-test-base.h"
 #include "kudu/tablet/tablet-test-base.h"
 #include "kudu/util/mem_tracker.h"
+#include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(consult_bloom_filters);
 DECLARE_int32(cfile_default_block_size);
 
 using std::shared_ptr;
@@ -208,6 +211,33 @@ TEST_F(TestCFileSet, TestPartiallyMaterialize) {
   ASSERT_LT(stats[1].cells_read_from_disk, kNumRows * 3 / 4);
 }
 
+// A full scan reads each column in order, so it should read data blocks
+// ahead of the scan, and use every block it reads ahead.
+TEST_F(TestCFileSet, TestSequentialScanReadsAhead) {
+  const int kNumRows = 10000;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset;
+  ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset));
+
+  shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+  gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+  ASSERT_OK(iter->Init(nullptr));
+  vector<string> results;
+  ASSERT_OK(IterateToStringList(iter.get(), &results));
+  ASSERT_EQ(kNumRows, results.size());
+
+  vector<IteratorStats> stats;
+  iter->GetIteratorStats(&stats);
+  ASSERT_EQ(3, stats.size());
+  for (int i = 0; i < 3; i++) {
+    LOG(INFO) << "Col " << i << " stats: " << stats[i].ToString();
+    EXPECT_EQ(0, stats[i].readahead_bytes_wasted);
+  }
+  ASSERT_GT(stats[0].readahead_hits, 0);
+  ASSERT_LT(stats[0].readahead_hits, stats[0].data_blocks_read_from_disk);
+}
+
 TEST_F(TestCFileSet, TestIteratePartialSchema) {
   const int kNumRows = 100;
   WriteTestRowSet(kNumRows);
@@ -318,6 +348,133 @@ TEST_F(TestCFileSet, TestRangePredicates2) {
   DoTestRangeScan(fileset, kNumRows * 10, kNoBound);
 }
 
+// Predicates on non-key columns should skip the blocks, or the whole rowset,
+// which the zone maps of the column rule out.
+TEST_F(TestCFileSet, TestZoneMapPruning) {
+  const int kNumRows = 10000;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset;
+  ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset));
+
+  // Scans with 'pred', checking that 'expected_rows' rows are returned, and
+  // returns the scanned ordinal bounds and the stats of column c2.
+  auto scan = [&] (const ColumnPredicate& pred, const std::set<ColumnId>* updated_col_ids,
+                   int expected_rows, size_t* lower_bound, size_t* upper_bound,
+                   IteratorStats* c2_stats) {
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+    if (updated_col_ids != nullptr) {
+      cfile_iter->EnableZoneMapPruning(*updated_col_ids);
+    }
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    ScanSpec spec;
+    spec.AddPredicate(pred);
+    ASSERT_OK(iter->Init(&spec));
+    *lower_bound = cfile_iter->lower_bound_idx_;
+    *upper_bound = cfile_iter->upper_bound_idx_;
+
+    vector<string> results;
+    ASSERT_OK(IterateToStringList(iter.get(), &results));
+    ASSERT_EQ(expected_rows, results.size()) << pred.ToString();
+    vector<IteratorStats> stats;
+    iter->GetIteratorStats(&stats);
+    *c2_stats = stats[2];
+  };
+
+  const std::set<ColumnId> no_updates;
+  size_t lower_bound;
+  size_t upper_bound;
+  IteratorStats stats;
+
+  // A narrow range of c2 only needs the blocks containing it.
+  int32_t lower = 500000;
+  int32_t upper = 501000;
+  auto range = ColumnPredicate::Range(schema_.column(2), &lower, &upper);
+  NO_FATALS(scan(range, &no_updates, 10, &lower_bound, &upper_bound, &stats));
+  EXPECT_LE(lower_bound, 5000);
+  EXPECT_GE(upper_bound, 5010);
+  EXPECT_LT(upper_bound - lower_bound, 1000);
+  EXPECT_LE(stats.data_blocks_read_from_disk, 2);
+
+  // Values at either end of c1 leave the blocks in between excluded.
+  int32_t first = 10;
+  int32_t last = (kNumRows - 1) * 10;
+  vector<const void*> values = { &first, &last };
+  auto in_list = ColumnPredicate::InList(schema_.column(1), &values);
+  NO_FATALS(scan(in_list, &no_updates, 2, &lower_bound, &upper_bound, &stats));
+  EXPECT_LE(stats.data_blocks_read_from_disk, 2);
+
+  // A range past the values of c2 excludes the whole rowset.
+  int32_t past_end = kNumRows * 100;
+  auto none = ColumnPredicate::Range(schema_.column(2), &past_end, nullptr);
+  NO_FATALS(scan(none, &no_updates, 0, &lower_bound, &upper_bound, &stats));
+  EXPECT_EQ(lower_bound, upper_bound);
+  EXPECT_EQ(0, stats.data_blocks_read_from_disk);
+
+  // The zone maps aren't used unless pruning is enabled, nor for columns
+  // which may have been updated.
+  NO_FATALS(scan(range, nullptr, 10, &lower_bound, &upper_bound, &stats));
+  EXPECT_EQ(0, lower_bound);
+  EXPECT_EQ(kNumRows, upper_bound);
+  const std::set<ColumnId> c2_updated = { schema_.column_id(2) };
+  NO_FATALS(scan(range, &c2_updated, 10, &lower_bound, &upper_bound, &stats));
+  EXPECT_EQ(0, lower_bound);
+  EXPECT_EQ(kNumRows, upper_bound);
+}
+
+// Checking a sorted batch of keys at once must give the same results as
+// checking each key on its own, with or without the bloom filter.
+TEST_F(TestCFileSet, TestCheckRowsPresent) {
+  const int kNumRows = 10000;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset;
+  ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset));
+
+  // The rowset's keys are the even numbers below kNumRows * 2. Check keys
+  // before, among and after them.
+  vector<int32_t> keys;
+  for (int32_t key = -3; key < kNumRows * 2 + 5; key += 3) {
+    keys.push_back(key);
+  }
+  vector<std::unique_ptr<RowBuilder>> rbs;
+  vector<std::unique_ptr<RowSetKeyProbe>> probes;
+  for (int32_t key : keys) {
+    rbs.emplace_back(new RowBuilder(schema_.CreateKeyProjection()));
+    rbs.back()->AddInt32(key);
+    probes.emplace_back(new RowSetKeyProbe(rbs.back()->row()));
+  }
+
+  for (bool consult_bloom_filters : { true, false }) {
+    SCOPED_TRACE(consult_bloom_filters);
+    FLAGS_consult_bloom_filters = consult_bloom_filters;
+
+    vector<ProbeStats> stats(keys.size());
+    vector<RowSetKeyCheck> checks;
+    for (int i = 0; i < keys.size(); i++) {
+      checks.emplace_back(probes[i].get(), &stats[i]);
+    }
+    vector<rowid_t> rowids;
+    ASSERT_OK(fileset->CheckRowsPresent(&checks, &rowids));
+    ASSERT_EQ(keys.size(), rowids.size());
+
+    for (int i = 0; i < keys.size(); i++) {
+      SCOPED_TRACE(keys[i]);
+      bool present;
+      rowid_t rowid;
+      ProbeStats single_stats;
+      ASSERT_OK(fileset->CheckRowPresent(*probes[i], &present, &rowid, &single_stats));
+      ASSERT_EQ(present, checks[i].present);
+      bool expected = keys[i] >= 0 && keys[i] % 2 == 0 && keys[i] < kNumRows * 2;
+      ASSERT_EQ(expected, present);
+      if (present) {
+        ASSERT_EQ(rowid, rowids[i]);
+        ASSERT_EQ(static_cast<rowid_t>(keys[i] / 2), rowid);
+      }
+      ASSERT_EQ(consult_bloom_filters ? 1 : 0, stats[i].blooms_consulted);
+    }
+  }
+}
 
 } // namespace tablet
 } // namespace kudu
@@ -24,6 +24,8 @@
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/index_btree.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/column_materialization_context.h"
 #include "kudu/gutil/dynamic_annotations.h"
@@ -38,13 +40,25 @@
 DEFINE_bool(consult_bloom_filters, true, "Whether to consult bloom filters on row presence checks");
 TAG_FLAG(consult_bloom_filters, hidden);
 
+DEFINE_bool(use_zone_maps_for_scans, true,
+            "Whether to use the zone maps of the base data to skip blocks and rowsets "
+            "which can't satisfy a scan's predicates");
+TAG_FLAG(use_zone_maps_for_scans, hidden);
+TAG_FLAG(use_zone_maps_for_scans, runtime);
+
 namespace kudu {
 namespace tablet {
 
+using cfile::BlockZoneMapsPB;
 using cfile::ReaderOptions;
 using cfile::DefaultColumnValueIterator;
+using cfile::IndexTreeIterator;
+using cfile::ZoneMapMayMatch;
+using cfile::ZoneMapPB;
 using fs::ReadableBlock;
+using std::pair;
 using std::shared_ptr;
+using std::vector;
 using strings::Substitute;
 
 ////////////////////////////////////////////////////////////
@@ -194,6 +208,23 @@ Status CFileSet::GetBounds(string* min_encoded_key,
   return Status::OK();
 }
 
+Status CFileSet::GetKeySamples(vector<string>* keys) const {
+  CFileReader* key_reader = key_index_reader();
+  if (!key_reader->has_validx()) {
+    keys->push_back(min_encoded_key_);
+    return Status::OK();
+  }
+  gscoped_ptr<IndexTreeIterator> iter(
+      IndexTreeIterator::Create(key_reader, key_reader->validx_root()));
+  RETURN_NOT_OK(iter->SeekToFirst());
+  keys->push_back(iter->GetCurrentKey().ToString());
+  while (iter->HasNext()) {
+    RETURN_NOT_OK(iter->Next());
+    keys->push_back(iter->GetCurrentKey().ToString());
+  }
+  return Status::OK();
+}
+
 uint64_t CFileSet::EstimateOnDiskSize() const {
   uint64_t ret = 0;
   for (const ReaderMap::value_type& e : readers_by_col_id_) {
@@ -255,6 +286,74 @@ Status CFileSet::CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
   return s;
 }
 
+Status CFileSet::CheckRowsPresent(vector<RowSetKeyCheck>* checks,
+                                  vector<rowid_t>* rowids) const {
+  rowids->resize(checks->size());
+
+  // The indexes of the checks which the bloom filter couldn't rule out.
+  vector<int> candidates;
+  candidates.reserve(checks->size());
+  bool bloom_checked = false;
+  if (bloom_reader_ != nullptr && FLAGS_consult_bloom_filters) {
+    // Fully open the BloomFileReader if it was lazily opened earlier.
+    RETURN_NOT_OK(bloom_reader_->Init());
+
+    vector<const BloomKeyProbe*> bloom_probes;
+    bloom_probes.reserve(checks->size());
+    for (RowSetKeyCheck& check : *checks) {
+      check.stats->blooms_consulted++;
+      bloom_probes.push_back(&check.probe->bloom_probe());
+    }
+    std::unique_ptr<bool[]> maybe_present(new bool[checks->size()]);
+    Status s = bloom_reader_->CheckKeysPresent(bloom_probes, maybe_present.get());
+    if (s.ok()) {
+      for (int i = 0; i < checks->size(); i++) {
+        if (maybe_present[i]) {
+          candidates.push_back(i);
+        }
+      }
+      bloom_checked = true;
+    } else {
+      LOG(WARNING) << "Unable to query bloom: " << s.ToString()
+                   << " (disabling bloom for this rowset from this point forward)";
+      const_cast<CFileSet *>(this)->bloom_reader_.reset(nullptr);
+      // Continue with the slow path
+    }
+  }
+  if (!bloom_checked) {
+    for (int i = 0; i < checks->size(); i++) {
+      candidates.push_back(i);
+    }
+  }
+  for (RowSetKeyCheck& check : *checks) {
+    check.present = false;
+  }
+  if (candidates.empty()) {
+    return Status::OK();
+  }
+
+  CFileIterator *key_iter = nullptr;
+  RETURN_NOT_OK(NewKeyIterator(&key_iter));
+  gscoped_ptr<CFileIterator> key_iter_scoped(key_iter); // free on return
+
+  for (int i : candidates) {
+    RowSetKeyCheck* check = &(*checks)[i];
+    check->stats->keys_consulted++;
+    bool exact;
+    Status s = key_iter->SeekAtOrAfter(check->probe->encoded_key(), &exact);
+    if (s.IsNotFound()) {
+      // The key comes past the end of the file.
+      continue;
+    }
+    RETURN_NOT_OK(s);
+    if (exact) {
+      check->present = true;
+      (*rowids)[i] = key_iter->GetCurrentOrdinal();
+    }
+  }
+  return Status::OK();
+}
+
 Status CFileSet::NewKeyIterator(CFileIterator **key_iter) const {
   return key_index_reader()->NewIterator(key_iter, CFileReader::CACHE_BLOCK);
 }
@@ -321,6 +420,8 @@ Status CFileSet::Iterator::Init(ScanSpec *spec) {
   // ordinal range.
   RETURN_NOT_OK(PushdownRangeScanPredicate(spec));
 
+  RETURN_NOT_OK(PushdownZoneMapPredicates(spec));
+
   initted_ = true;
 
   // Don't actually seek -- we'll seek when we first actually read the
@@ -390,6 +491,105 @@ Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
   return Status::OK();
 }
 
+void CFileSet::Iterator::EnableZoneMapPruning(std::set<ColumnId> updated_col_ids) {
+  DCHECK(!initted_);
+  zone_map_pruning_enabled_ = true;
+  updated_col_ids_ = std::move(updated_col_ids);
+}
+
+Status CFileSet::Iterator::PushdownZoneMapPredicates(const ScanSpec* spec) {
+  excluded_ranges_.clear();
+  next_excluded_range_ = 0;
+
+  if (!zone_map_pruning_enabled_ || !FLAGS_use_zone_maps_for_scans ||
+      spec == nullptr || lower_bound_idx_ >= upper_bound_idx_) {
+    return Status::OK();
+  }
+
+  CFileReader::CacheControl cache_blocks = spec->cache_blocks() ?
+      CFileReader::CACHE_BLOCK : CFileReader::DONT_CACHE_BLOCK;
+
+  vector<pair<rowid_t, rowid_t>> excluded;
+  for (const auto& entry : spec->predicates()) {
+    const ColumnPredicate& pred = entry.second;
+    int proj_col_idx = projection_->find_column(pred.column().name());
+    if (proj_col_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    ColumnId col_id = projection_->column_id(proj_col_idx);
+    if (ContainsKey(updated_col_ids_, col_id) || !base_data_->has_data_for_column_id(col_id)) {
+      continue;
+    }
+    CFileReader* reader = FindOrDie(base_data_->readers_by_col_id_, col_id).get();
+    RETURN_NOT_OK(reader->Init());
+    if (!reader->has_zone_maps()) {
+      continue;
+    }
+
+    if (!ZoneMapMayMatch(reader->type_info(), reader->zone_map(), pred)) {
+      VLOG(1) << "Zone map of " << base_data_->ToString() << " excludes predicate "
+              << pred.ToString() << ": skipping all rows";
+      lower_bound_idx_ = upper_bound_idx_;
+      return Status::OK();
+    }
+
+    BlockZoneMapsPB zone_maps;
+    RETURN_NOT_OK(reader->ReadBlockZoneMaps(cache_blocks, &zone_maps));
+    rowid_t first_row = 0;
+    for (const ZoneMapPB& zone_map : zone_maps.zone_maps()) {
+      rowid_t end_row = first_row + zone_map.num_rows();
+      if (end_row > lower_bound_idx_ && first_row < upper_bound_idx_ &&
+          !ZoneMapMayMatch(reader->type_info(), zone_map, pred)) {
+        excluded.emplace_back(first_row, end_row);
+      }
+      first_row = end_row;
+    }
+    if (PREDICT_FALSE(first_row != row_count_)) {
+      return Status::Corruption(Substitute("zone maps of $0 cover $1 rows, expected $2",
+                                           reader->ToString(), first_row, row_count_));
+    }
+  }
+  if (excluded.empty()) {
+    return Status::OK();
+  }
+
+  // Merge the ranges of all the predicates, coalescing adjacent ranges so
+  // that a batch is never prepared between two of them.
+  std::sort(excluded.begin(), excluded.end());
+  for (const auto& range : excluded) {
+    if (!excluded_ranges_.empty() && range.first <= excluded_ranges_.back().second) {
+      excluded_ranges_.back().second = std::max(excluded_ranges_.back().second, range.second);
+    } else {
+      excluded_ranges_.push_back(range);
+    }
+  }
+
+  // Ranges at either end of the bounds narrow the bounds instead.
+  if (excluded_ranges_.back().second >= upper_bound_idx_) {
+    upper_bound_idx_ = std::max(lower_bound_idx_,
+                                std::min(upper_bound_idx_, excluded_ranges_.back().first));
+    excluded_ranges_.pop_back();
+  }
+  if (!excluded_ranges_.empty() && excluded_ranges_.front().first <= lower_bound_idx_) {
+    lower_bound_idx_ = std::min(upper_bound_idx_,
+                                std::max(lower_bound_idx_, excluded_ranges_.front().second));
+    excluded_ranges_.erase(excluded_ranges_.begin());
+  }
+  VLOG(1) << "Zone maps of " << base_data_->ToString() << " narrowed the scan to rows ["
+          << lower_bound_idx_ << ", " << upper_bound_idx_ << ") excluding "
+          << excluded_ranges_.size() << " ranges";
+  return Status::OK();
+}
+
+void CFileSet::Iterator::SkipExcludedRows() {
+  if (next_excluded_range_ < excluded_ranges_.size() &&
+      excluded_ranges_[next_excluded_range_].first <= cur_idx_) {
+    DCHECK_LT(cur_idx_, excluded_ranges_[next_excluded_range_].second);
+    cur_idx_ = excluded_ranges_[next_excluded_range_].second;
+    next_excluded_range_++;
+  }
+}
+
 void CFileSet::Iterator::Unprepare() {
   prepared_count_ = 0;
   cols_prepared_.assign(col_iters_.size(), false);
@@ -398,7 +598,13 @@ void CFileSet::Iterator::Unprepare() {
 Status CFileSet::Iterator::PrepareBatch(size_t *n) {
   DCHECK_EQ(prepared_count_, 0) << "Already prepared";
 
+  SkipExcludedRows();
+
   size_t remaining = upper_bound_idx_ - cur_idx_;
+  if (next_excluded_range_ < excluded_ranges_.size()) {
+    // Stop the batch at the next excluded range, so it can be skipped too.
+    remaining = excluded_ranges_[next_excluded_range_].first - cur_idx_;
+  }
   if (*n > remaining) {
     *n = remaining;
   }
@@ -19,8 +19,10 @@
 
 #include <gtest/gtest_prod.h>
 #include <memory>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "kudu/cfile/bloomfile.h"
@@ -69,6 +71,10 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
 
   uint64_t EstimateOnDiskSize() const;
 
+  // See RowSet::GetKeySamples. The keys are those of the key index, which has
+  // an entry for each of its data blocks.
+  Status GetKeySamples(std::vector<std::string>* keys) const;
+
   // Determine the index of the given row key.
   Status FindRow(const RowSetKeyProbe &probe, rowid_t *idx, ProbeStats* stats) const;
 
@@ -81,6 +87,16 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                          rowid_t *rowid, ProbeStats* stats) const;
 
+  // Like CheckRowPresent(), for each of 'checks', which must be sorted by
+  // key. For each key which is present, sets the corresponding entry of
+  // 'rowids' to the row's index.
+  //
+  // Each bloom filter block is read once for all the keys which fall in it,
+  // and the keys are looked up with a single key index iterator, so that
+  // index blocks are shared between nearby keys.
+  Status CheckRowsPresent(std::vector<RowSetKeyCheck>* checks,
+                          std::vector<rowid_t>* rowids) const;
+
   // Return true if there exists a CFile for the given column ID.
   bool has_data_for_column_id(ColumnId col_id) const {
     return ContainsKey(readers_by_col_id_, col_id);
@@ -171,10 +187,22 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // Collect the IO statistics for each of the underlying columns.
   virtual void GetIteratorStats(vector<IteratorStats> *stats) const OVERRIDE;
 
+  // Allow the iterator to skip rows which, according to the zone maps of the
+  // base data, can't satisfy the scan's predicates. Zone maps only describe
+  // the base data, so predicates on the columns in 'updated_col_ids', whose
+  // values may have been changed by deltas, are not used.
+  //
+  // Rows are skipped by advancing cur_ordinal_idx(), so wrapping iterators
+  // must reposition themselves if it changes unexpectedly.
+  //
+  // Must be called before Init().
+  void EnableZoneMapPruning(std::set<ColumnId> updated_col_ids);
+
   virtual ~Iterator();
  private:
   DISALLOW_COPY_AND_ASSIGN(Iterator);
   FRIEND_TEST(TestCFileSet, TestRangeScan);
+  FRIEND_TEST(TestCFileSet, TestZoneMapPruning);
   friend class CFileSet;
 
   // 'projection' must remain valid for the lifetime of this object.
@@ -183,7 +211,9 @@ class CFileSet::Iterator : public ColumnwiseIterator {
         projection_(projection),
         initted_(false),
         cur_idx_(0),
-        prepared_count_(0) {
+        prepared_count_(0),
+        zone_map_pruning_enabled_(false),
+        next_excluded_range_(0) {
     CHECK_OK(base_data_->CountRows(&row_count_));
   }
 
@@ -195,6 +225,14 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // store it in member fields.
   Status PushdownRangeScanPredicate(ScanSpec *spec);
 
+  // Use the zone maps of the columns with predicates to find the ranges of
+  // rows which can't satisfy them, narrowing the ordinal bounds where
+  // possible. The predicates are left in the scan spec.
+  Status PushdownZoneMapPredicates(const ScanSpec* spec);
+
+  // Advance cur_idx_ past the excluded range it is in, if any.
+  void SkipExcludedRows();
+
   void Unprepare();
 
   // Prepare the given column if not already prepared.
@@ -227,6 +265,17 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // materialized, it doesn't need to be read off disk.
   vector<bool> cols_prepared_;
 
+  // See EnableZoneMapPruning().
+  bool zone_map_pruning_enabled_;
+  std::set<ColumnId> updated_col_ids_;
+
+  // Ranges of ordinal row indexes [first, second) which the zone maps showed
+  // can't satisfy the predicates. Sorted, non-overlapping and non-adjacent,
+  // and always strictly within the bounds above.
+  std::vector<std::pair<rowid_t, rowid_t>> excluded_ranges_;
+
+  // The index of the first range in 'excluded_ranges_' not yet skipped.
+  size_t next_excluded_range_;
 };
 
 } // namespace tablet
@@ -72,14 +72,17 @@ bool DeltaApplier::HasNext() const {
 }
 
 Status DeltaApplier::PrepareBatch(size_t *nrows) {
+  rowid_t expected_idx = base_iter_->cur_ordinal_idx();
+  RETURN_NOT_OK(base_iter_->PrepareBatch(nrows));
+
   // The initial seek is deferred from Init() into the first PrepareBatch()
   // because it requires a loaded delta file, and we don't want to require
-  // that at Init() time.
-  if (first_prepare_) {
+  // that at Init() time. The base iterator may also have skipped rows which
+  // its zone maps ruled out, in which case the deltas must catch up.
+  if (first_prepare_ || base_iter_->cur_ordinal_idx() != expected_idx) {
     RETURN_NOT_OK(delta_iter_->SeekToOrdinal(base_iter_->cur_ordinal_idx()));
     first_prepare_ = false;
   }
-  RETURN_NOT_OK(base_iter_->PrepareBatch(nrows));
   RETURN_NOT_OK(delta_iter_->PrepareBatch(*nrows, DeltaIterator::PREPARE_FOR_APPLY));
   return Status::OK();
 }
@@ -411,6 +411,13 @@ Status DeltaTracker::WrapIterator(const shared_ptr<CFileSet::Iterator> &base,
   unique_ptr<DeltaIterator> iter;
   RETURN_NOT_OK(NewDeltaIterator(&base->schema(), mvcc_snap, &iter));
 
+  // The zone maps of the base data may only be used for the columns which
+  // the deltas can't have changed.
+  set<ColumnId> col_ids_with_updates;
+  if (GetColumnIdsWithAnyUpdates(&col_ids_with_updates)) {
+    base->EnableZoneMapPruning(std::move(col_ids_with_updates));
+  }
+
   out->reset(new DeltaApplier(base, std::move(iter)));
   return Status::OK();
 }
@@ -606,5 +613,23 @@ void DeltaTracker::GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const
   col_ids->assign(column_ids_with_updates.begin(), column_ids_with_updates.end());
 }
 
+bool DeltaTracker::GetColumnIdsWithAnyUpdates(set<ColumnId>* col_ids) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+  if (!dms_->Empty()) {
+    return false;
+  }
+  for (const SharedDeltaStoreVector* stores : { &redo_delta_stores_, &undo_delta_stores_ }) {
+    for (const shared_ptr<DeltaStore>& ds : *stores) {
+      // We won't force open files just to read their stats. A DeltaMemStore
+      // which is being flushed has no stats, but may have updated any column.
+      if (!ds->Initted() || dynamic_cast<const DeltaMemStore*>(ds.get()) != nullptr) {
+        return false;
+      }
+      ds->delta_stats().AddColumnIdsWithUpdates(col_ids);
+    }
+  }
+  return true;
+}
+
 } // namespace tablet
 } // namespace kudu
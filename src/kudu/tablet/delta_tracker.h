@@ -19,6 +19,7 @@
 
 #include <gtest/gtest_prod.h>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -183,6 +184,13 @@ class DeltaTracker {
   // Retrieves the list of column indexes that currently have updates.
   void GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const;
 
+  // Retrieves the ids of the columns which may be updated by any REDO or UNDO
+  // delta store. Returns false if this can't be determined without opening a
+  // delta file, or if any DeltaMemStore (including one which is being
+  // flushed) holds any mutations; in that case, every column may have been
+  // updated.
+  bool GetColumnIdsWithAnyUpdates(std::set<ColumnId>* col_ids) const;
+
   Mutex* compact_flush_lock() {
     return &compact_flush_lock_;
   }
@@ -190,6 +198,7 @@ class DeltaTracker {
  private:
   FRIEND_TEST(TestRowSet, TestRowSetUpdate);
   FRIEND_TEST(TestRowSet, TestDMSFlush);
+  FRIEND_TEST(TestRowSet, TestZoneMapsNotUsedWhileFlushingDMS);
   FRIEND_TEST(TestRowSet, TestMakeDeltaIteratorMergerUnlocked);
   FRIEND_TEST(TestRowSet, TestCompactStores);
   FRIEND_TEST(TestMajorDeltaCompaction, TestCompact);
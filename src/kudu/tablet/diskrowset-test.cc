@@ -19,12 +19,16 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <time.h>
 
 #include "kudu/common/row.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/tablet/delta_compaction.h"
+#include "kudu/tablet/delta_tracker.h"
+#include "kudu/tablet/deltamemstore.h"
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/diskrowset-test-base.h"
 #include "kudu/tablet/tablet-test-util.h"
@@ -40,9 +44,12 @@ DECLARE_double(tablet_delta_store_major_compact_min_ratio);
 DECLARE_int32(tablet_delta_store_minor_compact_max);
 
 using std::is_sorted;
+using std::set;
 using std::shared_ptr;
+using std::string;
 using std::unique_ptr;
 using std::unordered_set;
+using std::vector;
 
 namespace kudu {
 namespace tablet {
@@ -297,6 +304,56 @@ TEST_F(TestRowSet, TestDMSFlush) {
   }
 }
 
+// Test that a scan doesn't skip base data using its zone maps while the
+// DeltaMemStore holding updates to it is being flushed.
+TEST_F(TestRowSet, TestZoneMapsNotUsedWhileFlushingDMS) {
+  WriteTestRowSet();
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(OpenTestRowSet(&rs));
+
+  // Update a row to a value above the range of the base data.
+  const uint32_t new_val = n_rows_ * 10;
+  OperationResultPB result;
+  ASSERT_OK(UpdateRow(rs.get(), 5, new_val, &result));
+
+  // Swap out the DMS the way DeltaTracker::Flush() does before it writes
+  // the old one out, leaving it in the list of REDO stores.
+  DeltaTracker* dt = rs->delta_tracker_.get();
+  {
+    std::lock_guard<rw_spinlock> l(dt->component_lock_);
+    shared_ptr<DeltaMemStore> old_dms = dt->dms_;
+    ASSERT_OK(DeltaMemStore::Create(old_dms->id() + 1, rs->metadata()->id(),
+                                    dt->log_anchor_registry_,
+                                    dt->mem_trackers_.dms_tracker, &dt->dms_));
+    ASSERT_OK(dt->dms_->Init());
+    dt->dms_empty_.Store(true);
+    dt->redo_delta_stores_.push_back(old_dms);
+  }
+  set<ColumnId> col_ids;
+  ASSERT_FALSE(dt->GetColumnIdsWithAnyUpdates(&col_ids));
+
+  // A scan for the updated value must still find the row.
+  Arena arena(256, 1024);
+  AutoReleasePool pool;
+  ScanSpec spec;
+  spec.AddPredicate(ColumnPredicate::Range(schema_.column(1), &new_val, nullptr));
+  spec.OptimizeScan(schema_, &arena, &pool, true);
+  MvccSnapshot snap = MvccSnapshot::CreateSnapshotIncludingAllTransactions();
+  gscoped_ptr<RowwiseIterator> row_iter;
+  ASSERT_OK(rs->NewRowIterator(&schema_, snap, UNORDERED, &row_iter));
+  ASSERT_OK(row_iter->Init(&spec));
+  vector<string> rows;
+  ASSERT_OK(IterateToStringList(row_iter.get(), &rows));
+  ASSERT_EQ(1, rows.size());
+
+  // Once the flush finishes, the updates are described by the delta file's
+  // stats.
+  ASSERT_OK(rs->FlushDeltas());
+  col_ids.clear();
+  ASSERT_TRUE(dt->GetColumnIdsWithAnyUpdates(&col_ids));
+  ASSERT_EQ(1, col_ids.count(schema_.column_id(1)));
+}
+
 // Test that when a single row is updated multiple times, we can query the
 // historical values using MVCC, even after it is flushed.
 TEST_F(TestRowSet, TestFlushedUpdatesRespectMVCC) {
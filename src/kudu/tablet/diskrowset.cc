@@ -646,6 +646,26 @@ Status DiskRowSet::CheckRowPresent(const RowSetKeyProbe &probe,
   return Status::OK();
 }
 
+Status DiskRowSet::CheckRowsPresent(vector<RowSetKeyCheck>* checks) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+
+  vector<rowid_t> row_idxs;
+  RETURN_NOT_OK(base_data_->CheckRowsPresent(checks, &row_idxs));
+
+  // Keys found in the base data might have been deleted since.
+  for (int i = 0; i < checks->size(); i++) {
+    RowSetKeyCheck* check = &(*checks)[i];
+    if (!check->present) {
+      continue;
+    }
+    bool deleted = false;
+    RETURN_NOT_OK(delta_tracker_->CheckRowDeleted(row_idxs[i], &deleted, check->stats));
+    check->present = !deleted;
+  }
+  return Status::OK();
+}
+
 Status DiskRowSet::CountRows(rowid_t *count) const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_.get_lock());
@@ -660,6 +680,12 @@ Status DiskRowSet::GetBounds(std::string* min_encoded_key,
   return base_data_->GetBounds(min_encoded_key, max_encoded_key);
 }
 
+Status DiskRowSet::GetKeySamples(vector<string>* keys) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return base_data_->GetKeySamples(keys);
+}
+
 uint64_t DiskRowSet::EstimateBaseDataDiskSize() const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_.get_lock());
@@ -309,6 +309,8 @@ class DiskRowSet : public RowSet {
                          bool *present,
                          ProbeStats* stats) const OVERRIDE;
 
+  Status CheckRowsPresent(std::vector<RowSetKeyCheck>* checks) const OVERRIDE;
+
   ////////////////////
   // Read functions.
   ////////////////////
@@ -328,6 +330,9 @@ class DiskRowSet : public RowSet {
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
+  // See RowSet::GetKeySamples(...)
+  Status GetKeySamples(std::vector<std::string>* keys) const OVERRIDE;
+
   // Estimate the number of bytes on-disk for the base data.
   uint64_t EstimateBaseDataDiskSize() const;
 
@@ -372,6 +377,7 @@ class DiskRowSet : public RowSet {
  private:
   FRIEND_TEST(TestRowSet, TestRowSetUpdate);
   FRIEND_TEST(TestRowSet, TestDMSFlush);
+  FRIEND_TEST(TestRowSet, TestZoneMapsNotUsedWhileFlushingDMS);
   FRIEND_TEST(TestCompaction, TestOneToOne);
   FRIEND_TEST(TabletHistoryGcTest, TestMajorDeltaCompactionOnSubsetOfColumns);
 
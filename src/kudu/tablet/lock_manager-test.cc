@@ -23,17 +23,24 @@
 #include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/lock_manager.h"
 #include "kudu/util/env.h"
+#include "kudu/util/random.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 #include "kudu/util/thread.h"
 
 using std::vector;
 using std::shared_ptr;
+using strings::Substitute;
 
 DEFINE_int32(num_test_threads, 10, "number of stress test client threads");
 DEFINE_int32(num_iterations, 1000, "number of iterations per client thread");
+DEFINE_int32(batch_size, 8, "number of rows locked at once by each client thread "
+             "in the batch stress tests");
+DEFINE_int32(num_hot_rows, 64, "number of rows locked by the client threads in "
+             "the batch stress tests");
 
 namespace kudu {
 namespace tablet {
@@ -92,6 +99,43 @@ TEST_F(LockManagerTest, TestRelockSameRow) {
   VerifyAlreadyLocked(key_a);
 }
 
+TEST_F(LockManagerTest, TestLockBatch) {
+  Slice key_a("a"), key_b("b");
+  {
+    vector<ScopedRowLock> locks;
+    lock_manager_.LockBatch({ key_b, key_a, key_b }, kFakeTransaction,
+                            LockManager::LOCK_EXCLUSIVE, &locks);
+    ASSERT_EQ(3, locks.size());
+    for (const auto& l : locks) {
+      ASSERT_TRUE(l.acquired());
+    }
+    VerifyAlreadyLocked(key_a);
+    VerifyAlreadyLocked(key_b);
+
+    // Releasing one of the duplicate locks keeps the row locked.
+    locks[0].Release();
+    VerifyAlreadyLocked(key_b);
+  }
+
+  // Once the locks are released, the rows can be locked again.
+  ScopedRowLock l1(&lock_manager_, kFakeTransaction, key_a, LockManager::LOCK_EXCLUSIVE);
+  ScopedRowLock l2(&lock_manager_, kFakeTransaction, key_b, LockManager::LOCK_EXCLUSIVE);
+}
+
+// Test locking enough rows at once to resize the lock table.
+TEST_F(LockManagerTest, TestLockManyRows) {
+  vector<string> key_strs;
+  for (int i = 0; i < 10000; i++) {
+    key_strs.push_back(Substitute("key$0", i));
+  }
+  vector<Slice> keys(key_strs.begin(), key_strs.end());
+  vector<ScopedRowLock> locks;
+  lock_manager_.LockBatch(keys, kFakeTransaction, LockManager::LOCK_EXCLUSIVE, &locks);
+  for (int i = 0; i < keys.size(); i += 100) {
+    VerifyAlreadyLocked(keys[i]);
+  }
+}
+
 TEST_F(LockManagerTest, TestMoveLock) {
   // Acquire a lock.
   Slice key_a("a");
@@ -144,8 +188,9 @@ class LmTestResource {
 class LmTestThread {
  public:
   LmTestThread(LockManager* manager, vector<const Slice*> keys,
-               const vector<LmTestResource*> resources)
-      : manager_(manager), keys_(std::move(keys)), resources_(resources) {}
+               const vector<LmTestResource*> resources, bool use_batches = false)
+      : manager_(manager), keys_(std::move(keys)), resources_(resources),
+        use_batches_(use_batches) {}
 
   void Start() {
     CHECK_OK(kudu::Thread::Create("test", "test", &LmTestThread::Run, this, &thread_));
@@ -156,13 +201,21 @@ class LmTestThread {
     const TransactionState* my_txn = reinterpret_cast<TransactionState*>(tid_);
 
     std::sort(keys_.begin(), keys_.end());
+    vector<Slice> batch;
+    for (const Slice* key : keys_) {
+      batch.push_back(*key);
+    }
     for (int i = 0; i < FLAGS_num_iterations; i++) {
       std::vector<shared_ptr<ScopedRowLock> > locks;
-      // TODO: We don't have an API for multi-row
-      for (const Slice* key : keys_) {
-        locks.push_back(shared_ptr<ScopedRowLock>(
-                          new ScopedRowLock(manager_, my_txn,
-                                            *key, LockManager::LOCK_EXCLUSIVE)));
+      std::vector<ScopedRowLock> batch_locks;
+      if (use_batches_) {
+        manager_->LockBatch(batch, my_txn, LockManager::LOCK_EXCLUSIVE, &batch_locks);
+      } else {
+        for (const Slice* key : keys_) {
+          locks.push_back(shared_ptr<ScopedRowLock>(
+                            new ScopedRowLock(manager_, my_txn,
+                                              *key, LockManager::LOCK_EXCLUSIVE)));
+        }
       }
 
       for (LmTestResource* r : resources_) {
@@ -187,6 +240,7 @@ class LmTestThread {
   LockManager* manager_;
   vector<const Slice*> keys_;
   const vector<LmTestResource*> resources_;
+  const bool use_batches_;
   uint64_t tid_;
   scoped_refptr<kudu::Thread> thread_;
 };
@@ -283,5 +337,55 @@ TEST_F(LockManagerTest, TestUncontended) {
   runPerformanceTest("Uncontended", &threads);
 }
 
+// Test running a bunch of threads at once that each lock small batches of
+// rows from a small set of hot rows, as concurrent writers to a hot tablet
+// do. The rows are locked one at a time with the legacy lock table, as
+// before the table was striped, then one at a time and a batch at a time
+// with the striped table.
+TEST_F(LockManagerTest, TestSmallBatchContention) {
+  vector<string> key_strs;
+  for (int i = 0; i < FLAGS_num_hot_rows; i++) {
+    key_strs.push_back(Substitute("row$0", i));
+  }
+  vector<Slice> slices(key_strs.begin(), key_strs.end());
+  vector<shared_ptr<LmTestResource> > resources;
+  for (const Slice& slice : slices) {
+    resources.push_back(shared_ptr<LmTestResource>(new LmTestResource(&slice)));
+  }
+
+  LockManager legacy_manager(LockManager::LEGACY_TABLE_FOR_TESTS);
+  struct {
+    const char* name;
+    LockManager* manager;
+    bool use_batches;
+  } const kRuns[] = {
+    { "Legacy per-row", &legacy_manager, false },
+    { "Per-row", &lock_manager_, false },
+    { "Batched", &lock_manager_, true },
+  };
+  // Every run locks the same rows in each thread.
+  const int seed = SeedRandom();
+  for (const auto& run : kRuns) {
+    Random rng(seed);
+    vector<shared_ptr<LmTestThread> > threads;
+    for (int i = 0; i < FLAGS_num_test_threads; ++i) {
+      // Each thread locks a distinct set of random rows.
+      vector<bool> picked(FLAGS_num_hot_rows);
+      vector<const Slice*> k;
+      vector<LmTestResource*> r;
+      while (k.size() < std::min(FLAGS_batch_size, FLAGS_num_hot_rows)) {
+        int row = rng.Uniform(FLAGS_num_hot_rows);
+        if (picked[row]) continue;
+        picked[row] = true;
+        k.push_back(&slices[row]);
+        r.push_back(resources[row].get());
+      }
+      threads.push_back(shared_ptr<LmTestThread>(
+          new LmTestThread(run.manager, k, r, run.use_batches)));
+    }
+    runPerformanceTest(run.name, &threads);
+  }
+}
+
 } // namespace tablet
 } // namespace kudu
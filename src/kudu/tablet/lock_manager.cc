@@ -18,13 +18,16 @@
 #include "kudu/tablet/lock_manager.h"
 
 #include <glog/logging.h>
+#include <algorithm>
 #include <mutex>
 #include <semaphore.h>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/hash/city.h"
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
@@ -66,6 +69,7 @@ class LockEntry {
 
  private:
   friend class LockTable;
+  friend class LegacyLockTable;
   friend class LockManager;
 
   void CopyKey() {
@@ -92,7 +96,185 @@ class LockEntry {
   const TransactionState* holder_;
 };
 
+// A hash table of the locked keys, split into stripes by the high bits of
+// the keys' hashes. Each stripe is a separate chained hash table with its
+// own lock, which it holds while looking up, inserting, removing or
+// resizing, so that threads locking different keys rarely contend and a
+// resize only blocks the users of one stripe.
 class LockTable {
+ private:
+  struct CACHELINE_ALIGNED Stripe {
+    simple_spinlock lock;
+    // Heads of the bucket chains.
+    gscoped_array<LockEntry*> buckets;
+    // Number of buckets - 1, used to find a bucket (hash & mask).
+    uint64_t mask;
+    // Number of entries in the stripe.
+    uint64_t item_count;
+  };
+
+ public:
+  LockTable() {
+    for (Stripe& stripe : stripes_) {
+      stripe.buckets.reset(new LockEntry*[kInitialBuckets]());
+      stripe.mask = kInitialBuckets - 1;
+      stripe.item_count = 0;
+    }
+  }
+
+  ~LockTable() {
+    // Sanity checks: The table shouldn't be destructed when there are any entries in it.
+    for (const Stripe& stripe : stripes_) {
+      DCHECK_EQ(0, stripe.item_count) << "There are some unreleased locks";
+      for (size_t i = 0; i <= stripe.mask; ++i) {
+        for (LockEntry *p = stripe.buckets[i]; p != nullptr; p = p->ht_next_) {
+          DCHECK(p == nullptr) << "The entry " << p->ToString() << " was not released";
+        }
+      }
+    }
+  }
+
+  LockEntry *GetLockEntry(const Slice &key);
+
+  // Like GetLockEntry() for each of 'keys', setting (*entries)[i] to the
+  // entry for keys[i]. Each stripe is locked once for all of its keys.
+  void GetLockEntries(const std::vector<Slice>& keys, std::vector<LockEntry*>* entries);
+
+  void ReleaseLockEntry(LockEntry *entry);
+
+ private:
+  static const int kNumStripesLog2 = 5;
+  static const int kNumStripes = 1 << kNumStripesLog2;
+  static const uint64_t kInitialBuckets = 8;
+
+  Stripe *FindStripe(uint64_t hash) {
+    return &stripes_[hash >> (64 - kNumStripesLog2)];
+  }
+
+  // Return the entry matching 'new_entry's key in 'stripe', taking a reference
+  // to it, or insert 'new_entry' and return it if there is none. The stripe
+  // must be locked.
+  LockEntry *GetOrInsertUnlocked(Stripe *stripe, LockEntry *new_entry);
+
+  // Double the number of buckets in the stripe. The stripe must be locked.
+  void ResizeUnlocked(Stripe *stripe);
+
+  Stripe stripes_[kNumStripes];
+};
+
+LockEntry *LockTable::GetOrInsertUnlocked(Stripe *stripe, LockEntry *new_entry) {
+  LockEntry **node = &stripe->buckets[new_entry->key_hash_ & stripe->mask];
+  while (*node && !(*node)->Equals(new_entry->key_, new_entry->key_hash_)) {
+    node = &((*node)->ht_next_);
+  }
+  if (*node != nullptr) {
+    (*node)->refs_++;
+    return *node;
+  }
+  new_entry->ht_next_ = nullptr;
+  new_entry->CopyKey();
+  *node = new_entry;
+  if (++stripe->item_count > stripe->mask + 1) {
+    ResizeUnlocked(stripe);
+  }
+  return new_entry;
+}
+
+LockEntry *LockTable::GetLockEntry(const Slice& key) {
+  auto new_entry = new LockEntry(key);
+  LockEntry *entry;
+  {
+    Stripe *stripe = FindStripe(new_entry->key_hash_);
+    std::lock_guard<simple_spinlock> l(stripe->lock);
+    entry = GetOrInsertUnlocked(stripe, new_entry);
+  }
+  if (entry != new_entry) {
+    delete new_entry;
+  }
+  return entry;
+}
+
+void LockTable::GetLockEntries(const std::vector<Slice>& keys,
+                               std::vector<LockEntry*>* entries) {
+  entries->resize(keys.size());
+  std::vector<LockEntry*> new_entries(keys.size());
+  std::vector<int> order(keys.size());
+  for (int i = 0; i < keys.size(); i++) {
+    new_entries[i] = new LockEntry(keys[i]);
+    order[i] = i;
+  }
+  // Group the keys by stripe.
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return new_entries[a]->key_hash_ < new_entries[b]->key_hash_;
+    });
+
+  int i = 0;
+  while (i < order.size()) {
+    Stripe *stripe = FindStripe(new_entries[order[i]]->key_hash_);
+    std::lock_guard<simple_spinlock> l(stripe->lock);
+    for (; i < order.size() && FindStripe(new_entries[order[i]]->key_hash_) == stripe; i++) {
+      (*entries)[order[i]] = GetOrInsertUnlocked(stripe, new_entries[order[i]]);
+    }
+  }
+
+  for (int j = 0; j < keys.size(); j++) {
+    if ((*entries)[j] != new_entries[j]) {
+      delete new_entries[j];
+    }
+  }
+}
+
+void LockTable::ReleaseLockEntry(LockEntry *entry) {
+  bool removed = false;
+  {
+    Stripe *stripe = FindStripe(entry->key_hash_);
+    std::lock_guard<simple_spinlock> l(stripe->lock);
+    for (LockEntry **node = &stripe->buckets[entry->key_hash_ & stripe->mask];
+         *node != nullptr;
+         node = &((*node)->ht_next_)) {
+      if (*node == entry) {
+        // ASSUMPTION: There are few updates, so locking the same row at the same time is rare
+        // TODO: Move out this if we're going with the TryLock
+        if (--entry->refs_ > 0)
+          return;
+
+        *node = entry->ht_next_;
+        stripe->item_count--;
+        removed = true;
+        break;
+      }
+    }
+  }
+
+  DCHECK(removed) << "Unable to find LockEntry on release";
+  delete entry;
+}
+
+void LockTable::ResizeUnlocked(Stripe *stripe) {
+  uint64_t new_size = (stripe->mask + 1) * 2;
+  uint64_t new_mask = new_size - 1;
+  gscoped_array<LockEntry*> new_buckets(new LockEntry*[new_size]());
+
+  // Move the entries to the new buckets.
+  for (uint64_t i = 0; i <= stripe->mask; ++i) {
+    LockEntry *p = stripe->buckets[i];
+    while (p != nullptr) {
+      LockEntry *next = p->ht_next_;
+      LockEntry **bucket = &new_buckets[p->key_hash_ & new_mask];
+      p->ht_next_ = *bucket;
+      *bucket = p;
+      p = next;
+    }
+  }
+
+  stripe->mask = new_mask;
+  stripe->buckets.swap(new_buckets);
+}
+
+// The lock table used before LockTable was striped: a single hash table
+// with a lock per bucket, resized under a table-wide write lock. Only used
+// by tests, through LockManager::LEGACY_TABLE_FOR_TESTS.
+class LegacyLockTable {
  private:
   struct Bucket {
     simple_spinlock lock;
@@ -102,11 +284,11 @@ class LockTable {
   };
 
  public:
-  LockTable() : mask_(0), size_(0), item_count_(0) {
+  LegacyLockTable() : mask_(0), size_(0), item_count_(0) {
     Resize();
   }
 
-  ~LockTable() {
+  ~LegacyLockTable() {
     // Sanity checks: The table shouldn't be destructed when there are any entries in it.
     DCHECK_EQ(0, NoBarrier_Load(&(item_count_))) << "There are some unreleased locks";
     for (size_t i = 0; i < size_; ++i) {
@@ -162,7 +344,7 @@ class LockTable {
   base::subtle::Atomic64 item_count_;
 };
 
-LockEntry *LockTable::GetLockEntry(const Slice& key) {
+LockEntry *LegacyLockTable::GetLockEntry(const Slice& key) {
   auto new_entry = new LockEntry(key);
   LockEntry *old_entry;
 
@@ -200,7 +382,7 @@ LockEntry *LockTable::GetLockEntry(const Slice& key) {
   return new_entry;
 }
 
-void LockTable::ReleaseLockEntry(LockEntry *entry) {
+void LegacyLockTable::ReleaseLockEntry(LockEntry *entry) {
   bool removed = false;
   {
     std::lock_guard<rw_spinlock> table_rdlock(lock_.get_lock());
@@ -225,7 +407,7 @@ void LockTable::ReleaseLockEntry(LockEntry *entry) {
   delete entry;
 }
 
-void LockTable::Resize() {
+void LegacyLockTable::Resize() {
   // Calculate a new table size
   size_t new_size = 16;
   while (new_size < base::subtle::NoBarrier_Load(&item_count_)) {
@@ -281,6 +463,13 @@ ScopedRowLock::ScopedRowLock(LockManager *manager,
   }
 }
 
+ScopedRowLock::ScopedRowLock(LockManager *manager, LockEntry *entry)
+  : manager_(manager),
+    acquired_(true),
+    entry_(entry),
+    ls_(LockManager::LOCK_ACQUIRED) {
+}
+
 ScopedRowLock::ScopedRowLock(ScopedRowLock&& other) {
   TakeState(&other);
 }
@@ -316,24 +505,78 @@ void ScopedRowLock::Release() {
 //  LockManager
 // ============================================================================
 
-LockManager::LockManager()
-  : locks_(new LockTable()) {
+LockManager::LockManager(TableType table_type)
+  : locks_(table_type == STRIPED_TABLE ? new LockTable() : nullptr),
+    legacy_locks_(table_type == LEGACY_TABLE_FOR_TESTS ? new LegacyLockTable() : nullptr) {
 }
 
 LockManager::~LockManager() {
   delete locks_;
+  delete legacy_locks_;
+}
+
+LockEntry *LockManager::GetLockEntry(const Slice& key) {
+  if (PREDICT_FALSE(legacy_locks_ != nullptr)) {
+    return legacy_locks_->GetLockEntry(key);
+  }
+  return locks_->GetLockEntry(key);
+}
+
+void LockManager::ReleaseLockEntry(LockEntry *entry) {
+  if (PREDICT_FALSE(legacy_locks_ != nullptr)) {
+    legacy_locks_->ReleaseLockEntry(entry);
+    return;
+  }
+  locks_->ReleaseLockEntry(entry);
 }
 
 LockManager::LockStatus LockManager::Lock(const Slice& key,
                                           const TransactionState* tx,
                                           LockManager::LockMode mode,
                                           LockEntry** entry) {
-  *entry = locks_->GetLockEntry(key);
+  *entry = GetLockEntry(key);
+  Acquire(key, tx, *entry);
+  return LOCK_ACQUIRED;
+}
 
+void LockManager::LockBatch(const std::vector<Slice>& keys,
+                            const TransactionState* tx,
+                            LockManager::LockMode mode,
+                            std::vector<ScopedRowLock>* locks) {
+  std::vector<LockEntry*> entries;
+  if (PREDICT_FALSE(legacy_locks_ != nullptr)) {
+    for (const Slice& key : keys) {
+      entries.push_back(legacy_locks_->GetLockEntry(key));
+    }
+  } else {
+    locks_->GetLockEntries(keys, &entries);
+  }
+
+  // Acquire the locks in key order, so that batches which share keys can't
+  // deadlock.
+  std::vector<int> order(keys.size());
+  for (int i = 0; i < keys.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return keys[a].compare(keys[b]) < 0;
+    });
+  for (int i : order) {
+    Acquire(keys[i], tx, entries[i]);
+  }
+
+  locks->clear();
+  locks->reserve(keys.size());
+  for (LockEntry* entry : entries) {
+    locks->emplace_back(ScopedRowLock(this, entry));
+  }
+}
+
+void LockManager::Acquire(const Slice& key, const TransactionState* tx, LockEntry* entry) {
   // We expect low contention, so just try to try_lock first. This is faster
   // than a timed_lock, since we don't have to do a syscall to get the current
   // time.
-  if (!(*entry)->sem.TryAcquire()) {
+  if (!entry->sem.TryAcquire()) {
     // If the current holder of this lock is the same transaction just return
     // a LOCK_ALREADY_ACQUIRED status without actually acquiring the mutex.
     //
@@ -343,9 +586,9 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     // obtained and released at the same time). If at any time in the future
     // we opt to perform more fine grained locking, possibly letting transactions
     // release a portion of the locks they no longer need, this no longer is OK.
-    if (ANNOTATE_UNPROTECTED_READ((*entry)->holder_) == tx) {
-      (*entry)->recursion_++;
-      return LOCK_ACQUIRED;
+    if (ANNOTATE_UNPROTECTED_READ(entry->holder_) == tx) {
+      entry->recursion_++;
+      return;
     }
 
     // If we couldn't immediately acquire the lock, do a timed lock so we can
@@ -355,8 +598,8 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     TRACE_COUNTER_INCREMENT("row_lock_wait_count", 1);
     MicrosecondsInt64 start_wait_us = GetMonoTimeMicros();
     int waited_seconds = 0;
-    while (!(*entry)->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
-      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ((*entry)->holder_);
+    while (!entry->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
+      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ(entry->holder_);
       LOG(WARNING) << "Waited " << (++waited_seconds) << " seconds to obtain row lock on key "
                    << KUDU_REDACT(key.ToDebugString()) << " cur holder: " << cur_holder;
       // TODO(unknown): would be nice to also include some info about the blocking transaction,
@@ -370,18 +613,17 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     }
   }
 
-  (*entry)->holder_ = tx;
-  return LOCK_ACQUIRED;
+  entry->holder_ = tx;
 }
 
 LockManager::LockStatus LockManager::TryLock(const Slice& key,
                                              const TransactionState* tx,
                                              LockManager::LockMode mode,
                                              LockEntry **entry) {
-  *entry = locks_->GetLockEntry(key);
+  *entry = GetLockEntry(key);
   bool locked = (*entry)->sem.TryAcquire();
   if (!locked) {
-    locks_->ReleaseLockEntry(*entry);
+    ReleaseLockEntry(*entry);
     return LOCK_BUSY;
   }
   (*entry)->holder_ = tx;
@@ -397,7 +639,7 @@ void LockManager::Release(LockEntry *lock, LockStatus ls) {
       lock->sem.Release();
     }
   }
-  locks_->ReleaseLockEntry(lock);
+  ReleaseLockEntry(lock);
 }
 
 } // namespace tablet
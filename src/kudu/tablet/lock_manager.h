@@ -17,6 +17,8 @@
 #ifndef KUDU_TABLET_LOCK_MANAGER_H
 #define KUDU_TABLET_LOCK_MANAGER_H
 
+#include <vector>
+
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/move.h"
 #include "kudu/util/slice.h"
@@ -24,7 +26,9 @@
 namespace kudu { namespace tablet {
 
 class LockManager;
+class ScopedRowLock;
 class LockTable;
+class LegacyLockTable;
 class LockEntry;
 class TransactionState;
 
@@ -37,7 +41,17 @@ class TransactionState;
 // but this should be enough for the single-row use case.
 class LockManager {
  public:
-  LockManager();
+  enum TableType {
+    // A hash table split into independently locked stripes.
+    STRIPED_TABLE,
+
+    // The single hash table which the striped one replaced. It's only kept
+    // so that tests can compare the two, and will be removed in the next
+    // release.
+    LEGACY_TABLE_FOR_TESTS
+  };
+
+  explicit LockManager(TableType table_type = STRIPED_TABLE);
   ~LockManager();
 
   enum LockStatus {
@@ -49,6 +63,17 @@ class LockManager {
     LOCK_EXCLUSIVE
   };
 
+  // Lock each of 'keys' for 'tx', blocking until all of the locks are held,
+  // and set (*locks)[i] to hold the lock on keys[i]. The keys must remain
+  // valid and unchanged for as long as their locks are held, and may
+  // contain duplicates.
+  //
+  // This is cheaper than locking each key with ScopedRowLock, since the
+  // lock table's stripes are each locked once for the whole batch. The
+  // locks are taken in key order, so concurrent batches can't deadlock.
+  void LockBatch(const std::vector<Slice>& keys, const TransactionState* tx,
+                 LockMode mode, std::vector<ScopedRowLock>* locks);
+
  private:
   friend class ScopedRowLock;
   friend class LockManagerTest;
@@ -59,7 +84,17 @@ class LockManager {
                      LockMode mode, LockEntry **entry);
   void Release(LockEntry *lock, LockStatus ls);
 
+  // Look up or release an entry in whichever table is in use.
+  LockEntry *GetLockEntry(const Slice& key);
+  void ReleaseLockEntry(LockEntry *entry);
+
+  // Acquire the lock of 'entry', which is for 'key', for 'tx', blocking
+  // until it is available.
+  void Acquire(const Slice& key, const TransactionState* tx, LockEntry* entry);
+
+  // Exactly one of these is set, depending on the table type.
   LockTable *locks_;
+  LegacyLockTable *legacy_locks_;
 
   DISALLOW_COPY_AND_ASSIGN(LockManager);
 };
@@ -116,6 +151,11 @@ class ScopedRowLock {
   ~ScopedRowLock();
 
  private:
+  friend class LockManager;
+
+  // Take ownership of the already acquired lock of 'entry'.
+  ScopedRowLock(LockManager *manager, LockEntry *entry);
+
   void TakeState(ScopedRowLock* other);
 
   LockManager *manager_;
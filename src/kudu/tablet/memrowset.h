@@ -233,6 +233,10 @@ class MemRowSet : public RowSet,
   virtual Status GetBounds(std::string *min_encoded_key,
                            std::string *max_encoded_key) const OVERRIDE;
 
+  Status GetKeySamples(std::vector<std::string>* keys) const OVERRIDE {
+    return Status::NotSupported("");
+  }
+
   uint64_t EstimateOnDiskSize() const OVERRIDE {
     return 0;
   }
@@ -71,6 +71,10 @@ class MockRowSet : public RowSet {
     LOG(FATAL) << "Unimplemented";
     return Status::OK();
   }
+  virtual Status GetKeySamples(std::vector<std::string>* keys) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
   virtual Status Delete() {
     LOG(FATAL) << "Unimplemented";
     return Status::OK();
@@ -62,6 +62,10 @@ Status MultiColumnWriter::Open() {
     /// Set the column storage attributes.
     opts.storage_attributes = col.attributes();
 
+    // Summarize each block so that scans can skip blocks whose values can't
+    // satisfy their predicates.
+    opts.write_zone_maps = true;
+
     // If the schema has a single PK and this is the PK col
     if (i == 0 && schema_->num_key_columns() == 1) {
       opts.write_validx = true;
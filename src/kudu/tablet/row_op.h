@@ -81,6 +81,13 @@ struct RowOp {
   // If this operation is being replayed from the log, set to the original
   // result. Otherwise nullptr.
   const OperationResultPB* orig_result_from_log_;
+
+  // Set by Tablet::BulkCheckPresence() if it already checked whether this
+  // operation's key is present in the tablet's rowsets, in which case
+  // 'present_in_rowset' is the rowset which holds it, or nullptr if none
+  // does.
+  bool checked_present;
+  RowSet* present_in_rowset;
 };
 
 
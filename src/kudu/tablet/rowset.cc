@@ -33,6 +33,13 @@ using strings::Substitute;
 
 namespace kudu { namespace tablet {
 
+Status RowSet::CheckRowsPresent(vector<RowSetKeyCheck>* checks) const {
+  for (RowSetKeyCheck& check : *checks) {
+    RETURN_NOT_OK(CheckRowPresent(*check.probe, &check.present, check.stats));
+  }
+  return Status::OK();
+}
+
 DuplicatingRowSet::DuplicatingRowSet(RowSetVector old_rowsets,
                                      RowSetVector new_rowsets)
     : old_rowsets_(std::move(old_rowsets)),
@@ -180,6 +187,38 @@ Status DuplicatingRowSet::CheckRowPresent(const RowSetKeyProbe &probe,
   return Status::OK();
 }
 
+Status DuplicatingRowSet::CheckRowsPresent(vector<RowSetKeyCheck>* checks) const {
+  // A key is present in at most one of the input rowsets, so each rowset
+  // only needs to check the keys which weren't found in the previous ones.
+  vector<int> remaining(checks->size());
+  for (int i = 0; i < checks->size(); i++) {
+    (*checks)[i].present = false;
+    remaining[i] = i;
+  }
+  for (const shared_ptr<RowSet> &rowset : old_rowsets_) {
+    if (remaining.empty()) {
+      break;
+    }
+    vector<RowSetKeyCheck> rs_checks;
+    rs_checks.reserve(remaining.size());
+    for (int i : remaining) {
+      rs_checks.emplace_back((*checks)[i].probe, (*checks)[i].stats);
+    }
+    RETURN_NOT_OK(rowset->CheckRowsPresent(&rs_checks));
+
+    vector<int> still_remaining;
+    for (int j = 0; j < rs_checks.size(); j++) {
+      if (rs_checks[j].present) {
+        (*checks)[remaining[j]].present = true;
+      } else {
+        still_remaining.push_back(remaining[j]);
+      }
+    }
+    remaining.swap(still_remaining);
+  }
+  return Status::OK();
+}
+
 Status DuplicatingRowSet::CountRows(rowid_t *count) const {
   int64_t accumulated_count = 0;
   for (const shared_ptr<RowSet> &rs : new_rowsets_) {
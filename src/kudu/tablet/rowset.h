@@ -49,6 +49,7 @@ class MvccSnapshot;
 class RowSetKeyProbe;
 class RowSetMetadata;
 struct ProbeStats;
+struct RowSetKeyCheck;
 
 class RowSet {
  public:
@@ -67,6 +68,14 @@ class RowSet {
   virtual Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                                  ProbeStats* stats) const = 0;
 
+  // Like CheckRowPresent(), for each of 'checks', which must be sorted by
+  // key. Sets the 'present' field of each check.
+  //
+  // The default implementation checks each key with CheckRowPresent(); rowsets
+  // which can share work between nearby keys (e.g. reading each bloom filter
+  // or index block once for the whole batch) should override it.
+  virtual Status CheckRowsPresent(std::vector<RowSetKeyCheck>* checks) const;
+
   // Update/delete a row in this rowset.
   // The 'update_schema' is the client schema used to encode the 'update' RowChangeList.
   //
@@ -107,6 +116,19 @@ class RowSet {
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const = 0;
 
+  // Append a sample of the encoded keys of this RowSet to 'keys', in
+  // increasing order, which split its on-disk data into chunks of roughly
+  // equal size. Each key is where a chunk starts, so the first one is no
+  // greater than the RowSet's minimum key.
+  //
+  // The keys may not be valid encodings of full primary keys (e.g. they may
+  // have been shortened in an index), so callers must check them before
+  // using them as bounds.
+  //
+  // In the case that the rowset is still mutable (eg MemRowSet), this may
+  // return Status::NotSupported.
+  virtual Status GetKeySamples(std::vector<std::string>* keys) const = 0;
+
   // Return a displayable string for this rowset.
   virtual string ToString() const = 0;
 
@@ -241,6 +263,23 @@ struct ProbeStats {
   int mrs_consulted;
 };
 
+// A key whose presence in a rowset is checked by RowSet::CheckRowsPresent().
+struct RowSetKeyCheck {
+  RowSetKeyCheck(const RowSetKeyProbe* probe, ProbeStats* stats)
+      : probe(probe),
+        stats(stats),
+        present(false) {
+  }
+
+  const RowSetKeyProbe* probe;
+
+  // The stats of the operation the key belongs to.
+  ProbeStats* stats;
+
+  // Set by CheckRowsPresent().
+  bool present;
+};
+
 // RowSet which is used during the middle of a flush or compaction.
 // It consists of a set of one or more input rowsets, and a single
 // output rowset. All mutations are duplicated to the appropriate input
@@ -262,6 +301,8 @@ class DuplicatingRowSet : public RowSet {
   Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                          ProbeStats* stats) const OVERRIDE;
 
+  Status CheckRowsPresent(std::vector<RowSetKeyCheck>* checks) const OVERRIDE;
+
   virtual Status NewRowIterator(const Schema *projection,
                                 const MvccSnapshot &snap,
                                 OrderMode order,
@@ -276,6 +317,10 @@ class DuplicatingRowSet : public RowSet {
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
+  Status GetKeySamples(std::vector<std::string>* keys) const OVERRIDE {
+    return Status::NotSupported("");
+  }
+
   uint64_t EstimateOnDiskSize() const OVERRIDE;
 
   string ToString() const OVERRIDE;
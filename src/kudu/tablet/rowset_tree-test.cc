@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <memory>
@@ -128,6 +129,43 @@ TEST_F(TestRowSetTree, TestPerformance) {
   }
 }
 
+// Checks that ForEachRowSetContainingKeys() finds the same rowsets as
+// FindRowSetsWithKeyInRange() does for each key.
+TEST_F(TestRowSetTree, TestForEachRowSetContainingKeys) {
+  SeedRandom();
+  RowSetVector vec = GenerateRandomRowSets(100);
+  // Add rowsets whose endpoints coincide with each other and with the keys.
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("0500", "0500")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("0500", "0600")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("0400", "0500")));
+  vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  vector<string> key_strs;
+  for (int i = 0; i < 1000; i++) {
+    key_strs.push_back(StringPrintf("%04d", rand() % 11000));
+  }
+  key_strs.push_back("0400");
+  key_strs.push_back("0500");
+  key_strs.push_back("0500");
+  key_strs.push_back("0600");
+  std::sort(key_strs.begin(), key_strs.end());
+  vector<Slice> keys(key_strs.begin(), key_strs.end());
+
+  vector<unordered_set<RowSet*>> found(keys.size());
+  tree.ForEachRowSetContainingKeys(keys, [&](RowSet* rs, int i) {
+      EXPECT_TRUE(found[i].insert(rs).second);
+    });
+  for (int i = 0; i < keys.size(); i++) {
+    vector<RowSet*> expected;
+    tree.FindRowSetsWithKeyInRange(keys[i], &expected);
+    ASSERT_EQ(unordered_set<RowSet*>(expected.begin(), expected.end()), found[i])
+        << "key " << key_strs[i];
+  }
+}
+
 TEST_F(TestRowSetTree, TestEndpointsConsistency) {
   const int kNumRowSets = 1000;
   RowSetVector vec = GenerateRandomRowSets(kNumRowSets);
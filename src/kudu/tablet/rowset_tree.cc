@@ -191,6 +191,52 @@ void RowSetTree::FindRowSetsWithKeyInRange(const Slice &encoded_key,
   }
 }
 
+void RowSetTree::ForEachRowSetContainingKeys(
+    const vector<Slice>& encoded_keys,
+    const std::function<void(RowSet*, int)>& cb) const {
+  DCHECK(initted_);
+  DCHECK(std::is_sorted(encoded_keys.begin(), encoded_keys.end(),
+                        [](const Slice& a, const Slice& b) { return a.compare(b) < 0; }));
+
+  // All rowsets with unknown bounds need to be checked.
+  for (const shared_ptr<RowSet> &rs : unbounded_rowsets_) {
+    for (int i = 0; i < encoded_keys.size(); i++) {
+      cb(rs.get(), i);
+    }
+  }
+
+  // Sweep over the endpoints, keeping track of the rowsets whose ranges
+  // contain the current key. Both bounds are inclusive, so a rowset is added
+  // once its START endpoint is at or before the key, and removed once its
+  // STOP endpoint is before the key. Endpoints with the same key aren't
+  // ordered by type, so each type is swept with its own cursor.
+  vector<RowSet*> active;
+  int next_start = 0;
+  int next_stop = 0;
+  const int num_endpoints = key_endpoints_.size();
+  for (int i = 0; i < encoded_keys.size(); i++) {
+    const Slice& key = encoded_keys[i];
+    for (; next_start < num_endpoints &&
+           key_endpoints_[next_start].slice_.compare(key) <= 0; next_start++) {
+      if (key_endpoints_[next_start].endpoint_ == START) {
+        active.push_back(key_endpoints_[next_start].rowset_);
+      }
+    }
+    for (; next_stop < num_endpoints &&
+           key_endpoints_[next_stop].slice_.compare(key) < 0; next_stop++) {
+      if (key_endpoints_[next_stop].endpoint_ == STOP) {
+        auto it = std::find(active.begin(), active.end(), key_endpoints_[next_stop].rowset_);
+        DCHECK(it != active.end());
+        *it = active.back();
+        active.pop_back();
+      }
+    }
+    for (RowSet* rs : active) {
+      cb(rs, i);
+    }
+  }
+}
+
 RowSetTree::~RowSetTree() {
   STLDeleteElements(&entries_);
 }
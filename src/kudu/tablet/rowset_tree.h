@@ -17,6 +17,7 @@
 #ifndef KUDU_TABLET_ROWSET_MANAGER_H
 #define KUDU_TABLET_ROWSET_MANAGER_H
 
+#include <functional>
 #include <unordered_map>
 #include <vector>
 #include <utility>
@@ -73,6 +74,16 @@ class RowSetTree {
   void FindRowSetsWithKeyInRange(const Slice &encoded_key,
                                  std::vector<RowSet *> *rowsets) const;
 
+  // For each of 'encoded_keys', which must be sorted, calls 'cb' with the
+  // index of the key and each RowSet whose range may contain it. Rather than
+  // querying the tree for each key, this sweeps over the rowsets' endpoints
+  // once, so it is cheaper than calling FindRowSetsWithKeyInRange() for each
+  // key of a large batch.
+  //
+  // For each RowSet, 'cb' is called with increasing key indexes.
+  void ForEachRowSetContainingKeys(const std::vector<Slice>& encoded_keys,
+                                   const std::function<void(RowSet*, int)>& cb) const;
+
   void FindRowSetsIntersectingInterval(const Slice &lower_bound,
                                        const Slice &upper_bound,
                                        std::vector<RowSet *> *rowsets) const;
@@ -696,6 +696,72 @@ TYPED_TEST(TestTablet, TestUpsert) {
   EXPECT_EQ(vector<string>{ this->setup_.FormatDebugRow(0, 1002, false) }, rows);
 }
 
+// Test a batch whose inserts and upserts are checked against both a DRS and
+// the MRS, including keys which appear more than once in the batch and keys
+// of deleted rows.
+TYPED_TEST(TestTablet, TestBatchPresenceChecks) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  this->InsertTestRows(0, 10, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_OK(this->DeleteTestRow(&writer, 2));
+  this->InsertTestRows(10, 10, 0);
+  ASSERT_OK(this->DeleteTestRow(&writer, 12));
+
+  struct TestOp {
+    RowOperationsPB::Type type;
+    int64_t key_idx;
+    bool expect_present;
+  };
+  const vector<TestOp> test_ops = {
+    { RowOperationsPB::INSERT, 5, true },    // In the DRS.
+    { RowOperationsPB::INSERT, 15, true },   // In the MRS.
+    { RowOperationsPB::INSERT, 30, false },
+    { RowOperationsPB::INSERT, 31, false },
+    { RowOperationsPB::INSERT, 31, true },   // Inserted earlier in the batch.
+    { RowOperationsPB::DELETE, 6, false },
+    { RowOperationsPB::INSERT, 6, false },   // Deleted earlier in the batch.
+    { RowOperationsPB::UPSERT, 2, false },   // Deleted in the DRS.
+    { RowOperationsPB::UPSERT, 12, false },  // Deleted in the MRS.
+    { RowOperationsPB::UPSERT, 7, false },   // Updates the DRS.
+    { RowOperationsPB::UPSERT, 17, false },  // Updates the MRS.
+    { RowOperationsPB::INSERT, 32, false },
+    { RowOperationsPB::DELETE, 32, false },
+  };
+  vector<KuduPartialRow> rows;
+  rows.reserve(test_ops.size());
+  vector<LocalTabletWriter::Op> ops;
+  for (const TestOp& test_op : test_ops) {
+    rows.emplace_back(&this->client_schema_);
+    if (test_op.type == RowOperationsPB::DELETE) {
+      this->setup_.BuildRowKey(&rows.back(), test_op.key_idx);
+    } else {
+      this->setup_.BuildRow(&rows.back(), test_op.key_idx, 1);
+    }
+    ops.emplace_back(test_op.type, &rows.back());
+  }
+  Status s = writer.WriteBatch(ops);
+  ASSERT_TRUE(s.IsAlreadyPresent()) << s.ToString();
+
+  const TxResultPB& result = writer.last_batch_result();
+  ASSERT_EQ(test_ops.size(), static_cast<size_t>(result.ops_size()));
+  for (int i = 0; i < test_ops.size(); i++) {
+    SCOPED_TRACE(i);
+    ASSERT_EQ(test_ops[i].expect_present, result.ops(i).has_failed_status());
+  }
+
+  vector<string> expected;
+  for (int64_t key_idx : { 0, 1, 3, 4, 5, 8, 9, 10, 11, 13, 14, 15, 16, 18, 19 }) {
+    expected.push_back(this->setup_.FormatDebugRow(key_idx, 0, false));
+  }
+  for (int64_t key_idx : { 2, 6, 7, 12, 17, 30, 31 }) {
+    expected.push_back(this->setup_.FormatDebugRow(key_idx, 1, false));
+  }
+  std::sort(expected.begin(), expected.end());
+  vector<string> rows_out;
+  ASSERT_OK(this->IterateToStringList(&rows_out));
+  std::sort(rows_out.begin(), rows_out.end());
+  ASSERT_EQ(expected, rows_out);
+}
 
 // Test that when a row has been updated many times, it always yields
 // the most recent value.
@@ -23,11 +23,14 @@
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/common/encoded_key.h"
+#include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/row_changelist.h"
 #include "kudu/common/row_operations.h"
@@ -62,6 +65,7 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/maintenance_manager.h"
+#include "kudu/util/memory/arena.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/stopwatch.h"
@@ -131,6 +135,25 @@ DEFINE_int32(max_encoded_key_size_bytes, 16 * 1024,
              "result in an error.");
 TAG_FLAG(max_encoded_key_size_bytes, unsafe);
 
+DEFINE_int32(tablet_scan_parallelism, 4,
+             "Maximum number of threads which read the rowsets of a single unordered "
+             "tablet scan in parallel, when the tablet server has a scan thread pool. "
+             "Set to 1 to scan every tablet on the RPC thread alone.");
+TAG_FLAG(tablet_scan_parallelism, experimental);
+
+DEFINE_int32(tablet_scan_parallel_min_rowsets, 8,
+             "Minimum number of rowsets a tablet scan must read for them to be read "
+             "in parallel. Smaller scans aren't worth the cost of handing their rows "
+             "between threads.");
+TAG_FLAG(tablet_scan_parallel_min_rowsets, experimental);
+
+DEFINE_bool(tablet_bulk_presence_checks, true,
+            "Whether to check whether the keys of a write batch's inserts are "
+            "already present in the tablet in a single sorted pass over each rowset, "
+            "rather than one key at a time.");
+TAG_FLAG(tablet_bulk_presence_checks, advanced);
+TAG_FLAG(tablet_bulk_presence_checks, runtime);
+
 METRIC_DEFINE_entity(tablet);
 METRIC_DEFINE_gauge_size(tablet, memrowset_size, "MemRowSet Memory Usage",
                          kudu::MetricUnit::kBytes,
@@ -148,6 +171,7 @@ using kudu::server::HybridClock;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::unordered_map;
 using std::unordered_set;
 using std::vector;
 using strings::Substitute;
@@ -298,12 +322,20 @@ Status Tablet::NewRowIterator(const Schema &projection,
                               const MvccSnapshot &snap,
                               const OrderMode order,
                               gscoped_ptr<RowwiseIterator> *iter) const {
+  return NewRowIterator(projection, snap, order, nullptr, iter);
+}
+
+Status Tablet::NewRowIterator(const Schema &projection,
+                              const MvccSnapshot &snap,
+                              const OrderMode order,
+                              ThreadPool* scan_pool,
+                              gscoped_ptr<RowwiseIterator> *iter) const {
   CHECK_EQ(state_, kOpen);
   if (metrics_) {
     metrics_->scans_started->Increment();
   }
   VLOG_WITH_PREFIX(2) << "Created new Iterator under snap: " << snap.ToString();
-  iter->reset(new Iterator(this, projection, snap, order));
+  iter->reset(new Iterator(this, projection, snap, order, scan_pool));
   return Status::OK();
 }
 
@@ -349,8 +381,18 @@ Status Tablet::AcquireRowLocks(WriteTransactionState* tx_state) {
   TRACE_EVENT1("tablet", "Tablet::AcquireRowLocks",
                "num_locks", tx_state->row_ops().size());
   TRACE("PREPARE: Acquiring locks for $0 operations", tx_state->row_ops().size());
+  vector<Slice> keys;
+  keys.reserve(tx_state->row_ops().size());
   for (RowOp* op : tx_state->row_ops()) {
-    RETURN_NOT_OK(AcquireLockForOp(tx_state, op));
+    RETURN_NOT_OK(DecodeKeyForOp(op));
+    keys.push_back(op->key_probe->encoded_key_slice());
+  }
+
+  vector<ScopedRowLock> locks;
+  lock_manager_.LockBatch(keys, tx_state, LockManager::LOCK_EXCLUSIVE, &locks);
+  int i = 0;
+  for (RowOp* op : tx_state->row_ops()) {
+    op->row_lock = std::move(locks[i++]);
   }
   TRACE("PREPARE: locks acquired");
   return Status::OK();
@@ -372,16 +414,10 @@ Status Tablet::CheckRowInTablet(const ConstContiguousRow& row) const {
   return Status::OK();
 }
 
-Status Tablet::AcquireLockForOp(WriteTransactionState* tx_state, RowOp* op) {
+Status Tablet::DecodeKeyForOp(RowOp* op) {
   ConstContiguousRow row_key(&key_schema_, op->decoded_op.row_data);
   op->key_probe.reset(new tablet::RowSetKeyProbe(row_key));
-  RETURN_NOT_OK(CheckRowInTablet(row_key));
-
-  op->row_lock = ScopedRowLock(&lock_manager_,
-                               tx_state,
-                               op->key_probe->encoded_key_slice(),
-                               LockManager::LOCK_EXCLUSIVE);
-  return Status::OK();
+  return CheckRowInTablet(row_key);
 }
 
 void Tablet::AssignTimestampAndStartTransactionForTests(WriteTransactionState* tx_state) {
@@ -485,23 +521,33 @@ Status Tablet::InsertOrUpsertUnlocked(WriteTransactionState *tx_state,
   const bool is_upsert = op->decoded_op.type == RowOperationsPB::UPSERT;
   const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
 
-  // First, ensure that it is a unique key by checking all the open RowSets.
-  vector<RowSet *> to_check = FindRowSetsToCheck(op, comps);
-  for (RowSet *rowset : to_check) {
-    bool present = false;
-    RETURN_NOT_OK(rowset->CheckRowPresent(*op->key_probe, &present, stats));
-    if (present) {
-      if (is_upsert) {
-        return ApplyUpsertAsUpdate(tx_state, op, rowset, stats);
-      }
-      Status s = Status::AlreadyPresent("key already present");
-      if (metrics_) {
-        metrics_->insertions_failed_dup_key->Increment();
+  // First, ensure that it is a unique key by checking all the open RowSets,
+  // unless BulkCheckPresence() already did.
+  RowSet* present_in_rowset = nullptr;
+  if (op->checked_present) {
+    present_in_rowset = op->present_in_rowset;
+  } else {
+    vector<RowSet *> to_check = FindRowSetsToCheck(op, comps);
+    for (RowSet *rowset : to_check) {
+      bool present = false;
+      RETURN_NOT_OK(rowset->CheckRowPresent(*op->key_probe, &present, stats));
+      if (present) {
+        present_in_rowset = rowset;
+        break;
       }
-      op->SetFailed(s);
-      return s;
     }
   }
+  if (present_in_rowset) {
+    if (is_upsert) {
+      return ApplyUpsertAsUpdate(tx_state, op, present_in_rowset, stats);
+    }
+    Status s = Status::AlreadyPresent("key already present");
+    if (metrics_) {
+      metrics_->insertions_failed_dup_key->Increment();
+    }
+    op->SetFailed(s);
+    return s;
+  }
 
   Timestamp ts = tx_state->timestamp();
   ConstContiguousRow row(schema(), op->decoded_op.row_data);
@@ -528,6 +574,84 @@ Status Tablet::InsertOrUpsertUnlocked(WriteTransactionState *tx_state,
   return s;
 }
 
+Status Tablet::BulkCheckPresence(WriteTransactionState* tx_state,
+                                 ProbeStats* stats_array) {
+  const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
+  const vector<RowOp*>& row_ops = tx_state->row_ops();
+
+  // Sort the operations by key, so that duplicate keys are adjacent and the
+  // rowsets can be swept in key order.
+  vector<int> sorted;
+  for (int i = 0; i < row_ops.size(); i++) {
+    const RowOp* op = row_ops[i];
+    if (!op->has_result() && op->key_probe) {
+      sorted.push_back(i);
+    }
+  }
+  std::sort(sorted.begin(), sorted.end(), [&](int a, int b) {
+      return row_ops[a]->key_probe->encoded_key_slice().compare(
+          row_ops[b]->key_probe->encoded_key_slice()) < 0;
+    });
+
+  vector<int> op_idxs;
+  vector<Slice> keys;
+  for (int i = 0; i < sorted.size(); i++) {
+    const RowOp* op = row_ops[sorted[i]];
+    Slice key = op->key_probe->encoded_key_slice();
+    if ((i > 0 && row_ops[sorted[i - 1]]->key_probe->encoded_key_slice() == key) ||
+        (i + 1 < sorted.size() &&
+         row_ops[sorted[i + 1]]->key_probe->encoded_key_slice() == key)) {
+      continue;
+    }
+    if ((op->decoded_op.type != RowOperationsPB::INSERT &&
+         op->decoded_op.type != RowOperationsPB::UPSERT) ||
+        op->orig_result_from_log_ ||
+        !ValidateInsertOrUpsertUnlocked(*op).ok()) {
+      continue;
+    }
+    op_idxs.push_back(sorted[i]);
+    keys.push_back(key);
+  }
+  if (keys.size() < 2) {
+    return Status::OK();
+  }
+
+  // Group the keys by the rowsets which may contain them. Each rowset's keys
+  // stay sorted.
+  unordered_map<RowSet*, vector<int>> keys_by_rowset;
+  comps->rowsets->ForEachRowSetContainingKeys(keys, [&](RowSet* rs, int key_idx) {
+      keys_by_rowset[rs].push_back(key_idx);
+    });
+
+  vector<RowSet*> present_in(keys.size(), nullptr);
+  vector<RowSetKeyCheck> checks;
+  for (const auto& e : keys_by_rowset) {
+    checks.clear();
+    vector<int> key_idxs;
+    for (int key_idx : e.second) {
+      // A key can only be present in one rowset.
+      if (present_in[key_idx]) continue;
+      RowOp* op = row_ops[op_idxs[key_idx]];
+      checks.emplace_back(op->key_probe.get(), &stats_array[op_idxs[key_idx]]);
+      key_idxs.push_back(key_idx);
+    }
+    if (checks.empty()) continue;
+    RETURN_NOT_OK(e.first->CheckRowsPresent(&checks));
+    for (int i = 0; i < checks.size(); i++) {
+      if (checks[i].present) {
+        present_in[key_idxs[i]] = e.first;
+      }
+    }
+  }
+
+  for (int i = 0; i < op_idxs.size(); i++) {
+    RowOp* op = row_ops[op_idxs[i]];
+    op->checked_present = true;
+    op->present_in_rowset = present_in[i];
+  }
+  return Status::OK();
+}
+
 Status Tablet::ApplyUpsertAsUpdate(WriteTransactionState* tx_state,
                                    RowOp* upsert,
                                    RowSet* rowset,
@@ -684,14 +808,24 @@ void Tablet::ApplyRowOperations(WriteTransactionState* tx_state) {
       tx_state->arena()->AllocateBytesAligned(sizeof(ProbeStats) * num_ops,
                                               alignof(ProbeStats)));
 
+  for (int i = 0; i < num_ops; i++) {
+    // Manually run the constructor to clear the stats to 0 before collecting
+    // them.
+    new (&stats_array[i]) ProbeStats();
+  }
+
   StartApplying(tx_state);
+  if (FLAGS_tablet_bulk_presence_checks) {
+    Status s = BulkCheckPresence(tx_state, stats_array);
+    if (PREDICT_FALSE(!s.ok())) {
+      // Each operation will check its key individually instead.
+      LOG_WITH_PREFIX(WARNING) << "Unable to check the presence of a batch of keys: "
+                               << s.ToString();
+    }
+  }
   int i = 0;
   for (RowOp* row_op : tx_state->row_ops()) {
-    ProbeStats* stats = &stats_array[i++];
-    // Manually run the constructor to clear the stats to 0 before collecting
-    // them.
-    new (stats) ProbeStats();
-    ApplyRowOperation(tx_state, row_op, stats);
+    ApplyRowOperation(tx_state, row_op, &stats_array[i++]);
   }
 
   if (metrics_) {
@@ -1535,6 +1669,89 @@ size_t Tablet::EstimateOnDiskSize() const {
   return ret;
 }
 
+Status Tablet::SplitKeyRange(const string& start_key,
+                             const string& stop_key,
+                             uint64_t target_chunk_size_bytes,
+                             vector<KeyRange>* ranges) const {
+  CHECK_GT(target_chunk_size_bytes, 0);
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  // A chunk of a rowset's data, starting at 'key'.
+  struct Sample {
+    string key;
+    uint64_t size_bytes;
+
+    // Whether 'key' is a complete primary key, and may bound a range.
+    bool usable;
+  };
+  vector<Sample> samples;
+  Arena arena(1024, 1024 * 1024);
+  for (const shared_ptr<RowSet>& rowset : comps->rowsets->all_rowsets()) {
+    string min_key, max_key;
+    vector<string> keys;
+    Status s = rowset->GetBounds(&min_key, &max_key);
+    if (s.ok()) {
+      s = rowset->GetKeySamples(&keys);
+    }
+    if (s.IsNotSupported()) {
+      continue;
+    }
+    RETURN_NOT_OK(s);
+    if (keys.empty() ||
+        (!stop_key.empty() && min_key >= stop_key) ||
+        (!start_key.empty() && max_key < start_key)) {
+      continue;
+    }
+
+    uint64_t chunk_size = rowset->EstimateOnDiskSize() / keys.size();
+    for (size_t i = 0; i < keys.size(); i++) {
+      // Skip the chunks which end before the range, and those after it.
+      if (i + 1 < keys.size() && !start_key.empty() && keys[i + 1] <= start_key) {
+        continue;
+      }
+      if (!stop_key.empty() && keys[i] >= stop_key) {
+        break;
+      }
+      Sample sample;
+      sample.size_bytes = chunk_size;
+      if (keys[i] <= start_key) {
+        sample.key = start_key;
+        sample.usable = false;
+      } else {
+        sample.key = keys[i];
+        arena.Reset();
+        gscoped_ptr<EncodedKey> decoded;
+        sample.usable = EncodedKey::DecodeEncodedString(*schema(), &arena, sample.key,
+                                                        &decoded).ok();
+      }
+      samples.emplace_back(std::move(sample));
+    }
+  }
+  std::sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b) {
+      return a.key < b.key;
+    });
+
+  // Start a new range at the first usable key after each range has grown to
+  // the target size.
+  KeyRange range;
+  range.start_primary_key = start_key;
+  range.size_bytes = 0;
+  for (const Sample& sample : samples) {
+    if (range.size_bytes >= target_chunk_size_bytes && sample.usable &&
+        sample.key > range.start_primary_key) {
+      range.stop_primary_key = sample.key;
+      ranges->push_back(range);
+      range.start_primary_key = sample.key;
+      range.size_bytes = 0;
+    }
+    range.size_bytes += sample.size_bytes;
+  }
+  range.stop_primary_key = stop_key;
+  ranges->push_back(range);
+  return Status::OK();
+}
+
 size_t Tablet::DeltaMemStoresSize() const {
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
@@ -1752,11 +1969,13 @@ string Tablet::LogPrefix() const {
 ////////////////////////////////////////////////////////////
 
 Tablet::Iterator::Iterator(const Tablet* tablet, const Schema& projection,
-                           MvccSnapshot snap, const OrderMode order)
+                           MvccSnapshot snap, const OrderMode order,
+                           ThreadPool* scan_pool)
     : tablet_(tablet),
       projection_(projection),
       snap_(std::move(snap)),
-      order_(order) {}
+      order_(order),
+      scan_pool_(scan_pool) {}
 
 Tablet::Iterator::~Iterator() {}
 
@@ -1775,7 +1994,17 @@ Status Tablet::Iterator::Init(ScanSpec *spec) {
       break;
     case UNORDERED:
     default:
-      iter_.reset(new UnionIterator(iters));
+      // Read the rowsets of large scans in parallel, if possible. Ordered
+      // scans always merge their rowsets on this thread.
+      if (scan_pool_ != nullptr && FLAGS_tablet_scan_parallelism > 1 &&
+          iters.size() >= std::max<size_t>(FLAGS_tablet_scan_parallel_min_rowsets, 2)) {
+        VLOG(2) << tablet_->LogPrefix() << "Scanning " << iters.size()
+                << " rowsets in parallel";
+        iter_.reset(new ParallelUnionIterator(iters, scan_pool_,
+                                              FLAGS_tablet_scan_parallelism));
+      } else {
+        iter_.reset(new UnionIterator(iters));
+      }
       break;
   }
 
@@ -60,6 +60,7 @@ class Clock;
 class MaintenanceManager;
 class MaintenanceOp;
 class MaintenanceOpStats;
+class ThreadPool;
 
 namespace tablet {
 
@@ -75,6 +76,16 @@ struct TabletComponents;
 struct TabletMetrics;
 class WriteTransactionState;
 
+// A range of a tablet's primary keys, [start_primary_key, stop_primary_key),
+// where the keys are encoded and an empty key leaves that side unbounded.
+struct KeyRange {
+  std::string start_primary_key;
+  std::string stop_primary_key;
+
+  // The estimated on-disk size of the rows in the range.
+  uint64_t size_bytes;
+};
+
 class Tablet {
  public:
   typedef std::map<int64_t, int64_t> ReplaySizeMap;
@@ -131,23 +142,9 @@ class Tablet {
   // don't boot a tablet server.
   void AssignTimestampAndStartTransactionForTests(WriteTransactionState* tx_state);
 
-  // Insert a new row into the tablet.
-  //
-  // The provided 'data' slice should have length equivalent to this
-  // tablet's Schema.byte_size().
-  //
-  // After insert, the row and any referred-to memory (eg for strings)
-  // have been copied into internal memory, and thus the provided memory
-  // buffer may safely be re-used or freed.
-  //
-  // Returns Status::AlreadyPresent() if an entry with the same key is already
-  // present in the tablet.
-  // Returns Status::OK unless allocation fails.
-  //
-  // Acquires the row lock for the given operation, setting it in the
-  // RowOp struct. This also sets the row op's RowSetKeyProbe.
-  Status AcquireLockForOp(WriteTransactionState* tx_state,
-                          RowOp* op);
+  // Sets the row op's RowSetKeyProbe, and checks that its row belongs in
+  // this tablet.
+  Status DecodeKeyForOp(RowOp* op);
 
   // Signal that the given transaction is about to Apply.
   void StartApplying(WriteTransactionState* tx_state);
@@ -173,6 +170,14 @@ class Tablet {
                         const OrderMode order,
                         gscoped_ptr<RowwiseIterator> *iter) const;
 
+  // Like the above, but unordered scans of many rowsets may read them in
+  // parallel on the threads of 'scan_pool', if it is non-NULL.
+  Status NewRowIterator(const Schema &projection,
+                        const MvccSnapshot &snap,
+                        const OrderMode order,
+                        ThreadPool* scan_pool,
+                        gscoped_ptr<RowwiseIterator> *iter) const;
+
   // Flush the current MemRowSet for this tablet to disk. This swaps
   // in a new (initially empty) MemRowSet in its place.
   //
@@ -237,6 +242,19 @@ class Tablet {
   // Estimate the total on-disk size of this tablet, in bytes.
   size_t EstimateOnDiskSize() const;
 
+  // Split the range of encoded primary keys [start_key, stop_key) into
+  // contiguous ranges whose on-disk data is roughly 'target_chunk_size_bytes'
+  // each, appending them to 'ranges' in key order. Empty keys leave that side
+  // of the range unbounded.
+  //
+  // The split points are taken from the key indexes of the DiskRowSets, so
+  // no range is split more finely than a block of a single rowset, and rows
+  // which are only in memory aren't accounted for.
+  Status SplitKeyRange(const std::string& start_key,
+                       const std::string& stop_key,
+                       uint64_t target_chunk_size_bytes,
+                       std::vector<KeyRange>* ranges) const;
+
   // Get the total size of all the DMS
   size_t DeltaMemStoresSize() const;
 
@@ -387,6 +405,18 @@ class Tablet {
                                 RowOp* op,
                                 ProbeStats* stats);
 
+  // Checks in bulk whether the keys of the INSERT and UPSERT operations in
+  // the transaction are already present in the tablet's rowsets, marking each
+  // checked operation with the rowset holding its key, if any. The keys are
+  // checked in sorted order, one rowset at a time, so that each rowset's
+  // index and bloom filter blocks are read once per batch rather than once
+  // per key.
+  //
+  // Operations whose key appears more than once in the batch are left to be
+  // checked individually, since an earlier operation may change the outcome.
+  // If this returns an error, no operation is marked.
+  Status BulkCheckPresence(WriteTransactionState* tx_state, ProbeStats* stats_array);
+
   // Same as above, but for UPDATE.
   Status MutateRowUnlocked(WriteTransactionState *tx_state,
                            RowOp* mutate,
@@ -630,12 +660,13 @@ class Tablet::Iterator : public RowwiseIterator {
   DISALLOW_COPY_AND_ASSIGN(Iterator);
 
   Iterator(const Tablet* tablet, const Schema& projection, MvccSnapshot snap,
-           const OrderMode order);
+           const OrderMode order, ThreadPool* scan_pool);
 
   const Tablet *tablet_;
   Schema projection_;
   const MvccSnapshot snap_;
   const OrderMode order_;
+  ThreadPool* const scan_pool_;
   gscoped_ptr<RowwiseIterator> iter_;
 };
 
@@ -87,6 +87,16 @@ METRIC_DEFINE_counter(tablet, scanner_bytes_scanned_from_disk, "Scanner Bytes Sc
                       "and does not include data read from in-memory stores. However, it"
                       "includes both cache misses and cache hits.");
 
+METRIC_DEFINE_counter(tablet, scanner_readahead_hits, "Scanner Readahead Hits",
+                      kudu::MetricUnit::kBlocks,
+                      "Number of data blocks needed by scan requests which had already "
+                      "been read ahead of the scan.");
+
+METRIC_DEFINE_counter(tablet, scanner_readahead_bytes_wasted, "Scanner Readahead Bytes Wasted",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes read ahead of scan requests which were discarded "
+                      "without being used.");
+
 
 METRIC_DEFINE_counter(tablet, insertions_failed_dup_key, "Duplicate Key Inserts",
                       kudu::MetricUnit::kRows,
@@ -233,6 +243,8 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(scanner_rows_scanned),
     MINIT(scanner_cells_scanned_from_disk),
     MINIT(scanner_bytes_scanned_from_disk),
+    MINIT(scanner_readahead_hits),
+    MINIT(scanner_readahead_bytes_wasted),
     MINIT(scans_started),
     MINIT(bloom_lookups),
     MINIT(key_file_lookups),
@@ -57,6 +57,8 @@ struct TabletMetrics {
   scoped_refptr<Counter> scanner_rows_scanned;
   scoped_refptr<Counter> scanner_cells_scanned_from_disk;
   scoped_refptr<Counter> scanner_bytes_scanned_from_disk;
+  scoped_refptr<Counter> scanner_readahead_hits;
+  scoped_refptr<Counter> scanner_readahead_bytes_wasted;
   scoped_refptr<Counter> scans_started;
 
   // Probe stats
@@ -0,0 +1,191 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/scan_aggregator.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using google::protobuf::RepeatedPtrField;
+using std::string;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+class ScanAggregatorTest : public KuduTest {
+ public:
+  ScanAggregatorTest()
+      : schema_({ ColumnSchema("key", INT32),
+                  ColumnSchema("double_val", DOUBLE, true /* nullable */),
+                  ColumnSchema("string_val", STRING, true /* nullable */) },
+                1),
+        arena_(1024, 1024 * 1024) {
+  }
+
+  // Fills 'block' with rows whose key is 'first_key' onwards. Every fourth
+  // row has NULL 'double_val' and 'string_val' cells.
+  void FillRowBlock(int first_key, RowBlock* block) {
+    block->selection_vector()->SetAllTrue();
+    for (int i = 0; i < block->nrows(); i++) {
+      RowBlockRow row = block->row(i);
+      int key = first_key + i;
+      *reinterpret_cast<int32_t*>(row.mutable_cell_ptr(0)) = key;
+      bool is_null = key % 4 == 0;
+      row.cell(1).set_null(is_null);
+      row.cell(2).set_null(is_null);
+      *reinterpret_cast<double*>(row.mutable_cell_ptr(1)) = key * 0.5;
+      Slice str;
+      CHECK(arena_.RelocateSlice(Substitute("row $0", key), &str));
+      *reinterpret_cast<Slice*>(row.mutable_cell_ptr(2)) = str;
+    }
+  }
+
+  static ScanAggregatePB MakeAggregate(ScanAggregatePB::Function function, int col_idx = -1) {
+    ScanAggregatePB pb;
+    pb.set_function(function);
+    if (col_idx != -1) {
+      pb.set_column_idx(col_idx);
+    }
+    return pb;
+  }
+
+ protected:
+  Schema schema_;
+  Arena arena_;
+};
+
+TEST_F(ScanAggregatorTest, TestAggregates) {
+  RepeatedPtrField<ScanAggregatePB> aggs;
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::COUNT);
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::COUNT, 1);
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::SUM, 0);
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::SUM, 1);
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::MIN, 0);
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::MAX, 2);
+  gscoped_ptr<ScanAggregator> aggregator;
+  ASSERT_OK(ScanAggregator::Create(schema_, aggs, &aggregator));
+
+  // Aggregate two blocks of rows 0-99 and 100-199, with every even row of
+  // the second block unselected.
+  RowBlock block(schema_, 100, &arena_);
+  FillRowBlock(0, &block);
+  aggregator->HandleRowBlock(block);
+  FillRowBlock(100, &block);
+  for (int i = 0; i < block.nrows(); i += 2) {
+    block.selection_vector()->SetRowUnselected(i);
+  }
+  aggregator->HandleRowBlock(block);
+
+  int64_t count = 0, non_null_count = 0, key_sum = 0;
+  double double_sum = 0;
+  for (int key = 0; key < 200; key++) {
+    if (key >= 100 && key % 2 == 0) continue;
+    count++;
+    key_sum += key;
+    if (key % 4 != 0) {
+      non_null_count++;
+      double_sum += key * 0.5;
+    }
+  }
+
+  RepeatedPtrField<ScanAggregateResultPB> results;
+  aggregator->GetResults(&results);
+  ASSERT_EQ(aggs.size(), results.size());
+  ASSERT_EQ(count, results.Get(0).count());
+  ASSERT_EQ(non_null_count, results.Get(1).count());
+  ASSERT_EQ(key_sum, results.Get(2).int_sum());
+  ASSERT_FALSE(results.Get(2).has_double_sum());
+  ASSERT_DOUBLE_EQ(double_sum, results.Get(3).double_sum());
+  ASSERT_EQ(non_null_count, results.Get(3).count());
+  int32_t min_key = 0;
+  ASSERT_EQ(string(reinterpret_cast<const char*>(&min_key), sizeof(min_key)),
+            results.Get(4).value());
+  // "row 99" is the largest string, since the string comparison is bytewise.
+  ASSERT_EQ("row 99", results.Get(5).value());
+}
+
+TEST_F(ScanAggregatorTest, TestNoRows) {
+  RepeatedPtrField<ScanAggregatePB> aggs;
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::COUNT);
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::MAX, 0);
+  gscoped_ptr<ScanAggregator> aggregator;
+  ASSERT_OK(ScanAggregator::Create(schema_, aggs, &aggregator));
+
+  RepeatedPtrField<ScanAggregateResultPB> results;
+  aggregator->GetResults(&results);
+  ASSERT_EQ(2, results.size());
+  ASSERT_EQ(0, results.Get(0).count());
+  ASSERT_EQ(0, results.Get(1).count());
+  ASSERT_FALSE(results.Get(1).has_value());
+}
+
+// An integer SUM which overflows wraps around.
+TEST_F(ScanAggregatorTest, TestSumOverflow) {
+  Schema schema({ ColumnSchema("val", INT64) }, 1);
+  RepeatedPtrField<ScanAggregatePB> aggs;
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::SUM, 0);
+  gscoped_ptr<ScanAggregator> aggregator;
+  ASSERT_OK(ScanAggregator::Create(schema, aggs, &aggregator));
+
+  RowBlock block(schema, 3, &arena_);
+  block.selection_vector()->SetAllTrue();
+  const int64_t kVals[] = { INT64_MAX, 2, -5 };
+  for (int i = 0; i < block.nrows(); i++) {
+    *reinterpret_cast<int64_t*>(block.row(i).mutable_cell_ptr(0)) = kVals[i];
+  }
+  aggregator->HandleRowBlock(block);
+
+  RepeatedPtrField<ScanAggregateResultPB> results;
+  aggregator->GetResults(&results);
+  ASSERT_EQ(1, results.size());
+  ASSERT_EQ(3, results.Get(0).count());
+  // INT64_MAX + 2 wraps to INT64_MIN + 1, and then subtracting 5 wraps back.
+  ASSERT_EQ(INT64_MAX - 3, results.Get(0).int_sum());
+}
+
+TEST_F(ScanAggregatorTest, TestInvalidAggregates) {
+  gscoped_ptr<ScanAggregator> aggregator;
+  RepeatedPtrField<ScanAggregatePB> aggs;
+
+  *aggs.Add() = MakeAggregate(ScanAggregatePB::UNKNOWN_FUNCTION);
+  Status s = ScanAggregator::Create(schema_, aggs, &aggregator);
+  ASSERT_STR_CONTAINS(s.ToString(), "Unknown aggregate function");
+
+  *aggs.Mutable(0) = MakeAggregate(ScanAggregatePB::MIN);
+  s = ScanAggregator::Create(schema_, aggs, &aggregator);
+  ASSERT_STR_CONTAINS(s.ToString(), "Aggregate MIN requires a column");
+
+  *aggs.Mutable(0) = MakeAggregate(ScanAggregatePB::MAX, 3);
+  s = ScanAggregator::Create(schema_, aggs, &aggregator);
+  ASSERT_STR_CONTAINS(s.ToString(), "Aggregate column index 3 is not in the projection");
+
+  *aggs.Mutable(0) = MakeAggregate(ScanAggregatePB::SUM, 2);
+  s = ScanAggregator::Create(schema_, aggs, &aggregator);
+  ASSERT_STR_CONTAINS(s.ToString(), "Cannot compute SUM of column");
+}
+
+} // namespace tserver
+} // namespace kudu
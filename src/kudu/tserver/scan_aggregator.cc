@@ -0,0 +1,227 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/scan_aggregator.h"
+
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/slice.h"
+
+using google::protobuf::RepeatedPtrField;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+namespace {
+
+bool IsSummable(DataType type) {
+  switch (type) {
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+    case FLOAT:
+    case DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Adds the selected, non-NULL cells of 'cblock' to 'sum', and returns the
+// number of cells added.
+template<DataType Type, typename SumType>
+int64_t SumCells(const ColumnBlock& cblock, const SelectionVector& sel, SumType* sum) {
+  typedef typename DataTypeTraits<Type>::cpp_type CppType;
+  const CppType* cells = reinterpret_cast<const CppType*>(cblock.data());
+  const bool nullable = cblock.is_nullable();
+  int64_t count = 0;
+  for (size_t i = 0; i < cblock.nrows(); i++) {
+    if (!sel.IsRowSelected(i) || (nullable && cblock.is_null(i))) continue;
+    *sum += cells[i];
+    count++;
+  }
+  return count;
+}
+
+} // anonymous namespace
+
+ScanAggregator::ScanAggregator(vector<Aggregate> aggregates)
+    : aggregates_(std::move(aggregates)) {
+}
+
+ScanAggregator::~ScanAggregator() {}
+
+Status ScanAggregator::Create(const Schema& projection,
+                              const RepeatedPtrField<ScanAggregatePB>& aggregates,
+                              gscoped_ptr<ScanAggregator>* aggregator) {
+  vector<Aggregate> aggs;
+  aggs.reserve(aggregates.size());
+  for (const ScanAggregatePB& pb : aggregates) {
+    Aggregate agg;
+    agg.function = pb.function();
+    agg.col_idx = -1;
+    agg.type_info = nullptr;
+    agg.count = 0;
+    agg.int_sum = 0;
+    agg.double_sum = 0;
+
+    switch (pb.function()) {
+      case ScanAggregatePB::COUNT:
+      case ScanAggregatePB::SUM:
+      case ScanAggregatePB::MIN:
+      case ScanAggregatePB::MAX:
+        break;
+      default:
+        return Status::InvalidArgument(Substitute("Unknown aggregate function: $0",
+                                                  pb.function()));
+    }
+
+    if (pb.has_column_idx()) {
+      if (pb.column_idx() < 0 || pb.column_idx() >= projection.num_columns()) {
+        return Status::InvalidArgument(Substitute(
+            "Aggregate column index $0 is not in the projection", pb.column_idx()));
+      }
+      agg.col_idx = pb.column_idx();
+      agg.type_info = projection.column(agg.col_idx).type_info();
+    } else if (pb.function() != ScanAggregatePB::COUNT) {
+      return Status::InvalidArgument(Substitute(
+          "Aggregate $0 requires a column",
+          ScanAggregatePB::Function_Name(pb.function())));
+    }
+
+    if (pb.function() == ScanAggregatePB::SUM && !IsSummable(agg.type_info->type())) {
+      return Status::InvalidArgument(Substitute(
+          "Cannot compute SUM of column $0",
+          projection.column(agg.col_idx).ToString()));
+    }
+    aggs.emplace_back(std::move(agg));
+  }
+  aggregator->reset(new ScanAggregator(std::move(aggs)));
+  return Status::OK();
+}
+
+void ScanAggregator::HandleRowBlock(const RowBlock& block) {
+  const SelectionVector& sel = *block.selection_vector();
+  for (Aggregate& agg : aggregates_) {
+    if (agg.col_idx == -1) {
+      agg.count += sel.CountSelected();
+    } else {
+      HandleColumn(block, &agg);
+    }
+  }
+}
+
+void ScanAggregator::HandleColumn(const RowBlock& block, Aggregate* agg) {
+  const SelectionVector& sel = *block.selection_vector();
+  ColumnBlock cblock = block.column_block(agg->col_idx);
+  DCHECK_EQ(agg->type_info->type(), cblock.type_info()->type());
+
+  if (agg->function == ScanAggregatePB::SUM) {
+    switch (agg->type_info->type()) {
+      case INT8:
+        agg->count += SumCells<INT8>(cblock, sel, &agg->int_sum);
+        break;
+      case INT16:
+        agg->count += SumCells<INT16>(cblock, sel, &agg->int_sum);
+        break;
+      case INT32:
+        agg->count += SumCells<INT32>(cblock, sel, &agg->int_sum);
+        break;
+      case INT64:
+        agg->count += SumCells<INT64>(cblock, sel, &agg->int_sum);
+        break;
+      case FLOAT:
+        agg->count += SumCells<FLOAT>(cblock, sel, &agg->double_sum);
+        break;
+      case DOUBLE:
+        agg->count += SumCells<DOUBLE>(cblock, sel, &agg->double_sum);
+        break;
+      default:
+        LOG(FATAL) << "Unexpected SUM type: " << agg->type_info->name();
+    }
+    return;
+  }
+
+  const bool nullable = cblock.is_nullable();
+  for (size_t i = 0; i < cblock.nrows(); i++) {
+    if (!sel.IsRowSelected(i) || (nullable && cblock.is_null(i))) continue;
+    const void* cell = cblock.cell_ptr(i);
+    if (agg->function == ScanAggregatePB::MIN) {
+      if (agg->count == 0 || agg->type_info->Compare(cell, agg->value_buf) < 0) {
+        SetValue(cell, agg);
+      }
+    } else if (agg->function == ScanAggregatePB::MAX) {
+      if (agg->count == 0 || agg->type_info->Compare(cell, agg->value_buf) > 0) {
+        SetValue(cell, agg);
+      }
+    }
+    agg->count++;
+  }
+}
+
+void ScanAggregator::SetValue(const void* cell_ptr, Aggregate* agg) {
+  if (agg->type_info->physical_type() == BINARY) {
+    // The cell points into the arena of the current row block, so the
+    // value must be copied out.
+    const Slice* cell = reinterpret_cast<const Slice*>(cell_ptr);
+    agg->binary_value.assign(reinterpret_cast<const char*>(cell->data()), cell->size());
+    Slice copy(agg->binary_value);
+    memcpy(agg->value_buf, &copy, sizeof(copy));
+  } else {
+    DCHECK_LE(agg->type_info->size(), sizeof(agg->value_buf));
+    memcpy(agg->value_buf, cell_ptr, agg->type_info->size());
+  }
+}
+
+void ScanAggregator::GetResults(RepeatedPtrField<ScanAggregateResultPB>* results) const {
+  for (const Aggregate& agg : aggregates_) {
+    ScanAggregateResultPB* result = results->Add();
+    result->set_count(agg.count);
+    switch (agg.function) {
+      case ScanAggregatePB::SUM:
+        if (agg.type_info->type() == FLOAT || agg.type_info->type() == DOUBLE) {
+          result->set_double_sum(agg.double_sum);
+        } else {
+          result->set_int_sum(static_cast<int64_t>(agg.int_sum));
+        }
+        break;
+      case ScanAggregatePB::MIN:
+      case ScanAggregatePB::MAX:
+        if (agg.count == 0) break;
+        if (agg.type_info->physical_type() == BINARY) {
+          result->set_value(agg.binary_value);
+        } else {
+          result->set_value(agg.value_buf, agg.type_info->size());
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+} // namespace tserver
+} // namespace kudu
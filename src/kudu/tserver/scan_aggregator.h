@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_SCAN_AGGREGATOR_H
+#define KUDU_TSERVER_SCAN_AGGREGATOR_H
+
+#include <string>
+#include <vector>
+
+#include <google/protobuf/repeated_field.h>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class RowBlock;
+class Schema;
+class TypeInfo;
+
+namespace tserver {
+
+// Evaluates the aggregates of a NewScanRequestPB over the rows returned by
+// a tablet scanner, accumulating partial results across continuation
+// requests until the scan completes.
+//
+// This class is not thread-safe; like the rest of the Scanner state, it is
+// only accessed by the RPC handling the scanner's current request.
+class ScanAggregator {
+ public:
+  // Creates an aggregator for 'aggregates', whose column indexes refer to
+  // the client projection 'projection'.
+  //
+  // Returns InvalidArgument if any aggregate is malformed or does not apply
+  // to the type of its column.
+  static Status Create(
+      const Schema& projection,
+      const google::protobuf::RepeatedPtrField<ScanAggregatePB>& aggregates,
+      gscoped_ptr<ScanAggregator>* aggregator);
+
+  ~ScanAggregator();
+
+  // Folds the selected rows of 'block' into the aggregates. The leading
+  // columns of the block's schema must match the client projection.
+  void HandleRowBlock(const RowBlock& block);
+
+  // Appends the current partial results to 'results', one per aggregate.
+  void GetResults(
+      google::protobuf::RepeatedPtrField<ScanAggregateResultPB>* results) const;
+
+ private:
+  struct Aggregate {
+    ScanAggregatePB::Function function;
+
+    // Index of the aggregated column, or -1 for COUNT(*).
+    int col_idx;
+
+    // Type of the aggregated column, or NULL for COUNT(*).
+    const TypeInfo* type_info;
+
+    // Number of rows or non-NULL cells folded in so far.
+    int64_t count;
+
+    // Running sums, for SUM. Integer sums are accumulated unsigned so that
+    // overflow wraps around rather than being undefined.
+    uint64_t int_sum;
+    double double_sum;
+
+    // The current MIN or MAX, valid if 'count' is non-zero. Fixed-length
+    // values are stored inline in 'value_buf'; BINARY values are stored in
+    // 'binary_value', which 'value_buf' then holds a Slice of.
+    uint8_t value_buf[16];
+    std::string binary_value;
+  };
+
+  explicit ScanAggregator(std::vector<Aggregate> aggregates);
+
+  // Aggregates the selected cells of column 'agg->col_idx' in 'block'.
+  void HandleColumn(const RowBlock& block, Aggregate* agg);
+
+  // Replaces the current MIN or MAX of 'agg' with the cell at 'cell_ptr'.
+  static void SetValue(const void* cell_ptr, Aggregate* agg);
+
+  std::vector<Aggregate> aggregates_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanAggregator);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_SCAN_AGGREGATOR_H
@@ -185,6 +185,7 @@ Scanner::Scanner(string id, const scoped_refptr<TabletPeer>& tablet_peer,
       call_seq_id_(0),
       start_time_(MonoTime::Now()),
       metrics_(metrics),
+      row_format_flags_(0),
       arena_(1024, 1024 * 1024) {
   UpdateAccessTime();
 }
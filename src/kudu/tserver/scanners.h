@@ -29,6 +29,7 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tablet/tablet_peer.h"
+#include "kudu/tserver/scan_aggregator.h"
 #include "kudu/util/auto_release_pool.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
@@ -272,6 +273,25 @@ class Scanner {
     already_reported_stats_ = stats;
   }
 
+  // The row format flags (a bitmask of RowFormatFlags) requested by the
+  // client when the scan was started.
+  uint64_t row_format_flags() const {
+    return row_format_flags_;
+  }
+  void set_row_format_flags(uint64_t row_format_flags) {
+    row_format_flags_ = row_format_flags;
+  }
+
+  // Associate the aggregates requested by the client with the Scanner. The
+  // scanner takes ownership of 'aggregator'.
+  void set_aggregator(gscoped_ptr<ScanAggregator> aggregator) {
+    aggregator_.swap(aggregator);
+  }
+
+  // Returns the aggregator which should consume the scanned rows in place
+  // of returning them, or NULL if this is not an aggregating scan.
+  ScanAggregator* aggregator() { return aggregator_.get(); }
+
  private:
   friend class ScannerManager;
 
@@ -305,6 +325,9 @@ class Scanner {
   // as the scanner proceeds.
   IteratorStats already_reported_stats_;
 
+  // The row format flags requested by the client.
+  uint64_t row_format_flags_;
+
   // The spec used by 'iter_'
   gscoped_ptr<ScanSpec> spec_;
 
@@ -314,6 +337,9 @@ class Scanner {
 
   gscoped_ptr<RowwiseIterator> iter_;
 
+  // The aggregates being computed by this scanner, if any.
+  gscoped_ptr<ScanAggregator> aggregator_;
+
   AutoReleasePool autorelease_pool_;
 
   // Arena used for allocations which must last as long as the scanner
@@ -1690,6 +1690,100 @@ TEST_F(TabletServerTest, TestScan_NoResults) {
   }
 }
 
+// Test computing aggregates on the server, with a small batch size so that
+// the aggregates span several continuation requests.
+TEST_F(TabletServerTest, TestScanWithAggregates) {
+  const int kNumRows = 1000;
+  InsertTestRowsDirect(0, kNumRows);
+  ASSERT_NO_FATAL_FAILURE(DeleteTestRowsRemote(0, 10));
+  FLAGS_scanner_batch_size_rows = 100;
+
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+
+  // Compute COUNT(*), SUM(int_val) and MAX(key) over the rows with
+  // key < 500.
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  SchemaBuilder sb;
+  ASSERT_OK(sb.AddColumn(schema_.column(0), false));
+  ASSERT_OK(sb.AddColumn(schema_.column(1), false));
+  Schema projection = sb.BuildWithoutIds();
+  ASSERT_OK(SchemaToColumnPBs(projection, scan->mutable_projected_columns(),
+                              SCHEMA_PB_WITHOUT_IDS));
+  ColumnPredicatePB* pred = scan->add_column_predicates();
+  pred->set_column("key");
+  int32_t upper = 500;
+  pred->mutable_range()->mutable_upper()->append(reinterpret_cast<char*>(&upper),
+                                                 sizeof(upper));
+  ScanAggregatePB* agg = scan->add_aggregates();
+  agg->set_function(ScanAggregatePB::COUNT);
+  agg = scan->add_aggregates();
+  agg->set_function(ScanAggregatePB::SUM);
+  agg->set_column_idx(1);
+  agg = scan->add_aggregates();
+  agg->set_function(ScanAggregatePB::MAX);
+  agg->set_column_idx(0);
+  req.set_batch_size_bytes(0);
+  req.set_call_seq_id(0);
+  {
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_TRUE(resp.has_more_results());
+    ASSERT_EQ(0, resp.aggregate_results_size());
+  }
+
+  // Drain the scanner. No rows are returned, and only the final response
+  // carries the aggregates.
+  ScanRequestPB continue_req;
+  continue_req.set_scanner_id(resp.scanner_id());
+  continue_req.set_batch_size_bytes(1);
+  int call_seq_id = 1;
+  do {
+    rpc.Reset();
+    continue_req.set_call_seq_id(call_seq_id++);
+    ASSERT_OK(proxy_->Scan(continue_req, &resp, &rpc));
+    ASSERT_FALSE(resp.has_error()) << SecureDebugString(resp);
+    ASSERT_FALSE(resp.has_data());
+  } while (resp.has_more_results());
+
+  int64_t expected_sum = 0;
+  for (int i = 10; i < 500; i++) {
+    expected_sum += i * 2;
+  }
+  ASSERT_EQ(3, resp.aggregate_results_size());
+  ASSERT_EQ(490, resp.aggregate_results(0).count());
+  ASSERT_EQ(expected_sum, resp.aggregate_results(1).int_sum());
+  int32_t max_key = 499;
+  ASSERT_EQ(string(reinterpret_cast<const char*>(&max_key), sizeof(max_key)),
+            resp.aggregate_results(2).value());
+
+  // A COUNT(*) with an empty projection and no predicates returns its
+  // result in the first response.
+  scan->clear_projected_columns();
+  scan->clear_column_predicates();
+  scan->clear_aggregates();
+  scan->add_aggregates()->set_function(ScanAggregatePB::COUNT);
+  req.set_batch_size_bytes(1024 * 1024);
+  rpc.Reset();
+  ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+  ASSERT_FALSE(resp.has_error()) << SecureDebugString(resp);
+  ASSERT_FALSE(resp.has_more_results());
+  ASSERT_EQ(1, resp.aggregate_results_size());
+  ASSERT_EQ(kNumRows - 10, resp.aggregate_results(0).count());
+
+  // Aggregates can't be computed by ordered scans.
+  scan->set_order_mode(ORDERED);
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+  rpc.Reset();
+  ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+  ASSERT_TRUE(resp.has_error());
+  ASSERT_EQ(TabletServerErrorPB::INVALID_SCAN_SPEC, resp.error().code());
+}
+
 // Test scanning a tablet that has no entries.
 TEST_F(TabletServerTest, TestScan_InvalidScanSeqId) {
   InsertTestRowsDirect(0, 10);
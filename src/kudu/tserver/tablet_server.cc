@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/service_if.h"
@@ -88,6 +89,7 @@ Status TabletServer::Init() {
   RETURN_NOT_OK(ValidateMasterAddressResolution());
 
   RETURN_NOT_OK(ServerBase::Init());
+  cfile::BlockCache::GetSingleton()->StartSecondaryCache(fs_manager_->uuid());
   RETURN_NOT_OK(path_handlers_->Register(web_server_.get()));
 
   heartbeater_.reset(new Heartbeater(opts_, this));
@@ -125,6 +127,7 @@ Status TabletServer::Start() {
 
   RETURN_NOT_OK(heartbeater_->Start());
   RETURN_NOT_OK(maintenance_manager_->Init());
+  fs_manager_->block_manager()->RegisterMaintenanceOps(maintenance_manager_.get());
 
   google::FlushLogFiles(google::INFO); // Flush the startup messages.
 
@@ -135,6 +138,9 @@ void TabletServer::Shutdown() {
   LOG(INFO) << "TabletServer shutting down...";
 
   if (initted_) {
+    // Unregistering the block manager's ops first cancels any that are
+    // running, rather than waiting for them to finish.
+    fs_manager_->block_manager()->UnregisterMaintenanceOps();
     maintenance_manager_->Shutdown();
     WARN_NOT_OK(heartbeater_->Stop(), "Failed to stop TS Heartbeat thread");
     ServerBase::Shutdown();
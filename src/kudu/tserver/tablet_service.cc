@@ -45,6 +45,7 @@
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/tserver/tablet_copy_service.h"
+#include "kudu/tserver/scan_aggregator.h"
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/ts_tablet_manager.h"
@@ -94,6 +95,12 @@ DEFINE_int32(scanner_inject_latency_on_each_batch_ms, 0,
              "Used for tests.");
 TAG_FLAG(scanner_inject_latency_on_each_batch_ms, unsafe);
 
+DEFINE_bool(scanner_inject_service_unavailable_on_continue_scan, false,
+            "If set, the scanner will return a ServiceUnavailable status on "
+            "any scan continuation request, without consuming its call "
+            "sequence ID. Used for tests.");
+TAG_FLAG(scanner_inject_service_unavailable_on_continue_scan, unsafe);
+
 DECLARE_int32(memory_limit_warn_threshold_percentage);
 DECLARE_int32(tablet_history_max_age_sec);
 
@@ -334,6 +341,22 @@ class ScanResultCollector {
 
   // Return the number of rows actually returned to the client.
   virtual int64_t NumRowsReturned() const = 0;
+
+  // Sets the row format flags (a bitmask of RowFormatFlags) of the scanner
+  // whose results are being collected.
+  //
+  // This is a setter rather than a constructor argument because the collector
+  // is built before the scanner, which records the flags of the original
+  // request, has been looked up.
+  //
+  // Does nothing by default.
+  virtual void set_row_format_flags(uint64_t row_format_flags) {}
+
+  // Handles the final results of an aggregating scan, in which the scanned
+  // rows are consumed by 'aggregator' rather than passed to HandleRowBlock().
+  //
+  // Does nothing by default.
+  virtual void HandleAggregateResults(const ScanAggregator& aggregator) {}
 };
 
 namespace {
@@ -357,7 +380,8 @@ void SetLastRow(const RowBlock& row_block, faststring* last_primary_key) {
 
 }  // namespace
 
-// Copies the scan result to the given row block PB and data buffers.
+// Copies the scan result into row data buffers which can be attached to the
+// scan response.
 //
 // This implementation is used in the common case where a client is running
 // a scan and the data needs to be returned to the client.
@@ -367,10 +391,9 @@ void SetLastRow(const RowBlock& row_block, faststring* last_primary_key) {
 // server-side scan and thus never need to return the actual data.)
 class ScanResultCopier : public ScanResultCollector {
  public:
-  ScanResultCopier(RowwiseRowBlockPB* rowblock_pb, faststring* rows_data, faststring* indirect_data)
-      : rowblock_pb_(DCHECK_NOTNULL(rowblock_pb)),
-        rows_data_(DCHECK_NOTNULL(rows_data)),
-        indirect_data_(DCHECK_NOTNULL(indirect_data)),
+  explicit ScanResultCopier(size_t batch_size_bytes)
+      : batch_size_bytes_(batch_size_bytes),
+        row_format_flags_(NO_FLAGS),
         blocks_processed_(0),
         num_rows_returned_(0) {
   }
@@ -378,9 +401,18 @@ class ScanResultCopier : public ScanResultCollector {
   virtual void HandleRowBlock(const Schema* client_projection_schema,
                               const RowBlock& row_block) OVERRIDE {
     blocks_processed_++;
-    num_rows_returned_ += row_block.selection_vector()->CountSelected();
-    SerializeRowBlock(row_block, rowblock_pb_, client_projection_schema,
-                      rows_data_, indirect_data_);
+    if (is_columnar()) {
+      num_rows_returned_ += SerializeRowBlockColumnar(row_block, client_projection_schema,
+                                                      &columnar_batch_);
+    } else {
+      if (!rows_data_) {
+        rows_data_.reset(new faststring(batch_size_bytes_ * 11 / 10));
+        indirect_data_.reset(new faststring(batch_size_bytes_ * 11 / 10));
+      }
+      num_rows_returned_ += row_block.selection_vector()->CountSelected();
+      SerializeRowBlock(row_block, &rowblock_pb_, client_projection_schema,
+                        rows_data_.get(), indirect_data_.get());
+    }
     SetLastRow(row_block, &last_primary_key_);
   }
 
@@ -388,7 +420,10 @@ class ScanResultCopier : public ScanResultCollector {
 
   // Returns number of bytes buffered to return.
   virtual int64_t ResponseSize() const OVERRIDE {
-    return rows_data_->size() + indirect_data_->size();
+    if (is_columnar()) {
+      return columnar_batch_.TotalSize();
+    }
+    return rows_data_ ? rows_data_->size() + indirect_data_->size() : 0;
   }
 
   virtual const faststring& last_primary_key() const OVERRIDE {
@@ -399,10 +434,84 @@ class ScanResultCopier : public ScanResultCollector {
     return num_rows_returned_;
   }
 
+  virtual void set_row_format_flags(uint64_t row_format_flags) OVERRIDE {
+    row_format_flags_ = row_format_flags;
+  }
+
+  virtual void HandleAggregateResults(const ScanAggregator& aggregator) OVERRIDE {
+    aggregator.GetResults(&aggregate_results_);
+  }
+
+  // Moves any aggregate results into 'resp'.
+  void SetupAggregateResponse(ScanResponsePB* resp) {
+    resp->mutable_aggregate_results()->Swap(&aggregate_results_);
+  }
+
+  // Moves the buffered rows into sidecars of 'context' and records them in
+  // 'resp'. Must only be called once, and only if BlocksProcessed() > 0.
+  void SetupResponse(rpc::RpcContext* context, ScanResponsePB* resp) {
+    DCHECK_GT(blocks_processed_, 0);
+    if (is_columnar()) {
+      gscoped_ptr<faststring> data(new faststring());
+      gscoped_ptr<faststring> varlen_data(new faststring());
+      gscoped_ptr<faststring> non_null_bitmaps(new faststring());
+      ColumnarRowBlockPB* columnar_pb = resp->mutable_columnar_data();
+      FinishColumnarBatch(&columnar_batch_, columnar_pb, data.get(), varlen_data.get(),
+                          non_null_bitmaps.get());
+
+      int idx;
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+          new rpc::RpcSidecar(std::move(data))), &idx));
+      columnar_pb->set_data_sidecar(idx);
+      if (varlen_data->size() > 0) {
+        CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+            new rpc::RpcSidecar(std::move(varlen_data))), &idx));
+        columnar_pb->set_varlen_data_sidecar(idx);
+      }
+      if (non_null_bitmaps->size() > 0) {
+        CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+            new rpc::RpcSidecar(std::move(non_null_bitmaps))), &idx));
+        columnar_pb->set_non_null_bitmap_sidecar(idx);
+      }
+      return;
+    }
+
+    resp->mutable_data()->CopyFrom(rowblock_pb_);
+
+    // Add sidecar data to context and record the returned indices.
+    int rows_idx;
+    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+        new rpc::RpcSidecar(std::move(rows_data_))), &rows_idx));
+    resp->mutable_data()->set_rows_sidecar(rows_idx);
+
+    // Add indirect data as a sidecar, if applicable.
+    if (indirect_data_->size() > 0) {
+      int indirect_idx;
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+          new rpc::RpcSidecar(std::move(indirect_data_))), &indirect_idx));
+      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+    }
+  }
+
  private:
-  RowwiseRowBlockPB* const rowblock_pb_;
-  faststring* const rows_data_;
-  faststring* const indirect_data_;
+  bool is_columnar() const {
+    return row_format_flags_ & COLUMNAR_LAYOUT;
+  }
+
+  const size_t batch_size_bytes_;
+  uint64_t row_format_flags_;
+
+  // Row-wise output, allocated on the first row block.
+  RowwiseRowBlockPB rowblock_pb_;
+  gscoped_ptr<faststring> rows_data_;
+  gscoped_ptr<faststring> indirect_data_;
+
+  // Columnar output, used if the COLUMNAR_LAYOUT flag is set.
+  ColumnarSerializedBatch columnar_batch_;
+
+  // The final results of an aggregating scan.
+  RepeatedPtrField<ScanAggregateResultPB> aggregate_results_;
+
   int blocks_processed_;
   int64_t num_rows_returned_;
   faststring last_primary_key_;
@@ -1048,11 +1157,7 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
     return;
   }
 
-  size_t batch_size_bytes = GetMaxBatchSizeBytesHint(req);
-  gscoped_ptr<faststring> rows_data(new faststring(batch_size_bytes * 11 / 10));
-  gscoped_ptr<faststring> indirect_data(new faststring(batch_size_bytes * 11 / 10));
-  RowwiseRowBlockPB data;
-  ScanResultCopier collector(&data, rows_data.get(), indirect_data.get());
+  ScanResultCopier collector(GetMaxBatchSizeBytesHint(req));
 
   bool has_more_results = false;
   TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
@@ -1092,24 +1197,11 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
     return;
   }
   resp->set_has_more_results(has_more_results);
+  collector.SetupAggregateResponse(resp);
 
   DVLOG(2) << "Blocks processed: " << collector.BlocksProcessed();
   if (collector.BlocksProcessed() > 0) {
-    resp->mutable_data()->CopyFrom(data);
-
-    // Add sidecar data to context and record the returned indices.
-    int rows_idx;
-    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
-        new rpc::RpcSidecar(std::move(rows_data))), &rows_idx));
-    resp->mutable_data()->set_rows_sidecar(rows_idx);
-
-    // Add indirect data as a sidecar, if applicable.
-    if (indirect_data->size() > 0) {
-      int indirect_idx;
-      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
-          new rpc::RpcSidecar(std::move(indirect_data))), &indirect_idx));
-      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
-    }
+    collector.SetupResponse(context, resp);
 
     // Set the last row found by the collector.
     // We could have an empty batch if all the remaining rows are filtered by the predicate,
@@ -1210,8 +1302,58 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
   context->RespondSuccess();
 }
 
+void TabletServiceImpl::SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                                      SplitKeyRangeResponsePB* resp,
+                                      rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::SplitKeyRange",
+               "tablet_id", req->tablet_id());
+  DVLOG(3) << "Received SplitKeyRange RPC: " << SecureDebugString(*req);
+
+  if (PREDICT_FALSE(req->target_chunk_size_bytes() == 0)) {
+    context->RespondFailure(Status::InvalidArgument("Target chunk size must be positive"));
+    return;
+  }
+
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  vector<tablet::KeyRange> ranges;
+  s = tablet->SplitKeyRange(req->start_primary_key(), req->stop_primary_key(),
+                            req->target_chunk_size_bytes(), &ranges);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s,
+                         TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  for (const tablet::KeyRange& range : ranges) {
+    KeyRangePB* range_pb = resp->add_ranges();
+    if (!range.start_primary_key.empty()) {
+      range_pb->set_start_primary_key(range.start_primary_key);
+    }
+    if (!range.stop_primary_key.empty()) {
+      range_pb->set_stop_primary_key(range.stop_primary_key);
+    }
+    range_pb->set_size_bytes_estimate(range.size_bytes);
+  }
+  context->RespondSuccess();
+}
+
 bool TabletServiceImpl::SupportsFeature(uint32_t feature) const {
-  return feature == TabletServerFeatures::COLUMN_PREDICATES;
+  return feature == TabletServerFeatures::COLUMN_PREDICATES ||
+         feature == TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE ||
+         feature == TabletServerFeatures::SCAN_AGGREGATES ||
+         feature == TabletServerFeatures::BLOOM_FILTER_PREDICATE;
 }
 
 void TabletServiceImpl::Shutdown() {
@@ -1442,6 +1584,12 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     return Status::InvalidArgument("User requests should not have Column IDs");
   }
 
+  if (PREDICT_FALSE(scan_pb.row_format_flags() & ~COLUMNAR_LAYOUT)) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return Status::InvalidArgument(
+        Substitute("Unknown row format flags: $0", scan_pb.row_format_flags()));
+  }
+
   if (scan_pb.order_mode() == ORDERED) {
     // Ordered scans must be at a snapshot so that we perform a serializable read (which can be
     // resumed). Otherwise, this would be read committed isolation, which is not resumable.
@@ -1451,6 +1599,21 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     }
   }
 
+  gscoped_ptr<ScanAggregator> aggregator;
+  if (scan_pb.aggregates_size() > 0) {
+    // A resumed fault-tolerant scan would lose the partial aggregates of
+    // the failed attempt, so the two can't be combined.
+    if (scan_pb.order_mode() == ORDERED) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return Status::InvalidArgument("Cannot compute aggregates in an ordered scan");
+    }
+    s = ScanAggregator::Create(projection, scan_pb.aggregates(), &aggregator);
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return s;
+    }
+  }
+
   gscoped_ptr<ScanSpec> spec(new ScanSpec);
 
   // Missing columns will contain the columns that are not mentioned in the client
@@ -1470,6 +1633,9 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
   if (spec->CanShortCircuit()) {
     VLOG(1) << "short-circuiting without creating a server-side scanner.";
     *has_more_results = false;
+    if (aggregator) {
+      result_collector->HandleAggregateResults(*aggregator);
+    }
     return Status::OK();
   }
 
@@ -1506,7 +1672,8 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
         return s;
       }
       case READ_LATEST: {
-        s = tablet->NewRowIterator(projection, &iter);
+        s = tablet->NewRowIterator(projection, tablet::MvccSnapshot(*tablet->mvcc_manager()),
+                                   UNORDERED, server_->tablet_manager()->scan_pool(), &iter);
         break;
       }
       case READ_AT_SNAPSHOT: {
@@ -1586,10 +1753,15 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
   if (!*has_more_results) {
     // If there are no more rows, we can short circuit some work and respond immediately.
     VLOG(1) << "No more rows, short-circuiting out without creating a server-side scanner.";
+    if (aggregator) {
+      result_collector->HandleAggregateResults(*aggregator);
+    }
     return Status::OK();
   }
 
   scanner->Init(std::move(iter), std::move(orig_spec));
+  scanner->set_row_format_flags(scan_pb.row_format_flags());
+  scanner->set_aggregator(std::move(aggregator));
   unreg_scanner.Cancel();
   *scanner_id = scanner->id();
 
@@ -1621,6 +1793,11 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   TRACE_EVENT1("tserver", "TabletServiceImpl::HandleContinueScanRequest",
                "scanner_id", req->scanner_id());
 
+  if (PREDICT_FALSE(FLAGS_scanner_inject_service_unavailable_on_continue_scan)) {
+    return Status::ServiceUnavailable("Injecting service unavailable status on scan due to "
+                                      "--scanner_inject_service_unavailable_on_continue_scan");
+  }
+
   size_t batch_size_bytes = GetMaxBatchSizeBytesHint(req);
 
   // TODO: need some kind of concurrency control on these scanner objects
@@ -1655,8 +1832,10 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   }
   scanner->IncrementCallSeqId();
   scanner->UpdateAccessTime();
+  result_collector->set_row_format_flags(scanner->row_format_flags());
 
   RowwiseIterator* iter = scanner->iter();
+  ScanAggregator* aggregator = scanner->aggregator();
 
   // TODO: could size the RowBlock based on the user's requested batch size?
   // If people had really large indirect objects, we would currently overshoot
@@ -1689,7 +1868,13 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
       // The collector will separately count the number of rows actually returned to
       // the client.
       rows_scanned += block.nrows();
-      result_collector->HandleRowBlock(scanner->client_projection_schema(), block);
+      if (aggregator) {
+        // The rows are folded into the aggregates rather than returned, so
+        // the scan continues until it completes or exhausts its time budget.
+        aggregator->HandleRowBlock(block);
+      } else {
+        result_collector->HandleRowBlock(scanner->client_projection_schema(), block);
+      }
     }
 
     int64_t response_size = result_collector->ResponseSize();
@@ -1755,10 +1940,17 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
         delta_stats.cells_read_from_disk);
     tablet->metrics()->scanner_bytes_scanned_from_disk->IncrementBy(
         delta_stats.bytes_read_from_disk);
+    tablet->metrics()->scanner_readahead_hits->IncrementBy(
+        delta_stats.readahead_hits);
+    tablet->metrics()->scanner_readahead_bytes_wasted->IncrementBy(
+        delta_stats.readahead_bytes_wasted);
   }
 
   scanner->UpdateAccessTime();
   *has_more_results = !req->close_scanner() && iter->HasNext();
+  if (aggregator && !iter->HasNext()) {
+    result_collector->HandleAggregateResults(*aggregator);
+  }
   if (*has_more_results) {
     unreg_scanner.Cancel();
   } else {
@@ -1880,7 +2072,8 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   if (scan_pb.order_mode() == UNKNOWN_ORDER_MODE) {
     return Status::InvalidArgument("Unknown order mode specified");
   }
-  RETURN_NOT_OK(tablet->NewRowIterator(projection, snap, scan_pb.order_mode(), iter));
+  RETURN_NOT_OK(tablet->NewRowIterator(projection, snap, scan_pb.order_mode(),
+                                       server_->tablet_manager()->scan_pool(), iter));
   *snap_timestamp = tmp_snap_timestamp;
   return Status::OK();
 }
@@ -34,6 +34,7 @@
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/casts.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/master/master.pb.h"
@@ -71,6 +72,13 @@ DEFINE_int32(num_tablets_to_open_simultaneously, 0,
              "may make sense to manually tune this.");
 TAG_FLAG(num_tablets_to_open_simultaneously, advanced);
 
+DEFINE_int32(num_tablet_scan_threads, 0,
+             "Number of threads available to read the rowsets of tablet scans in "
+             "parallel, shared by all scans on the server. If this is set to 0 (the "
+             "default), then it is set to the number of CPU cores. See "
+             "--tablet_scan_parallelism for the number used by each scan.");
+TAG_FLAG(num_tablet_scan_threads, experimental);
+
 DEFINE_int32(tablet_start_warn_threshold_ms, 500,
              "If a tablet takes more than this number of millis to start, issue "
              "a warning with a trace.");
@@ -167,6 +175,14 @@ TSTabletManager::TSTabletManager(FsManager* fs_manager,
       METRIC_op_apply_queue_time.Instantiate(server_->metric_entity()));
   apply_pool_->SetRunTimeMicrosHistogram(
       METRIC_op_apply_run_time.Instantiate(server_->metric_entity()));
+
+  int max_scan_threads = FLAGS_num_tablet_scan_threads;
+  if (max_scan_threads == 0) {
+    max_scan_threads = base::NumCPUs();
+  }
+  CHECK_OK(ThreadPoolBuilder("scan")
+           .set_max_threads(max_scan_threads)
+           .Build(&scan_pool_));
 }
 
 TSTabletManager::~TSTabletManager() {
@@ -834,6 +850,9 @@ void TSTabletManager::Shutdown() {
   // Shut down the apply pool.
   apply_pool_->Shutdown();
 
+  // Shut down the scan pool. Scans are no longer being served at this point.
+  scan_pool_->Shutdown();
+
   {
     std::lock_guard<rw_spinlock> l(lock_);
     // We don't expect anyone else to be modifying the map after we start the
@@ -144,6 +144,10 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
 
   virtual const NodeInstancePB& NodeInstance() const override;
 
+  // Returns the thread pool which reads the rowsets of tablet scans in
+  // parallel, shared between all tablets.
+  ThreadPool* scan_pool() const { return scan_pool_.get(); }
+
   // Initiate tablet copy of the specified tablet on the tablet_copy_pool_.
   // See the StartTabletCopy() RPC declaration in consensus.proto for details.
   // 'cb' is guaranteed to be invoked as a callback.
@@ -318,6 +322,9 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // Thread pool for apply transactions, shared between all tablets.
   gscoped_ptr<ThreadPool> apply_pool_;
 
+  // Thread pool for reading rowsets of tablet scans, shared between all tablets.
+  gscoped_ptr<ThreadPool> scan_pool_;
+
   DISALLOW_COPY_AND_ASSIGN(TSTabletManager);
 };
 
@@ -25,6 +25,8 @@
 
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/blocking_queue.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_macros.h"
 
 using std::shared_ptr;
 using std::string;
@@ -65,6 +67,26 @@ TEST(BlockingQueueTest, TestBlockingDrainTo) {
   ASSERT_EQ(3, out[2]);
 }
 
+TEST(BlockingQueueTest, TestBlockingDrainToWithDeadline) {
+  BlockingQueue<int32_t> test_queue(3);
+  vector<int32_t> out;
+  MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(10);
+  Status s = test_queue.BlockingDrainTo(&out, deadline);
+  ASSERT_TRUE(s.IsTimedOut()) << s.ToString();
+  ASSERT_TRUE(out.empty());
+
+  // Elements are appended to the ones already in 'out'.
+  out.push_back(0);
+  ASSERT_EQ(test_queue.Put(1), QUEUE_SUCCESS);
+  ASSERT_EQ(test_queue.Put(2), QUEUE_SUCCESS);
+  ASSERT_OK(test_queue.BlockingDrainTo(&out, MonoTime::Now()));
+  ASSERT_EQ((vector<int32_t>{ 0, 1, 2 }), out);
+
+  test_queue.Shutdown();
+  s = test_queue.BlockingDrainTo(&out, MonoTime::Now() + MonoDelta::FromSeconds(10));
+  ASSERT_TRUE(s.IsAborted()) << s.ToString();
+}
+
 TEST(BlockingQueueTest, TestTooManyInsertions) {
   BlockingQueue<int32_t> test_queue(2);
   ASSERT_EQ(test_queue.Put(123), QUEUE_SUCCESS);
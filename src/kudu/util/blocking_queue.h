@@ -26,7 +26,9 @@
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 
@@ -105,13 +107,7 @@ class BlockingQueue {
     MutexLock l(lock_);
     while (true) {
       if (!list_.empty()) {
-        out->reserve(list_.size());
-        for (const T& elt : list_) {
-          out->push_back(elt);
-          decrement_size_unlocked(elt);
-        }
-        list_.clear();
-        not_full_.Signal();
+        DrainToUnlocked(out);
         return true;
       }
       if (shutdown_) {
@@ -121,6 +117,27 @@ class BlockingQueue {
     }
   }
 
+  // Like BlockingDrainTo(), but only waits for elements until 'deadline'.
+  // Returns TimedOut if the deadline passed before any element was enqueued,
+  // and Aborted if the queue was shut down and is empty.
+  Status BlockingDrainTo(std::vector<T>* out, const MonoTime& deadline) {
+    MutexLock l(lock_);
+    while (true) {
+      if (!list_.empty()) {
+        DrainToUnlocked(out);
+        return Status::OK();
+      }
+      if (shutdown_) {
+        return Status::Aborted("queue has been shut down");
+      }
+      MonoTime now = MonoTime::Now();
+      if (now >= deadline) {
+        return Status::TimedOut("no elements were enqueued before the deadline");
+      }
+      not_empty_.TimedWait(deadline - now);
+    }
+  }
+
   // Attempts to put the given value in the queue.
   // Returns:
   //   QUEUE_SUCCESS: if successfully inserted
@@ -215,6 +232,17 @@ class BlockingQueue {
 
  private:
 
+  // Moves all elements to 'out'. Must be called when 'lock_' is held.
+  void DrainToUnlocked(std::vector<T>* out) {
+    out->reserve(out->size() + list_.size());
+    for (const T& elt : list_) {
+      out->push_back(elt);
+      decrement_size_unlocked(elt);
+    }
+    list_.clear();
+    not_full_.Signal();
+  }
+
   // Increments queue size. Must be called when 'lock_' is held.
   void increment_size_unlocked(const T& t) {
     size_ += LOGICAL_SIZE::logical_size(t);
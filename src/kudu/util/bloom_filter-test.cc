@@ -84,4 +84,56 @@ TEST(TestBloomFilter, TestInsertAndProbe) {
   ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
 }
 
+TEST(TestBloomFilter, TestBlockedInsertAndProbe) {
+  BloomFilterSizing sizing = BloomFilterSizing::BySizeAndFPRate(4096, 0.01);
+  BlockedBloomFilterBuilder bfb(sizing);
+  ASSERT_EQ(4096, bfb.n_bytes());
+
+  // The blocked filter holds fewer keys than a standard one of the same
+  // size to reach the same false positive rate.
+  int n_keys = bfb.expected_count();
+  ASSERT_LT(n_keys, sizing.expected_count());
+  ASSERT_GT(n_keys, sizing.expected_count() / 2);
+  double expected_fp_rate = bfb.false_positive_rate();
+  ASSERT_LE(expected_fp_rate, 0.01);
+  ASSERT_GT(BlockedBloomFilter::FalsePositiveRate(bfb.n_bytes(), n_keys + 1), 0.01);
+
+  srandom(kRandomSeed);
+  for (int i = 0; i < n_keys; i++) {
+    uint64_t key = random();
+    bfb.AddKey(BloomKeyProbe(Slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key))));
+  }
+  ASSERT_EQ(n_keys, bfb.count());
+
+  // Every inserted key is found.
+  BlockedBloomFilter bf(bfb.slice());
+  srandom(kRandomSeed);
+  for (int i = 0; i < n_keys; i++) {
+    uint64_t key = random();
+    ASSERT_TRUE(bf.MayContainKey(
+        BloomKeyProbe(Slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key)))));
+  }
+
+  uint32_t num_queries = 100000;
+  uint32_t num_positives = 0;
+  for (int i = 0; i < num_queries; i++) {
+    uint64_t key = random();
+    if (bf.MayContainKey(
+            BloomKeyProbe(Slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key))))) {
+      num_positives++;
+    }
+  }
+  double fp_rate = static_cast<double>(num_positives) / static_cast<double>(num_queries);
+  LOG(INFO) << "FP rate: " << fp_rate << " (" << num_positives << "/" << num_queries << ")";
+  LOG(INFO) << "Expected FP rate: " << expected_fp_rate;
+  ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
+
+  // Clearing the filter removes every key.
+  bfb.Clear();
+  ASSERT_EQ(0, bfb.count());
+  uint64_t key = 12345;
+  ASSERT_FALSE(BlockedBloomFilter(bfb.slice()).MayContainKey(
+      BloomKeyProbe(Slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key)))));
+}
+
 } // namespace kudu
@@ -17,6 +17,8 @@
 
 #include <math.h>
 
+#include <algorithm>
+
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/bitmap.h"
 
@@ -41,7 +43,7 @@ BloomFilterSizing BloomFilterSizing::ByCountAndFPRate(
   CHECK_GT(n_bytes, 0)
     << "expected_count: " << expected_count
     << " fp_rate: " << fp_rate;
-  return BloomFilterSizing(n_bytes, expected_count);
+  return BloomFilterSizing(n_bytes, expected_count, fp_rate);
 }
 
 BloomFilterSizing BloomFilterSizing::BySizeAndFPRate(size_t n_bytes, double fp_rate) {
@@ -49,7 +51,7 @@ BloomFilterSizing BloomFilterSizing::BySizeAndFPRate(size_t n_bytes, double fp_r
   double expected_elems = -static_cast<double>(n_bits) * kNaturalLog2 * kNaturalLog2 /
     log(fp_rate);
   DCHECK_GT(expected_elems, 1);
-  return BloomFilterSizing(n_bytes, (size_t)ceil(expected_elems));
+  return BloomFilterSizing(n_bytes, (size_t)ceil(expected_elems), fp_rate);
 }
 
 
@@ -81,6 +83,61 @@ BloomFilter::BloomFilter(const Slice &data, size_t n_hashes)
     n_hashes_(n_hashes)
 {}
 
+BlockedBloomFilter::BlockedBloomFilter(const Slice &data)
+  : buckets_(data.data()),
+    n_buckets_(data.size() / kBucketBytes) {
+  DCHECK_GT(n_buckets_, 0);
+  DCHECK_EQ(data.size() % kBucketBytes, 0);
+}
+
+double BlockedBloomFilter::FalsePositiveRate(size_t n_bytes, size_t count) {
+  // The number of keys in a bucket follows a Poisson distribution. A bucket
+  // holding j keys reports a false positive if each of its words has the
+  // probed bit set by one of them.
+  size_t n_buckets = n_bytes / kBucketBytes;
+  double keys_per_bucket = static_cast<double>(count) / n_buckets;
+  double word_bits = kBucketBytes * 8 / kNumHashes;
+  double p_keys = exp(-keys_per_bucket);
+  double rate = 0;
+  for (int j = 0; j < 10 * (keys_per_bucket + 1); j++) {
+    rate += p_keys * pow(1 - pow(1 - 1 / word_bits, j), kNumHashes);
+    p_keys *= keys_per_bucket / (j + 1);
+  }
+  return rate;
+}
+
+BlockedBloomFilterBuilder::BlockedBloomFilterBuilder(const BloomFilterSizing &sizing)
+  : n_buckets_(std::max<size_t>(sizing.n_bytes() / BlockedBloomFilter::kBucketBytes, 1)),
+    bitmap_(new uint8_t[n_buckets_ * BlockedBloomFilter::kBucketBytes]),
+    n_inserted_(0) {
+  CHECK_GT(sizing.fp_rate(), 0);
+  CHECK_LT(sizing.fp_rate(), 1);
+
+  // Find the largest number of keys which keeps the false positive rate at
+  // or below the target, which grows with the number of keys.
+  size_t lo = 1;
+  size_t hi = n_bytes() * 8;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo + 1) / 2;
+    if (BlockedBloomFilter::FalsePositiveRate(n_bytes(), mid) <= sizing.fp_rate()) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  expected_count_ = lo;
+  Clear();
+}
+
+void BlockedBloomFilterBuilder::Clear() {
+  memset(&bitmap_[0], 0, n_bytes());
+  n_inserted_ = 0;
+}
+
+double BlockedBloomFilterBuilder::false_positive_rate() const {
+  return BlockedBloomFilter::FalsePositiveRate(n_bytes(), expected_count_);
+}
+
 
 
 } // namespace kudu
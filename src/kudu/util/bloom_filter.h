@@ -17,6 +17,10 @@
 #ifndef KUDU_UTIL_BLOOM_FILTER_H
 #define KUDU_UTIL_BLOOM_FILTER_H
 
+#include <smmintrin.h>
+
+#include <cstdint>
+
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/macros.h"
@@ -73,6 +77,12 @@ class BloomKeyProbe {
     return h + h_2_;
   }
 
+  // The second of the two hash values. BlockedBloomFilter uses the first to
+  // pick a bucket and this one to pick the bits within it.
+  uint32_t second_hash() const {
+    return h_2_;
+  }
+
  private:
   Slice key_;
 
@@ -99,14 +109,19 @@ class BloomFilterSizing {
   size_t n_bytes() const { return n_bytes_; }
   size_t expected_count() const { return expected_count_; }
 
+  // The target false positive rate.
+  double fp_rate() const { return fp_rate_; }
+
  private:
-  BloomFilterSizing(size_t n_bytes, size_t expected_count) :
+  BloomFilterSizing(size_t n_bytes, size_t expected_count, double fp_rate) :
     n_bytes_(n_bytes),
-    expected_count_(expected_count)
+    expected_count_(expected_count),
+    fp_rate_(fp_rate)
   {}
 
   size_t n_bytes_;
   size_t expected_count_;
+  double fp_rate_;
 };
 
 
@@ -174,6 +189,11 @@ class BloomFilter {
   // Return true if the filter may contain the given key.
   bool MayContainKey(const BloomKeyProbe &probe) const;
 
+  // Return the filter's bitmap, in the format of BloomFilterBuilder::slice().
+  Slice data() const { return Slice(bitmap_, n_bits_ / 8); }
+
+  size_t n_hashes() const { return n_hashes_; }
+
  private:
   friend class BloomFilterBuilder;
   static uint32_t PickBit(uint32_t hash, size_t n_bits);
@@ -185,6 +205,95 @@ class BloomFilter {
 };
 
 
+// A bloom filter in which all of a key's bits fall within a single 32-byte
+// bucket, so that probing a key touches one cache line rather than one per
+// hash function.
+//
+// This uses the "split block" layout: each bucket is eight 32-bit words, and
+// a key sets one bit in each of them. The key's first hash picks the bucket,
+// and the bit within each word is picked by multiplying its second hash by a
+// different odd constant per word. All eight words are tested at once with
+// SSE instructions. For a given size, the false positive rate is somewhat
+// higher than that of BloomFilter, so BlockedBloomFilterBuilder holds fewer
+// keys to reach the same target rate.
+//
+// See "Cache-, Hash- and Space-Efficient Bloom Filters", Putze et al, 2007.
+class BlockedBloomFilter {
+ public:
+  // The size of a bucket, in bytes.
+  static const size_t kBucketBytes = 32;
+
+  // The number of bits set for each key.
+  static const size_t kNumHashes = 8;
+
+  // 'data' must be a non-empty multiple of kBucketBytes.
+  explicit BlockedBloomFilter(const Slice &data);
+
+  // Return true if the filter may contain the given key.
+  bool MayContainKey(const BloomKeyProbe &probe) const;
+
+  // Return the expected false positive rate of a filter of 'n_bytes' bytes
+  // holding 'count' keys.
+  static double FalsePositiveRate(size_t n_bytes, size_t count);
+
+ private:
+  friend class BlockedBloomFilterBuilder;
+
+  // Return the index of the bucket for 'probe' among 'n_buckets'.
+  static size_t PickBucket(const BloomKeyProbe &probe, size_t n_buckets);
+
+  // Compute the bits to set in each half of a bucket for 'probe'.
+  static void BucketMask(const BloomKeyProbe &probe, __m128i *lo, __m128i *hi);
+
+  const uint8_t *buckets_;
+  size_t n_buckets_;
+};
+
+// Builder for a BlockedBloomFilter.
+class BlockedBloomFilterBuilder {
+ public:
+  // Create a filter of sizing.n_bytes() bytes, rounded down to a multiple
+  // of the bucket size, expecting as many keys as it can hold while
+  // keeping the false positive rate at or below sizing.fp_rate().
+  explicit BlockedBloomFilterBuilder(const BloomFilterSizing &sizing);
+
+  // Clear all entries, reset insertion count.
+  void Clear();
+
+  // Add the given key to the bloom filter.
+  void AddKey(const BloomKeyProbe &probe);
+
+  // Return an estimate of the false positive rate.
+  double false_positive_rate() const;
+
+  int n_bytes() const {
+    return n_buckets_ * BlockedBloomFilter::kBucketBytes;
+  }
+
+  // Return a slice view into this filter, suitable for writing out to a file.
+  const Slice slice() const {
+    return Slice(&bitmap_[0], n_bytes());
+  }
+
+  size_t expected_count() const { return expected_count_; }
+
+  // Return the number of keys inserted.
+  size_t count() const { return n_inserted_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BlockedBloomFilterBuilder);
+
+  size_t n_buckets_;
+  gscoped_array<uint8_t> bitmap_;
+
+  // The number of keys the filter can hold at the target false positive rate.
+  size_t expected_count_;
+
+  // The number of elements inserted so far since the last Reset.
+  size_t n_inserted_;
+};
+
+
 ////////////////////////////////////////////////////////////
 // Inline implementations
 ////////////////////////////////////////////////////////////
@@ -243,6 +352,52 @@ inline bool BloomFilter::MayContainKey(const BloomKeyProbe &probe) const {
   return true;
 }
 
+inline size_t BlockedBloomFilter::PickBucket(const BloomKeyProbe &probe, size_t n_buckets) {
+  // Map the hash onto [0, n_buckets) with a multiply and shift rather than
+  // a division.
+  return (static_cast<uint64_t>(probe.initial_hash()) * n_buckets) >> 32;
+}
+
+inline void BlockedBloomFilter::BucketMask(const BloomKeyProbe &probe,
+                                           __m128i *lo, __m128i *hi) {
+  const __m128i salt_lo = _mm_setr_epi32(0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d);
+  const __m128i salt_hi = _mm_setr_epi32(0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31);
+  const __m128i h = _mm_set1_epi32(probe.second_hash());
+
+  // The top 5 bits of each product pick the bit within its word. SSE has no
+  // per-lane variable shift, so compute 1 << n as the float 2^n, by placing
+  // n + 127 in the exponent, and convert it back to an integer. 2^31 is out
+  // of range and converts to 0x80000000, which happens to be the right bit.
+  const __m128i bias = _mm_set1_epi32(127);
+  __m128i bits_lo = _mm_srli_epi32(_mm_mullo_epi32(h, salt_lo), 27);
+  __m128i bits_hi = _mm_srli_epi32(_mm_mullo_epi32(h, salt_hi), 27);
+  *lo = _mm_cvttps_epi32(_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(bits_lo, bias), 23)));
+  *hi = _mm_cvttps_epi32(_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(bits_hi, bias), 23)));
+}
+
+inline void BlockedBloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
+  uint8_t *bucket = &bitmap_[BlockedBloomFilter::PickBucket(probe, n_buckets_) *
+                             BlockedBloomFilter::kBucketBytes];
+  __m128i mask_lo, mask_hi;
+  BlockedBloomFilter::BucketMask(probe, &mask_lo, &mask_hi);
+  __m128i *lo = reinterpret_cast<__m128i *>(bucket);
+  __m128i *hi = reinterpret_cast<__m128i *>(bucket + 16);
+  _mm_storeu_si128(lo, _mm_or_si128(_mm_loadu_si128(lo), mask_lo));
+  _mm_storeu_si128(hi, _mm_or_si128(_mm_loadu_si128(hi), mask_hi));
+  n_inserted_++;
+}
+
+inline bool BlockedBloomFilter::MayContainKey(const BloomKeyProbe &probe) const {
+  const uint8_t *bucket = buckets_ + PickBucket(probe, n_buckets_) * kBucketBytes;
+  __m128i mask_lo, mask_hi;
+  BucketMask(probe, &mask_lo, &mask_hi);
+  // _mm_testc_si128(a, b) is set if every bit of 'b' is set in 'a'.
+  return _mm_testc_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bucket)),
+                         mask_lo) &&
+         _mm_testc_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bucket + 16)),
+                         mask_hi);
+}
+
 } // namespace kudu
 
 #endif
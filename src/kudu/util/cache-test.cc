@@ -6,18 +6,32 @@
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <memory>
-
+#include <thread>
 #include <vector>
+
+#include "kudu/gutil/casts.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/random.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(cache_force_single_shard);
+DECLARE_double(cache_high_priority_ratio);
 #if defined(__linux__)
 DECLARE_string(nvm_cache_path);
 #endif // defined(__linux__)
 
+DEFINE_int32(cache_bench_lookups_per_thread, 200000,
+             "Number of lookups done by each thread in TestConcurrentLookupScaling");
+
+METRIC_DECLARE_counter(block_cache_high_priority_hits);
+METRIC_DECLARE_gauge_uint64(block_cache_high_priority_usage);
+
 namespace kudu {
 
 // Conversions between numeric keys/values and the types expected by Cache.
@@ -87,7 +101,7 @@ class CacheTest : public KuduTest,
     Cache::PendingHandle* handle = CHECK_NOTNULL(cache_->Allocate(key_str, val_str.size(), charge));
     memcpy(cache_->MutableValue(handle), val_str.data(), val_str.size());
 
-    cache_->Release(cache_->Insert(handle, this));
+    cache_->Release(cache_->Insert(handle, this, Cache::NORMAL_PRIORITY));
   }
 
   void Erase(int key) {
@@ -231,4 +245,192 @@ TEST_P(CacheTest, NewId) {
   ASSERT_NE(a, b);
 }
 
+// Looks up keys from a mix of point lookups over a small set of hot keys and
+// large scans over keys which are never read again, inserting each key which
+// misses, and returns the fraction of the lookups of hot keys which hit.
+static double HotHitRate(Cache* cache, int capacity) {
+  const int kNumHotKeys = capacity / 2;
+  const int kScanLength = capacity * 2;
+  Random rng(SeedRandom());
+  int next_cold_key = kNumHotKeys;
+  int hot_lookups = 0;
+  int hot_hits = 0;
+
+  auto lookup_or_insert = [&] (int key) {
+    string key_str = EncodeInt(key);
+    Cache::Handle* h = cache->Lookup(key_str, Cache::EXPECT_IN_CACHE);
+    if (h != nullptr) {
+      cache->Release(h);
+      return true;
+    }
+    Cache::PendingHandle* pending = CHECK_NOTNULL(cache->Allocate(key_str, key_str.size(), 1));
+    memcpy(cache->MutableValue(pending), key_str.data(), key_str.size());
+    cache->Release(cache->Insert(pending, nullptr, Cache::NORMAL_PRIORITY));
+    return false;
+  };
+
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < capacity * 4; i++) {
+      hot_lookups++;
+      hot_hits += lookup_or_insert(rng.Uniform(kNumHotKeys));
+    }
+    for (int i = 0; i < kScanLength; i++) {
+      lookup_or_insert(next_cold_key++);
+    }
+  }
+  return static_cast<double>(hot_hits) / hot_lookups;
+}
+
+class CacheEvictionPolicyTest : public KuduTest {
+};
+
+// Test that a segmented LRU cache keeps frequently used entries through scans
+// which would flush them from an LRU cache, and compare the hit rates.
+TEST_F(CacheEvictionPolicyTest, TestScanResistance) {
+  FLAGS_cache_force_single_shard = true;
+  const int kCapacity = 1000;
+
+  gscoped_ptr<Cache> lru(NewLRUCache(DRAM_CACHE, kCapacity, "lru_scan_test"));
+  double lru_hit_rate = HotHitRate(lru.get(), kCapacity);
+  gscoped_ptr<Cache> slru(NewSLRUCache(kCapacity, "slru_scan_test"));
+  double slru_hit_rate = HotHitRate(slru.get(), kCapacity);
+
+  LOG(INFO) << "Hit rate of hot keys with LRU eviction: " << lru_hit_rate;
+  LOG(INFO) << "Hit rate of hot keys with SLRU eviction: " << slru_hit_rate;
+  ASSERT_GT(slru_hit_rate, lru_hit_rate);
+  // Only the first lookups of each hot key should miss.
+  ASSERT_GT(slru_hit_rate, 0.95);
+}
+
+// Test that entries of a segmented LRU cache which are looked up are kept over
+// ones which are inserted later but never looked up.
+TEST_F(CacheEvictionPolicyTest, TestSLRUPromotion) {
+  FLAGS_cache_force_single_shard = true;
+  gscoped_ptr<Cache> cache(NewSLRUCache(10, "slru_promotion_test"));
+  auto insert = [&] (int key) {
+    string key_str = EncodeInt(key);
+    Cache::PendingHandle* pending = CHECK_NOTNULL(cache->Allocate(key_str, key_str.size(), 1));
+    memcpy(cache->MutableValue(pending), key_str.data(), key_str.size());
+    cache->Release(cache->Insert(pending, nullptr, Cache::NORMAL_PRIORITY));
+  };
+  auto contains = [&] (int key) {
+    Cache::Handle* h = cache->Lookup(EncodeInt(key), Cache::EXPECT_IN_CACHE);
+    if (h == nullptr) return false;
+    cache->Release(h);
+    return true;
+  };
+
+  for (int i = 0; i < 5; i++) {
+    insert(i);
+    ASSERT_TRUE(contains(i));
+  }
+  // Fill the cache several times over with entries which are never looked up.
+  for (int i = 100; i < 200; i++) {
+    insert(i);
+  }
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(contains(i)) << i;
+  }
+}
+
+// Test that high priority entries are kept over normal priority ones, up to
+// the capacity reserved for them.
+TEST_F(CacheEvictionPolicyTest, TestHighPriority) {
+  FLAGS_cache_force_single_shard = true;
+  FLAGS_cache_high_priority_ratio = 0.5;
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  gscoped_ptr<Cache> cache(NewLRUCache(DRAM_CACHE, 10, "high_priority_test"));
+  cache->SetMetrics(entity);
+  auto insert = [&] (int key, Cache::Priority priority) {
+    string key_str = EncodeInt(key);
+    Cache::PendingHandle* pending = CHECK_NOTNULL(cache->Allocate(key_str, key_str.size(), 1));
+    memcpy(cache->MutableValue(pending), key_str.data(), key_str.size());
+    cache->Release(cache->Insert(pending, nullptr, priority));
+  };
+  auto contains = [&] (int key) {
+    Cache::Handle* h = cache->Lookup(EncodeInt(key), Cache::EXPECT_IN_CACHE);
+    if (h == nullptr) return false;
+    cache->Release(h);
+    return true;
+  };
+
+  // More high priority entries than fit in their segment: the oldest ones
+  // are treated as normal priority.
+  for (int i = 0; i < 7; i++) {
+    insert(i, Cache::HIGH_PRIORITY);
+  }
+  ASSERT_EQ(7, down_cast<AtomicGauge<uint64_t>*>(
+      entity->FindOrNull(METRIC_block_cache_high_priority_usage).get())->value());
+
+  // Flush the cache with normal priority entries which are used more recently.
+  for (int i = 100; i < 200; i++) {
+    insert(i, Cache::NORMAL_PRIORITY);
+  }
+  for (int i = 0; i < 2; i++) {
+    ASSERT_FALSE(contains(i)) << i;
+  }
+  for (int i = 2; i < 7; i++) {
+    ASSERT_TRUE(contains(i)) << i;
+  }
+  ASSERT_EQ(5, down_cast<Counter*>(
+      entity->FindOrNull(METRIC_block_cache_high_priority_hits).get())->value());
+  ASSERT_EQ(5, down_cast<AtomicGauge<uint64_t>*>(
+      entity->FindOrNull(METRIC_block_cache_high_priority_usage).get())->value());
+}
+
+class CacheConcurrencyTest : public KuduTest {};
+
+// Measures the throughput of concurrent lookups which hit, with increasing
+// numbers of threads. Since lookups only take their shard's lock in shared
+// mode, the throughput should scale with the number of threads. Without slow
+// tests, only a few lookups are done to check that they all hit.
+TEST_F(CacheConcurrencyTest, TestConcurrentLookupScaling) {
+  const int kNumKeys = 1000;
+  const int lookups_per_thread =
+      AllowSlowTests() ? FLAGS_cache_bench_lookups_per_thread : 1000;
+  gscoped_ptr<Cache> cache(NewLRUCache(DRAM_CACHE, kNumKeys * 2, "lookup_scaling_test"));
+  std::vector<string> keys;
+  for (int i = 0; i < kNumKeys; i++) {
+    keys.push_back(EncodeInt(i));
+    Cache::PendingHandle* pending = CHECK_NOTNULL(cache->Allocate(keys.back(), 4, 1));
+    memcpy(cache->MutableValue(pending), keys.back().data(), 4);
+    cache->Release(cache->Insert(pending, nullptr, Cache::NORMAL_PRIORITY));
+  }
+
+  for (int num_threads = 1; num_threads <= base::NumCPUs(); num_threads *= 2) {
+    std::vector<std::thread> threads;
+    std::vector<int> hits(num_threads);
+    Stopwatch sw;
+    sw.start();
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] () {
+        Random rng(t);
+        int thread_hits = 0;
+        for (int i = 0; i < lookups_per_thread; i++) {
+          int key = rng.Uniform(kNumKeys);
+          Cache::Handle* h = cache->Lookup(keys[key], Cache::EXPECT_IN_CACHE);
+          if (h == nullptr) continue;
+          if (DecodeInt(cache->Value(h)) == key) {
+            thread_hits++;
+          }
+          cache->Release(h);
+        }
+        hits[t] = thread_hits;
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    sw.stop();
+    for (int t = 0; t < num_threads; t++) {
+      ASSERT_EQ(lookups_per_thread, hits[t]) << "thread " << t;
+    }
+    LOG(INFO) << strings::Substitute(
+        "$0 threads: $1 lookups/sec", num_threads,
+        static_cast<int64_t>(num_threads * lookups_per_thread /
+                             sw.elapsed().wall_seconds()));
+  }
+}
+
 }  // namespace kudu
@@ -35,6 +35,17 @@ DEFINE_bool(cache_force_single_shard, false,
             "Override all cache implementations to use just one shard");
 TAG_FLAG(cache_force_single_shard, hidden);
 
+DEFINE_double(cache_slru_protected_ratio, 0.8,
+              "The fraction of the capacity of a segmented LRU cache which is "
+              "reserved for entries which have been looked up since they were "
+              "inserted. The remainder holds newly inserted entries.");
+TAG_FLAG(cache_slru_protected_ratio, experimental);
+
+DEFINE_double(cache_high_priority_ratio, 0.5,
+              "The fraction of the capacity of a cache which is reserved for "
+              "high priority entries, such as CFile index and bloom filter blocks.");
+TAG_FLAG(cache_high_priority_ratio, experimental);
+
 namespace kudu {
 
 class MetricEntity;
@@ -51,6 +62,18 @@ typedef simple_spinlock MutexType;
 
 // LRU cache implementation
 
+// The segments of a cache shard, in the order that entries are evicted from
+// them. Each segment is an LRU list.
+enum Segment : uint8_t {
+  // Newly inserted entries.
+  PROBATIONARY,
+  // Entries of a segmented LRU cache which have been looked up since they
+  // were inserted.
+  PROTECTED,
+  // High priority entries.
+  HIGH_PRIORITY
+};
+
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
 struct LRUHandle {
@@ -63,6 +86,11 @@ struct LRUHandle {
   uint32_t val_length;
   Atomic32 refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  Segment segment;    // The segment whose list the entry is in
+  bool high_priority;
+  // Set when the entry is looked up, and cleared when it's (re)placed in a
+  // segment. See LRUCache::Lookup().
+  Atomic32 referenced;
 
   // The storage for the key/value pair itself. The data is stored as:
   //   [key bytes ...] [padding up to 8-byte boundary] [value bytes ...]
@@ -181,9 +209,21 @@ class LRUCache {
   // Separate from constructor so caller can easily make an array of LRUCache
   void SetCapacity(size_t capacity) { capacity_ = capacity; }
 
+  // Sets the capacity of the protected segment, which must be no larger than
+  // the total capacity. If 0, the default, entries are never protected and
+  // the cache is a plain LRU cache.
+  void SetProtectedCapacity(size_t capacity) { capacity_by_segment_[PROTECTED] = capacity; }
+
+  // Sets the capacity of the high priority segment, which must be no larger
+  // than the total capacity. If 0, the default, priorities are ignored.
+  void SetHighPriorityCapacity(size_t capacity) {
+    capacity_by_segment_[HIGH_PRIORITY] = capacity;
+  }
+
   void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
 
-  Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
+  Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback,
+                        Cache::Priority priority);
   // Like Cache::Lookup, but with an extra "hash" parameter.
   Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
   void Release(Cache::Handle* handle);
@@ -191,7 +231,24 @@ class LRUCache {
 
  private:
   void LRU_Remove(LRUHandle* e);
-  void LRU_Append(LRUHandle* e);
+  // Make 'e' the newest entry of 'segment'. If that overflows the segment's
+  // capacity, its oldest entries are moved into the probationary segment,
+  // unless they've been referenced since they were placed.
+  void LRU_Append(LRUHandle* e, Segment segment);
+  // Make 'e' the newest entry of 'segment', without checking its capacity.
+  void LRU_Link(LRUHandle* e, Segment segment);
+  // Returns the segment that 'e' moves to once it's found to have been
+  // referenced.
+  Segment SegmentForReferenced(const LRUHandle* e) const {
+    if (e->high_priority && FitsIn(e, HIGH_PRIORITY)) {
+      return HIGH_PRIORITY;
+    }
+    return FitsIn(e, PROTECTED) ? PROTECTED : PROBATIONARY;
+  }
+  // Returns whether 'e' fits in 'segment'.
+  bool FitsIn(const LRUHandle* e, Segment segment) const {
+    return capacity_by_segment_[segment] > 0 && e->charge <= capacity_by_segment_[segment];
+  }
   // Just reduce the reference count by 1.
   // Return true if last reference
   bool Unref(LRUHandle* e);
@@ -201,13 +258,21 @@ class LRUCache {
   // Initialized before use.
   size_t capacity_;
 
-  // mutex_ protects the following state.
-  MutexType mutex_;
+  // The capacity of each segment. That of the probationary segment is unused,
+  // since it's only limited by the total capacity.
+  size_t capacity_by_segment_[3];
+
+  // mutex_ protects the following state. Lookups only take it in shared mode,
+  // since they don't modify it.
+  rw_spinlock mutex_;
   size_t usage_;
+  size_t usage_by_segment_[3];
 
-  // Dummy head of LRU list.
+  // Dummy heads of the LRU lists of each segment. The probationary segment
+  // holds every entry unless the cache is segmented or has high priority
+  // entries.
   // lru.prev is newest entry, lru.next is oldest entry.
-  LRUHandle lru_;
+  LRUHandle lru_[3];
 
   HandleTable table_;
 
@@ -220,19 +285,25 @@ LRUCache::LRUCache(MemTracker* tracker)
  : usage_(0),
    mem_tracker_(tracker),
    metrics_(nullptr) {
-  // Make empty circular linked list
-  lru_.next = &lru_;
-  lru_.prev = &lru_;
+  for (size_t s = 0; s < arraysize(lru_); s++) {
+    capacity_by_segment_[s] = 0;
+    usage_by_segment_[s] = 0;
+    // Make empty circular linked list
+    lru_[s].next = &lru_[s];
+    lru_[s].prev = &lru_[s];
+  }
 }
 
 LRUCache::~LRUCache() {
-  for (LRUHandle* e = lru_.next; e != &lru_; ) {
-    LRUHandle* next = e->next;
-    DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
-    if (Unref(e)) {
-      FreeEntry(e);
+  for (LRUHandle& head : lru_) {
+    for (LRUHandle* e = head.next; e != &head; ) {
+      LRUHandle* next = e->next;
+      DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
+      if (Unref(e)) {
+        FreeEntry(e);
+      }
+      e = next;
     }
-    e = next;
   }
 }
 
@@ -249,6 +320,9 @@ void LRUCache::FreeEntry(LRUHandle* e) {
   mem_tracker_->Release(e->charge);
   if (PREDICT_TRUE(metrics_)) {
     metrics_->cache_usage->DecrementBy(e->charge);
+    if (e->high_priority) {
+      metrics_->high_priority_usage->DecrementBy(e->charge);
+    }
     metrics_->evictions->Increment();
   }
   delete [] e;
@@ -258,26 +332,53 @@ void LRUCache::LRU_Remove(LRUHandle* e) {
   e->next->prev = e->prev;
   e->prev->next = e->next;
   usage_ -= e->charge;
+  usage_by_segment_[e->segment] -= e->charge;
 }
 
-void LRUCache::LRU_Append(LRUHandle* e) {
-  // Make "e" newest entry by inserting just before lru_
-  e->next = &lru_;
-  e->prev = lru_.prev;
+void LRUCache::LRU_Link(LRUHandle* e, Segment segment) {
+  // Make "e" newest entry by inserting just before the list head
+  LRUHandle* head = &lru_[segment];
+  e->next = head;
+  e->prev = head->prev;
   e->prev->next = e;
   e->next->prev = e;
+  e->segment = segment;
+  base::subtle::NoBarrier_Store(&e->referenced, 0);
   usage_ += e->charge;
+  usage_by_segment_[segment] += e->charge;
+}
+
+void LRUCache::LRU_Append(LRUHandle* e, Segment segment) {
+  LRU_Link(e, segment);
+
+  // Demoted entries get another chance in the probationary segment before
+  // they're evicted. Entries which were referenced stay in the segment. Each
+  // pass clears their flag, so this terminates.
+  if (segment != PROBATIONARY) {
+    LRUHandle* head = &lru_[segment];
+    while (usage_by_segment_[segment] > capacity_by_segment_[segment]) {
+      LRUHandle* old = head->next;
+      LRU_Remove(old);
+      LRU_Link(old, base::subtle::NoBarrier_Load(&old->referenced) ? segment : PROBATIONARY);
+    }
+  }
 }
 
 Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
   LRUHandle* e;
   {
-    std::lock_guard<MutexType> l(mutex_);
+    // Rather than moving the entry to the head of its LRU list, which would
+    // need the lock in exclusive mode, only flag it as referenced. Referenced
+    // entries are moved when they reach the tail of their list (CLOCK-style),
+    // which happens under the exclusive lock taken by Insert().
+    shared_lock<rw_spinlock> l(mutex_);
     e = table_.Lookup(key, hash);
     if (e != nullptr) {
       base::RefCountInc(&e->refs);
-      LRU_Remove(e);
-      LRU_Append(e);
+      // Avoid dirtying the cache line of entries which are already flagged.
+      if (!base::subtle::NoBarrier_Load(&e->referenced)) {
+        base::subtle::NoBarrier_Store(&e->referenced, 1);
+      }
     }
   }
 
@@ -285,6 +386,9 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
   if (metrics_) {
     metrics_->lookups->Increment();
     bool was_hit = (e != nullptr);
+    if (was_hit && e->high_priority) {
+      metrics_->high_priority_hits->Increment();
+    }
     if (was_hit) {
       if (caching) {
         metrics_->cache_hits_caching->Increment();
@@ -311,23 +415,28 @@ void LRUCache::Release(Cache::Handle* handle) {
   }
 }
 
-Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_callback) {
+Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_callback,
+                                Cache::Priority priority) {
 
   // Set the remaining LRUHandle members which were not already allocated during
   // Allocate().
   e->eviction_callback = eviction_callback;
   e->refs = 2;  // One from LRUCache, one for the returned handle
+  e->high_priority = priority == Cache::HIGH_PRIORITY;
   mem_tracker_->Consume(e->charge);
   if (PREDICT_TRUE(metrics_)) {
     metrics_->cache_usage->IncrementBy(e->charge);
+    if (e->high_priority) {
+      metrics_->high_priority_usage->IncrementBy(e->charge);
+    }
     metrics_->inserts->Increment();
   }
 
   LRUHandle* to_remove_head = nullptr;
   {
-    std::lock_guard<MutexType> l(mutex_);
+    std::lock_guard<rw_spinlock> l(mutex_);
 
-    LRU_Append(e);
+    LRU_Append(e, e->high_priority && FitsIn(e, HIGH_PRIORITY) ? HIGH_PRIORITY : PROBATIONARY);
 
     LRUHandle* old = table_.Insert(e);
     if (old != nullptr) {
@@ -338,9 +447,23 @@ Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_
       }
     }
 
-    while (usage_ > capacity_ && lru_.next != &lru_) {
-      LRUHandle* old = lru_.next;
+    // Entries are evicted from the probationary segment first, and from the
+    // high priority segment last. Referenced entries are moved instead of
+    // being evicted, and their flag is cleared, so this terminates.
+    while (usage_ > capacity_) {
+      int segment = PROBATIONARY;
+      while (segment <= HIGH_PRIORITY && lru_[segment].next == &lru_[segment]) {
+        segment++;
+      }
+      if (segment > HIGH_PRIORITY) {
+        break;
+      }
+      LRUHandle* old = lru_[segment].next;
       LRU_Remove(old);
+      if (base::subtle::NoBarrier_Load(&old->referenced)) {
+        LRU_Append(old, SegmentForReferenced(old));
+        continue;
+      }
       table_.Remove(old->key(), old->hash);
       if (Unref(old)) {
         old->next = to_remove_head;
@@ -364,7 +487,7 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   LRUHandle* e;
   bool last_reference = false;
   {
-    std::lock_guard<MutexType> l(mutex_);
+    std::lock_guard<rw_spinlock> l(mutex_);
     e = table_.Remove(key, hash);
     if (e != nullptr) {
       LRU_Remove(e);
@@ -378,6 +501,12 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   }
 }
 
+double HighPriorityRatio() {
+  CHECK(FLAGS_cache_high_priority_ratio >= 0 && FLAGS_cache_high_priority_ratio <= 1)
+      << "--cache_high_priority_ratio must be between 0 and 1";
+  return FLAGS_cache_high_priority_ratio;
+}
+
 // Determine the number of bits of the hash that should be used to determine
 // the cache shard. This, in turn, determines the number of shards.
 int DetermineShardBits() {
@@ -410,7 +539,11 @@ class ShardedLRUCache : public Cache {
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity, const string& id)
+  // 'protected_ratio' is the fraction of the capacity of each shard to reserve
+  // for its protected segment, or 0 for a plain LRU cache.
+  // 'high_priority_ratio' is the fraction to reserve for high priority entries.
+  ShardedLRUCache(size_t capacity, double protected_ratio, double high_priority_ratio,
+                  const string& id)
       : last_id_(0),
         shard_bits_(DetermineShardBits()) {
     // A cache is often a singleton, so:
@@ -424,6 +557,8 @@ class ShardedLRUCache : public Cache {
     for (int s = 0; s < num_shards; s++) {
       gscoped_ptr<LRUCache> shard(new LRUCache(mem_tracker_.get()));
       shard->SetCapacity(per_shard);
+      shard->SetProtectedCapacity(per_shard * protected_ratio);
+      shard->SetHighPriorityCapacity(per_shard * high_priority_ratio);
       shards_.push_back(shard.release());
     }
   }
@@ -433,9 +568,10 @@ class ShardedLRUCache : public Cache {
   }
 
   virtual Handle* Insert(PendingHandle* handle,
-                         Cache::EvictionCallback* eviction_callback) OVERRIDE {
+                         Cache::EvictionCallback* eviction_callback,
+                         Priority priority) OVERRIDE {
     LRUHandle* h = reinterpret_cast<LRUHandle*>(DCHECK_NOTNULL(handle));
-    return shards_[Shard(h->hash)]->Insert(h, eviction_callback);
+    return shards_[Shard(h->hash)]->Insert(h, eviction_callback, priority);
   }
   virtual Handle* Lookup(const Slice& key, CacheBehavior caching) OVERRIDE {
     const uint32_t hash = HashSlice(key);
@@ -499,7 +635,7 @@ class ShardedLRUCache : public Cache {
 Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
   switch (type) {
     case DRAM_CACHE:
-      return new ShardedLRUCache(capacity, id);
+      return new ShardedLRUCache(capacity, 0, HighPriorityRatio(), id);
 #if !defined(__APPLE__)
     case NVM_CACHE:
       return NewLRUNvmCache(capacity, id);
@@ -509,4 +645,11 @@ Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
   }
 }
 
+Cache* NewSLRUCache(size_t capacity, const string& id) {
+  CHECK(FLAGS_cache_slru_protected_ratio >= 0 && FLAGS_cache_slru_protected_ratio <= 1)
+      << "--cache_slru_protected_ratio must be between 0 and 1";
+  return new ShardedLRUCache(capacity, FLAGS_cache_slru_protected_ratio,
+                             HighPriorityRatio(), id);
+}
+
 }  // namespace kudu
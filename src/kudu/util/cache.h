@@ -41,6 +41,15 @@ enum CacheType {
 // of Cache uses a least-recently-used eviction policy.
 Cache* NewLRUCache(CacheType type, size_t capacity, const std::string& id);
 
+// Create a new DRAM cache with a fixed size capacity, which uses a segmented
+// LRU eviction policy: new entries are inserted into a probationary segment,
+// and are only moved into a protected segment (of a fraction of the capacity
+// set by --cache_slru_protected_ratio) when they are looked up again. Entries
+// are evicted from the probationary segment first, so entries which are only
+// used once, such as the blocks read by a large scan, can't push out entries
+// which are used repeatedly.
+Cache* NewSLRUCache(size_t capacity, const std::string& id);
+
 class Cache {
  public:
   // Callback interface which is called when an entry is evicted from the
@@ -106,6 +115,19 @@ class Cache {
     NO_EXPECT_IN_CACHE
   };
 
+  // The priority of an entry. High priority entries are kept in a segment of
+  // the cache reserved for them (of a fraction of the capacity set by
+  // --cache_high_priority_ratio), and are only evicted once the cache holds
+  // no normal priority entries. Once that segment is full, the least recently
+  // used high priority entries are treated as normal priority ones until
+  // they're looked up again.
+  //
+  // Implementations may ignore priorities.
+  enum Priority {
+    NORMAL_PRIORITY,
+    HIGH_PRIORITY
+  };
+
   // If the cache has no mapping for "key", returns NULL.
   //
   // Else return a handle that corresponds to the mapping.  The caller
@@ -155,7 +177,7 @@ class Cache {
   //     ... error handling ...
   //     return;
   //   }
-  //   Handle* h = cache_->Insert(ph, my_eviction_callback);
+  //   Handle* h = cache_->Insert(ph, my_eviction_callback, Cache::NORMAL_PRIORITY);
   //   ...
   //   cache_->Release(h);
 
@@ -193,7 +215,10 @@ class Cache {
   //
   // If 'eviction_callback' is non-NULL, then it will be called when the
   // entry is later evicted or when the cache shuts down.
-  virtual Handle* Insert(PendingHandle* pending, EvictionCallback* eviction_callback) = 0;
+  //
+  // 'priority' is the priority of the entry for as long as it's cached.
+  virtual Handle* Insert(PendingHandle* pending, EvictionCallback* eviction_callback,
+                         Priority priority) = 0;
 
   // Free 'ptr', which must have been previously allocated using 'Allocate'.
   virtual void Free(PendingHandle* ptr) = 0;
@@ -45,9 +45,19 @@ METRIC_DEFINE_counter(server, block_cache_hits_caching,
                       "Use this number instead of cache_hits when trying to determine how "
                       "efficient the cache is");
 
+METRIC_DEFINE_counter(server, block_cache_high_priority_hits,
+                      "Block Cache High Priority Hits", kudu::MetricUnit::kBlocks,
+                      "Number of lookups that found a high priority block, such as an "
+                      "index, bloom filter or dictionary block");
+
 METRIC_DEFINE_gauge_uint64(server, block_cache_usage, "Block Cache Memory Usage",
                            kudu::MetricUnit::kBytes,
                            "Memory consumed by the block cache");
+METRIC_DEFINE_gauge_uint64(server, block_cache_high_priority_usage,
+                           "Block Cache High Priority Memory Usage",
+                           kudu::MetricUnit::kBytes,
+                           "Memory consumed by high priority blocks in the block cache, "
+                           "such as index, bloom filter and dictionary blocks");
 
 namespace kudu {
 
@@ -61,7 +71,9 @@ CacheMetrics::CacheMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(cache_hits_caching, block_cache_hits_caching),
     MINIT(cache_misses, block_cache_misses),
     MINIT(cache_misses_caching, block_cache_misses_caching),
-    GINIT(cache_usage, block_cache_usage) {
+    MINIT(high_priority_hits, block_cache_high_priority_hits),
+    GINIT(cache_usage, block_cache_usage),
+    GINIT(high_priority_usage, block_cache_high_priority_usage) {
 }
 #undef MINIT
 #undef GINIT
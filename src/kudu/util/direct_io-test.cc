@@ -0,0 +1,127 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/direct_io.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/env.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+
+class DirectIOTest : public KuduTest {
+ public:
+  DirectIOTest()
+      : rng_(SeedRandom()),
+        path_(GetTestPath("file")) {
+  }
+
+ protected:
+  // Opens 'path_' with direct I/O. Sets 'supported_' to false if the test
+  // directory's filesystem doesn't support it.
+  Status OpenDirectRWFile(Env::CreateMode mode, unique_ptr<RWFile>* file) {
+    RWFileOptions opts;
+    opts.mode = mode;
+    opts.direct_io = true;
+    Status s = env_->NewRWFile(opts, path_, file);
+    if (s.IsNotSupported()) {
+      LOG(WARNING) << "Skipping test: " << s.ToString();
+      supported_ = false;
+      return Status::OK();
+    }
+    return s;
+  }
+
+  Random rng_;
+  const string path_;
+  bool supported_ = true;
+};
+
+TEST_F(DirectIOTest, TestWriteAndRead) {
+  unique_ptr<RWFile> file;
+  ASSERT_OK(OpenDirectRWFile(Env::CREATE_NON_EXISTING, &file));
+  if (!supported_) return;
+
+  // Append chunks of random sizes, flushing now and then, so that partial
+  // alignment units are written and later rewritten.
+  string expected;
+  DirectFileWriter writer(file.get(), 0, 2 * kDirectIOAlignment);
+  for (int i = 0; i < 100; i++) {
+    string chunk(rng_.Uniform(3 * kDirectIOAlignment), '\0');
+    RandomString(&chunk[0], chunk.size(), &rng_);
+    ASSERT_OK(writer.Append(chunk));
+    expected += chunk;
+    if (rng_.OneIn(10)) {
+      ASSERT_OK(writer.Flush());
+    }
+  }
+  ASSERT_OK(writer.Flush());
+  ASSERT_EQ(expected.size(), writer.bytes_appended());
+
+  // Only the padding should follow the appended data.
+  uint64_t size;
+  ASSERT_OK(file->Size(&size));
+  ASSERT_GE(size, expected.size());
+  ASSERT_LT(size, expected.size() + kDirectIOAlignment);
+  ASSERT_OK(file->Truncate(expected.size()));
+  ASSERT_OK(file->Close());
+
+  unique_ptr<RandomAccessFile> buffered;
+  ASSERT_OK(env_->NewRandomAccessFile(path_, &buffered));
+  unique_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+  Slice result;
+  ASSERT_OK(buffered->Read(0, expected.size(), &result, scratch.get()));
+  ASSERT_EQ(Slice(expected), result);
+
+  // Read unaligned ranges into several slices each.
+  RandomAccessFileOptions opts;
+  opts.direct_io = true;
+  unique_ptr<RandomAccessFile> direct;
+  ASSERT_OK(env_->NewRandomAccessFile(opts, path_, &direct));
+  for (int i = 0; i < 100; i++) {
+    uint64_t offset = rng_.Uniform(expected.size());
+    size_t length = rng_.Uniform(expected.size() - offset + 1);
+    size_t first = rng_.Uniform(length + 1);
+    vector<Slice> results = { Slice(scratch.get(), first),
+                              Slice(scratch.get() + first, length - first) };
+    ASSERT_OK(DirectReadV(direct.get(), offset, &results));
+    ASSERT_EQ(expected.substr(offset, length),
+              string(reinterpret_cast<const char*>(scratch.get()), length));
+  }
+
+  // Reads past the end of the file fail.
+  vector<Slice> results = { Slice(scratch.get(), 2) };
+  Status s = DirectReadV(direct.get(), expected.size() - 1, &results);
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+}
+
+} // namespace kudu
@@ -0,0 +1,152 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/direct_io.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/alignment.h"
+#include "kudu/util/env.h"
+#include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/slice.h"
+
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+uint8_t* AllocateAligned(size_t size) {
+  void* buf = aligned_malloc(size, kDirectIOAlignment);
+  CHECK(buf) << "failed to allocate " << size << " bytes for direct I/O";
+  return static_cast<uint8_t*>(buf);
+}
+
+} // anonymous namespace
+
+DirectFileWriter::DirectFileWriter(RWFile* file, uint64_t offset, size_t buffer_size)
+    : file_(file),
+      buffer_offset_(offset),
+      buffer_size_(buffer_size),
+      buffer_(AllocateAligned(buffer_size)),
+      buffered_(0),
+      dirty_(false),
+      bytes_appended_(0) {
+  DCHECK_EQ(0, offset % kDirectIOAlignment);
+  DCHECK_GT(buffer_size, 0U);
+  DCHECK_EQ(0, buffer_size % kDirectIOAlignment);
+}
+
+DirectFileWriter::~DirectFileWriter() {
+  aligned_free(buffer_);
+}
+
+Status DirectFileWriter::Append(const Slice& data) {
+  const uint8_t* src = data.data();
+  size_t remaining = data.size();
+  while (remaining > 0) {
+    size_t n = std::min(remaining, buffer_size_ - buffered_);
+    memcpy(buffer_ + buffered_, src, n);
+    buffered_ += n;
+    src += n;
+    remaining -= n;
+    if (buffered_ == buffer_size_) {
+      RETURN_NOT_OK(WriteBuffer(buffer_size_));
+      buffer_offset_ += buffer_size_;
+      buffered_ = 0;
+    }
+  }
+  bytes_appended_ += data.size();
+  dirty_ = true;
+  return Status::OK();
+}
+
+Status DirectFileWriter::Flush() {
+  if (!dirty_) {
+    return Status::OK();
+  }
+  if (buffered_ > 0) {
+    size_t padded = KUDU_ALIGN_UP(buffered_, kDirectIOAlignment);
+    memset(buffer_ + buffered_, 0, padded - buffered_);
+    RETURN_NOT_OK(WriteBuffer(padded));
+
+    // Keep the last partial unit, which must be written again along with the
+    // data which completes it.
+    size_t complete = KUDU_ALIGN_DOWN(buffered_, kDirectIOAlignment);
+    size_t partial = buffered_ - complete;
+    if (partial > 0 && complete > 0) {
+      memmove(buffer_, buffer_ + complete, partial);
+    }
+    buffer_offset_ += complete;
+    buffered_ = partial;
+  }
+  dirty_ = false;
+  return Status::OK();
+}
+
+Status DirectFileWriter::WriteBuffer(size_t length) {
+  DCHECK_EQ(0, length % kDirectIOAlignment);
+  return file_->Write(buffer_offset_, Slice(buffer_, length));
+}
+
+Status DirectReadV(const RandomAccessFile* file, uint64_t offset,
+                   vector<Slice>* results) {
+  size_t length = 0;
+  for (const Slice& result : *results) {
+    length += result.size();
+  }
+  if (length == 0) {
+    return Status::OK();
+  }
+
+  uint64_t start = KUDU_ALIGN_DOWN(offset, kDirectIOAlignment);
+  uint64_t end = KUDU_ALIGN_UP(offset + length, kDirectIOAlignment);
+  size_t buf_len = end - start;
+  uint8_t* buf = AllocateAligned(buf_len);
+  auto cleanup = MakeScopedCleanup([&]() { aligned_free(buf); });
+
+  // The aligned range may extend past the end of the file, so only the
+  // requested bytes need to be read. A short read which isn't aligned can
+  // only be at the end of the file.
+  size_t needed = offset + length - start;
+  size_t have = 0;
+  while (have < needed) {
+    Slice chunk;
+    RETURN_NOT_OK(file->Read(start + have, buf_len - have, &chunk, buf + have));
+    have += chunk.size();
+    if (chunk.empty() || (have < needed && have % kDirectIOAlignment != 0)) {
+      return Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
+                                        length, offset),
+                             file->filename());
+    }
+  }
+
+  const uint8_t* src = buf + (offset - start);
+  for (Slice& result : *results) {
+    memcpy(result.mutable_data(), src, result.size());
+    src += result.size();
+  }
+  return Status::OK();
+}
+
+} // namespace kudu
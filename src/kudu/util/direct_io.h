@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Helpers for reading and writing files opened with direct I/O (see
+// RWFileOptions::direct_io), which requires the buffers, file offsets and
+// lengths of every request to be aligned.
+#ifndef KUDU_UTIL_DIRECT_IO_H
+#define KUDU_UTIL_DIRECT_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class RWFile;
+class RandomAccessFile;
+class Slice;
+
+// The alignment of the buffers, offsets and lengths of direct I/O requests.
+// A multiple of the logical block size of all common devices.
+const size_t kDirectIOAlignment = 4096;
+
+// Buffers appends to a file opened with direct I/O so that they're written
+// as aligned requests.
+//
+// Not thread-safe.
+class DirectFileWriter {
+ public:
+  // Appended data is written to 'file' beginning at 'offset', which must be
+  // aligned. 'buffer_size' is the size of the largest write that is issued,
+  // and must be a non-zero multiple of kDirectIOAlignment.
+  //
+  // 'file' must outlive the writer.
+  DirectFileWriter(RWFile* file, uint64_t offset, size_t buffer_size);
+
+  ~DirectFileWriter();
+
+  // Appends 'data', writing out the buffer each time it fills up.
+  Status Append(const Slice& data);
+
+  // Writes out all appended data which hasn't been written yet.
+  //
+  // The last partial alignment unit is padded with zeros, so afterwards the
+  // file may extend up to kDirectIOAlignment - 1 bytes past the appended
+  // data. Any further appends overwrite the padding.
+  Status Flush();
+
+  // The number of bytes appended so far.
+  uint64_t bytes_appended() const { return bytes_appended_; }
+
+ private:
+  // Writes out the first 'length' bytes of the buffer, which must be
+  // aligned.
+  Status WriteBuffer(size_t length);
+
+  RWFile* file_;
+
+  // The file offset at which the buffer's contents belong.
+  uint64_t buffer_offset_;
+
+  const size_t buffer_size_;
+
+  // Aligned to kDirectIOAlignment.
+  uint8_t* buffer_;
+
+  // The number of bytes in 'buffer_' which haven't been written out, or
+  // which were written out with padding by Flush() and must be rewritten
+  // along with any further appends.
+  size_t buffered_;
+
+  // Whether data has been appended since the last Flush().
+  bool dirty_;
+
+  uint64_t bytes_appended_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectFileWriter);
+};
+
+// Reads into 'results' from 'file', which must have been opened with direct
+// I/O, beginning at 'offset', as RandomAccessFile::ReadV() does.
+//
+// The smallest aligned range of the file which encloses the requested bytes
+// is read into a temporary aligned buffer, from which they are copied.
+// Returns an IOError if the requested bytes aren't all in the file.
+Status DirectReadV(const RandomAccessFile* file, uint64_t offset,
+                   std::vector<Slice>* results);
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_DIRECT_IO_H
@@ -391,6 +391,10 @@ class ShortReadRandomAccessFile : public RandomAccessFile {
     return wrapped_->Read(offset, short_n, result, scratch);
   }
 
+  virtual Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE {
+    return wrapped_->ReadV(offset, results);
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     return wrapped_->Size(size);
   }
@@ -452,6 +456,55 @@ TEST_F(TestEnv, TestReadFully) {
   ASSERT_STR_CONTAINS(status.ToString(), "EOF");
 }
 
+TEST_F(TestEnv, TestReadV) {
+  const string kTestPath = GetTestPath("test");
+  const int kFileSize = 64 * 1024;
+  Env* env = Env::Default();
+
+  WriteTestFile(env, kTestPath, kFileSize);
+  ASSERT_NO_FATAL_FAILURE();
+
+  shared_ptr<RandomAccessFile> raf;
+  ASSERT_OK(env_util::OpenFileForRandom(env, kTestPath, &raf));
+  unique_ptr<RWFile> rwf;
+  RWFileOptions opts;
+  opts.mode = Env::OPEN_EXISTING;
+  ASSERT_OK(env->NewRWFile(opts, kTestPath, &rwf));
+
+  // Slices of various sizes, including an empty one, read back to back.
+  const vector<size_t> kSizes = { 1, 4096, 0, 10000, 7 };
+  size_t total = 0;
+  for (size_t size : kSizes) {
+    total += size;
+  }
+  unique_ptr<uint8_t[]> scratch(new uint8_t[total]);
+  const uint64_t kOffset = 123;
+  for (int i = 0; i < 2; i++) {
+    vector<Slice> results;
+    uint8_t* dst = scratch.get();
+    for (size_t size : kSizes) {
+      results.emplace_back(dst, size);
+      dst += size;
+    }
+    if (i == 0) {
+      ASSERT_OK(raf->ReadV(kOffset, &results));
+    } else {
+      ASSERT_OK(rwf->ReadV(kOffset, &results));
+    }
+    ASSERT_EQ(kSizes.size(), results.size());
+    ASSERT_NO_FATAL_FAILURE(VerifyTestData(Slice(scratch.get(), total), kOffset));
+  }
+
+  // Reading past the end of the file fails with an IOError.
+  vector<Slice> results = { Slice(scratch.get(), 100), Slice(scratch.get() + 100, 100) };
+  Status s = raf->ReadV(kFileSize - 150, &results);
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "EOF");
+  s = rwf->ReadV(kFileSize - 150, &results);
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "EOF");
+}
+
 TEST_F(TestEnv, TestAppendVector) {
   WritableFileOptions opts;
   LOG(INFO) << "Testing AppendVector() only, NO pre-allocation";
@@ -371,6 +371,15 @@ class RandomAccessFile {
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       uint8_t *scratch) const = 0;
 
+  // Reads exactly the sum of the sizes of 'results' contiguous bytes from
+  // the file starting at 'offset', filling each slice's buffer in turn, as
+  // if each were read with its own Read() call. Unlike Read(), retries on
+  // short reads, and returns an IOError if the end of the file is reached
+  // before all of the slices are filled.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status ReadV(uint64_t offset, std::vector<Slice>* results) const = 0;
+
   // Returns the size of the file
   virtual Status Size(uint64_t *size) const = 0;
 
@@ -397,7 +406,16 @@ struct WritableFileOptions {
 
 // Options specified when a file is opened for random access.
 struct RandomAccessFileOptions {
-  RandomAccessFileOptions() {}
+  // Read with direct I/O, bypassing the operating system's page cache. The
+  // buffers, offsets and lengths of all reads must then be suitably aligned
+  // (see kudu/util/direct_io.h).
+  //
+  // Opening fails with Status::NotSupported() if the platform or filesystem
+  // doesn't support direct I/O.
+  bool direct_io;
+
+  RandomAccessFileOptions()
+    : direct_io(false) { }
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -442,6 +460,10 @@ class WritableFile {
   // return a meaningful status.
   virtual Status Flush(FlushMode mode) = 0;
 
+  // Flushes all dirty data and metadata to disk.
+  //
+  // May be called concurrently with Append() and AppendVector(), in which
+  // case only the data appended before the call is guaranteed to be durable.
   virtual Status Sync() = 0;
 
   virtual uint64_t Size() const = 0;
@@ -463,9 +485,14 @@ struct RWFileOptions {
   // See CreateMode for details.
   Env::CreateMode mode;
 
+  // Read and write with direct I/O, bypassing the operating system's page
+  // cache. See RandomAccessFileOptions::direct_io.
+  bool direct_io;
+
   RWFileOptions()
     : sync_on_close(false),
-      mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE) { }
+      mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE),
+      direct_io(false) { }
 };
 
 // A file abstraction for both reading and writing. No notion of a built-in
@@ -502,6 +529,14 @@ class RWFile {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const = 0;
 
+  // Reads exactly the sum of the sizes of 'results' contiguous bytes from
+  // the file starting at 'offset', filling each slice's buffer in turn.
+  // Like Read(), retries on EINTR and short reads, and returns an IOError if
+  // the bytes can't all be read.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status ReadV(uint64_t offset, std::vector<Slice>* results) const = 0;
+
   // Writes 'data' to the file position given by 'offset'.
   virtual Status Write(uint64_t offset, const Slice& data) = 0;
 
@@ -584,6 +619,10 @@ class FileLock {
 extern Status WriteStringToFile(Env* env, const Slice& data,
                                 const std::string& fname);
 
+// Like WriteStringToFile(), but also syncs the file.
+extern Status WriteStringToFileSync(Env* env, const Slice& data,
+                                    const std::string& fname);
+
 // A utility routine: read contents of named file into *data
 extern Status ReadFileToString(Env* env, const std::string& fname,
                                faststring* data);
@@ -224,9 +224,41 @@ static Status DoSync(int fd, const string& filename) {
   return Status::OK();
 }
 
-static Status DoOpen(const string& filename, Env::CreateMode mode, int* fd) {
+// Adds O_DIRECT to 'flags' if 'direct_io' is set. Returns NotSupported if
+// the platform doesn't support direct I/O.
+static Status AddDirectIOFlag(const string& filename, bool direct_io, int* flags) {
+  if (!direct_io) {
+    return Status::OK();
+  }
+#if defined(O_DIRECT)
+  *flags |= O_DIRECT;
+  return Status::OK();
+#else
+  return Status::NotSupported("direct I/O is not supported on this platform", filename);
+#endif
+}
+
+// Opens 'filename' with open(2), translating the EINVAL with which
+// filesystems reject O_DIRECT into NotSupported.
+static Status OpenWithFlags(const string& filename, int flags, int* fd) {
+  const int f = open(filename.c_str(), flags, 0644);
+  if (f < 0) {
+    int err = errno;
+#if defined(O_DIRECT)
+    if (err == EINVAL && (flags & O_DIRECT)) {
+      return Status::NotSupported("filesystem does not support direct I/O", filename);
+    }
+#endif
+    return IOError(filename, err);
+  }
+  *fd = f;
+  return Status::OK();
+}
+
+static Status DoOpen(const string& filename, Env::CreateMode mode, bool direct_io, int* fd) {
   ThreadRestrictions::AssertIOAllowed();
   int flags = O_RDWR;
+  RETURN_NOT_OK(AddDirectIOFlag(filename, direct_io, &flags));
   switch (mode) {
     case Env::CREATE_IF_NON_EXISTING_TRUNCATE:
       flags |= O_CREAT | O_TRUNC;
@@ -239,11 +271,82 @@ static Status DoOpen(const string& filename, Env::CreateMode mode, int* fd) {
     default:
       return Status::NotSupported(Substitute("Unknown create mode $0", mode));
   }
-  const int f = open(filename.c_str(), flags, 0644);
-  if (f < 0) {
-    return IOError(filename, errno);
+  return OpenWithFlags(filename, flags, fd);
+}
+
+// Reads 'results' from 'fd' starting at 'offset', retrying on short reads
+// until every slice is filled. Returns an IOError at EOF.
+static Status DoReadV(int fd, const string& filename, uint64_t offset,
+                      vector<Slice>* results) {
+  ThreadRestrictions::AssertIOAllowed();
+  size_t total = 0;
+  for (const Slice& result : *results) {
+    total += result.size();
   }
-  *fd = f;
+  if (total == 0) {
+    return Status::OK();
+  }
+  const uint64_t start_offset = offset;
+
+#if defined(__linux__)
+  // Copy the slices into iovecs, which are advanced past partially-filled
+  // buffers after short reads.
+  vector<struct iovec> iov(results->size());
+  for (size_t i = 0; i < results->size(); i++) {
+    iov[i].iov_base = (*results)[i].mutable_data();
+    iov[i].iov_len = (*results)[i].size();
+  }
+  size_t cur = 0;
+  size_t rem = total;
+  while (rem > 0) {
+    // Skip over any filled (or empty) buffers.
+    while (iov[cur].iov_len == 0) {
+      cur++;
+    }
+    int iov_count = std::min<size_t>(iov.size() - cur, IOV_MAX);
+    ssize_t r;
+    RETRY_ON_EINTR(r, preadv(fd, &iov[cur], iov_count, offset));
+    if (PREDICT_FALSE(r < 0)) {
+      return IOError(filename, errno);
+    }
+    if (PREDICT_FALSE(r == 0)) {
+      return Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
+                                        total, start_offset));
+    }
+    DCHECK_LE(r, rem);
+    rem -= r;
+    offset += r;
+    size_t n = r;
+    while (n > 0) {
+      size_t consumed = std::min(n, iov[cur].iov_len);
+      iov[cur].iov_base = static_cast<uint8_t*>(iov[cur].iov_base) + consumed;
+      iov[cur].iov_len -= consumed;
+      n -= consumed;
+      if (iov[cur].iov_len == 0) {
+        cur++;
+      }
+    }
+  }
+#else
+  for (Slice& result : *results) {
+    uint8_t* dst = result.mutable_data();
+    size_t rem = result.size();
+    while (rem > 0) {
+      ssize_t r;
+      RETRY_ON_EINTR(r, pread(fd, dst, rem, offset));
+      if (PREDICT_FALSE(r < 0)) {
+        return IOError(filename, errno);
+      }
+      if (PREDICT_FALSE(r == 0)) {
+        return Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
+                                          total, start_offset));
+      }
+      dst += r;
+      rem -= r;
+      offset += r;
+    }
+  }
+#endif
   return Status::OK();
 }
 
@@ -311,6 +414,10 @@ class PosixRandomAccessFile: public RandomAccessFile {
     return s;
   }
 
+  virtual Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE {
+    return DoReadV(fd_, filename_, offset, results);
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     TRACE_EVENT1("io", "PosixRandomAccessFile::Size", "path", filename_);
     ThreadRestrictions::AssertIOAllowed();
@@ -366,7 +473,7 @@ class PosixWritableFile : public WritableFile {
       s = DoWritev(data_vector, i, n);
     }
 
-    pending_sync_ = true;
+    pending_sync_.Store(true);
     return s;
   }
 
@@ -402,7 +509,7 @@ class PosixWritableFile : public WritableFile {
       RETRY_ON_EINTR(ret, ftruncate(fd_, filesize_));
       if (ret != 0) {
         s = IOError(filename_, errno);
-        pending_sync_ = true;
+        pending_sync_.Store(true);
       }
     }
 
@@ -450,8 +557,7 @@ class PosixWritableFile : public WritableFile {
     TRACE_EVENT1("io", "PosixWritableFile::Sync", "path", filename_);
     ThreadRestrictions::AssertIOAllowed();
     LOG_SLOW_EXECUTION(WARNING, 1000, Substitute("sync call for $0", filename_)) {
-      if (pending_sync_) {
-        pending_sync_ = false;
+      if (pending_sync_.CompareAndSwap(true, false)) {
         RETURN_NOT_OK(DoSync(fd_, filename_));
       }
     }
@@ -533,7 +639,8 @@ class PosixWritableFile : public WritableFile {
   uint64_t filesize_;
   uint64_t pre_allocated_size_;
 
-  bool pending_sync_;
+  // Atomic so that Sync() may be called concurrently with appends.
+  AtomicBool pending_sync_;
 };
 
 class PosixRWFile : public RWFile {
@@ -577,6 +684,10 @@ class PosixRWFile : public RWFile {
     return Status::OK();
   }
 
+  virtual Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE {
+    return DoReadV(fd_, filename_, offset, results);
+  }
+
   virtual Status Write(uint64_t offset, const Slice& data) OVERRIDE {
     MAYBE_RETURN_FAILURE(FLAGS_env_inject_io_error_on_write_or_preallocate,
                          Status::IOError(Env::kInjectedFailureStatusMsg));
@@ -782,10 +893,10 @@ class PosixEnv : public Env {
                                      unique_ptr<RandomAccessFile>* result) OVERRIDE {
     TRACE_EVENT1("io", "PosixEnv::NewRandomAccessFile", "path", fname);
     ThreadRestrictions::AssertIOAllowed();
-    int fd = open(fname.c_str(), O_RDONLY);
-    if (fd < 0) {
-      return IOError(fname, errno);
-    }
+    int flags = O_RDONLY;
+    RETURN_NOT_OK(AddDirectIOFlag(fname, opts.direct_io, &flags));
+    int fd;
+    RETURN_NOT_OK(OpenWithFlags(fname, flags, &fd));
 
     result->reset(new PosixRandomAccessFile(fname, fd));
     return Status::OK();
@@ -801,7 +912,7 @@ class PosixEnv : public Env {
                                  unique_ptr<WritableFile>* result) OVERRIDE {
     TRACE_EVENT1("io", "PosixEnv::NewWritableFile", "path", fname);
     int fd;
-    RETURN_NOT_OK(DoOpen(fname, opts.mode, &fd));
+    RETURN_NOT_OK(DoOpen(fname, opts.mode, /* direct_io= */ false, &fd));
     return InstantiateNewWritableFile(fname, fd, opts, result);
   }
 
@@ -828,7 +939,7 @@ class PosixEnv : public Env {
                            unique_ptr<RWFile>* result) OVERRIDE {
     TRACE_EVENT1("io", "PosixEnv::NewRWFile", "path", fname);
     int fd;
-    RETURN_NOT_OK(DoOpen(fname, opts.mode, &fd));
+    RETURN_NOT_OK(DoOpen(fname, opts.mode, opts.direct_io, &fd));
     result->reset(new PosixRWFile(fname, fd, opts.sync_on_close));
     return Status::OK();
   }
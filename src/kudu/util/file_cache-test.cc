@@ -223,6 +223,32 @@ TYPED_TEST(FileCacheTest, TestDeletion) {
   ASSERT_EQ(this->initial_open_fds_, CountOpenFds(this->env_));
 }
 
+TYPED_TEST(FileCacheTest, TestInvalidate) {
+  const string kFile = this->GetTestPath("foo");
+  const string kTmpFile = this->GetTestPath("foo.tmp");
+  const string kData1 = "test data 1";
+  const string kData2 = "new test data";
+  ASSERT_OK(this->WriteTestFile(kFile, kData1));
+
+  shared_ptr<TypeParam> f;
+  ASSERT_OK(this->cache_->OpenExistingFile(kFile, &f));
+  uint64_t size;
+  ASSERT_OK(f->Size(&size));
+  ASSERT_EQ(kData1.size(), size);
+
+  // Replace the file. Until the cache is invalidated, the descriptor keeps
+  // using the replaced file.
+  ASSERT_OK(this->WriteTestFile(kTmpFile, kData2));
+  ASSERT_OK(this->env_->RenameFile(kTmpFile, kFile));
+  ASSERT_OK(f->Size(&size));
+  ASSERT_EQ(kData1.size(), size);
+
+  this->cache_->Invalidate(kFile);
+  ASSERT_OK(f->Size(&size));
+  ASSERT_EQ(kData2.size(), size);
+  ASSERT_EQ(this->initial_open_fds_ + 1, CountOpenFds(this->env_));
+}
+
 TYPED_TEST(FileCacheTest, TestHeavyReads) {
   const int kNumFiles = 20;
   const int kNumIterations = 100;
@@ -20,6 +20,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include <gflags/gflags.h>
 
@@ -117,7 +118,7 @@ class BaseDescriptor {
            &file_ptr,
            sizeof(file_ptr));
     return ScopedOpenedDescriptor<FileType>(this, Cache::UniqueHandle(
-        cache()->Insert(pending, file_cache_->eviction_cb_.get()),
+        cache()->Insert(pending, file_cache_->eviction_cb_.get(), Cache::NORMAL_PRIORITY),
         Cache::HandleDeleter(cache())));
   }
 
@@ -213,6 +214,12 @@ class Descriptor<RWFile> : public RWFile {
     return opened.file()->Read(offset, length, result, scratch);
   }
 
+  Status ReadV(uint64_t offset, std::vector<Slice>* results) const override {
+    ScopedOpenedDescriptor<RWFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->ReadV(offset, results);
+  }
+
   Status Write(uint64_t offset, const Slice& data) override {
     ScopedOpenedDescriptor<RWFile> opened(&base_);
     RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
@@ -326,6 +333,12 @@ class Descriptor<RandomAccessFile> : public RandomAccessFile {
     return opened.file()->Read(offset, n, result, scratch);
   }
 
+  Status ReadV(uint64_t offset, std::vector<Slice>* results) const override {
+    ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->ReadV(offset, results);
+  }
+
   Status Size(uint64_t *size) const override {
     ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
     RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
@@ -463,6 +476,11 @@ Status FileCache<FileType>::DeleteFile(const string& file_name) {
   return env_->DeleteFile(file_name);
 }
 
+template <class FileType>
+void FileCache<FileType>::Invalidate(const string& file_name) {
+  cache_->Erase(file_name);
+}
+
 template <class FileType>
 int FileCache<FileType>::NumDescriptorsForTests() const {
   std::lock_guard<simple_spinlock> l(lock_);
@@ -559,6 +577,8 @@ Status FileCache<RWFile>::OpenExistingFile(
 template
 Status FileCache<RWFile>::DeleteFile(const string& file_name);
 template
+void FileCache<RWFile>::Invalidate(const string& file_name);
+template
 int FileCache<RWFile>::NumDescriptorsForTests() const;
 template
 string FileCache<RWFile>::ToDebugString() const;
@@ -580,6 +600,8 @@ Status FileCache<RandomAccessFile>::OpenExistingFile(
 template
 Status FileCache<RandomAccessFile>::DeleteFile(const string& file_name);
 template
+void FileCache<RandomAccessFile>::Invalidate(const string& file_name);
+template
 int FileCache<RandomAccessFile>::NumDescriptorsForTests() const;
 template
 string FileCache<RandomAccessFile>::ToDebugString() const;
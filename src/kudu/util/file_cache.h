@@ -130,6 +130,14 @@ class FileCache {
   // deleted immediately.
   Status DeleteFile(const std::string& file_name);
 
+  // Closes the cached open file for 'file_name', if any, so that descriptors
+  // for it reopen the file by name the next time they're used.
+  //
+  // Used when a file is replaced by renaming another file over it; without
+  // this, descriptors might keep using the replaced file. File operations
+  // that are already in progress are unaffected.
+  void Invalidate(const std::string& file_name);
+
   // Returns the number of entries in the descriptor map.
   //
   // Only intended for unit tests.